@@ -0,0 +1,33 @@
+#version 330 core
+
+// Instanced glyphs (see vktuto_glyphs.h): a small base mesh per shape,
+// placed by per-instance attributes
+layout(location = 0) in vec3 glyphVertex;
+layout(location = 1) in vec4 instancePositionScale;
+layout(location = 2) in vec3 instanceDirection;
+layout(location = 3) in vec4 instanceColor;
+
+uniform mat4 MVP;
+// Markers are sized in pixels; arrows span their direction vector
+uniform bool screenSized;
+uniform float unitsPerPixel;
+
+out vec4 Frag_Color;
+
+void main() {
+	vec3 offset;
+	if (screenSized) {
+		offset = glyphVertex * instancePositionScale.w * unitsPerPixel;
+	} else {
+		vec3 axis = instanceDirection * instancePositionScale.w;
+		float len = length(axis);
+		// Any frame with z along the arrow; the head is symmetric
+		vec3 z = len > 0.0 ? axis / len : vec3(0.0, 0.0, 1.0);
+		vec3 helper = abs(z.x) < 0.9 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0);
+		vec3 x = normalize(cross(helper, z));
+		vec3 y = cross(z, x);
+		offset = mat3(x, y, z) * glyphVertex * len;
+	}
+	gl_Position = MVP * vec4(instancePositionScale.xyz + offset, 1.0);
+	Frag_Color = instanceColor;
+}
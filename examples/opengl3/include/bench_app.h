@@ -0,0 +1,101 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "opengl3_base.h"
+#include "nurbs/nurbs.h"
+#include "vktuto_geometry_jobs.h"
+#include "vktuto_nurbs.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+struct BenchmarkOptions {
+  HeadlessOptions headless;
+  // Frames per phase, after a few warm-up frames
+  unsigned int frames = 300;
+  // Surface samples per direction
+  unsigned int grid = 257;
+  // Canvas magnification around the middle of the patch; 1 frames it all
+  float zoom = 1.0f;
+  // Glyphs spread over the surface, half markers and half normal arrows
+  unsigned int glyphs = 0;
+  // Small surfaces added to the mesh arena, tiled over the frame
+  unsigned int patches = 0;
+  // Optional outputs: the last canvas as binary PPM, results as CSV
+  std::string image_file;
+  std::string csv_file;
+};
+
+// Headless canvas benchmark for CI: tessellates a fixed surface, then times
+// frames while only drawing, while re-uploading the whole mesh every frame
+// while updating a band of vertices every frame, while tessellating it
+// again and again a few rows per frame within the work budget
+// (IncrementalTessellation) and while editing the
+// surface with a background re-tessellation per frame (live preview, with
+// GeometryWorker). Prints one line per
+// phase to stdout; Run() returns when all phases are done. With a render
+// thread (HeadlessOptions::render_thread) the frame times are those of the
+// UI thread, and the render times show what the render thread did.
+class BenchmarkApp : public BaseApp {
+ public:
+  explicit BenchmarkApp(const BenchmarkOptions &options);
+  virtual ~BenchmarkApp();
+
+ protected:
+  virtual void Initialize() override;
+  virtual void Update() override;
+  virtual void Cleanup() override;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  enum class Phase {
+    kWarmup, kDraw, kUpload, kPartialUpload, kIncremental, kPreview, kDone
+  };
+
+  struct PhaseResult {
+    const char *name;
+    std::vector<double> frame_ms;
+    double      seconds = 0.0;
+    UploadStats uploads;
+    // GPU time of the canvas draw, over the profiler history (the last
+    // frames of the phase); no samples without timer queries
+    ProfileSummary gpu_canvas;
+    // CPU time of the frames the renderer drew, commands included; with a
+    // render thread, frames merged into later ones are not among them
+    ProfileSummary render;
+  };
+
+  BenchmarkOptions options_;
+  nurbs::RationalSurface3f surface_;
+  std::vector<glm::vec3>   positions_, normals_;
+  double tessellation_ms_ = 0.0;
+
+  IncrementalTessellation incremental_;
+  size_t incremental_surfaces_ = 0, incremental_frames_ = 0;
+
+  GeometryWorker  geometry_;
+  SurfaceGeometry preview_;
+  size_t          preview_jobs_ = 0, preview_results_ = 0;
+  double          preview_job_ms_ = 0.0;
+
+  Phase        phase_ = Phase::kWarmup;
+  unsigned int frame_ = 0;
+  Clock::time_point last_frame_;
+  std::vector<PhaseResult> results_;
+
+  void BeginPhase(Phase phase);
+  void EndPhase();
+  // Scales heights by 'scale' <= 1, which keeps vertices inside the
+  // quantization box of the original mesh
+  void AnimateRows(unsigned int row_begin, unsigned int row_end, float scale);
+  void Report();
+  void WriteImage();
+}; // class BenchmarkApp
+
+} // inline namespace opengl3
+
+} // namespace vktuto
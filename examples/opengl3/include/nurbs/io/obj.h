@@ -13,6 +13,7 @@
 #include "../core/surface.h"
 #include "../util/util.h"
 #include "../util/array2.h"
+#include "obj_writer.h"
 
 namespace nurbs {
 
@@ -124,7 +125,7 @@ void CurveReadOBJ(const std::string &filename, unsigned int &deg, std::vector<T>
         }
         ssline.clear();
     }
-    file.CloseTo();
+    file.close();
 
     // Check if necessary data was available in file
     if (!parsed.cstype) {
@@ -328,34 +329,11 @@ template <typename T>
 void CurveSaveOBJ(const std::string &filename, unsigned int degree,
                   const std::vector<T>& knots, const std::vector<glm::vec<3, T>> &ctrlPts,
                   const std::vector<T> &weights, bool rational) {
-    using std::endl;
-    std::ofstream fout(filename);
-
-    for (int i = 0; i < ctrlPts.size(); ++i) {
-        fout << "v " << ctrlPts[i].x << " " << ctrlPts[i].y << " " << ctrlPts[i].z <<
-             " " << weights[i] << endl;
-    }
-
-    int n_knots = knots.size();
-    int n_cp = ctrlPts.size();
-
-    if (!rational) {
-        fout << "cstype bspline" << endl;
-    }
-    else {
-        fout << "cstype rat bspline" << endl;
-    }
-    fout << "deg " << degree << endl << "curv ";
-    fout << knots[degree] << " " << knots[n_knots - degree - 1];
-    for (int i = 0; i < n_cp; ++i) {
-        fout << " " << i + 1;
-    }
-    fout << endl << "parm u";
-    for (auto knot : knots) {
-        fout << " " << knot;
-    }
-    fout << endl << "end";
-    fout.CloseTo();
+    ObjWriter::Options options;
+    options.shortest_round_trip = false;
+    ObjWriter writer(filename, options);
+    writer.WriteCurve(degree, knots, ctrlPts, weights, rational);
+    writer.Flush();
 }
 
 /**
@@ -372,48 +350,11 @@ void CurveSaveOBJ(const std::string &filename, unsigned int degree,
 template <typename T>
 void SurfaceSaveOBJ(const std::string &filename, unsigned int deg_u, unsigned int deg_v, const std::vector<T>& knots_u, const std::vector<T>& knots_v,
                     const array2<glm::vec<3, T>> &ctrlPts, const array2<T> &weights, bool rational) {
-
-    using std::endl;
-    std::ofstream fout(filename);
-
-    if (ctrlPts.rows() == 0 || ctrlPts.cols() == 0) {
-        return;
-    }
-
-    for (int j = 0; j < ctrlPts.cols(); j++) {
-        for (int i = 0; i < ctrlPts.rows(); i++) {
-            fout << "v " << ctrlPts(i, j).x << " " << ctrlPts(i, j).y << " " << ctrlPts(i, j).z << " " << weights(i, j) << endl;
-        }
-    }
-
-    int nknots_u = knots_u.size();
-    int nknots_v = knots_v.size();
-
-    int nCpU = ctrlPts.rows();
-    int nCpV = ctrlPts.cols();
-
-    if (!rational) {
-        fout << "cstype bspline" << endl;
-    }
-    else {
-        fout << "cstype rat bspline" << endl;
-    }
-    fout << "deg " << deg_u << " " << deg_v << endl << "surf ";
-    fout << knots_u[deg_u] << " " << knots_u[nknots_u - deg_u - 1] << " "
-         << knots_v[deg_v] << " " << knots_v[nknots_v - deg_v - 1];
-    for (int i = 0; i < nCpU*nCpV; i++) {
-        fout << " " << i + 1;
-    }
-    fout << endl << "parm u";
-    for (auto knot : knots_u) {
-        fout << " " << knot;
-    }
-    fout << endl << "parm v";
-    for (auto knot : knots_v) {
-        fout << " " << knot;
-    }
-    fout << endl << "end";
-    fout.close();
+    ObjWriter::Options options;
+    options.shortest_round_trip = false;
+    ObjWriter writer(filename, options);
+    writer.WriteSurface(deg_u, deg_v, knots_u, knots_v, ctrlPts, weights, rational);
+    writer.Flush();
 }
 
 } // namespace internal
@@ -0,0 +1,470 @@
+/**
+@file
+@brief Reading every free-form curve and surface of a Wavefront OBJ file that
+holds many `curv`/`surf` blocks sharing one vertex pool.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "glm/glm.hpp"
+#include "../core/curve.h"
+#include "../core/surface.h"
+#include "../util/array2.h"
+#include "../util/thread_pool.h"
+
+namespace nurbs {
+
+/**
+ * All free-form objects of an OBJ file, in file order.
+ * @tparam T Data type of control points and knots (float or double)
+ */
+template <typename T>
+struct ObjScene {
+    std::vector<RationalCurve<3, T>> curves;
+    std::vector<RationalSurface<3, T>> surfaces;
+};
+
+/////////////////////////////////////////////////////////////////////
+
+namespace internal {
+
+/**
+ * Tokenizer over one logical OBJ line. A trailing `\` joins the next physical
+ * line and `#` starts a comment.
+ */
+class ObjLineTokens {
+public:
+    ObjLineTokens(const char *begin, const char *end) : p_(begin), end_(end) {
+    }
+
+    /**
+     * Read the next token of the logical line.
+     * @param[out] token The token
+     * @return false at the end of the logical line
+     */
+    bool Next(std::string_view &token) {
+        for (;;) {
+            while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r')) {
+                ++p_;
+            }
+            if (p_ == end_ || *p_ == '\n') {
+                return false;
+            }
+            if (*p_ == '#') {
+                while (p_ < end_ && *p_ != '\n') {
+                    ++p_;
+                }
+                return false;
+            }
+            const char *start = p_;
+            while (p_ < end_ && *p_ != ' ' && *p_ != '\t' && *p_ != '\r' && *p_ != '\n') {
+                ++p_;
+            }
+            token = std::string_view(start, p_ - start);
+            if (token != "\\") {
+                return true;
+            }
+            // Line continuation: skip to the start of the next physical line
+            while (p_ < end_ && *p_ != '\n') {
+                ++p_;
+            }
+            if (p_ < end_) {
+                ++p_;
+            }
+        }
+    }
+
+    /**
+     * Skip the rest of the logical line.
+     * @return Start of the next logical line
+     */
+    const char * SkipLine() {
+        std::string_view token;
+        while (Next(token)) {
+        }
+        return p_ < end_ ? p_ + 1 : end_;
+    }
+
+private:
+    const char *p_;
+    const char *end_;
+};
+
+/**
+ * Convert a token to a number, throwing on malformed input: the whole token
+ * must be the number, so "3x" or "1.5e" are rejected too.
+ */
+template <typename V>
+V ObjToNumber(std::string_view token) {
+    V value{};
+    const char *first = token.data();
+    if (!token.empty() && token.front() == '+') {
+        ++first;
+    }
+    const char *last = token.data() + token.size();
+    auto res = std::from_chars(first, last, value);
+    if (res.ec != std::errc() || res.ptr != last) {
+        throw std::runtime_error("Malformed number '" + std::string(token) + "' in OBJ file");
+    }
+    return value;
+}
+
+/**
+ * Byte range of consecutive `v` lines whose vertices are stored from
+ * first_index on.
+ */
+struct ObjVertexChunk {
+    const char *begin, *end;
+    size_t first_index;
+    size_t count;
+};
+
+/**
+ * Byte range of one free-form block, from its `curv`/`surf` line to its `end`
+ * line, together with the state attributes that were active at its start.
+ */
+struct ObjFreeformBlock {
+    const char *begin, *end;
+    bool is_surface;
+    bool rational;
+    unsigned int deg_u, deg_v;
+    size_t num_vertices_before;
+    size_t output_index;
+};
+
+/**
+ * Result of the sequential first pass over the file.
+ */
+struct ObjLayout {
+    std::vector<ObjVertexChunk> vertex_chunks;
+    std::vector<ObjFreeformBlock> blocks;
+    size_t num_vertices = 0;
+    size_t num_curves = 0;
+    size_t num_surfaces = 0;
+};
+
+/**
+ * First pass: find the vertex lines and the block boundaries. Only the
+ * `cstype` and `deg` attributes are decoded here; everything else is left to
+ * the parallel second pass.
+ * @param begin Start of the file contents
+ * @param end End of the file contents
+ * @param vertices_per_chunk Maximum number of vertices per vertex chunk
+ * @param cancel Optional flag, checked every few thousand lines; once set the
+ * scan stops and returns an empty layout
+ */
+inline ObjLayout ScanOBJ(const char *begin, const char *end,
+                         size_t vertices_per_chunk = 16384,
+                         const std::atomic<bool> *cancel = nullptr) {
+    constexpr size_t kLinesPerCancelCheck = 4096;
+    ObjLayout layout;
+    size_t num_lines = 0;
+    bool rational = false;
+    unsigned int deg_u = 0, deg_v = 0;
+    ObjFreeformBlock *open_block = nullptr;
+    ObjVertexChunk *open_chunk = nullptr;
+
+    const char *line = begin;
+    while (line < end) {
+        if (cancel != nullptr && ++num_lines % kLinesPerCancelCheck == 0 && *cancel) {
+            return ObjLayout();
+        }
+        ObjLineTokens tokens(line, end);
+        std::string_view keyword;
+        if (!tokens.Next(keyword)) {
+            line = tokens.SkipLine();
+            continue;
+        }
+        const char *next_line;
+        if (keyword == "v") {
+            next_line = tokens.SkipLine();
+            if (open_chunk == nullptr || open_chunk->count == vertices_per_chunk) {
+                layout.vertex_chunks.push_back({line, next_line, layout.num_vertices, 0});
+                open_chunk = &layout.vertex_chunks.back();
+            }
+            open_chunk->end = next_line;
+            ++open_chunk->count;
+            ++layout.num_vertices;
+            line = next_line;
+            continue;
+        }
+
+        if (keyword == "cstype") {
+            std::string_view token1, token2;
+            if (tokens.Next(token1)) {
+                if (token1 == "bspline") {
+                    rational = false;
+                }
+                else if (token1 == "rat" && tokens.Next(token2) && token2 == "bspline") {
+                    rational = true;
+                }
+            }
+        }
+        else if (keyword == "deg") {
+            std::string_view token;
+            if (tokens.Next(token)) {
+                deg_u = ObjToNumber<unsigned int>(token);
+                deg_v = tokens.Next(token) ? ObjToNumber<unsigned int>(token) : 0;
+            }
+        }
+        else if (keyword == "curv" || keyword == "surf") {
+            bool is_surface = keyword == "surf";
+            size_t &counter = is_surface ? layout.num_surfaces : layout.num_curves;
+            if (open_block != nullptr) {
+                // Missing 'end': the previous block stops here
+                open_block->end = line;
+            }
+            layout.blocks.push_back({line, end, is_surface, rational, deg_u, deg_v,
+                                     layout.num_vertices, counter++});
+            open_block = &layout.blocks.back();
+        }
+        else if (keyword == "end") {
+            if (open_block != nullptr) {
+                open_block->end = tokens.SkipLine();
+                open_block = nullptr;
+            }
+        }
+        next_line = tokens.SkipLine();
+        // A vertex chunk only spans consecutive vertex lines
+        open_chunk = nullptr;
+        line = next_line;
+    }
+    return layout;
+}
+
+/**
+ * Parse one chunk of `v` lines into its slots of the shared vertex table.
+ */
+template <typename T>
+void ParseVertexChunk(const ObjVertexChunk &chunk, std::vector<glm::vec<3, T>> &points,
+                      std::vector<T> &weights) {
+    size_t index = chunk.first_index;
+    const char *line = chunk.begin;
+    while (line < chunk.end) {
+        ObjLineTokens tokens(line, chunk.end);
+        std::string_view token;
+        if (tokens.Next(token) && token == "v") {
+            T coords[4] = {0, 0, 0, 1};
+            for (int i = 0; i < 4 && tokens.Next(token); ++i) {
+                coords[i] = ObjToNumber<T>(token);
+            }
+            points[index] = glm::vec<3, T>(coords[0], coords[1], coords[2]);
+            weights[index] = coords[3];
+            ++index;
+        }
+        line = tokens.SkipLine();
+    }
+}
+
+/**
+ * Parse one free-form block, resolving its vertex references against the
+ * completed vertex table.
+ * @param block Block found by ScanOBJ
+ * @param points Vertex positions of the whole file
+ * @param[out] indices Zero-based vertex indices of the block
+ * @param[out] knots_u Knot vector along u
+ * @param[out] knots_v Knot vector along v
+ */
+template <typename T>
+void ParseFreeformBlock(const ObjFreeformBlock &block,
+                        const std::vector<glm::vec<3, T>> &points,
+                        std::vector<size_t> &indices,
+                        std::vector<T> &knots_u, std::vector<T> &knots_v) {
+    indices.clear();
+    knots_u.clear();
+    knots_v.clear();
+
+    const char *line = block.begin;
+    while (line < block.end) {
+        ObjLineTokens tokens(line, block.end);
+        std::string_view keyword, token;
+        if (tokens.Next(keyword)) {
+            if (keyword == "curv" || keyword == "surf") {
+                // Skip the parameter range
+                int num_range = keyword == "surf" ? 4 : 2;
+                for (int i = 0; i < num_range && tokens.Next(token); ++i) {
+                }
+                while (tokens.Next(token)) {
+                    // Surface points may be v/vt/vn; only v is used
+                    std::string_view vertex = token.substr(0, token.find('/'));
+                    long long ref = ObjToNumber<long long>(vertex);
+                    long long idx = ref > 0 ? ref - 1
+                                            : static_cast<long long>(block.num_vertices_before) + ref;
+                    if (ref == 0 || idx < 0 || static_cast<size_t>(idx) >= points.size()) {
+                        throw std::runtime_error("Vertex reference " + std::string(token) +
+                                                 " out of range");
+                    }
+                    indices.push_back(static_cast<size_t>(idx));
+                }
+            }
+            else if (keyword == "parm" && tokens.Next(token)) {
+                std::vector<T> *knots = token == "u" ? &knots_u
+                                                     : token == "v" ? &knots_v : nullptr;
+                while (knots != nullptr && tokens.Next(token)) {
+                    knots->push_back(ObjToNumber<T>(token));
+                }
+            }
+        }
+        line = tokens.SkipLine();
+    }
+}
+
+/**
+ * Build the scene from a scanned layout using the given pool.
+ * @param cancel Optional flag, checked before every chunk and block; once set
+ * the scene comes back empty
+ */
+template <typename T>
+ObjScene<T> ParseOBJLayout(const ObjLayout &layout, util::ThreadPool &pool,
+                           const std::atomic<bool> *cancel = nullptr) {
+    auto cancelled = [cancel] { return cancel != nullptr && *cancel; };
+    // Pass 2: every chunk owns a disjoint slice of the vertex table, so the
+    // table is filled without any locking.
+    std::vector<glm::vec<3, T>> points(layout.num_vertices);
+    std::vector<T> weights(layout.num_vertices);
+    pool.ParallelFor(layout.vertex_chunks.size(), [&](size_t i) {
+        if (!cancelled()) {
+            ParseVertexChunk(layout.vertex_chunks[i], points, weights);
+        }
+    });
+    if (cancelled()) {
+        return ObjScene<T>();
+    }
+
+    // Pass 3: blocks write into the slot reserved for them by the scan, so
+    // the result does not depend on the number of threads.
+    ObjScene<T> scene;
+    scene.curves.resize(layout.num_curves);
+    scene.surfaces.resize(layout.num_surfaces);
+    pool.ParallelFor(layout.blocks.size(), [&](size_t i) {
+        if (cancelled()) {
+            return;
+        }
+        const ObjFreeformBlock &block = layout.blocks[i];
+        std::vector<size_t> indices;
+        std::vector<T> knots_u, knots_v;
+        try {
+            ParseFreeformBlock(block, points, indices, knots_u, knots_v);
+            if (!block.is_surface) {
+                int num_cp = static_cast<int>(knots_u.size()) - static_cast<int>(block.deg_u) - 1;
+                if (num_cp <= 0 || static_cast<size_t>(num_cp) > indices.size()) {
+                    throw std::runtime_error("'curv'/'parm u' lines do not match 'deg'");
+                }
+                RationalCurve<3, T> &crv = scene.curves[block.output_index];
+                crv.degree = block.deg_u;
+                crv.knots = std::move(knots_u);
+                crv.control_points.resize(num_cp);
+                crv.weights.resize(num_cp);
+                for (int k = 0; k < num_cp; ++k) {
+                    crv.control_points[k] = points[indices[k]];
+                    crv.weights[k] = weights[indices[k]];
+                }
+            }
+            else {
+                int num_cp_u = static_cast<int>(knots_u.size()) - static_cast<int>(block.deg_u) - 1;
+                int num_cp_v = static_cast<int>(knots_v.size()) - static_cast<int>(block.deg_v) - 1;
+                if (num_cp_u <= 0 || num_cp_v <= 0 ||
+                        static_cast<size_t>(num_cp_u) * num_cp_v > indices.size()) {
+                    throw std::runtime_error("'surf'/'parm' lines do not match 'deg'");
+                }
+                RationalSurface<3, T> &srf = scene.surfaces[block.output_index];
+                srf.degree_u = block.deg_u;
+                srf.degree_v = block.deg_v;
+                srf.knots_u = std::move(knots_u);
+                srf.knots_v = std::move(knots_v);
+                srf.control_points.resize(num_cp_u, num_cp_v);
+                srf.weights.resize(num_cp_u, num_cp_v);
+                size_t num = 0;
+                for (int j = 0; j < num_cp_v; ++j) {
+                    for (int k = 0; k < num_cp_u; ++k) {
+                        srf.control_points(k, j) = points[indices[num]];
+                        srf.weights(k, j) = weights[indices[num]];
+                        ++num;
+                    }
+                }
+            }
+        }
+        catch (const std::exception &e) {
+            throw std::runtime_error(std::string(block.is_surface ? "Surface " : "Curve ") +
+                                     std::to_string(block.output_index) + ": " + e.what());
+        }
+    });
+    if (cancelled()) {
+        return ObjScene<T>();
+    }
+    return scene;
+}
+
+} // namespace internal
+
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * Read all free-form curves and surfaces from OBJ data held in memory.
+ * A sequential pass finds vertex runs and block boundaries, then vertices and
+ * blocks are parsed in parallel on the pool.
+ * @param begin Start of the OBJ text
+ * @param end End of the OBJ text
+ * @param pool Thread pool to parse on
+ * @param cancel Optional flag that stops the parse when set, from any thread
+ * @return Curves and surfaces in file order, none if cancelled
+ */
+template <typename T>
+ObjScene<T> SceneParseOBJ(const char *begin, const char *end, util::ThreadPool &pool,
+                          const std::atomic<bool> *cancel = nullptr) {
+    internal::ObjLayout layout = internal::ScanOBJ(begin, end, 16384, cancel);
+    return internal::ParseOBJLayout<T>(layout, pool, cancel);
+}
+
+/**
+ * Read all free-form curves and surfaces from a Wavefront OBJ file.
+ * @param filename Name of the file
+ * @param pool Thread pool to parse on
+ * @param cancel Optional flag that stops reading and parsing when set, from
+ * any thread
+ * @return Curves and surfaces in file order, none if cancelled
+ */
+template <typename T>
+ObjScene<T> SceneReadOBJ(const std::string &filename, util::ThreadPool &pool,
+                         const std::atomic<bool> *cancel = nullptr) {
+    // Bytes read between checks of 'cancel'
+    constexpr size_t kReadBlockSize = size_t(16) << 20;
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file) {
+        throw std::runtime_error("File not found: " + filename);
+    }
+    std::string contents(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0, std::ios::beg);
+    for (size_t offset = 0; offset < contents.size(); offset += kReadBlockSize) {
+        if (cancel != nullptr && *cancel) {
+            return ObjScene<T>();
+        }
+        file.read(&contents[offset], std::min(kReadBlockSize, contents.size() - offset));
+    }
+    file.close();
+    return SceneParseOBJ<T>(contents.data(), contents.data() + contents.size(), pool,
+                            cancel);
+}
+
+/**
+ * Read all free-form curves and surfaces from a Wavefront OBJ file.
+ * @param filename Name of the file
+ * @param num_threads Number of parser threads, 0 for one per hardware thread
+ * @return Curves and surfaces in file order
+ */
+template <typename T>
+ObjScene<T> SceneReadOBJ(const std::string &filename, unsigned int num_threads = 0) {
+    util::ThreadPool pool(num_threads);
+    return SceneReadOBJ<T>(filename, pool);
+}
+
+} // namespace nurbs
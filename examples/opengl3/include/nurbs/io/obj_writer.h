@@ -0,0 +1,346 @@
+/**
+@file
+@brief Buffered Wavefront OBJ writer for curves and surfaces that formats
+numbers with std::to_chars and writes many objects into one file.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "glm/glm.hpp"
+#include "../core/curve.h"
+#include "../core/surface.h"
+#include "../util/array2.h"
+#include "obj_scene.h"
+
+namespace nurbs {
+
+/**
+ * Writes curves and surfaces into one OBJ file. Text is formatted into a
+ * reusable buffer that is flushed to disk in large blocks, so writing does
+ * not allocate per value. Vertex references of each object are offset by the
+ * vertices already written, so any number of objects can share the file.
+ */
+class ObjWriter {
+public:
+    /// Most significant digits a number is written with
+    static constexpr int kMaxPrecision = 25;
+
+    struct Options {
+        /// Size of the formatting buffer in bytes
+        size_t buffer_size = size_t(1) << 20;
+        /// Shortest representation that reads back to the same value
+        bool shortest_round_trip = true;
+        /// Significant digits when shortest_round_trip is off (as iostreams);
+        /// at most kMaxPrecision, larger values are clamped
+        int precision = 6;
+    };
+
+    explicit ObjWriter(const std::string &filename) : ObjWriter(filename, Options()) {
+    }
+
+    ObjWriter(const std::string &filename, const Options &options)
+        : file_(filename, std::ios::binary), filename_(filename), options_(options),
+          buffer_(std::max<size_t>(options.buffer_size, kMaxTokenSize * 2)) {
+        if (!file_) {
+            throw std::runtime_error("Could not open file: " + filename);
+        }
+        options_.precision = std::min(options_.precision, kMaxPrecision);
+    }
+
+    ObjWriter(const ObjWriter &) = delete;
+    ObjWriter & operator=(const ObjWriter &) = delete;
+
+    /**
+     * Flushes what is left; errors are lost here, so call Flush() first to
+     * see them.
+     */
+    ~ObjWriter() {
+        try {
+            Flush();
+        }
+        catch (...) {
+        }
+    }
+
+    /**
+     * Number of vertices written so far.
+     */
+    size_t num_vertices() const {
+        return num_vertices_;
+    }
+
+    /**
+     * Write the buffered text to the file, throwing if it could not be
+     * written (a full disk, for one).
+     */
+    void Flush() {
+        if (used_ > 0) {
+            WriteBuffer();
+        }
+        file_.flush();
+        CheckStream();
+    }
+
+    /**
+     * Write a curve block.
+     * @param degree Degree of the curve
+     * @param knots Knot vector of the curve
+     * @param ctrlPts Array of control points
+     * @param weights Array of corresponding weights
+     * @param rational Whether rational
+     */
+    template <typename T>
+    void WriteCurve(unsigned int degree, const std::vector<T> &knots,
+                    const std::vector<glm::vec<3, T>> &ctrlPts,
+                    const std::vector<T> &weights, bool rational) {
+        size_t first = num_vertices_ + 1;
+        for (size_t i = 0; i < ctrlPts.size(); ++i) {
+            WriteVertex(ctrlPts[i], weights[i]);
+        }
+        WriteCsType(rational);
+        Put("deg ");
+        PutInt(degree);
+        Put("\ncurv ");
+        PutReal(knots[degree]);
+        PutChar(' ');
+        PutReal(knots[knots.size() - degree - 1]);
+        for (size_t i = 0; i < ctrlPts.size(); ++i) {
+            PutChar(' ');
+            PutInt(first + i);
+        }
+        PutChar('\n');
+        WriteParm('u', knots);
+        Put("end\n");
+    }
+
+    /**
+     * Write a surface block.
+     * @param deg_u Degree of the surface along u-direction
+     * @param deg_v Degree of the surface along v-direction
+     * @param knots_u Knot vector of the surface along u-direction
+     * @param knots_v Knot vector of the surface along v-direction
+     * @param ctrlPts 2D grid of control points
+     * @param weights 2D grid of corresponding weights
+     * @param rational Whether rational
+     */
+    template <typename T>
+    void WriteSurface(unsigned int deg_u, unsigned int deg_v,
+                      const std::vector<T> &knots_u, const std::vector<T> &knots_v,
+                      const array2<glm::vec<3, T>> &ctrlPts, const array2<T> &weights,
+                      bool rational) {
+        if (ctrlPts.rows() == 0 || ctrlPts.cols() == 0) {
+            return;
+        }
+        size_t first = num_vertices_ + 1;
+        for (size_t j = 0; j < ctrlPts.cols(); j++) {
+            for (size_t i = 0; i < ctrlPts.rows(); i++) {
+                WriteVertex(ctrlPts(i, j), weights(i, j));
+            }
+        }
+        WriteCsType(rational);
+        Put("deg ");
+        PutInt(deg_u);
+        PutChar(' ');
+        PutInt(deg_v);
+        Put("\nsurf ");
+        PutReal(knots_u[deg_u]);
+        PutChar(' ');
+        PutReal(knots_u[knots_u.size() - deg_u - 1]);
+        PutChar(' ');
+        PutReal(knots_v[deg_v]);
+        PutChar(' ');
+        PutReal(knots_v[knots_v.size() - deg_v - 1]);
+        for (size_t i = 0; i < ctrlPts.size(); i++) {
+            PutChar(' ');
+            PutInt(first + i);
+        }
+        PutChar('\n');
+        WriteParm('u', knots_u);
+        WriteParm('v', knots_v);
+        Put("end\n");
+    }
+
+    /**
+     * Write a non-rational curve.
+     */
+    template <int dim, typename T>
+    void Write(const Curve<dim, T> &crv) {
+        std::vector<T> w(crv.control_points.size(), T(1));
+        if constexpr (dim == 3) {
+            WriteCurve(crv.degree, crv.knots, crv.control_points, w, false);
+        }
+        else {
+            WriteCurve(crv.degree, crv.knots, To3D(crv.control_points), w, false);
+        }
+    }
+
+    /**
+     * Write a rational curve.
+     */
+    template <int dim, typename T>
+    void Write(const RationalCurve<dim, T> &crv) {
+        if constexpr (dim == 3) {
+            WriteCurve(crv.degree, crv.knots, crv.control_points, crv.weights, true);
+        }
+        else {
+            WriteCurve(crv.degree, crv.knots, To3D(crv.control_points), crv.weights, true);
+        }
+    }
+
+    /**
+     * Write a non-rational surface.
+     */
+    template <typename T>
+    void Write(const Surface<3, T> &srf) {
+        array2<T> w(srf.control_points.rows(), srf.control_points.cols(), T(1));
+        WriteSurface(srf.degree_u, srf.degree_v, srf.knots_u, srf.knots_v,
+                     srf.control_points, w, false);
+    }
+
+    /**
+     * Write a rational surface.
+     */
+    template <typename T>
+    void Write(const RationalSurface<3, T> &srf) {
+        WriteSurface(srf.degree_u, srf.degree_v, srf.knots_u, srf.knots_v,
+                     srf.control_points, srf.weights, true);
+    }
+
+private:
+    // Longest formatted number (a double in scientific notation with sign)
+    static constexpr size_t kMaxTokenSize = 32;
+    // Sign, point and "e-308" take the rest
+    static_assert(kMaxPrecision + 7 <= kMaxTokenSize,
+                  "kMaxPrecision digits must fit a token");
+
+    std::ofstream file_;
+    std::string filename_;
+    Options options_;
+    std::vector<char> buffer_;
+    size_t used_ = 0;
+    size_t num_vertices_ = 0;
+
+    void CheckStream() const {
+        if (!file_) {
+            throw std::runtime_error("Could not write file: " + filename_);
+        }
+    }
+
+    void WriteBuffer() {
+        file_.write(buffer_.data(), used_);
+        used_ = 0;
+        CheckStream();
+    }
+
+    char * Reserve(size_t n) {
+        if (used_ + n > buffer_.size()) {
+            WriteBuffer();
+            if (n > buffer_.size()) {
+                buffer_.resize(n);
+            }
+        }
+        return buffer_.data() + used_;
+    }
+
+    void Put(const char *str) {
+        size_t n = std::strlen(str);
+        std::memcpy(Reserve(n), str, n);
+        used_ += n;
+    }
+
+    void PutChar(char c) {
+        *Reserve(1) = c;
+        ++used_;
+    }
+
+    // Keeps the number std::to_chars() formatted at 'first'
+    void Commit(char *first, std::to_chars_result result) {
+        if (result.ec != std::errc()) {
+            throw std::runtime_error("Could not format a number for: " + filename_);
+        }
+        used_ += result.ptr - first;
+    }
+
+    void PutInt(unsigned long long value) {
+        char *first = Reserve(kMaxTokenSize);
+        Commit(first, std::to_chars(first, first + kMaxTokenSize, value));
+    }
+
+    template <typename T>
+    void PutReal(T value) {
+        char *first = Reserve(kMaxTokenSize);
+        Commit(first, options_.shortest_round_trip
+            ? std::to_chars(first, first + kMaxTokenSize, value)
+            : std::to_chars(first, first + kMaxTokenSize, value,
+                            std::chars_format::general, options_.precision));
+    }
+
+    template <typename T>
+    void WriteVertex(const glm::vec<3, T> &pt, T w) {
+        Put("v ");
+        PutReal(pt.x);
+        PutChar(' ');
+        PutReal(pt.y);
+        PutChar(' ');
+        PutReal(pt.z);
+        PutChar(' ');
+        PutReal(w);
+        PutChar('\n');
+        ++num_vertices_;
+    }
+
+    void WriteCsType(bool rational) {
+        Put(rational ? "cstype rat bspline\n" : "cstype bspline\n");
+    }
+
+    template <typename T>
+    void WriteParm(char dir, const std::vector<T> &knots) {
+        Put("parm ");
+        PutChar(dir);
+        for (auto knot : knots) {
+            PutChar(' ');
+            PutReal(knot);
+        }
+        PutChar('\n');
+    }
+
+    template <int dim, typename T>
+    static std::vector<glm::vec<3, T>> To3D(const std::vector<glm::vec<dim, T>> &pts) {
+        std::vector<glm::vec<3, T>> cp(pts.size(), glm::vec<3, T>(0));
+        for (size_t i = 0; i < pts.size(); ++i) {
+            for (int j = 0; j < dim; ++j) {
+                cp[i][j] = pts[i][j];
+            }
+        }
+        return cp;
+    }
+};
+
+/**
+ * Save every curve and surface of a scene into one Wavefront OBJ file.
+ * @param filename Name of the file
+ * @param scene Curves and surfaces to save
+ * @param options Buffering and number formatting options
+ */
+template <typename T>
+void SceneSaveOBJ(const std::string &filename, const ObjScene<T> &scene,
+                  const ObjWriter::Options &options = ObjWriter::Options()) {
+    ObjWriter writer(filename, options);
+    for (const auto &crv : scene.curves) {
+        writer.Write(crv);
+    }
+    for (const auto &srf : scene.surfaces) {
+        writer.Write(srf);
+    }
+    writer.Flush();
+}
+
+} // namespace nurbs
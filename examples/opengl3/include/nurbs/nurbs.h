@@ -10,3 +10,5 @@
 #include "core/check.h"
 #include "core/modify.h"
 #include "io/obj.h"
+#include "io/obj_scene.h"
+#include "io/obj_writer.h"
@@ -6,6 +6,7 @@ weights of surfaces.
 
 #pragma once
 
+#include <cassert>
 #include <vector>
 #include <stdexcept>
 
@@ -0,0 +1,174 @@
+/**
+@file
+@brief A small fixed-size thread pool used for data-parallel work such as
+parsing large files or tessellating many patches.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace nurbs {
+namespace util {
+
+/**
+ * Fixed-size pool of worker threads fed by a FIFO task queue.
+ */
+class ThreadPool {
+public:
+    /**
+     * Start the worker threads.
+     * @param num_threads Number of workers. 0 selects the number of hardware
+     * threads.
+     */
+    explicit ThreadPool(unsigned int num_threads = 0) {
+        if (num_threads == 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        workers_.reserve(num_threads);
+        for (unsigned int i = 0; i < num_threads; ++i) {
+            workers_.emplace_back([this] { WorkerLoop(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    /**
+     * Finish the queued tasks and join the workers.
+     */
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto &worker : workers_) {
+            worker.join();
+        }
+    }
+
+    /**
+     * Number of worker threads.
+     */
+    size_t size() const {
+        return workers_.size();
+    }
+
+    /**
+     * Queue a task.
+     * @param task Callable without arguments
+     * @return Future holding the result (or exception) of the task
+     */
+    template <typename F>
+    std::future<typename std::invoke_result<F>::type> Submit(F &&task) {
+        using R = typename std::invoke_result<F>::type;
+        auto packaged = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        std::future<R> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.emplace_back([packaged] { (*packaged)(); });
+        }
+        cv_.notify_one();
+        return result;
+    }
+
+    /**
+     * Call fn(i) for every i in [0, count) and wait for all calls to return.
+     * Items are handed out through an atomic counter, so the calling thread
+     * takes part as well and the call never deadlocks when issued from a
+     * worker. The first exception thrown (by item index) is rethrown.
+     * @param count Number of items
+     * @param fn Callable taking the item index
+     */
+    template <typename F>
+    void ParallelFor(size_t count, F &&fn) {
+        if (count == 0) {
+            return;
+        }
+        struct State {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> done{0};
+            std::vector<std::exception_ptr> errors;
+            std::mutex mutex;
+            std::condition_variable cv;
+        };
+        auto state = std::make_shared<State>();
+        state->errors.resize(count);
+
+        auto run = [state, count, &fn] {
+            size_t idx;
+            while ((idx = state->next.fetch_add(1)) < count) {
+                try {
+                    fn(idx);
+                }
+                catch (...) {
+                    state->errors[idx] = std::current_exception();
+                }
+                if (state->done.fetch_add(1) + 1 == count) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->cv.notify_all();
+                }
+            }
+        };
+
+        size_t helpers = std::min(count - 1, workers_.size());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < helpers; ++i) {
+                tasks_.emplace_back(run);
+            }
+        }
+        cv_.notify_all();
+        run();
+
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->cv.wait(lock, [&] { return state->done.load() == count; });
+        }
+        for (auto &error : state->errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+
+    void WorkerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                if (stop_ && tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+} // namespace util
+
+} // namespace nurbs
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 // dear imgui:
 //  standalone example for GLFW + OpenGL 3, using programmable pipeline
@@ -13,22 +18,7 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 
-// About OpenGL function loaders:
-//  modern OpenGL doesn't have a standard header file and requires individual
-//  function pointers to be loaded manually. 
-//  Helper libraries are often used for this purpose!
-//  Here we are supporting a few common ones: gl3w, glew, glad.
-//  You may use another loader/header of your choice (glext, glLoadGen, etc.),
-//  or chose to manually implement your own.
-#if defined(IMGUI_IMPL_OPENGL_LOADER_GL3W)
-#include <GL/gl3w.h>    // Initialize with gl3wInit()
-#elif defined(IMGUI_IMPL_OPENGL_LOADER_GLEW)
-#include <GL/glew.h>    // Initialize with glewInit()
-#elif defined(IMGUI_IMPL_OPENGL_LOADER_GLAD)
-#include <glad/glad.h>  // Initialize with gladLoadGL()
-#else
-#include IMGUI_IMPL_OPENGL_LOADER_CUSTOM
-#endif
+#include "vktuto_gl.h"
 
 // Include glfw3.h after our OpenGL definitions
 #include "GLFW/glfw3.h"
@@ -47,21 +37,84 @@
 
 // utility
 #include "vktuto_utility.h"
+#include "vktuto_gl_buffer.h"
+#include "vktuto_vertex_format.h"
+#include "vktuto_grid_index.h"
+#include "vktuto_glyphs.h"
+#include "vktuto_grid_lod.h"
+#include "vktuto_mesh_arena.h"
+#include "vktuto_font_cache.h"
+#include "vktuto_glyph_set.h"
+#include "vktuto_headless.h"
+#include "vktuto_profiler.h"
+#include "vktuto_program_cache.h"
+#include "vktuto_render_thread.h"
 
 namespace vktuto {
 
 inline namespace opengl3 {
 
+// Runs the app without a window: no GLFW and no ImGui windows, only the
+// canvas framebuffer, drawn once per Update() until Quit()
+struct HeadlessOptions {
+  unsigned int    width = VKTUTO_WINDOW_WIDTH;
+  unsigned int    height = VKTUTO_WINDOW_HEIGHT;
+  HeadlessBackend backend = VKTUTO_HEADLESS_BACKEND;
+  // Draw on a render thread, as windows do with VKTUTO_RENDER_THREAD
+  bool            render_thread = false;
+  FramePacing     pacing = VKTUTO_FRAME_PACING;
+  // Program binary cache directory ("" for none); clearing it first
+  // measures a cold start
+  std::string     program_cache = VKTUTO_PROGRAM_CACHE_DIRECTORY;
+  bool            clear_program_cache = false;
+};
+
+// Startup settings of the windowed app
+struct WindowOptions {
+  // Prebaked font atlas file ("" for none); removing it first measures a
+  // cold start
+  std::string font_cache = VKTUTO_FONT_CACHE_FILE;
+  bool        clear_font_cache = false;
+};
+
 class BaseApp
 {
  public:
-  BaseApp();
+  explicit BaseApp(const WindowOptions &window = WindowOptions());
+  explicit BaseApp(const HeadlessOptions &headless);
   virtual ~BaseApp();
 
   void Run() {
-    MainLoop();
+    if (headless_) HeadlessLoop();
+    else           MainLoop();
   }
 
+  bool IsHeadless() const noexcept { return headless_ != nullptr; }
+  // True while Run() draws on a render thread
+  bool HasRenderThread() const noexcept { return render_thread_ != nullptr; }
+  const RenderThread * GetRenderThread() const { return render_thread_.get(); }
+  // Timings and counters of the last frames, written where OpenGL runs; read
+  // them under FrameProfiler::LockHistory() or in RunOnRenderThread()
+  FrameProfiler & GetProfiler() { return *profiler_; }
+  const FrameProfiler & GetProfiler() const { return *profiler_; }
+  // How the shader programs and the font atlas (windows only; its latest
+  // build) were made, and the time from the start of the constructor until
+  // the app was ready to Initialize()
+  const ProgramCacheStats & GetProgramStats() const { return program_stats_; }
+  const FontCacheStats & GetFontStats() const { return font_stats_; }
+  double StartupMilliseconds() const noexcept { return startup_ms_; }
+
+  // Why the canvas has to be drawn again, compared to the last time it was
+  // drawn; MainLoop() reuses the canvas texture while this is 0
+  enum CanvasChange : unsigned int {
+    kCanvasCamera   = 1 << 0,  // GetCamX() ... GetRotY()
+    kCanvasGeometry = 1 << 1,  // uploads, grid indices, mesh color
+    kCanvasDrawMode = 1 << 2,
+    kCanvasSize     = 1 << 3,
+    kCanvasForced   = 1 << 4   // MarkCanvasDirty()
+  };
+  unsigned int CanvasChanges() const noexcept;
+
  protected:
   utility::ConsoleApp console;
 
@@ -69,40 +122,138 @@ class BaseApp
   virtual void Update()     = 0 {}
   virtual void Cleanup()    = 0 {}
 
+  // nullptr in headless mode
   GLFWwindow * GetWindow() { return window_; };
+  // Ends Run() after the current frame
+  void Quit();
+  // Redraws the canvas on the next frame, for changes BaseApp cannot see
+  void MarkCanvasDirty() noexcept { canvas_forced_ = true; }
+  // True keeps MainLoop() drawing frames without waiting for input, e.g.
+  // while a background job shows its progress
+  virtual bool IsAnimating() const { return false; }
+  // Work spread over frames, like IncrementalTessellation::Step(), stops at
+  // this time: WorkBudgetMs() after the start of the current Update()
+  std::chrono::steady_clock::time_point WorkDeadline() const noexcept {
+    return work_deadline_;
+  }
+  double & WorkBudgetMs() noexcept { return work_budget_ms_; }
+
+  // BaseApp records its OpenGL work and runs it where the context is
+  // current: on the render thread, if there is one, when the frame is
+  // handed over. Runs 'run' there after everything recorded so far and
+  // waits for it; for OpenGL calls of derived classes.
+  void RunOnRenderThread(const std::function<void()> &run);
+  // Waits until everything recorded so far has reached the GPU and is done
+  void FinishRendering() { RunOnRenderThread([] { glFinish(); }); }
 
   bool & ShowDemo() noexcept { return show_demo_window_; }
+  bool & ShowProfiler() noexcept { return show_profiler_; }
 
+  // Valid for the current frame. Bold and thin fonts are loaded on first
+  // use: until the next frame the normal font stands in.
   ImFont * GetNormalFont() const noexcept { 
     return font_map.at(VkTutoFontFlag::Normal).im_font;
   }
-  ImFont * GetBoldFont() const noexcept {
-    return font_map.at(VkTutoFontFlag::Bold).im_font;
-  }
-  ImFont * GetThinFont() const noexcept {
-    return font_map.at(VkTutoFontFlag::Thin).im_font;
-  }
+  ImFont * GetBoldFont() noexcept { return GetFont(VkTutoFontFlag::Bold); }
+  ImFont * GetThinFont() noexcept { return GetFont(VkTutoFontFlag::Thin); }
+  // The fonts only have the glyphs asked for so far. Typed and pasted text
+  // and console lines ask for theirs; other text the UI shows should be
+  // passed here, and gets its glyphs from the next frame on.
+  void RequestGlyphs(const char *text, const char *text_end = nullptr);
 
   //const int GetCustomProg() const noexcept { return program_; }
   //const int GetVAO() const noexcept { return vao_; }
   //const int GetVBOPosition() const noexcept { return vbo_position_; }
   //const int GetVBOColor() const noexcept { return vbo_color_; }
   //const int GetIBO() const noexcept { return ibo_; }
-  void BindBuffers() const;
-  void BindBuffers2() const;
+  void BindBuffers();
+  void BindBuffers2();
+  void BindGlyphs();
+
+  // Further meshes, kept in a shared buffer arena and drawn in a few batched
+  // calls next to the surface mesh (see vktuto_mesh_arena.h). AddMesh()
+  // reorders triangle lists for the vertex cache and logs the gain.
+  MeshHandle AddMesh(const ArenaMesh &mesh);
+  MeshHandle AddGridMesh(unsigned int num_u, unsigned int num_v,
+                         const glm::vec3 *positions, const glm::vec3 *normals,
+                         const glm::vec4 &color);
+  void RemoveMesh(MeshHandle mesh);
+  size_t NumMeshes() const noexcept { return num_meshes_; }
+  // Render thread only, see RunOnRenderThread()
+  const MeshArena & GetMeshArena() const { return *arena_; }
+  // Re-uploads vertices [first, first + count) of GetVertices() after an
+  // edit that kept the vertex count, without touching the rest of the mesh
+  void UpdateVertices(size_t first, size_t count);
+  // Surface grid that arrives a few rows at a time: BeginGridRows() replaces
+  // the surface mesh with an empty num_u x num_v grid whose positions should
+  // stay within [lower, upper], AppendGridRows() adds its next rows (with
+  // normals if 'normals' was set). The finished rows are drawn as they come;
+  // the last ones upload the grid like BindBuffers(), level of detail and
+  // all. Fills GetVertices() and GetNormals() on the way.
+  void BeginGridRows(unsigned int num_u, unsigned int num_v,
+                     const glm::vec3 &lower, const glm::vec3 &upper,
+                     bool normals);
+  void AppendGridRows(const glm::vec3 *positions, const glm::vec3 *normals,
+                      unsigned int num_rows);
+
+  // Draws the surface mesh as a num_u x num_v vertex grid with a shared,
+  // cached index buffer instead of GetIndices(). Sizes below 2 switch back
+  // to GetIndices().
+  void SetGridIndices(unsigned int num_u, unsigned int num_v,
+                      GridTopology topology = VKTUTO_GRID_TOPOLOGY);
+  // View-dependent level of detail for SetGridIndices() grids: each patch
+  // of the grid is drawn at the coarsest level that stays within
+  // 'tolerance' pixels of the full grid (see vktuto_grid_lod.h)
+  void SetGridLod(bool enabled);
+  bool GridLodEnabled() const noexcept { return lod_enabled_; }
+  void SetLodTolerance(float pixels) {
+    lod_tolerance_ = pixels;
+    geometry_version_++;
+  }
+  // Puts every patch at one level, 0 the full grid, whatever the tolerance;
+  // -1 goes back to selecting by tolerance
+  void SetLodLevel(int level) {
+    lod_level_ = level;
+    geometry_version_++;
+  }
+  int LodLevel() const noexcept { return lod_level_; }
+  // Leaves out SetGridIndices() grid patches outside the view volume, the
+  // model rotation included
+  void SetFrustumCulling(bool enabled);
+  bool FrustumCullingEnabled() const noexcept { return cull_enabled_; }
+
+  // GetColors() is only used when it holds one color per vertex; otherwise
+  // the whole mesh takes the color set here
+  void SetMeshColor(const glm::vec4 &color) {
+    mesh_color_ = color;
+    geometry_version_++;
+  }
+  void SetVertexFormat(VertexFormat format) { vertex_format_ = format; }
 
   std::vector<glm::vec3> & GetVertices() { return vertices_; }
+  // Optional, one unit normal per vertex
+  std::vector<glm::vec3> & GetNormals() { return normals_; }
   std::vector<glm::vec3> & GetColors() { return colors_; }
   std::vector<GLuint>   & GetIndices() { return indices_; }
   std::vector<glm::vec3> & GetVertices2() { return vertices2_; }
   std::vector<glm::vec3> & GetColors2() { return colors2_; }
   std::vector<GLuint>   & GetIndices2() { return indices2_; }
+  // Instanced markers and arrows drawn over the meshes; BindGlyphs()
+  // uploads the glyphs of all shapes (see vktuto_glyphs.h)
+  std::vector<GlyphInstance> & GetGlyphs(GlyphShape shape) {
+    return glyph_instances_[static_cast<size_t>(shape)];
+  }
 
   const int GetFBO() const { return fbo_; }
   const int GetRBODepth() const { return rbo_depth_; }
   const int GetTexture() const { return texture_; }
   int & GetTextrueX() { return texture_x_; }
   int & GetTextrueY() { return texture_y_; }
+  // Reallocates the canvas color texture and depth buffer; keeps the camera
+  // height and adapts its width to the new aspect ratio
+  void ResizeCanvas(int width, int height);
+  // RGB rows of the last drawn canvas, bottom row first
+  void ReadCanvas(std::vector<uint8_t> &rgb);
 
   float & GetCamX() { return cam_x_; }
   float & GetCamY() { return cam_y_; }
@@ -121,13 +272,25 @@ class BaseApp
  private:
   const struct GLVersion { int major, minor; } gl_version_ /*= { 3, 0 }*/;
   const std::string glsl_version_;
-  GLFWwindow *window_;
+  GLFWwindow *window_ = nullptr;
+  std::unique_ptr<HeadlessContext> headless_;
+  HeadlessOptions headless_options_;
+  bool quit_ = false;
+  double startup_ms_ = 0.0;
+  ProgramCacheStats program_stats_;
+  FontCacheStats font_stats_;
   bool show_demo_window_ = false;
+  bool show_profiler_ = false;
+  std::unique_ptr<FrameProfiler> profiler_;
   glm::vec4 clear_color_ = glm::vec4(VKTUTO_CLEAR_COLOR);
   struct Font {
     std::string file;
     ImFont *im_font;
     float size;
+    // In the atlas: from the start, or since first used (bold and thin)
+    bool wanted = false;
+    // The font file, read when first wanted
+    std::vector<char> data;
   };
   enum class VkTutoFontFlag { Normal = 0, SolidIcon, BrandIcon, Bold, Thin };
   std::unordered_map<VkTutoFontFlag, Font> font_map = {
@@ -137,18 +300,135 @@ class BaseApp
     {VkTutoFontFlag::Bold,      {VKTUTO_FONT_BOLD_PATH,       nullptr, 22.f}},
     {VkTutoFontFlag::Thin,      {VKTUTO_FONT_THIN_PATH,       nullptr, 18.f}}
   };
+  // Codepoints of the text fonts and their ranges as last built
+  GlyphSet font_glyphs_;
+  std::vector<ImWchar> font_ranges_;
+  // New glyphs or fonts are wanted: RefreshFonts() rebuilds the atlas
+  bool fonts_dirty_ = false;
+  // Number of the next console line to take glyphs from
+  uint64_t console_lines_seen_ = 0;
+  // Console commands: STATS prints the counters and their change since
+  // the last STATS, PROFILE copies the frames of the history as they come
+  std::unordered_map<std::string, double> stats_seen_;
+  bool profiling_ = false;
+  std::string profile_file_ = "profile.csv";
+  unsigned long long profile_next_frame_ = 0;
+  std::vector<FrameStats> profile_frames_;
+  // ImGui's clipboard functions, which BaseApp's wrap
+  const char * (*get_clipboard_text_)(void *user_data) = nullptr;
+  void (*set_clipboard_text_)(void *user_data, const char *text) = nullptr;
+  void *clipboard_user_data_ = nullptr;
   enum class GLDrawMode { Point = GL_POINT,
                           Line = GL_LINE,
                           Fill = GL_FILL } draw_mode = GLDrawMode::Fill;
 
+  // Inputs of the canvas as of its last CustomGLDraw() in MainLoop()
+  struct CanvasState {
+    float cam_x, cam_y, cam_width, cam_height, rotate_x, rotate_y;
+    int width, height;
+    GLDrawMode draw_mode;
+    unsigned long long geometry_version;
+    // Not compared, their setters bump geometry_version
+    glm::vec4 mesh_color;
+    float lod_tolerance;
+    int lod_level;
+  } canvas_drawn_ = {};
+  // Bumped by every change of the canvas meshes
+  unsigned long long geometry_version_ = 1;
+  bool canvas_forced_ = true;
+  double work_budget_ms_ = VKTUTO_WORK_BUDGET_MS;
+  std::chrono::steady_clock::time_point work_deadline_;
+  // Set by the window callbacks, cleared once a frame handled them
+  bool had_events_ = true;
+  int active_frames_ = VKTUTO_IDLE_FRAMES;
+
+  // What the render thread needs for one frame; the commands carry the
+  // OpenGL work recorded during the frame
+  struct Frame : FramePacket {
+    Frame() { has_frame = true; }
+    CanvasState  canvas;
+    bool         draw_canvas = false;
+    // Windows only
+    int          display_w = 0, display_h = 0;
+    glm::vec4    clear_color;
+    DrawDataCopy imgui;
+    // UI thread times, for the profiler
+    double       ui_ms[kNumProfileSections] = {};
+
+    // The UI thread remembered the canvas of the skipped frame as drawn:
+    // its redraw and its UI time move into this frame
+    void MergeSkipped(const FramePacket &skipped) override {
+      const Frame &frame = static_cast<const Frame &>(skipped);
+      draw_canvas |= frame.draw_canvas;
+      for (size_t idx = 0; idx < kNumProfileSections; idx++)
+        ui_ms[idx] += frame.ui_ms[idx];
+    }
+  };
+  // Keys of the render-side state that commands rewrite as a whole
+  enum CommandKey : uint32_t {
+    kSurfaceCommand = 1, kCurveCommand, kGlyphCommand, kCanvasSizeCommand,
+    kFontCommand
+  };
+  // Null while OpenGL runs on the UI thread
+  std::unique_ptr<RenderThread> render_thread_;
+  std::vector<RenderCommand> commands_;
+  std::unique_ptr<Frame> spare_frame_;
   GLuint program_;
-  GLuint vao_, vao2_;
-  GLuint vbo_position_, vbo_position2_;
-  GLuint vbo_color_, vbo_color2_;
-  GLuint ibo_, ibo2_;
-
-  std::vector<glm::vec3> vertices_, colors_, vertices2_, colors2_;
+  struct Uniforms {
+    GLint mvp, model;
+    GLint position_offset, position_scale;
+    GLint object_color, use_vertex_color, has_normals;
+    GLint skirt_first_vertex, skirt_depth;
+  } uniform_;
+  GLuint vao_;
+  // Interleaved vertices (see vktuto_vertex_format.h)
+  std::unique_ptr<StreamBuffer> vbo_vertex_;
+  std::unique_ptr<StreamBuffer> vbo_color_;
+  std::unique_ptr<StreamBuffer> ibo_;
+  // Curves (GetVertices2()) and AddMesh() meshes
+  std::unique_ptr<MeshArena> arena_;
+  MeshHandle curve_mesh_ = kInvalidMesh;
+  std::unique_ptr<GlyphRenderer> glyphs_;
+
+  // UI side: edited through the getters, sent by BindBuffers() and friends
+  std::vector<glm::vec3> vertices_, normals_, colors_, vertices2_, colors2_;
   std::vector<GLuint> indices_, indices2_;
+  std::vector<GlyphInstance> glyph_instances_[kNumGlyphShapes];
+  unsigned int grid_u_ = 0, grid_v_ = 0;
+  GridTopology grid_topology_ = VKTUTO_GRID_TOPOLOGY;
+  // Vertices of the last BindBuffers(), for UpdateVertices()
+  size_t bound_vertices_ = 0;
+  MeshHandle next_mesh_ = 0;
+  size_t num_meshes_ = 0;
+
+  VertexFormat vertex_format_ = VKTUTO_VERTEX_FORMAT;
+  glm::vec4 mesh_color_ = glm::vec4(1.0f);
+
+  // Render side: the surface as of the last BindBuffers(), with the edits
+  // of UpdateVertices() since
+  struct SurfaceData {
+    std::vector<glm::vec3> vertices, normals, colors;
+    std::vector<GLuint> indices;
+    VertexFormat format = VKTUTO_VERTEX_FORMAT;
+    unsigned int grid_u = 0, grid_v = 0;
+    GridTopology topology = VKTUTO_GRID_TOPOLOGY;
+    bool lod = false, cull = false;
+  } drawn_;
+  // AddMesh() handles to arena handles
+  std::unordered_map<MeshHandle, MeshHandle> arena_meshes_;
+  PackedVertices packed_;
+  std::unique_ptr<GridIndexCache> grid_cache_;
+  std::shared_ptr<const GridIndexBuffer> grid_;
+  // Set while a BeginGridRows() grid is incomplete: the indices of a band of
+  // rows, drawn once per band of the rows so far
+  std::shared_ptr<const GridIndexBuffer> row_band_;
+  // Grid patches for level of detail and culling; skirt copies follow the
+  // grid in packed_
+  std::unique_ptr<GridLod> lod_;
+  bool  lod_enabled_ = VKTUTO_GRID_LOD != 0;
+  bool  cull_enabled_ = VKTUTO_FRUSTUM_CULLING != 0;
+  float lod_tolerance_ = VKTUTO_LOD_TOLERANCE;
+  int   lod_level_ = -1;
 
   GLuint fbo_;
   GLuint rbo_depth_;
@@ -166,6 +446,8 @@ class BaseApp
   bool full_screen_ = false;
 
   static void ErrorCallback(int error, const char *description);
+  static void OnWindowEvent(GLFWwindow *window);
+  void InstallEventCallbacks(GLFWwindow *window);
   void InitGLFWWithErrorCallback() const noexcept(false);
   const GLVersion DecideGLVersion(
       int major_version, int minor_version) const noexcept;
@@ -177,7 +459,8 @@ class BaseApp
       unsigned int width,
       unsigned int height,
       const std::string &title) noexcept(false);
-  void InitGLLoader() const noexcept(false);
+  void InitGLLoader(HeadlessContext::GetProcAddressProc get_proc_address =
+                        nullptr) const noexcept(false);
 
   void SetupImGuiContext() const;
   void BindPlatformAndRenderer(
@@ -185,17 +468,73 @@ class BaseApp
       const std::string &glsl_version);
   
   void SetImguiStyle() const noexcept;
-  void LoadFonts();
+  // Adds the wanted fonts and builds the atlas through 'cache'
+  void LoadFonts(FontAtlasCache &cache);
+  void AddFont(ImFontAtlas &atlas, VkTutoFontFlag flag, bool merge,
+               const ImWchar *ranges);
+  ImFont * GetFont(VkTutoFontFlag flag) noexcept;
+  // Between frames: rebuilds the atlas for new glyphs and fonts, and
+  // records the texture upload
+  void RefreshFonts();
+
+  // STATS, PROFILE and LOD
+  void AddConsoleCommands();
+  void PrintStats();
+  void ProfileCommand(const std::vector<std::string> &args);
+  void LodCommand(const std::vector<std::string> &args);
+  // Frames of the history for PROFILE: the ones whose GPU times are in,
+  // or with 'all' the ones still waiting for them too
+  void CollectProfile(bool all);
 
   void MainLoop();
-
-  void InitCustomGL();
-  std::string ReadShaderFile(const char *file_name);
-  void CompileShader(const char *file_path, GLuint shader_ID);
-  GLuint LoadShaders(const char *vertex_file_path, const char *fragment_file_path);
+  void HeadlessLoop();
+  void ApplyDrawMode(GLDrawMode mode) const;
+
+  void MakeContextCurrent();
+  void ReleaseContext();
+  void StartRenderThread(FramePacing pacing);
+  // Brings the context back to the calling thread
+  void StopRenderThread();
+  void Record(std::function<void()> run, uint32_t key = 0, bool full = false);
+  std::unique_ptr<Frame> NewFrame();
+  // Hands the frame and the recorded commands to the render thread, or runs
+  // them right away without one
+  void SubmitFrame(std::unique_ptr<Frame> frame);
+  // Render side of a packet: its commands, then its frame
+  void RunPacket(const FramePacket &packet);
+  void DrawFrame(const Frame &frame);
+
+  void InitCustomGL(int width, int height);
   void DestroyCustomGL();
 
-  void CustomGLDraw();
+  void SetVertexAttributes(const PackedVertices &packed,
+                           const StreamBuffer &vbo_vertex,
+                           const StreamBuffer *vbo_color) const;
+  void SetMeshUniforms(const PackedVertices &packed, const glm::vec4 &color,
+                       bool use_vertex_color) const;
+  void SetArenaUniforms(bool has_normals) const;
+  // Render side of BindBuffers(), SetGridIndices() and UpdateVertices()
+  void UploadSurface();
+  void SetGrid(unsigned int num_u, unsigned int num_v, GridTopology topology);
+  void UploadVertexRange(size_t first, const std::vector<glm::vec3> &vertices,
+                         const std::vector<glm::vec3> &normals);
+  // Render side of BeginGridRows() and AppendGridRows()
+  void ReserveGridRows(const glm::vec3 &lower, const glm::vec3 &upper,
+                       bool normals);
+  void UploadGridRows(const std::vector<glm::vec3> &vertices,
+                      const std::vector<glm::vec3> &normals);
+  // Lays out packed_ for drawn_'s whole grid with the bounding box
+  // [lower, upper], a little enlarged
+  void PackGridBox(const glm::vec3 &lower, const glm::vec3 &upper,
+                   bool normals);
+  // Rebuilds or re-measures lod_ for the current grid and vertices
+  void PrepareGridLod();
+  bool GridLodActive() const noexcept;
+  // Copies skirt sources [begin, end) of lod_ behind the grid in packed_
+  void CopySkirtVertices(size_t begin, size_t end);
+  void CustomGLDraw(const CanvasState &canvas);
+  CanvasState CurrentCanvasState() const noexcept;
+  void RememberCanvasState() noexcept;
 }; // class BaseApp
 
 } // inline namespace opengl3
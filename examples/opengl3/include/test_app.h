@@ -1,6 +1,13 @@
 #pragma once
+
+#include <future>
+
 #include "opengl3_base.h"
 #include "nurbs/nurbs.h"
+#include "vktuto_geometry_jobs.h"
+#include "vktuto_loader.h"
+#include "vktuto_mesh_io.h"
+#include "vktuto_nurbs.h"
 
 namespace vktuto {
 
@@ -8,7 +15,7 @@ inline namespace opengl3 {
 
 class TestApp : public BaseApp {
  public:
-  TestApp();
+  explicit TestApp(const WindowOptions &window = WindowOptions());
   virtual ~TestApp();
 
  protected:
@@ -18,6 +25,17 @@ class TestApp : public BaseApp {
 
   virtual void ChangeOutData() override;
   virtual void ChangeOutData2() override;
+  // Control-net markers and curve frame arrows, from the shown primitives
+  void ChangeGlyphs();
+
+  // The progress bar of a background load moves without input, and
+  // geometry jobs, exports, incremental tessellation and BENCH finish
+  // without it
+  virtual bool IsAnimating() const override {
+    return model_loader_.Busy() || geometry_.SurfaceBusy() ||
+           geometry_.CurveBusy() || geometry_.ExportBusy() ||
+           incremental_.Active() || bench_.valid();
+  }
 
  private:
   ImGuiWindowFlags window_flags_ = 0;
@@ -26,15 +44,26 @@ class TestApp : public BaseApp {
   glm::vec3 boundary[4] = {
     glm::vec3(-1, -1, 0), glm::vec3(-1, 1, 0), glm::vec3(1, -1, 0), glm::vec3(1, 1, 0)
   };
+  // Control points per direction of the surface, and of the curve; the
+  // editors only lay out the rows in view, so large nets stay cheap
+  static constexpr int kMaxControlPoints = 2048;
   int num_surface_con_point_u = 5, num_surface_con_point_v = 5;
   int degree_u = 2, degree_v = 2;
+  // Set by the editor widgets: the net and the knots are laid out again. A
+  // load clears them, so the editor keeps the loaded ones.
+  bool surface_cp_changed = true, surface_degree_changed = true;
   unsigned int num_para_u = 0, num_para_v = 0;
   std::vector<glm::vec3> surface_points;
+  std::vector<glm::vec3> surface_normals;
   nurbs::RationalSurface3f surface_primitive;
   nurbs::array2<glm::vec3> surface_control_points;
 
+  static constexpr float kMarkerPixels = 9.0f;
+  bool show_control_points = true;
   bool show_tangent = false, show_normal = false, show_binormal = false;
   unsigned int num_curve_para = 0;
+  int num_curve_con_points = 4, curve_degree = 2;
+  bool curve_cp_changed = true, curve_degree_changed = true;
   std::vector<glm::vec3> curve_points;
   nurbs::RationalCurve3f curve_primitive;
   std::vector<glm::vec3> curve_tangents;
@@ -42,11 +71,70 @@ class TestApp : public BaseApp {
   std::vector<glm::vec3> curve_binormals;
   std::vector<glm::vec3> curve_normals;
 
+  // Samples per direction of "Make surface" and of loaded surfaces, and
+  // samples of "Make curve"
+  static constexpr unsigned int kSurfaceSamples = 101;
+  static constexpr unsigned int kCurveSamples = 101;
+  // Edits are tessellated in the background and swapped in by
+  // PollGeometry(); with live preview every edit submits a job
+  GeometryWorker geometry_;
+  SurfaceGeometry surface_geometry_;
+  CurveGeometry curve_geometry_;
+  ExportResult export_result_;
+  bool live_preview_ = false;
+  // Samples per direction of "Make surface"
+  int surface_samples_ = kSurfaceSamples;
+  // Incremental mode tessellates "Make surface" on the UI thread, within
+  // the work budget of each frame, and shows the rows as they are done
+  bool incremental_mode_ = false;
+  IncrementalTessellation incremental_;
+  std::chrono::steady_clock::time_point incremental_start_;
+  unsigned int incremental_frames_ = 0;
+
+  // Exports renumber the vertices in fetch order, on copies of the surface
+  // buffers; off, they are written straight from GetVertices()
+  bool export_fetch_order_ = false;
+
+  // Title and results of a BENCH run, for the console
+  struct BenchReport {
+    std::string  title;
+    ConsoleTable table;
+  };
+  // The BENCH run in progress, until PollBench() prints it
+  std::future<BenchReport> bench_;
+
+  ModelLoader model_loader_;
+  // Loaded surfaces after the first one
+  std::vector<MeshHandle> extra_meshes_;
+  char load_file_name_[256] = "surface.txt";
+  bool open_load_popup_ = false;
+
   ImGuiWindowFlags & SetupWindowFlags() const noexcept;
 
   void ShowMainWindow();
   
   void MenuTabs();
+  void LoadFilesPopup();
+  void PollLoadedModels();
+  void PollGeometry();
+  // Next rows of the incremental tessellation, if one is running
+  void StepIncremental();
+  // Submit the edited surface or curve; 'report' logs invalid input
+  void RequestSurface(bool report);
+  void RequestCurve(bool report);
+  void ExportSurfaceMesh(const std::string &file_name);
+  void ExportSurfaceMeshStreamed(const std::string &file_name,
+                                 unsigned int num_u, unsigned int num_v);
+  // BENCH tessellate <nu> <nv> <threads> | eval <n>: times the surface
+  // being edited, or a stock one, on bench_thread_; one run at a time
+  void BenchCommand(const std::vector<std::string> &args);
+  // Prints the BENCH report once the run has finished
+  void PollBench();
+  static BenchReport BenchTessellate(const nurbs::RationalSurface3f &surface,
+                                     unsigned int num_u, unsigned int num_v,
+                                     unsigned int threads);
+  static BenchReport BenchEvaluate(const nurbs::RationalSurface3f &surface,
+                                   size_t count);
   void SplitView();
   
   void ControlsColumn();
@@ -65,6 +153,8 @@ class TestApp : public BaseApp {
       nurbs::array2<glm::vec3> &control_points,
       nurbs::array2<float> &weigths);
 
+  // Declared last: a BENCH still running finishes before the members go
+  nurbs::util::ThreadPool bench_thread_{ 1 };
 }; // class TestApp
 
 } // inline namespace opengl3
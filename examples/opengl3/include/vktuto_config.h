@@ -28,6 +28,152 @@
 #define VKTUTO_WINDOW_TITLE "TEST"
 #endif // !VKTUTO_WINDOW_TITLE
 
+// Use persistent-mapped stream buffers when GL_ARB_buffer_storage is
+// available (0 forces the orphaning path)
+#ifndef VKTUTO_STREAM_BUFFER_PERSISTENT
+#define VKTUTO_STREAM_BUFFER_PERSISTENT 1
+#endif // !VKTUTO_STREAM_BUFFER_PERSISTENT
+
+// Initial size of every stream buffer in bytes
+#ifndef VKTUTO_STREAM_BUFFER_MIN_SIZE
+#define VKTUTO_STREAM_BUFFER_MIN_SIZE (1 << 20)
+#endif // !VKTUTO_STREAM_BUFFER_MIN_SIZE
+
+// Layout of surface vertices on the GPU: VertexFormat::kQuantized stores
+// 16-bit positions relative to the mesh bounding box, kFloat full floats
+#ifndef VKTUTO_VERTEX_FORMAT
+#define VKTUTO_VERTEX_FORMAT VertexFormat::kQuantized
+#endif // !VKTUTO_VERTEX_FORMAT
+
+// Index layout of tessellated grids: GridTopology::kTiledTriangles (best
+// vertex cache reuse), kHilbertTriangles, kTriangleStrip (fewest indices,
+// with primitive restart) or kTriangles
+#ifndef VKTUTO_GRID_TOPOLOGY
+#define VKTUTO_GRID_TOPOLOGY GridTopology::kTiledTriangles
+#endif // !VKTUTO_GRID_TOPOLOGY
+
+// View-dependent level of detail for surface grids (see vktuto_grid_lod.h)
+// and the largest screen-space error it may introduce, in pixels
+#ifndef VKTUTO_GRID_LOD
+#define VKTUTO_GRID_LOD 1
+#endif // !VKTUTO_GRID_LOD
+
+#ifndef VKTUTO_LOD_TOLERANCE
+#define VKTUTO_LOD_TOLERANCE 1.0f
+#endif // !VKTUTO_LOD_TOLERANCE
+
+// Mesh arena batches are drawn with glMultiDrawElementsBaseVertex(); 0 draws
+// every mesh with its own call, for comparison
+#ifndef VKTUTO_ARENA_MULTI_DRAW
+#define VKTUTO_ARENA_MULTI_DRAW 1
+#endif // !VKTUTO_ARENA_MULTI_DRAW
+
+// Skip grid patches outside the canvas view volume
+#ifndef VKTUTO_FRUSTUM_CULLING
+#define VKTUTO_FRUSTUM_CULLING 1
+#endif // !VKTUTO_FRUSTUM_CULLING
+
+// Offscreen context providers of the headless mode (main --headless). EGL
+// links libEGL, OSMesa libOSMesa
+#ifndef VKTUTO_HEADLESS_EGL
+#if defined(__linux__)
+#define VKTUTO_HEADLESS_EGL 1
+#else
+#define VKTUTO_HEADLESS_EGL 0
+#endif
+#endif // !VKTUTO_HEADLESS_EGL
+
+#ifndef VKTUTO_HEADLESS_OSMESA
+#define VKTUTO_HEADLESS_OSMESA 0
+#endif // !VKTUTO_HEADLESS_OSMESA
+
+// HeadlessBackend::kEGL or kOSMesa
+#ifndef VKTUTO_HEADLESS_BACKEND
+#define VKTUTO_HEADLESS_BACKEND HeadlessBackend::kEGL
+#endif // !VKTUTO_HEADLESS_BACKEND
+
+// Idle main loop: after VKTUTO_IDLE_FRAMES frames without input or canvas
+// changes the window waits for events, waking up at least every
+// VKTUTO_IDLE_WAIT_SECONDS (0 keeps polling every frame)
+#ifndef VKTUTO_IDLE_FRAMES
+#define VKTUTO_IDLE_FRAMES 3
+#endif // !VKTUTO_IDLE_FRAMES
+
+#ifndef VKTUTO_IDLE_WAIT_SECONDS
+#define VKTUTO_IDLE_WAIT_SECONDS 0.5
+#endif // !VKTUTO_IDLE_WAIT_SECONDS
+
+// Windows draw on a render thread that owns the OpenGL context, fed with
+// one frame packet per UI frame (see vktuto_render_thread.h); 0 draws on
+// the UI thread
+#ifndef VKTUTO_RENDER_THREAD
+#define VKTUTO_RENDER_THREAD 1
+#endif // !VKTUTO_RENDER_THREAD
+
+// FramePacing::kLatest or kQueue
+#ifndef VKTUTO_FRAME_PACING
+#define VKTUTO_FRAME_PACING FramePacing::kLatest
+#endif // !VKTUTO_FRAME_PACING
+
+// kQueue: frame packets the UI thread may be ahead of the render thread
+#ifndef VKTUTO_QUEUED_FRAMES
+#define VKTUTO_QUEUED_FRAMES 1
+#endif // !VKTUTO_QUEUED_FRAMES
+
+// kLatest: the swap no longer paces the UI thread, so it sleeps to this
+// frame rate while active (0 runs it unpaced)
+#ifndef VKTUTO_UI_FRAME_RATE
+#define VKTUTO_UI_FRAME_RATE 60
+#endif // !VKTUTO_UI_FRAME_RATE
+
+// Directory of cached shader program binaries, relative to the working
+// directory (see vktuto_program_cache.h); "" compiles shaders on every start
+#ifndef VKTUTO_PROGRAM_CACHE_DIRECTORY
+#define VKTUTO_PROGRAM_CACHE_DIRECTORY "program_cache"
+#endif // !VKTUTO_PROGRAM_CACHE_DIRECTORY
+
+// Prebaked font atlas, relative to the working directory (see
+// vktuto_font_cache.h); "" rasterizes the fonts on every start
+#ifndef VKTUTO_FONT_CACHE_FILE
+#define VKTUTO_FONT_CACHE_FILE "font_atlas.cache"
+#endif // !VKTUTO_FONT_CACHE_FILE
+
+// Time a UI frame may spend on incremental work such as tessellating a large
+// surface a few rows at a time (see BaseApp::WorkDeadline()), in
+// milliseconds; keeps frames well below 16 ms while the work goes on
+#ifndef VKTUTO_WORK_BUDGET_MS
+#define VKTUTO_WORK_BUDGET_MS 4.0
+#endif // !VKTUTO_WORK_BUDGET_MS
+
+// Console log (see vktuto_utility.h): the newest lines it keeps, and the
+// memory for their text, in chunks of VKTUTO_CONSOLE_CHUNK_SIZE bytes; older
+// lines are dropped to make room
+#ifndef VKTUTO_CONSOLE_MAX_LINES
+#define VKTUTO_CONSOLE_MAX_LINES 65536
+#endif // !VKTUTO_CONSOLE_MAX_LINES
+
+#ifndef VKTUTO_CONSOLE_CHUNK_SIZE
+#define VKTUTO_CONSOLE_CHUNK_SIZE 65536
+#endif // !VKTUTO_CONSOLE_CHUNK_SIZE
+
+#ifndef VKTUTO_CONSOLE_MAX_CHUNKS
+#define VKTUTO_CONSOLE_MAX_CHUNKS 64
+#endif // !VKTUTO_CONSOLE_MAX_CHUNKS
+
+// Console lines tested against a new filter per frame; the matches show up
+// over a few frames instead of stalling one
+#ifndef VKTUTO_CONSOLE_FILTER_LINES
+#define VKTUTO_CONSOLE_FILTER_LINES 16384
+#endif // !VKTUTO_CONSOLE_FILTER_LINES
+
+// Count the heap allocations of the process (see AllocationStats in
+// vktuto_profiler.h) by replacing the global operator new and delete, the
+// aligned forms included; the profiler shows them per frame, the console's
+// STATS in total. A diagnostic, off by default: define it to 1 to count,
+// else both show "n/a".
+#ifndef VKTUTO_COUNT_ALLOCATIONS
+#define VKTUTO_COUNT_ALLOCATIONS 0
+#endif // !VKTUTO_COUNT_ALLOCATIONS
 
 #ifndef VKTUTO_FONT_COMMON_DIRECTORY
 #define VKTUTO_FONT_COMMON_DIRECTORY "../../misc/fonts/Noto_Sans_KR/"
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "imgui.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+// Read-only view of a whole file, mapped into memory rather than read: the
+// pages come from the file cache when they are touched
+class MappedFile {
+ public:
+  MappedFile() = default;
+  // empty() when the file is missing, empty or cannot be mapped
+  explicit MappedFile(const std::string &file_name);
+  ~MappedFile();
+
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile & operator=(MappedFile &&other) noexcept;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator=(const MappedFile &) = delete;
+
+  void Close();
+
+  bool empty() const noexcept { return data_ == nullptr; }
+  const unsigned char * data() const noexcept { return data_; }
+  size_t size() const noexcept { return size_; }
+
+ private:
+  const unsigned char *data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void *mapping_ = nullptr;  // HANDLE
+#endif
+};
+
+// What the last FontAtlasCache::Build() did
+struct FontCacheStats {
+  // Restored from the cache file instead of rasterized, and written for the
+  // next start
+  bool   cached = false;
+  bool   stored = false;
+  size_t fonts = 0, glyphs = 0;
+  int    width = 0, height = 0;
+  // Hashing the font files and settings
+  double key_ms = 0.0;
+  // Rasterizing and packing, or restoring from the file
+  double build_ms = 0.0;
+  double total_ms = 0.0;
+};
+
+// Keeps a built ImFontAtlas on disk: the Alpha8 texture and the glyph
+// tables of every font. The file is keyed by a hash of the font files,
+// sizes, glyph ranges and every other setting that changes the result, and
+// of the ImGui version; any change rasterizes the atlas again and rewrites
+// the file. A hit maps the file and points the atlas at its pixels, so
+// neither the rasterizer nor the packer runs, and font data the atlas owns
+// is released right away.
+//
+// Custom rectangles (the software mouse cursors, io.MouseDrawCursor) are
+// not kept: a restored atlas draws with the OS cursors only.
+class FontAtlasCache {
+ public:
+  // "" disables the cache: Build() always rasterizes
+  explicit FontAtlasCache(std::string file_name);
+
+  FontAtlasCache(const FontAtlasCache &) = delete;
+  FontAtlasCache & operator=(const FontAtlasCache &) = delete;
+
+  // Builds 'atlas', whose fonts are added but not built yet. Fonts keep
+  // their ImFont objects, so pointers returned by AddFont*() stay valid.
+  // Returns false when the atlas could not be built.
+  bool Build(ImFontAtlas &atlas);
+  // Once the font texture exists (ImGui_ImplOpenGL3_CreateDeviceObjects()):
+  // 'atlas' stops pointing into the file, which is unmapped. Must be called
+  // before the atlas is destroyed, which would free the mapped pixels.
+  void Release(ImFontAtlas &atlas);
+
+  // Removes the cache file, for a cold start
+  void Clear();
+
+  const std::string & file_name() const noexcept { return file_name_; }
+  const FontCacheStats & stats() const noexcept { return stats_; }
+
+ private:
+  std::string file_name_;
+  MappedFile file_;
+  FontCacheStats stats_;
+
+  bool Restore(ImFontAtlas &atlas, uint64_t key);
+  bool Store(const ImFontAtlas &atlas, uint64_t key) const;
+};
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "nurbs/nurbs.h"
+
+namespace vktuto {
+
+inline namespace algorithm {
+
+// Tessellated surface, a num_u x num_v grid laid out like TessellateSurface()
+struct SurfaceGeometry {
+  uint64_t version = 0;  // of the edit it was made from, 0 for none
+  unsigned int num_u = 0, num_v = 0;
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  // Empty on success
+  std::string error;
+  double seconds = 0.0;
+};
+
+// Evenly spaced curve samples with their Frenet frames. 'normals' are
+// curvature vectors: unit normals scaled by the curvature.
+struct CurveGeometry {
+  uint64_t version = 0;
+  std::vector<glm::vec3> points;
+  std::vector<glm::vec3> tangents;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::vec3> binormals;
+  std::string error;
+  double seconds = 0.0;
+};
+
+// A streamed export to a file
+struct ExportResult {
+  uint64_t version = 0;
+  std::string file_name;
+  unsigned int num_u = 0, num_v = 0;
+  // Empty on success
+  std::string error;
+  double seconds = 0.0;
+};
+
+// Tessellates edited surfaces and curves on a private thread pool. Every
+// submission gets the next version of its kind. One job of a kind runs at
+// a time, spread over the pool; a job still waiting when a newer one
+// arrives is dropped, while the running one goes on, so continuous edits
+// show results as fast as the workers produce them. Workers fill buffers
+// of their own, and the newest finished result waits until the UI thread
+// swaps it in at the start of a frame, so the UI never waits for a job and
+// never sees a half-written result.
+class GeometryWorker {
+ public:
+  // 0 threads selects one per hardware thread
+  explicit GeometryWorker(unsigned int num_threads = 0);
+  // Cancels the running jobs and waits for the workers
+  ~GeometryWorker();
+
+  GeometryWorker(const GeometryWorker &) = delete;
+  GeometryWorker & operator=(const GeometryWorker &) = delete;
+
+  // Copy 'surface' (or 'curve') into a new job and return its version. The
+  // surface is sampled on a num_u x num_v grid, the curve at 'num_samples'
+  // evenly spaced parameters.
+  uint64_t SubmitSurface(const nurbs::RationalSurface3f &surface,
+                         unsigned int num_u, unsigned int num_v);
+  uint64_t SubmitCurve(const nurbs::RationalCurve3f &curve,
+                       unsigned int num_samples);
+  // Writes 'surface', sampled on a num_u x num_v grid with normals, to a
+  // binary PLY file through TessellateSurfaceStreaming(), a few rows at a
+  // time, so memory use does not grow with the grid
+  uint64_t SubmitExport(const nurbs::RationalSurface3f &surface,
+                        unsigned int num_u, unsigned int num_v,
+                        const std::string &file_name);
+  // Drops every job of the kind and a result not swapped in yet. A running
+  // export stops at its next rows and removes its file.
+  void CancelSurface();
+  void CancelCurve();
+  void CancelExport();
+
+  // UI thread only. True until the newest job of the kind has finished.
+  bool SurfaceBusy() const;
+  bool CurveBusy() const;
+  bool ExportBusy() const;
+  // Rows of the running export written so far, out of all of them
+  float ExportProgress() const;
+  // UI thread only, at frame start. Exchanges 'geometry' with the newest
+  // finished result, if there is one; the buffers handed back are reused
+  // by later jobs. Never blocks on a running job.
+  bool SwapSurface(SurfaceGeometry &geometry);
+  bool SwapCurve(CurveGeometry &geometry);
+  bool SwapExport(ExportResult &result);
+
+  // Jobs dropped because of newer edits
+  size_t JobsCancelled() const noexcept { return cancelled_; }
+
+ private:
+  // Jobs and results of one kind
+  template <typename Geometry>
+  struct Channel {
+    // Newest version submitted, and newest finished or cancelled
+    std::atomic<uint64_t> latest{ 0 };
+    std::atomic<uint64_t> published{ 0 };
+    uint64_t next = 1;  // UI thread only
+
+    mutable std::mutex mutex;
+    std::function<void()> waiting;  // the next job to run
+    bool running = false;
+    std::unique_ptr<Geometry> ready;
+    std::vector<std::unique_ptr<Geometry>> spare;
+
+    // A newer result is out: no longer worth finishing
+    bool IsOutdated(uint64_t version) const { return version < published; }
+    uint64_t Next();
+    void Cancel();
+    bool Busy() const;
+    // A buffer for a job, from 'spare' if there is one
+    std::unique_ptr<Geometry> Acquire();
+    // Keeps a job's result as 'ready' unless a newer one is out; returns
+    // false when it was dropped
+    bool Publish(std::unique_ptr<Geometry> geometry);
+    bool Swap(Geometry &geometry);
+  };
+
+  Channel<SurfaceGeometry> surfaces_;
+  Channel<CurveGeometry>   curves_;
+  Channel<ExportResult>    exports_;
+  std::atomic<unsigned int> export_rows_{ 0 }, export_num_u_{ 0 };
+  std::atomic<size_t>      cancelled_{ 0 };
+  // Declared last: joined before the channels its jobs write to go away
+  nurbs::util::ThreadPool  pool_;
+
+  // Makes 'job' the next one of 'channel', replacing a waiting one
+  template <typename Geometry>
+  void Schedule(Channel<Geometry> &channel, std::function<void()> job);
+  // Runs the jobs of 'channel' on a pool thread until none is waiting
+  template <typename Geometry>
+  void Drain(Channel<Geometry> &channel);
+
+  void RunSurface(uint64_t version,
+                  const std::shared_ptr<const nurbs::RationalSurface3f> &surface,
+                  unsigned int num_u, unsigned int num_v);
+  void RunCurve(uint64_t version,
+                const std::shared_ptr<const nurbs::RationalCurve3f> &curve,
+                unsigned int num_samples);
+  void RunExport(uint64_t version,
+                 const std::shared_ptr<const nurbs::RationalSurface3f> &surface,
+                 unsigned int num_u, unsigned int num_v,
+                 const std::string &file_name);
+};
+
+} // inline namespace algorithm
+
+} // namespace vktuto
@@ -0,0 +1,18 @@
+#pragma once
+
+// About OpenGL function loaders:
+//  modern OpenGL doesn't have a standard header file and requires individual
+//  function pointers to be loaded manually. 
+//  Helper libraries are often used for this purpose!
+//  Here we are supporting a few common ones: gl3w, glew, glad.
+//  You may use another loader/header of your choice (glext, glLoadGen, etc.),
+//  or chose to manually implement your own.
+#if defined(IMGUI_IMPL_OPENGL_LOADER_GL3W)
+#include <GL/gl3w.h>    // Initialize with gl3wInit()
+#elif defined(IMGUI_IMPL_OPENGL_LOADER_GLEW)
+#include <GL/glew.h>    // Initialize with glewInit()
+#elif defined(IMGUI_IMPL_OPENGL_LOADER_GLAD)
+#include <glad/glad.h>  // Initialize with gladLoadGL()
+#else
+#include IMGUI_IMPL_OPENGL_LOADER_CUSTOM
+#endif
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+#include "vktuto_gl.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+// Optional features of the current context, queried once after the loader
+// is initialized.
+struct GLCapabilities {
+  int  major = 0, minor = 0;
+  bool primitive_restart = false;  // GL 3.1
+  bool sync = false;            // GL 3.2 / GL_ARB_sync
+  bool buffer_storage = false;  // GL 4.4 / GL_ARB_buffer_storage
+  bool timer_query = false;     // GL 3.3 / GL_ARB_timer_query
+  bool program_binary = false;  // GL 4.1 / GL_ARB_get_program_binary
+
+  static const GLCapabilities & Get();
+};
+
+// Upload counters, summed over all stream buffers until reset.
+struct UploadStats {
+  size_t bytes = 0;
+  size_t uploads = 0;
+  // Ring wrap-arounds: re-specified storage (orphaning) or fence waits
+  size_t orphans = 0;
+  size_t waits = 0;
+  double wait_seconds = 0.0;
+
+  static UploadStats & Global();
+  void Reset() { *this = UploadStats(); }
+};
+
+// Buffer object for data that is replaced often. Uploads are appended to a
+// ring inside one buffer, so a new upload never has to wait for draws still
+// reading an older one:
+//  - with GL_ARB_buffer_storage and sync objects the ring is mapped once
+//    (persistent, coherent) and regions are recycled behind fences;
+//  - otherwise each wrap-around orphans the storage with glBufferData(NULL)
+//    and writes use unsynchronized glMapBufferRange.
+// Only the most recent upload is live; earlier ones may be overwritten as
+// soon as the GPU is done with them.
+class StreamBuffer {
+ public:
+  StreamBuffer(GLenum target, size_t capacity);
+  ~StreamBuffer();
+
+  StreamBuffer(const StreamBuffer &) = delete;
+  StreamBuffer & operator=(const StreamBuffer &) = delete;
+
+  GLuint id() const noexcept { return buffer_; }
+  GLenum target() const noexcept { return target_; }
+  size_t capacity() const noexcept { return capacity_; }
+  bool   persistent() const noexcept { return mapped_ != nullptr; }
+
+  // Byte offset and size of the live upload
+  size_t offset() const noexcept { return live_offset_; }
+  size_t size() const noexcept { return live_size_; }
+
+  // Copies 'size' bytes into the ring and makes them the live upload.
+  // Returns their byte offset. Leaves the buffer bound to target().
+  size_t Upload(const void *data, size_t size);
+  // Makes 'size' bytes the live upload without writing them, for a mesh
+  // that arrives piece by piece through UpdateRange()
+  size_t Reserve(size_t size);
+
+  // Rewrites bytes [offset, offset + size) of the live upload, e.g. the
+  // vertices of a few edited rows.
+  void UpdateRange(size_t offset, const void *data, size_t size);
+
+  // Fences everything written so far; call after the draws that read it.
+  void Fence();
+
+ private:
+  struct Region {
+    size_t begin, end;
+    GLsync sync;
+  };
+
+  static constexpr size_t kAlignment = 16;
+
+  GLenum  target_;
+  GLuint  buffer_ = 0;
+  size_t  capacity_ = 0;
+  size_t  head_ = 0;
+  // End of the bytes written so far; a reservation is only handed to the
+  // GPU as its rows are written
+  size_t  written_ = 0;
+  // Start of the bytes written since the last fence
+  size_t  unfenced_ = 0;
+  size_t  live_offset_ = 0, live_size_ = 0;
+  char   *mapped_ = nullptr;
+  // Fenced regions still pending, oldest first
+  std::deque<Region> regions_;
+
+  void Allocate(size_t capacity);
+  void Release();
+  void WaitRegions(size_t begin, size_t end);
+};
+
+} // inline namespace opengl3
+
+} // namespace vktuto
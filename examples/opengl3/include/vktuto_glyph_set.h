@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "imgui.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+// Set of codepoints a font needs glyphs for, turned into the 0-terminated
+// range list ImFontConfig::GlyphRanges takes. Fonts start from a small set
+// and grow it as text arrives (see BaseApp::RequestGlyphs()), instead of
+// rasterizing whole scripts up front. Codepoints beyond ImWchar and control
+// characters, which have no glyphs, are ignored.
+class GlyphSet {
+ public:
+  GlyphSet();
+
+  // Adds a 0-terminated list of inclusive pairs, like
+  // ImFontAtlas::GetGlyphRangesDefault(); returns how many were new
+  size_t AddRanges(const ImWchar *ranges);
+  // True when 'codepoint' was new
+  bool Add(unsigned int codepoint);
+  // The codepoints of UTF-8 'text', up to 'text_end' or its terminator;
+  // returns how many were new
+  size_t AddText(const char *text, const char *text_end = nullptr);
+
+  bool Contains(unsigned int codepoint) const noexcept;
+  size_t size() const noexcept { return count_; }
+
+  // Every codepoint of the set as ranges, 0-terminated
+  std::vector<ImWchar> BuildRanges() const;
+
+ private:
+  static constexpr unsigned int kNumCodepoints = 1u << (8 * sizeof(ImWchar));
+
+  std::vector<uint64_t> bits_;
+  size_t count_ = 0;
+};
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "vktuto_gl.h"
+#include "vktuto_gl_buffer.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+// Base meshes of the glyph renderer:
+//   kMarker  small octahedron, sized in pixels, for control points
+//   kArrow   line arrow from the instance position along its direction
+enum class GlyphShape { kMarker = 0, kArrow, kCount };
+constexpr size_t kNumGlyphShapes = static_cast<size_t>(GlyphShape::kCount);
+
+// Per-instance attributes, 32 bytes
+struct GlyphInstance {
+  glm::vec3 position;
+  float     scale;      // pixels for markers, length factor for arrows
+  glm::vec3 direction;  // arrows only
+  uint8_t   color[4];   // RGBA
+};
+
+GlyphInstance MakeMarker(const glm::vec3 &position, float pixels,
+                         const glm::vec3 &color);
+// Arrow from 'origin' to 'origin + vector'
+GlyphInstance MakeArrow(const glm::vec3 &origin, const glm::vec3 &vector,
+                        const glm::vec3 &color);
+
+// Draws any number of glyphs with one instanced draw call per shape. The
+// instances of all shapes share one stream buffer, so replacing them is a
+// single upload; the base meshes are static.
+class GlyphRenderer {
+ public:
+  // Takes ownership of 'program', linked from glyph_shader.vs and
+  // fragment_shader.fs
+  explicit GlyphRenderer(GLuint program);
+  ~GlyphRenderer();
+
+  GlyphRenderer(const GlyphRenderer &) = delete;
+  GlyphRenderer & operator=(const GlyphRenderer &) = delete;
+
+  std::vector<GlyphInstance> & Instances(GlyphShape shape) {
+    return instances_[static_cast<size_t>(shape)];
+  }
+  size_t NumInstances() const noexcept;
+  // Instances of 'shape' in the last upload
+  size_t NumUploaded(GlyphShape shape) const noexcept {
+    return shapes_[static_cast<size_t>(shape)].count;
+  }
+
+  // Uploads the instances of all shapes
+  void Upload();
+
+  // Draws the uploaded instances of 'shape' with the canvas transform;
+  // 'units_per_pixel' converts marker sizes to world units. Leaves the
+  // glyph program in use. Returns the number of triangles.
+  size_t Draw(GlyphShape shape, const glm::mat4 &mvp, float units_per_pixel);
+
+  // Fences the instance buffer; call after the draws that read it
+  void Fence() { instance_buffer_->Fence(); }
+
+ private:
+  struct ShapeBuffers {
+    GLuint  vao = 0, vbo = 0, ibo = 0;
+    GLenum  mode = GL_TRIANGLES;
+    GLsizei num_indices = 0;
+    bool    screen_sized = false;
+    // Uploaded instances, starting at instance 'first' of the buffer
+    size_t  first = 0, count = 0;
+  };
+
+  GLuint program_;
+  struct Uniforms {
+    GLint mvp, screen_sized, units_per_pixel;
+  } uniform_;
+  std::unique_ptr<StreamBuffer> instance_buffer_;
+  ShapeBuffers shapes_[kNumGlyphShapes];
+  std::vector<GlyphInstance> instances_[kNumGlyphShapes];
+  std::vector<GlyphInstance> staging_;
+};
+
+} // inline namespace opengl3
+
+} // namespace vktuto
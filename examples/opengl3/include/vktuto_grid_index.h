@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+#include "vktuto_gl.h"
+#include "vktuto_mesh_opt.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+// Index layouts for a num_u x num_v vertex grid whose vertex (u_idx, v_idx)
+// is num_v * u_idx + v_idx, as produced by TessellateSurface().
+//  - kTriangles: two triangles per quad, row by row, 6 (nu - 1)(nv - 1)
+//    indices
+//  - kTriangleStrip: one strip per row of quads, separated by a primitive
+//    restart index, (nu - 1)(2 nv + 1) - 1 indices
+//  - kTiledTriangles: the triangle list walked in bands of kGridTileWidth
+//    quads, so a band's previous row is still in the post-transform cache
+//  - kHilbertTriangles: the triangle list in Hilbert curve order
+enum class GridTopology {
+  kTriangles, kTriangleStrip, kTiledTriangles, kHilbertTriangles
+};
+
+// Quads per band of kTiledTriangles: two rows of 8 vertices fit a 16-entry
+// FIFO vertex cache
+constexpr unsigned int kGridTileWidth = 7;
+
+size_t GridIndexCount(unsigned int num_u, unsigned int num_v,
+                      GridTopology topology);
+
+const char * GridTopologyName(GridTopology topology);
+
+// Post-transform cache behaviour of a grid layout, from SimulateVertexCache().
+// Strips are replayed as their vertex stream; restart indices are skipped.
+VertexCacheStats SimulateGridCache(unsigned int num_u, unsigned int num_v,
+                                   GridTopology topology,
+                                   unsigned int cache_size = kVertexCacheSize);
+
+// Whether every index of the grid (and the restart index) fits in 16 bits
+inline bool GridFitsUint16(unsigned int num_u, unsigned int num_v) {
+  return size_t(num_u) * num_v <= 0xFFFF;
+}
+
+namespace internal {
+
+// Calls quad(u_idx, v_idx) for every quad of a num_quads_u x num_quads_v grid
+// along a Hilbert curve. Long grids are cut into square power-of-two blocks,
+// each walked by its own curve.
+template <typename Quad>
+void ForEachHilbertQuad(unsigned int num_quads_u, unsigned int num_quads_v,
+                        Quad &&quad) {
+  unsigned int side = 1;
+  while (side < std::min(num_quads_u, num_quads_v)) side <<= 1;
+  const bool blocks_along_u = num_quads_u > num_quads_v;
+  const unsigned int length = blocks_along_u ? num_quads_u : num_quads_v;
+  for (unsigned int block = 0; block < length; block += side) {
+    for (size_t dist = 0; dist < size_t(side) * side; dist++) {
+      // Hilbert index to (x, y), x along the blocks
+      unsigned int x = 0, y = 0;
+      size_t rest = dist;
+      for (unsigned int scale = 1; scale < side; scale <<= 1) {
+        unsigned int rx = 1 & unsigned(rest / 2);
+        unsigned int ry = 1 & unsigned(rest ^ rx);
+        if (ry == 0) {
+          if (rx == 1) {
+            x = scale - 1 - x;
+            y = scale - 1 - y;
+          }
+          std::swap(x, y);
+        }
+        x += scale * rx;
+        y += scale * ry;
+        rest /= 4;
+      }
+      unsigned int u_idx = blocks_along_u ? block + x : y;
+      unsigned int v_idx = blocks_along_u ? y : block + x;
+      if (u_idx < num_quads_u && v_idx < num_quads_v) quad(u_idx, v_idx);
+    }
+  }
+}
+
+} // namespace internal
+
+// Writes GridIndexCount() indices to 'out'. Strips are separated by
+// std::numeric_limits<Index>::max().
+template <typename Index>
+void BuildGridIndices(unsigned int num_u, unsigned int num_v,
+                      GridTopology topology, Index *out) {
+  if (num_u < 2 || num_v < 2) return;
+  auto quad = [num_v, &out](unsigned int u_idx, unsigned int v_idx) {
+    Index idx = static_cast<Index>(num_v * u_idx + v_idx);
+    Index next = static_cast<Index>(idx + num_v);
+    *out++ = idx;     *out++ = idx + 1;     *out++ = next;
+    *out++ = idx + 1; *out++ = next + 1;    *out++ = next;
+  };
+  switch (topology) {
+    case GridTopology::kTriangleStrip: {
+      const Index restart = static_cast<Index>(~Index(0));
+      for (unsigned int u_idx = 0; u_idx + 1 < num_u; u_idx++) {
+        const Index row = static_cast<Index>(num_v * u_idx);
+        // Next row first keeps the winding of the triangle list
+        if (u_idx > 0) *out++ = restart;
+        for (unsigned int v_idx = 0; v_idx < num_v; v_idx++) {
+          *out++ = static_cast<Index>(row + num_v + v_idx);
+          *out++ = static_cast<Index>(row + v_idx);
+        }
+      }
+      break;
+    }
+    case GridTopology::kTiledTriangles:
+      for (unsigned int v_begin = 0; v_begin + 1 < num_v;
+           v_begin += kGridTileWidth) {
+        unsigned int v_end = std::min(v_begin + kGridTileWidth, num_v - 1);
+        for (unsigned int u_idx = 0; u_idx + 1 < num_u; u_idx++) {
+          for (unsigned int v_idx = v_begin; v_idx < v_end; v_idx++)
+            quad(u_idx, v_idx);
+        }
+      }
+      break;
+    case GridTopology::kHilbertTriangles:
+      internal::ForEachHilbertQuad(num_u - 1, num_v - 1, quad);
+      break;
+    default:
+      for (unsigned int u_idx = 0; u_idx + 1 < num_u; u_idx++) {
+        for (unsigned int v_idx = 0; v_idx + 1 < num_v; v_idx++)
+          quad(u_idx, v_idx);
+      }
+      break;
+  }
+}
+
+// Static index buffer of one grid, ready for glDrawElements().
+struct GridIndexBuffer {
+  unsigned int num_u = 0, num_v = 0;
+  GridTopology topology = GridTopology::kTriangles;
+  GLuint  ibo = 0;
+  GLenum  mode = GL_TRIANGLES;
+  GLenum  type = GL_UNSIGNED_INT;
+  GLsizei count = 0;
+  // Valid when mode is GL_TRIANGLE_STRIP
+  GLuint  restart_index = 0;
+  size_t  bytes = 0;
+
+  GridIndexBuffer() = default;
+  GridIndexBuffer(const GridIndexBuffer &) = delete;
+  GridIndexBuffer & operator=(const GridIndexBuffer &) = delete;
+  ~GridIndexBuffer();
+
+  size_t NumTriangles() const noexcept {
+    return 2 * size_t(num_u - 1) * (num_v - 1);
+  }
+};
+
+// Grid index buffers depend only on the grid size and topology, so surfaces
+// of the same resolution share one buffer and a new tessellation never
+// rebuilds its indices. Keeps the most recently used buffers; requires a
+// current GL context for its whole lifetime.
+class GridIndexCache {
+ public:
+  explicit GridIndexCache(size_t max_entries = 16);
+
+  // Builds and uploads the buffer on first use. Strips fall back to
+  // triangles when the context has no primitive restart (GL 3.1).
+  std::shared_ptr<const GridIndexBuffer> Get(unsigned int num_u,
+                                             unsigned int num_v,
+                                             GridTopology topology);
+
+  size_t size() const noexcept { return entries_.size(); }
+  size_t hits() const noexcept { return hits_; }
+  size_t misses() const noexcept { return misses_; }
+
+ private:
+  struct Entry {
+    std::shared_ptr<const GridIndexBuffer> buffer;
+    uint64_t last_use;
+  };
+
+  size_t   max_entries_;
+  uint64_t clock_ = 0;
+  size_t   hits_ = 0, misses_ = 0;
+  std::unordered_map<uint64_t, Entry> entries_;
+
+  std::shared_ptr<const GridIndexBuffer> Build(unsigned int num_u,
+                                               unsigned int num_v,
+                                               GridTopology topology) const;
+};
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "vktuto_gl.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+// Patch side in grid intervals. Level k of a patch samples every 2^k-th
+// vertex of the grid, down to one quad per patch.
+constexpr unsigned int kLodPatchSize = 16;
+constexpr unsigned int kLodMaxLevels = 5;
+
+// View-dependent level of detail for a vertex grid laid out like
+// TessellateSurface(). The grid is cut into patches of kLodPatchSize quads
+// (smaller at the far edges); each patch has a pyramid of levels that all
+// index into the full-resolution vertices, so switching levels never
+// re-tessellates or uploads anything.
+//
+// Every level knows its geometric error: the largest distance between a grid
+// vertex and the coarser triangles covering it. Under an orthographic
+// projection (rotations included) a world length maps to the same number of
+// pixels everywhere, so Select() only needs the pixels per world unit.
+//
+// Patches next to each other may use different levels. The cracks this
+// leaves along their shared edges are hidden by skirts: strips hanging from
+// the patch edge to copies of the full-resolution edge vertices, which the
+// vertex shader pushes back along the surface normal by SkirtDepth().
+//
+// Patches also carry the bounding box of their vertices, and a quadtree over
+// the patch grid holds the union boxes. Select() can cull against the view
+// volume with it: a node fully outside drops its patches, a node fully
+// inside keeps them all without testing further.
+class GridLod {
+ public:
+  GridLod();
+  ~GridLod();
+
+  GridLod(const GridLod &) = delete;
+  GridLod & operator=(const GridLod &) = delete;
+
+  // Lays out patches, levels and skirts for a num_u x num_v grid and uploads
+  // the index pyramid, then measures errors from 'positions'. Grids below
+  // 2 x 2 clear the pyramid.
+  void Build(unsigned int num_u, unsigned int num_v,
+             const glm::vec3 *positions);
+  // Measures the errors again for patches holding vertices
+  // [first, first + count), after an edit that kept the grid size
+  void UpdateErrors(const glm::vec3 *positions, size_t first, size_t count);
+
+  bool empty() const noexcept { return patches_.empty(); }
+  unsigned int num_u() const noexcept { return num_u_; }
+  unsigned int num_v() const noexcept { return num_v_; }
+
+  // Grid vertices that get a skirt copy, ascending. Copy i is vertex
+  // FirstSkirtVertex() + i of the vertex buffer.
+  const std::vector<GLuint> & SkirtSources() const noexcept {
+    return skirt_sources_;
+  }
+  GLint FirstSkirtVertex() const noexcept {
+    return static_cast<GLint>(size_t(num_u_) * num_v_);
+  }
+
+  // Picks for every patch the coarsest level whose error stays within
+  // 'tolerance' pixels; 0 keeps the full grid. A patch only coarsens once the
+  // next level beats the tolerance by a margin, so levels do not flicker at
+  // the threshold. With 'clip_from_model', an affine (orthographic)
+  // transform to clip space, patches outside the view volume are left out.
+  // A 'fixed_level' of 0 or more puts every patch at that level instead, or
+  // its coarsest one, whatever the error.
+  void Select(float pixels_per_unit, float tolerance,
+              const glm::mat4 *clip_from_model = nullptr,
+              int fixed_level = -1);
+  // World-space bound on the cracks of the current selection
+  float SkirtDepth() const noexcept { return skirt_depth_; }
+
+  // Draws the selected levels with their skirts, the vertex array being
+  // bound; returns the number of triangles
+  size_t Draw() const;
+  size_t NumTriangles() const noexcept { return num_selected_triangles_; }
+  size_t NumPatches() const noexcept { return patches_.size(); }
+  size_t NumVisiblePatches() const noexcept { return num_visible_patches_; }
+  // All patches at level 0, skirts not counted
+  size_t NumFullTriangles() const noexcept {
+    return 2 * size_t(num_u_ - 1) * (num_v_ - 1);
+  }
+
+ private:
+  // Surface triangles, then the skirts of sides u0, u1, v0 and v1
+  struct Range {
+    size_t  first = 0;   // in indices
+    GLsizei triangles = 0;
+    GLsizei side_count[4] = {};  // indices
+  };
+  struct Patch {
+    unsigned int u0, v0, size_u, size_v;
+    unsigned int num_levels;
+    int neighbor[4];  // patch across each side, -1 on the grid border
+    unsigned int level = 0;
+    bool visible = true;
+    float error[kLodMaxLevels] = {};
+    Range range[kLodMaxLevels];
+    glm::vec3 lo, hi;  // bounding box of the patch vertices
+  };
+  // Covers patches [pu0, pu1) x [pv0, pv1) of the patch grid. Children are
+  // stored next to each other, after their parent.
+  struct Node {
+    unsigned int pu0, pu1, pv0, pv1;
+    size_t first_child = 0;
+    unsigned int num_children = 0;
+    glm::vec3 lo, hi;
+  };
+
+  unsigned int num_u_ = 0, num_v_ = 0;
+  unsigned int num_patches_v_ = 0;
+  std::vector<Patch> patches_;
+  std::vector<Node> nodes_;  // nodes_[0] is the root
+  std::vector<size_t> cull_stack_;
+  std::vector<GLuint> skirt_sources_;
+  GLuint ibo_ = 0;
+
+  float skirt_depth_ = 0.0f;
+  size_t num_selected_triangles_ = 0;
+  size_t num_visible_patches_ = 0;
+  std::vector<GLsizei> draw_counts_;
+  std::vector<const void *> draw_offsets_;
+
+  void MeasureErrors(Patch &patch, const glm::vec3 *positions) const;
+  GLuint SkirtVertex(GLuint source) const;
+  void SplitNode(size_t node_idx);
+  // Node boxes from the patch boxes, leaves first
+  void RefitNodes();
+  // Marks the patches inside the view volume, boxes grown by 'margin'
+  void Cull(const glm::mat4 &clip_from_model, float margin);
+};
+
+} // inline namespace opengl3
+
+} // namespace vktuto
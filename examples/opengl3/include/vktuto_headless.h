@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+// Offscreen context providers for running without a window or display
+// server (build farms, CI). Which ones are compiled in is decided by
+// VKTUTO_HEADLESS_EGL and VKTUTO_HEADLESS_OSMESA in vktuto_config.h.
+//  - kEGL: EGL with no surface, on Mesa's surfaceless platform (llvmpipe,
+//    or the GPU render node) or a vendor EGL device; links libEGL
+//  - kOSMesa: Mesa's off-screen software renderer; links libOSMesa
+enum class HeadlessBackend { kEGL, kOSMesa };
+
+// Window-less OpenGL context, current on the creating thread. Everything is
+// drawn into framebuffer objects; there is no default framebuffer to present.
+class HeadlessContext {
+ public:
+  typedef void (*GLProc)(void);
+  typedef GLProc (*GetProcAddressProc)(const char *name);
+  // Native handles of the backend, defined in vktuto_headless.cpp
+  struct Native;
+
+  // Creates a context of at least version major.minor, core profile from
+  // 3.2 on. Throws std::runtime_error if the backend is not compiled in or
+  // no context can be created.
+  HeadlessContext(HeadlessBackend backend, int major, int minor);
+  ~HeadlessContext();
+
+  HeadlessContext(const HeadlessContext &) = delete;
+  HeadlessContext & operator=(const HeadlessContext &) = delete;
+
+  void MakeCurrent();
+  // Leaves the calling thread without a current context, so that another
+  // thread can MakeCurrent()
+  void ReleaseCurrent();
+
+  HeadlessBackend backend() const noexcept { return backend_; }
+  // For the OpenGL loader (gl3wInit2() and the like)
+  GetProcAddressProc GetProcAddress() const noexcept;
+  // "EGL 1.5 (Mesa Project, surfaceless)" and the like
+  const std::string & description() const noexcept { return description_; }
+
+  static bool Available(HeadlessBackend backend) noexcept;
+
+ private:
+  HeadlessBackend         backend_;
+  std::unique_ptr<Native> native_;
+  std::string             description_;
+};
+
+const char * HeadlessBackendName(HeadlessBackend backend);
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "nurbs/nurbs.h"
+
+#include "vktuto_queue.h"
+
+namespace vktuto {
+
+inline namespace io {
+
+struct LoadedSurface {
+  nurbs::RationalSurface3f surface;
+  unsigned int num_u = 0, num_v = 0;
+  // num_u x num_v grid, laid out like TessellateSurface()
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+};
+
+struct LoadResult {
+  uint64_t    id = 0;
+  std::string file_name;
+  // Only objects that passed SurfaceIsValid()/CurveIsValid()
+  std::vector<LoadedSurface>          surfaces;
+  std::vector<nurbs::RationalCurve3f> curves;
+  size_t      num_invalid = 0;
+  bool        cancelled = false;
+  // Empty on success
+  std::string error;
+  double      seconds = 0.0;
+};
+
+// Loads OBJ files off the UI thread. Parsing, validation and tessellation
+// run on a private thread pool; finished results wait in a lock-free queue
+// until the UI thread collects them with Poll(), so a frame never blocks
+// on a load in progress.
+class ModelLoader {
+ public:
+  enum class Stage { kIdle, kParsing, kValidating, kTessellating };
+
+  // 0 threads selects one per hardware thread
+  explicit ModelLoader(unsigned int num_threads = 0);
+  // Cancels the running load and waits for the workers
+  ~ModelLoader();
+
+  ModelLoader(const ModelLoader &) = delete;
+  ModelLoader & operator=(const ModelLoader &) = delete;
+
+  // Starts loading 'file_name', cancelling a load still in flight. Every
+  // valid surface is sampled on a num_u x num_v grid. Returns the id the
+  // result will carry.
+  uint64_t Load(const std::string &file_name,
+                unsigned int num_u, unsigned int num_v);
+  // Stops the running load soon: reading and parsing the file check for it
+  // as well as the tessellation
+  void Cancel();
+
+  // State of the most recent load; UI thread only
+  bool  Busy() const;
+  Stage CurrentStage() const;
+  // 0..1 over the whole load
+  float Progress() const;
+
+  // UI thread only. Hands out finished (or cancelled / failed) loads in
+  // the order they completed; never blocks.
+  bool Poll(LoadResult &result);
+
+ private:
+  struct Job;
+
+  std::shared_ptr<Job>                   current_;
+  uint64_t                               next_id_ = 1;
+  MpscQueue<std::unique_ptr<LoadResult>> results_;
+  // Declared last: joined before the queue it pushes into is destroyed
+  nurbs::util::ThreadPool                pool_;
+
+  void Run(const std::shared_ptr<Job> &job);
+};
+
+const char * StageName(ModelLoader::Stage stage);
+
+} // inline namespace io
+
+} // namespace vktuto
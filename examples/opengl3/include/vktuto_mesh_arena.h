@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "vktuto_gl.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+// First-fit allocator of ranges in [0, capacity()). Freed ranges merge with
+// the free ranges next to them.
+class RangeAllocator {
+ public:
+  static constexpr size_t kFailed = SIZE_MAX;
+
+  explicit RangeAllocator(size_t capacity = 0);
+
+  // Returns the offset of 'size' free units, or kFailed when no free range
+  // is large enough
+  size_t Allocate(size_t size);
+  void   Free(size_t offset, size_t size);
+  // Appends [capacity(), capacity) to the free space
+  void   Grow(size_t capacity);
+  // Frees everything
+  void   Reset();
+
+  size_t capacity() const noexcept { return capacity_; }
+  size_t used() const noexcept { return used_; }
+  size_t NumFreeRanges() const noexcept { return free_.size(); }
+
+ private:
+  size_t capacity_ = 0, used_ = 0;
+  std::map<size_t, size_t> free_;  // offset -> size
+};
+
+// Vertex of arena meshes, 20 bytes. Positions stay floats: meshes of any
+// extent share the buffer, so there is no common quantization box.
+struct ArenaVertex {
+  glm::vec3 position;
+  int16_t   normal[2];  // octahedral, see OctEncode()
+  uint8_t   color[4];   // RGBA
+};
+
+// Mesh to copy into the arena; nothing is kept after MeshArena::Add()
+struct ArenaMesh {
+  GLenum mode = GL_TRIANGLES;  // GL_TRIANGLES, GL_LINES or GL_POINTS
+  const glm::vec3 *positions = nullptr;
+  const glm::vec3 *normals = nullptr;  // optional, unit length
+  const glm::vec3 *colors = nullptr;   // optional, else 'color'
+  size_t num_vertices = 0;
+  const GLuint *indices = nullptr;     // relative to the mesh's vertices
+  size_t num_indices = 0;
+  glm::vec4 color = glm::vec4(1.0f);
+};
+
+typedef size_t MeshHandle;
+constexpr MeshHandle kInvalidMesh = SIZE_MAX;
+
+// Many meshes in one vertex buffer and one index buffer. Each mesh gets a
+// range of both from a RangeAllocator; indices are relative to the mesh,
+// so meshes are drawn with a base vertex and grid meshes of the same size
+// share one index range. Full buffers grow by copying on the GPU.
+//
+// Meshes are drawn in batches: all meshes with the same primitive mode and
+// normal presence go into one glMultiDrawElementsBaseVertex() call, so the
+// number of draw calls does not grow with the number of meshes.
+class MeshArena {
+ public:
+  struct Batch {
+    GLenum mode;
+    bool   has_normals;
+    size_t meshes;
+    size_t triangles;
+  };
+
+  explicit MeshArena(size_t vertex_capacity = size_t(1) << 16,
+                     size_t index_capacity = size_t(1) << 18);
+  ~MeshArena();
+
+  MeshArena(const MeshArena &) = delete;
+  MeshArena & operator=(const MeshArena &) = delete;
+
+  MeshHandle Add(const ArenaMesh &mesh);
+  // A num_u x num_v triangle grid laid out like TessellateSurface()
+  MeshHandle AddGrid(unsigned int num_u, unsigned int num_v,
+                     const glm::vec3 *positions, const glm::vec3 *normals,
+                     const glm::vec4 &color);
+  // Ignores kInvalidMesh
+  void Remove(MeshHandle mesh);
+  void Clear();
+
+  size_t NumMeshes() const noexcept { return num_meshes_; }
+  size_t VertexBytes() const noexcept {
+    return vertices_.capacity() * sizeof(ArenaVertex);
+  }
+  size_t IndexBytes() const noexcept {
+    return indices_.capacity() * sizeof(GLuint);
+  }
+  const RangeAllocator & vertex_ranges() const noexcept { return vertices_; }
+  const RangeAllocator & index_ranges() const noexcept { return indices_; }
+
+  // Batches of the current meshes, ordered by state
+  const std::vector<Batch> & Batches();
+  // Draws batch 'idx' of Batches() with the program in use
+  void DrawBatch(size_t idx) const;
+
+ private:
+  struct Mesh {
+    bool   alive = false;
+    GLenum mode = GL_TRIANGLES;
+    bool   has_normals = false;
+    size_t first_vertex = 0, num_vertices = 0;
+    size_t first_index = 0, num_indices = 0;
+    uint64_t grid_key = 0;  // shared grid indices, 0 for own indices
+  };
+  struct SharedIndices {
+    size_t first = 0, count = 0;
+    size_t users = 0;
+  };
+  struct BatchCalls {
+    std::vector<GLsizei>      counts;
+    std::vector<const void *> offsets;
+    std::vector<GLint>        base_vertices;
+  };
+
+  GLuint vao_ = 0, vbo_ = 0, ibo_ = 0;
+  RangeAllocator vertices_, indices_;
+  std::vector<Mesh> meshes_;
+  std::vector<MeshHandle> free_handles_;
+  size_t num_meshes_ = 0;
+  std::unordered_map<uint64_t, SharedIndices> grid_indices_;
+
+  bool dirty_ = true;
+  std::vector<Batch> batches_;
+  std::vector<BatchCalls> calls_;
+
+  size_t AllocateVertices(size_t count);
+  size_t AllocateIndices(size_t count);
+  // Replaces 'buffer' by one of 'new_bytes' holding its first 'old_bytes'
+  static void GrowBuffer(GLuint &buffer, size_t old_bytes, size_t new_bytes);
+  void SetAttributes() const;
+  MeshHandle Insert(const Mesh &mesh);
+  void UploadVertices(const ArenaMesh &mesh, size_t first_vertex);
+  void RebuildBatches();
+};
+
+} // inline namespace opengl3
+
+} // namespace vktuto
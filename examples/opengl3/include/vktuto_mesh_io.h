@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+namespace vktuto {
+
+inline namespace io {
+
+// Non-owning view of an indexed triangle mesh, e.g. the tessellation buffers
+// held by BaseApp (GetVertices()/GetIndices()). The exporters read straight
+// from these arrays; only a small fixed-size staging buffer is used when the
+// file layout interleaves attributes.
+struct MeshView {
+  const glm::vec3 *positions  = nullptr;
+  size_t          num_vertices = 0;
+  // Optional per-vertex normals, same count as positions
+  const glm::vec3 *normals    = nullptr;
+  // Triangle list, 3 indices per triangle
+  const uint32_t  *indices    = nullptr;
+  size_t          num_indices = 0;
+
+  MeshView() = default;
+  MeshView(const std::vector<glm::vec3> &positions,
+           const std::vector<uint32_t> &indices,
+           const std::vector<glm::vec3> *normals = nullptr);
+
+  size_t NumTriangles() const noexcept { return num_indices / 3; }
+};
+
+// All writers produce little-endian binary files and throw
+// std::runtime_error when the file cannot be written.
+
+// Binary little-endian PLY with float positions (and normals) and
+// uchar-counted uint face lists.
+void SaveMeshPLY(const std::string &file_name, const MeshView &mesh);
+
+// Binary STL. Facet normals are taken from the triangle winding; STL has no
+// per-vertex normals.
+void SaveMeshSTL(const std::string &file_name, const MeshView &mesh);
+
+// glTF 2.0 binary container (.glb) with a single triangle primitive.
+// Positions, normals and indices are written to the BIN chunk unmodified.
+void SaveMeshGLB(const std::string &file_name, const MeshView &mesh);
+
+// Receiver of a mesh that is produced piece by piece, e.g. by a streaming
+// tessellation. Vertices arrive in index order; a batch of triangles only
+// references vertices that were already delivered.
+class MeshSink {
+ public:
+  virtual ~MeshSink() = default;
+
+  // Total sizes of the mesh, known before the first batch
+  virtual void Begin(size_t /*num_vertices*/, size_t /*num_indices*/,
+                     bool /*has_normals*/) {}
+  // 'normals' is nullptr when the mesh has none
+  virtual void AddVertices(size_t first_vertex, const glm::vec3 *positions,
+                           const glm::vec3 *normals, size_t count) = 0;
+  // Triangle list using global vertex indices
+  virtual void AddTriangles(const uint32_t *indices, size_t num_indices) = 0;
+  virtual void End() {}
+};
+
+// Forwards every batch to user callbacks.
+class CallbackMeshSink : public MeshSink {
+ public:
+  using VertexCallback = std::function<void(size_t first_vertex,
+                                            const glm::vec3 *positions,
+                                            const glm::vec3 *normals,
+                                            size_t count)>;
+  using TriangleCallback = std::function<void(const uint32_t *indices,
+                                              size_t num_indices)>;
+
+  CallbackMeshSink(VertexCallback on_vertices, TriangleCallback on_triangles)
+      : on_vertices_(std::move(on_vertices)),
+        on_triangles_(std::move(on_triangles)) {}
+
+  void AddVertices(size_t first_vertex, const glm::vec3 *positions,
+                   const glm::vec3 *normals, size_t count) override {
+    on_vertices_(first_vertex, positions, normals, count);
+  }
+  void AddTriangles(const uint32_t *indices, size_t num_indices) override {
+    on_triangles_(indices, num_indices);
+  }
+
+ private:
+  VertexCallback   on_vertices_;
+  TriangleCallback on_triangles_;
+};
+
+class BinaryFile;
+
+// Writes a streamed mesh as binary PLY. Vertices go straight to the file;
+// faces are spooled to '<file_name>.faces' and appended by End(), so memory
+// use does not depend on the mesh size.
+class PlyStreamWriter : public MeshSink {
+ public:
+  explicit PlyStreamWriter(const std::string &file_name);
+  ~PlyStreamWriter() override;
+
+  void Begin(size_t num_vertices, size_t num_indices,
+             bool has_normals) override;
+  void AddVertices(size_t first_vertex, const glm::vec3 *positions,
+                   const glm::vec3 *normals, size_t count) override;
+  void AddTriangles(const uint32_t *indices, size_t num_indices) override;
+  void End() override;
+
+ private:
+  std::string                 file_name_;
+  std::string                 faces_name_;
+  std::unique_ptr<BinaryFile> file_;
+  std::unique_ptr<BinaryFile> faces_;
+  size_t                      vertices_written_ = 0;
+};
+
+} // inline namespace io
+
+} // namespace vktuto
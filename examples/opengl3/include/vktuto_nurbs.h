@@ -1 +1,141 @@
 #pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "nurbs/nurbs.h"
+
+#include "vktuto_mesh_io.h"
+
+namespace vktuto {
+
+inline namespace algorithm {
+
+// Evaluates points and normals of a rational surface. The homogeneous control
+// net is built once here instead of on every nurbs::SurfacePoint() call.
+class SurfaceEvaluator {
+ public:
+  explicit SurfaceEvaluator(const nurbs::RationalSurface3f &surface);
+
+  glm::vec3 Point(float u, float v) const;
+  glm::vec3 Normal(float u, float v) const;
+
+  // Parameter of sample 'idx' out of 'count' evenly spaced over the domain
+  float ParameterU(size_t idx, size_t count) const noexcept;
+  float ParameterV(size_t idx, size_t count) const noexcept;
+
+ private:
+  unsigned int degree_u_, degree_v_;
+  std::vector<float> knots_u_, knots_v_;
+  nurbs::array2<glm::vec4> homogeneous_;
+  float min_u_, max_u_, min_v_, max_v_;
+};
+
+// Surface points and normals evaluated so far by SurfaceEvaluator, and curve
+// points evaluated by GeometryWorker, for diagnostics. SurfaceEvaluator
+// tallies its evaluations per thread and adds them here every few thousand
+// samples and on FlushSurface(), so the sampling loops never touch a shared
+// counter.
+struct EvaluationStats {
+  std::atomic<uint64_t> surface_points{ 0 };
+  std::atomic<uint64_t> surface_normals{ 0 };
+  std::atomic<uint64_t> curve_points{ 0 };
+
+  static EvaluationStats & Global();
+  // Adds the surface evaluations the calling thread has tallied so far;
+  // call at the end of a batch of samples
+  static void FlushSurface();
+  static void AddCurve(size_t points);
+};
+
+// Samples a num_u x num_v grid. Vertex (u_idx, v_idx) is stored at
+// num_v * u_idx + v_idx, the layout TestApp uploads to BaseApp.
+void TessellateSurface(const nurbs::RationalSurface3f &surface,
+                       unsigned int num_u, unsigned int num_v,
+                       std::vector<glm::vec3> &positions,
+                       std::vector<glm::vec3> *normals = nullptr);
+
+// Samples u-rows [row_begin, row_end) of the num_u x num_v grid into arrays
+// that hold the whole grid. Disjoint row ranges may be filled concurrently.
+void TessellateSurfaceRows(const SurfaceEvaluator &evaluator,
+                           unsigned int num_u, unsigned int num_v,
+                           unsigned int row_begin, unsigned int row_end,
+                           glm::vec3 *positions, glm::vec3 *normals = nullptr);
+
+// TessellateSurfaceRows() for the whole grid, in bands of rows spread over
+// 'pool' and the calling thread; without a pool, on the calling thread only
+void TessellateSurfaceParallel(const SurfaceEvaluator &evaluator,
+                               unsigned int num_u, unsigned int num_v,
+                               nurbs::util::ThreadPool *pool,
+                               glm::vec3 *positions,
+                               glm::vec3 *normals = nullptr);
+
+// Tessellates a grid a slice at a time, for a UI thread that spends a few
+// milliseconds per frame on it: Step() samples until its deadline and picks
+// up on the next call where it stopped. Rows [0, rows_done()) are final and
+// may be drawn while the rest is still to come.
+class IncrementalTessellation {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  // Drops a tessellation in progress. 'positions()' (and 'normals()') are
+  // sized for the whole grid right away.
+  void Start(const nurbs::RationalSurface3f &surface,
+             unsigned int num_u, unsigned int num_v, bool normals = false);
+  // Samples until 'deadline', at least a few samples, and returns the rows
+  // completed by this call
+  unsigned int Step(Clock::time_point deadline);
+  void Cancel();
+
+  bool Active() const noexcept { return evaluator_ != nullptr; }
+  bool Done() const noexcept {
+    return num_u_ > 0 && next_ == size_t(num_u_) * num_v_;
+  }
+  float Progress() const noexcept {
+    return num_u_ > 0 ? float(next_) / (size_t(num_u_) * num_v_) : 0.0f;
+  }
+  unsigned int rows_done() const noexcept {
+    return num_v_ > 0 ? unsigned(next_ / num_v_) : 0;
+  }
+  unsigned int num_u() const noexcept { return num_u_; }
+  unsigned int num_v() const noexcept { return num_v_; }
+  std::vector<glm::vec3> & positions() noexcept { return positions_; }
+  std::vector<glm::vec3> & normals() noexcept { return normals_; }
+  // Bounding box of the control points, which holds the whole surface when
+  // no weight is negative (convex hull property)
+  const glm::vec3 & lower() const noexcept { return lower_; }
+  const glm::vec3 & upper() const noexcept { return upper_; }
+
+ private:
+  std::unique_ptr<SurfaceEvaluator> evaluator_;
+  unsigned int num_u_ = 0, num_v_ = 0;
+  // Next sample, num_v * u_idx + v_idx
+  size_t next_ = 0;
+  std::vector<glm::vec3> positions_, normals_;
+  glm::vec3 lower_ = glm::vec3(0.0f), upper_ = glm::vec3(0.0f);
+};
+
+struct StreamingTessellationOptions {
+  // Upper bound for the vertices and indices of one tile, in bytes
+  size_t memory_budget = size_t(64) << 20;
+  bool   normals = false;
+};
+
+// Tessellates the grid tile by tile, each tile being a band of u-rows, and
+// hands every tile to 'sink'. Only one tile is held in memory. A tile's
+// triangles reference the last row of the previous tile through global
+// indices, so seam vertices are emitted once and shared.
+void TessellateSurfaceStreaming(
+    const nurbs::RationalSurface3f &surface,
+    unsigned int num_u, unsigned int num_v,
+    MeshSink &sink,
+    const StreamingTessellationOptions &options = StreamingTessellationOptions());
+
+} // inline namespace algorithm
+
+} // namespace vktuto
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "vktuto_gl.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+// Timed parts of a frame. Frames are counted where OpenGL runs: kFrame is
+// BeginFrame() to EndFrame() around the recorded commands, the draws and
+// the buffer swap, and its GPU time is the sum of the other sections. The
+// UI thread's parts come in through AddCpuTime(). Sections may be entered
+// several times per frame and their times add up; CPU sections may nest,
+// GPU sections may not. Timers outside a frame are ignored.
+enum class ProfileSection {
+  kFrame = 0,
+  kUpdate,       // BaseApp::Update(), UI and edits
+  kImGuiRender,  // ImGui::Render() and ImGui_ImplOpenGL3_RenderDrawData()
+  kCanvasDraw,   // BaseApp::CustomGLDraw()
+  kUpload,       // BindBuffers(), BindBuffers2(), UpdateVertices()
+  kUiFrame,      // UI thread, events to the hand-over of the frame packet
+  kCount
+};
+constexpr size_t kNumProfileSections = static_cast<size_t>(ProfileSection::kCount);
+
+enum class ProfileClock { kCpu, kGpu };
+
+// Heap allocations of the whole process, through the replaceable operator
+// new and operator delete. Only counted with VKTUTO_COUNT_ALLOCATIONS
+// (vktuto_config.h); Enabled() tells.
+struct AllocationStats {
+  std::atomic<uint64_t> allocations{ 0 };
+  std::atomic<uint64_t> frees{ 0 };
+
+  static AllocationStats & Global();
+  static bool Enabled();
+};
+
+// One frame of the history. GPU times arrive two frames late; until then
+// (or if the query was dropped) gpu_valid is false.
+struct FrameStats {
+  unsigned long long frame = 0;
+  double cpu_ms[kNumProfileSections] = {};
+  double gpu_ms[kNumProfileSections] = {};
+  bool   gpu_valid = false;
+  size_t triangles = 0;
+  size_t draw_calls = 0;
+  size_t upload_bytes = 0;
+  size_t uploads = 0;
+  // In any thread, during the frame
+  size_t allocations = 0;
+};
+
+// Over the frames in the history that have a value for the clock
+struct ProfileSummary {
+  size_t samples = 0;
+  double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+// Per-frame CPU and GPU timings with a rolling history.
+// GPU sections use GL_TIME_ELAPSED queries in two sets that alternate
+// between frames: the set issued in frame N is read at the start of frame
+// N + 2, and only if GL_QUERY_RESULT_AVAILABLE says so, so reading never
+// stalls the pipeline. Late results are dropped instead. Without
+// GL_ARB_timer_query only CPU times are recorded.
+// Query objects belong to the context current at the first BeginGpu().
+// Everything but reading the history belongs to the thread that renders;
+// other threads read under LockHistory().
+class FrameProfiler {
+ public:
+  explicit FrameProfiler(size_t history = 240);
+  ~FrameProfiler();
+
+  FrameProfiler(const FrameProfiler &) = delete;
+  FrameProfiler & operator=(const FrameProfiler &) = delete;
+
+  void BeginFrame();
+  void EndFrame();
+
+  void BeginCpu(ProfileSection section);
+  void EndCpu(ProfileSection section);
+  void BeginGpu(ProfileSection section);
+  void EndGpu(ProfileSection section);
+
+  // CPU time measured elsewhere, e.g. on the UI thread, for the current
+  // frame
+  void AddCpuTime(ProfileSection section, double ms);
+
+  // Counters of the current frame
+  void AddDraw(size_t triangles) {
+    current_.triangles += triangles;
+    current_.draw_calls++;
+  }
+
+  // Frames in the history, oldest first; at(size() - 1) is the last ended
+  size_t size() const noexcept { return count_; }
+  size_t capacity() const noexcept { return history_.size(); }
+  const FrameStats & at(size_t idx) const {
+    return history_[(head_ + history_.size() - count_ + idx) % history_.size()];
+  }
+  const FrameStats & Latest() const { return at(count_ - 1); }
+  bool empty() const noexcept { return count_ == 0; }
+
+  ProfileSummary Summarize(ProfileSection section,
+                           ProfileClock clock = ProfileClock::kCpu) const;
+  bool HasGpuTimers() const noexcept { return gpu_timers_; }
+  // CPU time of the whole process (all threads) over wall time, measured
+  // over about a second; 1.0 is one busy core. Idle frames are not in the
+  // history, so this is the number to watch for idle costs.
+  double ProcessCpuUsage() const noexcept { return cpu_usage_; }
+  // GPU results that were not ready two frames later
+  size_t DroppedGpuResults() const noexcept { return dropped_; }
+
+  // Forgets the history; pending GPU results are dropped
+  void Reset();
+
+  // Keeps the history, and the usage figures above, from changing
+  std::unique_lock<std::mutex> LockHistory() const {
+    return std::unique_lock<std::mutex>(history_mutex_);
+  }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+  static constexpr size_t kQuerySets = 2;
+
+  struct QuerySet {
+    GLuint queries[kNumProfileSections] = {};
+    bool   issued[kNumProfileSections] = {};
+    unsigned long long frame = 0;
+  };
+
+  mutable std::mutex history_mutex_;
+  std::vector<FrameStats> history_;
+  size_t head_ = 0, count_ = 0;
+
+  FrameStats current_;
+  unsigned long long next_frame_ = 0;
+  bool in_frame_ = false;
+  Clock::time_point frame_start_;
+  Clock::time_point cpu_start_[kNumProfileSections];
+  int cpu_depth_[kNumProfileSections] = {};
+  size_t upload_bytes_start_ = 0, uploads_start_ = 0;
+  uint64_t allocations_start_ = 0;
+  Clock::time_point usage_start_;
+  double usage_cpu_seconds_ = 0.0;
+  double cpu_usage_ = 0.0;
+
+  bool gpu_timers_;
+  bool queries_created_ = false;
+  QuerySet sets_[kQuerySets];
+  int active_gpu_ = -1;
+  size_t dropped_ = 0;
+
+  QuerySet & CurrentSet() { return sets_[current_.frame % kQuerySets]; }
+  void CollectGpuResults(QuerySet &set);
+  FrameStats * FindFrame(unsigned long long frame);
+};
+
+class ScopedCpuTimer {
+ public:
+  ScopedCpuTimer(FrameProfiler &profiler, ProfileSection section)
+      : profiler_(profiler), section_(section) {
+    profiler_.BeginCpu(section_);
+  }
+  ~ScopedCpuTimer() { profiler_.EndCpu(section_); }
+
+  ScopedCpuTimer(const ScopedCpuTimer &) = delete;
+  ScopedCpuTimer & operator=(const ScopedCpuTimer &) = delete;
+
+ private:
+  FrameProfiler &profiler_;
+  ProfileSection section_;
+};
+
+// CPU and GPU time of the same section
+class ScopedTimer {
+ public:
+  ScopedTimer(FrameProfiler &profiler, ProfileSection section)
+      : profiler_(profiler), section_(section) {
+    profiler_.BeginCpu(section_);
+    profiler_.BeginGpu(section_);
+  }
+  ~ScopedTimer() {
+    profiler_.EndGpu(section_);
+    profiler_.EndCpu(section_);
+  }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer & operator=(const ScopedTimer &) = delete;
+
+ private:
+  FrameProfiler &profiler_;
+  ProfileSection section_;
+};
+
+const char * ProfileSectionName(ProfileSection section);
+
+// Like FrameProfiler::Summarize(), over frames kept elsewhere
+ProfileSummary SummarizeFrames(const std::vector<FrameStats> &frames,
+                               ProfileSection section,
+                               ProfileClock clock = ProfileClock::kCpu);
+
+// One row per frame: CPU and GPU milliseconds of every section, then the
+// counters; GPU times the frame never got are left empty. Throws
+// std::runtime_error when the file cannot be written.
+void WriteFrameStatsCsv(const std::string &file_name,
+                        const std::vector<FrameStats> &frames);
+
+// Semi-transparent window in the top-right corner: frame-time graphs, a
+// percentile table per section, triangles and uploads of the last frame
+void ShowProfilerOverlay(const FrameProfiler &profiler, bool *open);
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vktuto_gl.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+// Vertex and fragment shader files of one program
+struct ProgramFiles {
+  std::string vertex;
+  std::string fragment;
+};
+
+// What the last ProgramCache::Load() did
+struct ProgramCacheStats {
+  size_t programs = 0;
+  // Linked from a cached binary, compiled from source, and cached binaries
+  // the driver refused (then compiled)
+  size_t cached = 0, compiled = 0, rejected = 0;
+  // Binaries written for the next start
+  size_t stored = 0;
+  // Reading and hashing sources and cached binaries, on worker threads
+  double read_ms = 0.0;
+  // OpenGL work: binary loads, compiles and links
+  double link_ms = 0.0;
+  double total_ms = 0.0;
+};
+
+// Links shader programs and keeps their binaries on disk
+// (glGetProgramBinary(), GL 4.1 or GL_ARB_get_program_binary), so the next
+// start skips compiling and linking. A binary is keyed by a hash of the
+// shader sources and of the driver's vendor, renderer and version strings;
+// a changed shader or driver misses the cache, and a binary the driver
+// refuses is compiled again, so a stale cache costs time but never
+// breaks a program. Without driver support or with an empty directory
+// programs are compiled every time.
+//
+// Load() links several programs together: files are read and hashed on
+// worker threads, then every compile and link is issued before any status
+// is queried, so drivers that compile in the background
+// (GL_KHR_parallel_shader_compile, Mesa's shader threads) overlap them.
+// OpenGL calls run on the calling thread, which must have the context.
+class ProgramCache {
+ public:
+  explicit ProgramCache(std::string directory);
+
+  // One program per entry, in order; 0 for a program that could not be
+  // built, with its log on std::cerr
+  std::vector<GLuint> Load(const std::vector<ProgramFiles> &files);
+
+  // Removes the cached binaries, for a cold start
+  void Clear();
+
+  bool enabled() const noexcept { return enabled_; }
+  const std::string & directory() const noexcept { return directory_; }
+  const ProgramCacheStats & stats() const noexcept { return stats_; }
+
+ private:
+  struct Job;
+
+  std::string directory_;
+  // The driver can hand out binaries and the directory is usable
+  bool enabled_ = false;
+  uint64_t driver_hash_ = 0;
+  ProgramCacheStats stats_;
+
+  std::string BinaryPath(uint64_t key) const;
+  // Worker thread side: sources, key and cached binary of 'job'
+  void ReadJob(Job &job) const;
+  void WriteBinary(const Job &job) const;
+};
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace vktuto {
+
+inline namespace utility {
+
+// Unbounded multi-producer / single-consumer queue. Producers push with a
+// single compare-and-swap on the list head and never block each other or the
+// consumer; the consumer detaches the whole list at once and serves it in
+// FIFO order. Intended for handing finished work from worker threads to the
+// render thread.
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() = default;
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue & operator=(const MpscQueue &) = delete;
+
+  ~MpscQueue() {
+    FreeList(head_.exchange(nullptr));
+    FreeList(pending_);
+  }
+
+  // Any thread
+  void Push(T value) {
+    Node *node = new Node{ std::move(value),
+                           head_.load(std::memory_order_relaxed) };
+    while (!head_.compare_exchange_weak(node->next, node,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+    }
+  }
+
+  // Consumer thread only
+  bool TryPop(T &value) {
+    if (pending_ == nullptr) {
+      // Detach everything pushed so far and restore push order
+      Node *list = head_.exchange(nullptr, std::memory_order_acquire);
+      while (list != nullptr) {
+        Node *next = list->next;
+        list->next = pending_;
+        pending_ = list;
+        list = next;
+      }
+    }
+    if (pending_ == nullptr) return false;
+    Node *node = pending_;
+    pending_ = node->next;
+    value = std::move(node->value);
+    delete node;
+    return true;
+  }
+
+  // Consumer thread only; a hint when producers are active
+  bool Empty() const {
+    return pending_ == nullptr &&
+           head_.load(std::memory_order_acquire) == nullptr;
+  }
+
+ private:
+  struct Node {
+    T     value;
+    Node *next;
+  };
+
+  std::atomic<Node *> head_{ nullptr };
+  Node               *pending_ = nullptr;
+
+  static void FreeList(Node *node) {
+    while (node != nullptr) {
+      Node *next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+};
+
+} // inline namespace utility
+
+} // namespace vktuto
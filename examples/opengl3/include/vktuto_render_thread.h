@@ -0,0 +1,141 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "imgui.h"
+
+#include "vktuto_queue.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+// How the UI thread and the render thread keep in step
+//   kQueue   every frame is presented; the UI thread waits while
+//            'queued_frames' packets are waiting for the render thread
+//   kLatest  the UI thread never waits; a packet the render thread has not
+//            started yet is merged into the next one, so only the newest
+//            frame is presented and the commands of the others still run
+enum class FramePacing { kQueue, kLatest };
+
+const char * FramePacingName(FramePacing pacing);
+
+// OpenGL work recorded by the UI thread, run by the render thread in order.
+// 'key' names the state a command writes (0: none); a command with 'full'
+// set rewrites all of it, so earlier commands of its key that have not run
+// yet are skipped.
+struct RenderCommand {
+  std::function<void()> run;
+  uint32_t key = 0;
+  bool     full = false;
+};
+
+// One frame for the render thread. The UI thread fills a packet and hands
+// it over with RenderThread::Submit(); from then on nobody writes to it.
+// Applications derive from it to carry what their frame draws.
+struct FramePacket {
+  virtual ~FramePacket() = default;
+
+  std::vector<RenderCommand> commands;
+  // False for packets that only carry commands, which are never skipped
+  bool has_frame = false;
+
+  // FramePacing::kLatest: this frame replaces 'skipped', which is never
+  // run; keeps what the skipped frame carried and this one must not lose
+  virtual void MergeSkipped(const FramePacket & /*skipped*/) {}
+};
+
+// Drops commands that a later 'full' command of the same key makes
+// redundant, keeping the order of the others
+void PruneCommands(std::vector<RenderCommand> &commands);
+
+// Copy of the draw lists of ImGui::Render(), which ImGui refills on the next
+// frame. Keeps its buffers from one Assign() to the next; create and
+// destroy it on the thread of the ImGui context.
+class DrawDataCopy {
+ public:
+  DrawDataCopy() = default;
+  ~DrawDataCopy();
+
+  DrawDataCopy(const DrawDataCopy &) = delete;
+  DrawDataCopy & operator=(const DrawDataCopy &) = delete;
+
+  void Assign(const ImDrawData &source);
+  bool empty() const noexcept { return lists_.empty(); }
+  // For ImGui_ImplOpenGL3_RenderDrawData(), which only reads it
+  ImDrawData * get() const { return &data_; }
+
+ private:
+  mutable ImDrawData data_;
+  std::vector<ImDrawList *> lists_;
+};
+
+// Thread that owns the OpenGL context and runs frame packets. 'begin' makes
+// the context current on it and 'end' releases it again; 'run' is called
+// with every packet, runs its commands in order and, if it has a frame,
+// renders and presents it. Packets come
+// back through Recycle() on the submitting thread, which reuses them (and
+// frees them there, where ImGui allocations belong).
+//
+// An exception thrown on the render thread stops it and is rethrown by
+// the next Submit(), Finish() or Stop().
+class RenderThread {
+ public:
+  typedef std::function<void()> Callback;
+  typedef std::function<void(const FramePacket &)> PacketCallback;
+
+  RenderThread(Callback begin, PacketCallback run, Callback end,
+               FramePacing pacing, size_t queued_frames);
+  // Stops the thread; queued packets are dropped
+  ~RenderThread();
+
+  RenderThread(const RenderThread &) = delete;
+  RenderThread & operator=(const RenderThread &) = delete;
+
+  void Submit(std::unique_ptr<FramePacket> packet);
+  // Waits until every submitted packet has been run
+  void Finish();
+  // Runs what was submitted, then ends the thread and 'end' on it
+  void Stop();
+
+  // A packet the render thread is done with, or nullptr
+  std::unique_ptr<FramePacket> Recycle();
+
+  FramePacing pacing() const noexcept { return pacing_; }
+  // Frames drawn, and frames merged into later ones by kLatest
+  unsigned long long FramesDrawn() const;
+  unsigned long long FramesSkipped() const;
+
+ private:
+  PacketCallback run_;
+  FramePacing  pacing_;
+  size_t       queued_frames_;
+
+  mutable std::mutex      mutex_;
+  std::condition_variable changed_;
+  std::deque<std::unique_ptr<FramePacket>> pending_;
+  bool busy_ = false, stop_ = false, stopped_ = false;
+  std::exception_ptr error_;
+  unsigned long long drawn_ = 0, skipped_ = 0;
+
+  MpscQueue<std::unique_ptr<FramePacket>> done_;
+  std::vector<std::unique_ptr<FramePacket>> merged_;
+  // Declared last: started once everything above is initialized
+  std::thread thread_;
+
+  void Run(const Callback &begin, const Callback &end);
+  void RethrowError();
+};
+
+} // inline namespace opengl3
+
+} // namespace vktuto
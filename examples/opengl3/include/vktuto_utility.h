@@ -1,23 +1,86 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "imgui.h"
 
 namespace vktuto {
 
 inline namespace utility {
 
+// Log of text lines in bounded memory: a ring of the newest lines, whose text
+// is packed into a ring of fixed-size chunks. A line that does not fit in
+// the rest of a chunk starts the next one, and a chunk is written again once
+// all its lines are dropped, so Append() only allocates the first time each
+// chunk is used. Lines are numbered in the order they were appended; a
+// number stays valid until the line is dropped and is never reused.
+class ConsoleLog {
+ public:
+  // Table rows are drawn with their columns lined up (see ConsoleTable)
+  enum LineKind : uint8_t { kText, kCommand, kError, kTableHeader, kTable };
+
+  ConsoleLog(size_t max_lines, size_t chunk_size, size_t max_chunks);
+
+  // Drops the oldest lines to make room; a line longer than a chunk is cut
+  void Append(const char *text, size_t length, LineKind kind = kText);
+  void Clear();
+
+  // Lines [first(), last()) are kept
+  uint64_t first() const noexcept { return first_; }
+  uint64_t last() const noexcept { return last_; }
+  size_t size() const noexcept { return static_cast<size_t>(last_ - first_); }
+  bool empty() const noexcept { return first_ == last_; }
+
+  // Text of a kept line, 0-terminated; '*end' is set to its terminator
+  const char * Line(uint64_t number, const char **end = nullptr) const;
+  LineKind Kind(uint64_t number) const;
+
+ private:
+  struct LineRef {
+    uint32_t chunk, offset, length;
+    LineKind kind;
+  };
+
+  size_t chunk_size_;
+  // Both by position modulo their size
+  std::vector<LineRef> lines_;
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  // Chunk being written, and the bytes of it in use
+  size_t chunk_ = 0, used_ = 0;
+  uint64_t first_ = 0, last_ = 0;
+};
+
 // Demonstrate creating a simple console window, with scrolling, filtering,
 // completion and history. For the console example, here we are using a more
 // C++ like approach of declaring a class to hold the data and the functions.
 struct ConsoleApp
 {
   char                    InputBuf[256];
-  ImVector<char *>        Items;
+  ConsoleLog              Log;
   bool                    ScrollToBottom;
   ImVector<char *>        History;
   // -1: new line, 0..History.Size-1 browsing history.
   int                     HistoryPos;
   ImVector<const char *>  Commands;
+  // Commands of the app, see AddCommand()
+  typedef std::function<void(const std::vector<std::string> &args)>
+                          CommandFn;
+  struct AppCommand {
+    const char *name, *usage;
+    CommandFn   run;
+  };
+  std::vector<AppCommand> AppCommands;
+  ImGuiTextFilter         Filter;
+  // Numbers of the lines that pass the filter, from FilterIndex[
+  // FilterIndexBegin]; the lines up to FilterScanned have been tested
+  std::vector<uint64_t>   FilterIndex;
+  size_t                  FilterIndexBegin;
+  uint64_t                FilterScanned;
 
   ConsoleApp();
   ~ConsoleApp();
@@ -31,8 +94,22 @@ struct ConsoleApp
   void          ClearLog();
 
   void          AddLog(const char* fmt, ...) IM_FMTARGS(2);
+  // One line as it is, of the given kind
+  void          AddLine(const char *text, ConsoleLog::LineKind kind);
+  // A command beside CLEAR, HELP and HISTORY, matched case-insensitively.
+  // 'run' gets the words of the command line after the name. 'name' and
+  // 'usage', the arguments HELP shows, must outlive the console.
+  void          AddCommand(const char *name, const char *usage, CommandFn run);
 
   void          Draw();
+  // Tests the lines logged since the last frame, or a new filter against
+  // some more of the log, within VKTUTO_CONSOLE_FILTER_LINES lines a frame
+  void          UpdateFilter(bool filter_changed);
+  // The lines that pass the filter, not only the ones in view
+  void          CopyToClipboard() const;
+  // A ConsoleTable row, its cells at the columns of its padding
+  void          DrawTableRow(const char *text, const char *text_end,
+                             float line_x, float digit_width);
 
   void          ExecCommand(const char *command_line);
 
@@ -43,6 +120,25 @@ struct ConsoleApp
   int           TextEditCallback(ImGuiInputTextCallbackData *data);
 }; // struct ConsoleApp
 
+// Results for the console, one row per line: the first column left-aligned,
+// the others (numbers, mostly) right-aligned. The columns are padded with
+// spaces, at least two between them, for the clipboard; Draw() lines the
+// cells up again in the UI font, so cells must not hold two spaces in a row.
+class ConsoleTable {
+ public:
+  explicit ConsoleTable(std::vector<std::string> header);
+
+  void AddRow(std::vector<std::string> cells);
+  // printf() for a cell
+  static std::string Format(const char *fmt, ...) IM_FMTARGS(1);
+
+  void Print(ConsoleApp &console) const;
+
+ private:
+  // The header first
+  std::vector<std::vector<std::string>> rows_;
+};
+
 
 } // inline namespace utility
 
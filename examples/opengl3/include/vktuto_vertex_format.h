@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+// Interleaved vertex layouts. Positions are either 32-bit floats or 16-bit
+// unsigned normalized values relative to the mesh bounding box; normals are
+// octahedral-encoded into two 16-bit signed normalized values.
+//
+//   kFloat      float x, y, z       | short2 normal    12 / 16 bytes
+//   kQuantized  ushort x, y, z, pad | short2 normal     8 / 12 bytes
+//
+// (second size with normals). The shader restores positions as
+// positionOffset + positionScale * attribute.
+enum class VertexFormat { kFloat, kQuantized };
+
+struct PackedVertices {
+  VertexFormat         format = VertexFormat::kFloat;
+  bool                 has_normals = false;
+  size_t               count = 0;
+  size_t               stride = 0;
+  size_t               normal_offset = 0;
+  glm::vec3            position_offset = glm::vec3(0.0f);
+  glm::vec3            position_scale = glm::vec3(1.0f);
+  std::vector<uint8_t> bytes;
+};
+
+// Packs 'count' positions (and normals, when not nullptr) into 'out'. The
+// byte vector keeps its capacity, so repacking into the same object does not
+// allocate.
+void PackVertices(const glm::vec3 *positions, const glm::vec3 *normals,
+                  size_t count, VertexFormat format, PackedVertices &out);
+
+// Repacks vertices [first, first + count) in place, keeping the bounding box
+// of 'packed'. Returns false, leaving 'packed' untouched, when a position
+// falls outside the box and the whole mesh has to be packed again.
+bool PackVertexRange(const glm::vec3 *positions, const glm::vec3 *normals,
+                     size_t first, size_t count, PackedVertices &packed);
+
+// Octahedral normal encoding into two snorm16 values; 'normal' must be unit
+// length
+void      OctEncode(const glm::vec3 &normal, int16_t encoded[2]);
+glm::vec3 OctDecode(const int16_t encoded[2]);
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include "bench_app.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+namespace {
+
+constexpr unsigned int kWarmupFrames = 10;
+
+// Rows of the grid rewritten per frame by the partial upload phase
+constexpr unsigned int kPartialRows = 16;
+
+double Percentile(std::vector<double> values, double fraction) {
+  if (values.empty()) return 0.0;
+  size_t idx = static_cast<size_t>(fraction * (values.size() - 1) + 0.5);
+  std::nth_element(values.begin(), values.begin() + idx, values.end());
+  return values[idx];
+}
+
+double Mean(const std::vector<double> &values) {
+  double sum = 0.0;
+  for (double value : values) sum += value;
+  return values.empty() ? 0.0 : sum / values.size();
+}
+
+} // namespace
+
+BenchmarkApp::BenchmarkApp(const BenchmarkOptions &options)
+    : BaseApp(options.headless), options_(options) {
+  Initialize();
+}
+
+BenchmarkApp::~BenchmarkApp() {
+  Cleanup();
+}
+
+void BenchmarkApp::Initialize() {
+  // Bicubic test patch with one raised control point
+  surface_.degree_u = 3;
+  surface_.degree_v = 3;
+  surface_.knots_u = { 0, 0, 0, 0, 0.5, 1, 1, 1, 1 };
+  surface_.knots_v = { 0, 0, 0, 0, 0.5, 1, 1, 1, 1 };
+  surface_.control_points = { 5, 5,
+      { glm::vec3(0.5, 0.0, 0.0), glm::vec3(1.0, 0.0, 0.0), glm::vec3(1.3, 0.0, 0.0), glm::vec3(2.0, 0.0, 0.0), glm::vec3(2.8, 0.0, 0.0),
+        glm::vec3(0.4, 1.0, 0.0), glm::vec3(1.0, 1.0, 0.0), glm::vec3(2.3, 1.0, 0.2), glm::vec3(3.0, 1.0, 0.0), glm::vec3(3.5, 1.0, 0.0),
+        glm::vec3(0.0, 2.0, 0.0), glm::vec3(0.7, 2.0, 0.0), glm::vec3(1.3, 2.0, 1.2), glm::vec3(2.0, 2.0, 0.0), glm::vec3(2.8, 2.0, 0.0),
+        glm::vec3(0.4, 3.0, 0.0), glm::vec3(1.0, 3.0, 0.0), glm::vec3(2.3, 3.0, 0.2), glm::vec3(3.0, 3.0, 0.0), glm::vec3(3.5, 3.0, 0.0),
+        glm::vec3(0.0, 4.0, 0.0), glm::vec3(0.7, 4.0, 0.0), glm::vec3(1.3, 4.0, 0.0), glm::vec3(2.0, 4.0, 0.0), glm::vec3(2.8, 4.0, 0.0)
+      }
+  };
+  surface_.weights = { 5, 5, 1.0f };
+
+  const unsigned int grid = std::max(2u, options_.grid);
+  auto start = Clock::now();
+  TessellateSurface(surface_, grid, grid, positions_, &normals_);
+  tessellation_ms_ = std::chrono::duration<double, std::milli>(
+      Clock::now() - start).count();
+
+  GetVertices() = positions_;
+  GetNormals() = normals_;
+  GetColors().clear();
+  GetIndices().clear();
+  SetMeshColor(glm::vec4(1.0f, 0.6f, 0.1f, 1.0f));
+  SetGridIndices(grid, grid);
+  BindBuffers();
+
+  auto &markers = GetGlyphs(GlyphShape::kMarker);
+  auto &arrows = GetGlyphs(GlyphShape::kArrow);
+  markers.clear();
+  arrows.clear();
+  for (size_t idx = 0; idx < options_.glyphs; idx++) {
+    const size_t vertex = idx * positions_.size() / options_.glyphs;
+    if (idx % 2 == 0) {
+      markers.push_back(MakeMarker(positions_[vertex], 6.0f,
+                                   glm::vec3(0.35f, 0.6f, 1.0f)));
+    }
+    else {
+      arrows.push_back(MakeArrow(positions_[vertex], 0.1f * normals_[vertex],
+                                 glm::vec3(1.0f, 1.0f, 0.0f)));
+    }
+  }
+  BindGlyphs();
+
+  // Scaled copies of a coarse tessellation, each one arena mesh
+  if (options_.patches > 0) {
+    const unsigned int tiles = static_cast<unsigned int>(
+        std::ceil(std::sqrt(double(options_.patches))));
+    const float scale = 1.0f / tiles;
+    std::vector<glm::vec3> patch_positions, patch_normals, placed;
+    TessellateSurface(surface_, 17, 17, patch_positions, &patch_normals);
+    placed.resize(patch_positions.size());
+    for (unsigned int patch = 0; patch < options_.patches; patch++) {
+      const glm::vec3 offset(3.5f * scale * (patch % tiles),
+                             4.0f * scale * (patch / tiles), 0.5f);
+      for (size_t idx = 0; idx < placed.size(); idx++)
+        placed[idx] = offset + scale * patch_positions[idx];
+      const glm::vec4 color(0.3f + 0.7f * ((patch * 37) % 11) / 10.0f,
+                            0.8f, 0.3f + 0.7f * ((patch * 17) % 7) / 6.0f,
+                            1.0f);
+      AddGridMesh(17, 17, placed.data(), patch_normals.data(), color);
+    }
+  }
+
+  // Frame the patch, which spans [0, 3.5] x [0, 4]
+  GetCamH() = 5.0f / std::max(options_.zoom, 1e-3f);
+  GetCamW() = GetCamH() * GetTextrueX() / float(GetTextrueY());
+  GetCamX() = 1.75f - GetCamW() / 2;
+  GetCamY() = 2.0f - GetCamH() / 2;
+
+  results_.clear();
+  phase_ = Phase::kWarmup;
+  frame_ = 0;
+  UploadStats::Global().Reset();
+}
+
+void BenchmarkApp::Update() {
+  // Frame boundary: the previous frame has fully rendered, so frame times
+  // cover submission, uploads and rasterization. A render thread is not
+  // waited for: frame times are then those of the UI thread.
+  if (!HasRenderThread()) FinishRendering();
+  Clock::time_point now = Clock::now();
+  if (frame_ > 0 && phase_ != Phase::kWarmup && !results_.empty()) {
+    results_.back().frame_ms.push_back(
+        std::chrono::duration<double, std::milli>(now - last_frame_).count());
+  }
+  last_frame_ = now;
+
+  const unsigned int frames = std::max(1u, options_.frames);
+  if (phase_ == Phase::kWarmup && frame_ == kWarmupFrames) {
+    BeginPhase(Phase::kDraw);
+  }
+  else if (phase_ != Phase::kWarmup && frame_ == frames) {
+    EndPhase();
+    BeginPhase(static_cast<Phase>(static_cast<int>(phase_) + 1));
+  }
+  if (phase_ == Phase::kDone) {
+    GLenum error = GL_NO_ERROR;
+    RunOnRenderThread([&error] { error = glGetError(); });
+    if (error != GL_NO_ERROR) {
+      char message[64];
+      std::snprintf(message, sizeof(message), "OpenGL error 0x%04X", error);
+      throw std::runtime_error(message);
+    }
+    Report();
+    if (!options_.image_file.empty()) WriteImage();
+    Quit();
+    return;
+  }
+
+  const unsigned int grid = std::max(2u, options_.grid);
+  const float scale = 0.9f + 0.1f * std::cos(0.05f * frame_);
+  switch (phase_) {
+    case Phase::kUpload:
+      AnimateRows(0, grid, scale);
+      BindBuffers();
+      break;
+    case Phase::kPartialUpload: {
+      unsigned int row_begin = (frame_ * kPartialRows) % grid;
+      unsigned int row_end = std::min(row_begin + kPartialRows, grid);
+      AnimateRows(row_begin, row_end, scale);
+      UpdateVertices(size_t(row_begin) * grid,
+                     size_t(row_end - row_begin) * grid);
+      break;
+    }
+    case Phase::kIncremental: {
+      // One surface after the other, rows drawn as they are done. The wait
+      // for the last frame above is not part of the budget.
+      if (!incremental_.Active()) {
+        nurbs::RationalSurface3f edited = surface_;
+        edited.control_points(2, 2).z *= scale;
+        incremental_.Start(edited, grid, grid, true);
+        BeginGridRows(grid, grid, incremental_.lower(), incremental_.upper(),
+                      true);
+      }
+      const unsigned int first = incremental_.rows_done();
+      const unsigned int num_rows = incremental_.Step(
+          now + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double, std::milli>(
+                        WorkBudgetMs())));
+      const size_t offset = size_t(first) * grid;
+      AppendGridRows(incremental_.positions().data() + offset,
+                     incremental_.normals().data() + offset, num_rows);
+      incremental_frames_++;
+      if (incremental_.Done()) {
+        incremental_surfaces_++;
+        incremental_.Cancel();
+      }
+      break;
+    }
+    case Phase::kPreview: {
+      // Drag the raised control point: one job per frame, the newest
+      // finished result is shown
+      if (geometry_.SwapSurface(preview_) && preview_.error.empty()) {
+        GetVertices().swap(preview_.positions);
+        GetNormals().swap(preview_.normals);
+        BindBuffers();
+        preview_results_++;
+        preview_job_ms_ += preview_.seconds * 1000.0;
+      }
+      nurbs::RationalSurface3f edited = surface_;
+      edited.control_points(2, 2).z *= scale;
+      geometry_.SubmitSurface(edited, grid, grid);
+      preview_jobs_++;
+      break;
+    }
+    default:
+      break;
+  }
+  GetRotY() = 0.2f * std::sin(0.02f * frame_);
+  frame_++;
+}
+
+void BenchmarkApp::Cleanup() {
+}
+
+void BenchmarkApp::BeginPhase(Phase phase) {
+  static const char *names[] = {
+    "warmup", "draw", "upload", "partial", "incr", "preview"
+  };
+  phase_ = phase;
+  frame_ = 0;
+  if (phase == Phase::kDone) return;
+  PhaseResult result;
+  result.name = names[static_cast<int>(phase)];
+  result.frame_ms.reserve(options_.frames);
+  results_.push_back(result);
+  // Waits for the frames of the last phase
+  RunOnRenderThread([this] {
+    UploadStats::Global().Reset();
+    GetProfiler().Reset();
+  });
+}
+
+void BenchmarkApp::EndPhase() {
+  PhaseResult &result = results_.back();
+  for (double frame_ms : result.frame_ms) result.seconds += frame_ms / 1000.0;
+  RunOnRenderThread([this, &result] {
+    glFinish();
+    result.uploads = UploadStats::Global();
+    result.gpu_canvas = GetProfiler().Summarize(ProfileSection::kCanvasDraw,
+                                                ProfileClock::kGpu);
+    result.render = GetProfiler().Summarize(ProfileSection::kFrame);
+  });
+}
+
+void BenchmarkApp::AnimateRows(unsigned int row_begin, unsigned int row_end,
+                               float scale) {
+  const unsigned int grid = std::max(2u, options_.grid);
+  auto &vertices = GetVertices();
+  for (size_t idx = size_t(row_begin) * grid; idx < size_t(row_end) * grid;
+       idx++) {
+    vertices[idx] = glm::vec3(positions_[idx].x, positions_[idx].y,
+                              positions_[idx].z * scale);
+  }
+}
+
+void BenchmarkApp::Report() {
+  const unsigned int grid = std::max(2u, options_.grid);
+  const size_t full = 2 * size_t(grid - 1) * (grid - 1);
+  std::string version, renderer;
+  size_t drawn = full, arena_meshes = 0, vertex_bytes = 0, index_bytes = 0;
+  RunOnRenderThread([&] {
+    version = reinterpret_cast<const char *>(glGetString(GL_VERSION));
+    renderer = reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+    if (!GetProfiler().empty()) drawn = GetProfiler().Latest().triangles;
+    const MeshArena &arena = GetMeshArena();
+    arena_meshes = arena.NumMeshes();
+    vertex_bytes = arena.VertexBytes();
+    index_bytes = arena.IndexBytes();
+  });
+  std::printf("renderer : %s, %s\n", version.c_str(), renderer.c_str());
+  std::printf("canvas   : %d x %d\n", GetTextrueX(), GetTextrueY());
+  if (const RenderThread *thread = GetRenderThread()) {
+    std::printf("frames   : render thread, pacing %s, %llu drawn, %llu "
+                "skipped\n", FramePacingName(thread->pacing()),
+                thread->FramesDrawn(), thread->FramesSkipped());
+  }
+  else {
+    std::printf("frames   : UI thread\n");
+  }
+  const ProgramCacheStats &programs = GetProgramStats();
+  std::printf("startup  : %.1f ms, programs %.1f ms (read %.1f, link %.1f): "
+              "%zu from cache, %zu compiled, %zu refused, %zu stored\n",
+              StartupMilliseconds(), programs.total_ms, programs.read_ms,
+              programs.link_ms, programs.cached, programs.compiled,
+              programs.rejected, programs.stored);
+  std::printf("mesh     : %u x %u samples, %zu triangles (%s), "
+              "tessellated in %.2f ms\n", grid, grid,
+              2 * size_t(grid - 1) * (grid - 1),
+              GridTopologyName(VKTUTO_GRID_TOPOLOGY), tessellation_ms_);
+  std::printf("lod      : %s, culling %s, zoom %.1f, "
+              "%zu of %zu triangles drawn (%.1f%%)\n",
+              GridLodEnabled() ? "on" : "off",
+              FrustumCullingEnabled() ? "on" : "off", options_.zoom,
+              drawn, full, 100.0 * drawn / full);
+  std::printf("glyphs   : %u\n", options_.glyphs);
+  std::printf("arena    : %zu meshes, %s, %.1f MB vertices, %.1f MB "
+              "indices\n", arena_meshes,
+              VKTUTO_ARENA_MULTI_DRAW ? "batched" : "one call per mesh",
+              vertex_bytes / (1024.0 * 1024.0),
+              index_bytes / (1024.0 * 1024.0));
+  std::printf("incr     : %zu surfaces done, %.1f frames per surface, "
+              "work budget %.1f ms per frame\n", incremental_surfaces_,
+              incremental_surfaces_ > 0
+                  ? double(incremental_frames_) / incremental_surfaces_ : 0.0,
+              WorkBudgetMs());
+  std::printf("preview  : %zu of %zu jobs shown, %zu jobs dropped, "
+              "%.2f ms per shown job\n", preview_results_, preview_jobs_,
+              geometry_.JobsCancelled(),
+              preview_results_ > 0 ? preview_job_ms_ / preview_results_ : 0.0);
+  std::printf("%-8s %7s %9s %9s %9s %9s %10s %8s %6s %9s %9s\n", "phase",
+              "frames", "mean ms", "p50 ms", "p95 ms", "max ms",
+              "upload MB/s", "orphans", "waits", "render ms", "gpu ms");
+  for (const PhaseResult &result : results_) {
+    double mbps = result.seconds > 0.0
+        ? result.uploads.bytes / (1024.0 * 1024.0) / result.seconds : 0.0;
+    std::printf("%-8s %7zu %9.3f %9.3f %9.3f %9.3f %10.1f %8zu %6zu ",
+                result.name, result.frame_ms.size(), Mean(result.frame_ms),
+                Percentile(result.frame_ms, 0.5),
+                Percentile(result.frame_ms, 0.95),
+                Percentile(result.frame_ms, 1.0), mbps,
+                result.uploads.orphans, result.uploads.waits);
+    std::printf("%9.3f ", result.render.mean);
+    if (result.gpu_canvas.samples > 0)
+      std::printf("%9.3f\n", result.gpu_canvas.mean);
+    else
+      std::printf("%9s\n", "-");
+  }
+  std::fflush(stdout);
+
+  if (!options_.csv_file.empty()) {
+    std::ofstream csv(options_.csv_file);
+    if (!csv) throw std::runtime_error("Cannot write " + options_.csv_file);
+    csv << "phase,frames,mean_ms,p50_ms,p95_ms,max_ms,upload_bytes,"
+           "uploads,orphans,waits,wait_seconds,render_ms,gpu_canvas_ms\n";
+    for (const PhaseResult &result : results_) {
+      csv << result.name << ',' << result.frame_ms.size() << ','
+          << Mean(result.frame_ms) << ','
+          << Percentile(result.frame_ms, 0.5) << ','
+          << Percentile(result.frame_ms, 0.95) << ','
+          << Percentile(result.frame_ms, 1.0) << ','
+          << result.uploads.bytes << ',' << result.uploads.uploads << ','
+          << result.uploads.orphans << ',' << result.uploads.waits << ','
+          << result.uploads.wait_seconds << ','
+          << result.render.mean << ','
+          << result.gpu_canvas.mean << '\n';
+    }
+  }
+}
+
+void BenchmarkApp::WriteImage() {
+  // Canvas of the last benchmark frame, as binary PPM (top row first)
+  std::vector<uint8_t> rgb;
+  ReadCanvas(rgb);
+  const size_t row_bytes = size_t(3) * GetTextrueX();
+  std::ofstream out(options_.image_file, std::ios::binary);
+  if (!out) throw std::runtime_error("Cannot write " + options_.image_file);
+  out << "P6\n" << GetTextrueX() << ' ' << GetTextrueY() << "\n255\n";
+  for (int row = GetTextrueY() - 1; row >= 0; row--) {
+    out.write(reinterpret_cast<const char *>(rgb.data() + row * row_bytes),
+              row_bytes);
+  }
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -1,19 +1,156 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
 
 #include "opengl3_base.h"
 #include "test_app.h"
+#include "bench_app.h"
+
+namespace {
+
+void PrintUsage(const char *program) {
+  std::cerr << "usage: " << program << " [--font-cache cold|warm|off]\n"
+            << "       " << program << " --headless [options]\n"
+            << "  --font-cache cold|warm|off\n"
+            << "                      start without the prebaked font atlas,\n"
+            << "                      with it (default) or without the cache\n"
+            << "  --headless          run the canvas benchmark without a window\n"
+            << "  --backend egl|osmesa offscreen context (default "
+            << vktuto::HeadlessBackendName(vktuto::HeadlessOptions().backend)
+            << ")\n"
+            << "  --size WxH          canvas size\n"
+            << "  --frames N          frames per benchmark phase\n"
+            << "  --grid N            surface samples per direction\n"
+            << "  --zoom F            canvas magnification\n"
+            << "  --glyphs N          instanced glyphs over the surface\n"
+            << "  --patches N         extra surfaces in the mesh arena\n"
+            << "  --render-thread off|latest|queue\n"
+            << "                      draw on a render thread with this pacing\n"
+            << "  --program-cache cold|warm|off\n"
+            << "                      start without cached shader binaries, with\n"
+            << "                      them (default) or without the cache\n"
+            << "  --image FILE.ppm    save the last frame\n"
+            << "  --csv FILE.csv      save the results" << std::endl;
+}
+
+// Both return false on unknown or malformed arguments
+bool ParseWindowOptions(int argc, char *argv[],
+                        vktuto::WindowOptions &options) {
+  for (int idx = 1; idx < argc; idx += 2) {
+    const char *arg = argv[idx];
+    const char *value = idx + 1 < argc ? argv[idx + 1] : nullptr;
+    if (value == nullptr || std::strcmp(arg, "--font-cache") != 0)
+      return false;
+    if (std::strcmp(value, "cold") == 0)
+      options.clear_font_cache = true;
+    else if (std::strcmp(value, "off") == 0)
+      options.font_cache.clear();
+    else if (std::strcmp(value, "warm") != 0)
+      return false;
+  }
+  return true;
+}
+
+bool ParseBenchmarkOptions(int argc, char *argv[],
+                           vktuto::BenchmarkOptions &options) {
+  for (int idx = 2; idx < argc; idx++) {
+    const char *arg = argv[idx];
+    const char *value = idx + 1 < argc ? argv[idx + 1] : nullptr;
+    if (value == nullptr) return false;
+    if (std::strcmp(arg, "--backend") == 0) {
+      if (std::strcmp(value, "egl") == 0)
+        options.headless.backend = vktuto::HeadlessBackend::kEGL;
+      else if (std::strcmp(value, "osmesa") == 0)
+        options.headless.backend = vktuto::HeadlessBackend::kOSMesa;
+      else
+        return false;
+    }
+    else if (std::strcmp(arg, "--size") == 0) {
+      unsigned int width = 0, height = 0;
+      if (std::sscanf(value, "%ux%u", &width, &height) != 2 ||
+          width == 0 || height == 0)
+        return false;
+      options.headless.width = width;
+      options.headless.height = height;
+    }
+    else if (std::strcmp(arg, "--frames") == 0) {
+      options.frames = std::strtoul(value, nullptr, 10);
+    }
+    else if (std::strcmp(arg, "--grid") == 0) {
+      options.grid = std::strtoul(value, nullptr, 10);
+    }
+    else if (std::strcmp(arg, "--zoom") == 0) {
+      options.zoom = std::strtof(value, nullptr);
+      if (!(options.zoom > 0.0f)) return false;
+    }
+    else if (std::strcmp(arg, "--glyphs") == 0) {
+      options.glyphs = std::strtoul(value, nullptr, 10);
+    }
+    else if (std::strcmp(arg, "--patches") == 0) {
+      options.patches = std::strtoul(value, nullptr, 10);
+    }
+    else if (std::strcmp(arg, "--render-thread") == 0) {
+      options.headless.render_thread = std::strcmp(value, "off") != 0;
+      if (std::strcmp(value, "latest") == 0)
+        options.headless.pacing = vktuto::FramePacing::kLatest;
+      else if (std::strcmp(value, "queue") == 0)
+        options.headless.pacing = vktuto::FramePacing::kQueue;
+      else if (options.headless.render_thread)
+        return false;
+    }
+    else if (std::strcmp(arg, "--program-cache") == 0) {
+      if (std::strcmp(value, "cold") == 0)
+        options.headless.clear_program_cache = true;
+      else if (std::strcmp(value, "off") == 0)
+        options.headless.program_cache.clear();
+      else if (std::strcmp(value, "warm") != 0)
+        return false;
+    }
+    else if (std::strcmp(arg, "--image") == 0) {
+      options.image_file = value;
+    }
+    else if (std::strcmp(arg, "--csv") == 0) {
+      options.csv_file = value;
+    }
+    else {
+      return false;
+    }
+    idx++;
+  }
+  return true;
+}
+
+} // namespace
 
 int main(int argc, char * argv[]) {
+  const bool headless = argc > 1 && std::strcmp(argv[1], "--headless") == 0;
+  vktuto::BenchmarkOptions options;
+  vktuto::WindowOptions window;
+  if ((!headless && !ParseWindowOptions(argc, argv, window)) ||
+      (headless && !ParseBenchmarkOptions(argc, argv, options))) {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
   try
   {
-    vktuto::TestApp test_app;
-    test_app.Run();
+    if (headless) {
+      vktuto::BenchmarkApp bench_app(options);
+      bench_app.Run();
+    }
+    else {
+      vktuto::TestApp test_app(window);
+      test_app.Run();
+    }
   }
   catch (const std::exception& except)
   {
     std::cerr << "[Error] catched: "
-              << except.what() << std::endl; 
+              << except.what() << std::endl;
+    return EXIT_FAILURE;
   }
 
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -2,9 +2,19 @@
 #include <stdexcept>
 #include <fstream>
 #include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <cstdio>
+#include <iterator>
+#include <limits>
 #include <string>
+#include <thread>
 
 #include "opengl3_base.h"
+#include "vktuto_nurbs.h"
 
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
@@ -24,11 +34,45 @@ namespace vktuto {
 
 inline namespace opengl3 {
 
-BaseApp::BaseApp() : 
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double MillisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+Clock::time_point AfterMilliseconds(Clock::time_point start, double ms) {
+  return start + std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double, std::milli>(ms));
+}
+
+// Quad rows per draw call of a grid that is still arriving; one index
+// buffer of this height serves every band
+constexpr unsigned int kRowBand = 32;
+
+std::string Lowercase(std::string text) {
+  for (char &c : text)
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  return text;
+}
+
+bool ReadFontFile(const std::string &file_name, std::vector<char> &out) {
+  std::ifstream in(file_name, std::ios::binary);
+  if (!in) return false;
+  out.assign(std::istreambuf_iterator<char>(in),
+             std::istreambuf_iterator<char>());
+  return !in.bad() && !out.empty();
+}
+
+} // namespace
+
+BaseApp::BaseApp(const WindowOptions &window) : 
     gl_version_(DecideGLVersion(
                     VKTUTO_OPENGL_MAJOR_VERSION,
                     VKTUTO_OPENGL_MINOR_VERSION)),
     glsl_version_(DecideGLSLVersion(gl_version_)) {
+  const Clock::time_point start = Clock::now();
   InitGLFWWithErrorCallback();
   SetGLVersion();
 
@@ -40,10 +84,56 @@ BaseApp::BaseApp() :
 
   SetupImGuiContext();
   BindPlatformAndRenderer(window_, glsl_version_);
-  InitCustomGL();
+  // TestApp resizes the canvas to its tab on the first frame
+  InitCustomGL(VKTUTO_WINDOW_WIDTH, VKTUTO_WINDOW_HEIGHT);
 
   SetImguiStyle();
-  LoadFonts();
+  // Latin-1 to start with; text asks for more (RequestGlyphs()). The bold
+  // and thin fonts wait for their first use.
+  font_glyphs_.AddRanges(ImGui::GetIO().Fonts->GetGlyphRangesDefault());
+  for (VkTutoFontFlag flag : { VkTutoFontFlag::Normal,
+                               VkTutoFontFlag::SolidIcon,
+                               VkTutoFontFlag::BrandIcon })
+    font_map.at(flag).wanted = true;
+  FontAtlasCache font_cache(window.font_cache);
+  if (window.clear_font_cache) font_cache.Clear();
+  LoadFonts(font_cache);
+  // ImGui_ImplOpenGL3_NewFrame() would create its shaders and the font
+  // texture on first use, on the UI thread; this thread has the context
+  ImGui_ImplOpenGL3_CreateDeviceObjects();
+  // The texture is made: the atlas lets go of the mapped cache file
+  font_cache.Release(*ImGui::GetIO().Fonts);
+  font_stats_ = font_cache.stats();
+  console.AddLog("Font atlas: %dx%d (%zu KiB), %zu glyphs %s in %.1f ms",
+                 font_stats_.width, font_stats_.height,
+                 size_t(font_stats_.width) * font_stats_.height * 4 / 1024,
+                 font_stats_.glyphs,
+                 font_stats_.cached ? "from cache" : "rasterized",
+                 font_stats_.total_ms);
+  startup_ms_ = MillisecondsSince(start);
+  console.AddLog("Started in %.1f ms", startup_ms_);
+
+  AddConsoleCommands();
+  Initialize();
+}
+
+BaseApp::BaseApp(const HeadlessOptions &headless) :
+    gl_version_(DecideGLVersion(
+                    VKTUTO_OPENGL_MAJOR_VERSION,
+                    VKTUTO_OPENGL_MINOR_VERSION)),
+    glsl_version_(DecideGLSLVersion(gl_version_)),
+    headless_options_(headless) {
+  const Clock::time_point start = Clock::now();
+  // The canvas shaders are GLSL 330
+  bool below_33 = gl_version_.major < 3 ||
+                  (gl_version_.major == 3 && gl_version_.minor < 3);
+  headless_ = std::make_unique<HeadlessContext>(
+      headless.backend, below_33 ? 3 : gl_version_.major,
+      below_33 ? 3 : gl_version_.minor);
+  InitGLLoader(headless_->GetProcAddress());
+
+  InitCustomGL(headless.width, headless.height);
+  startup_ms_ = MillisecondsSince(start);
 
   Initialize();
 }
@@ -51,9 +141,22 @@ BaseApp::BaseApp() :
 BaseApp::~BaseApp() {
   Cleanup();
 
+  // The context comes back for the cleanup; work not run yet is dropped
+  if (render_thread_) {
+    render_thread_.reset();
+    MakeContextCurrent();
+  }
+  commands_.clear();
+  spare_frame_.reset();
+
   // Cleanup
   DestroyCustomGL();
 
+  if (headless_) {
+    headless_.reset();
+    return;
+  }
+
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
@@ -66,6 +169,47 @@ void BaseApp::ErrorCallback(int error, const char *description) {
   std::cerr << "Glfw Error " << error << ": " << description << std::endl;
 }
 
+void BaseApp::OnWindowEvent(GLFWwindow *window) {
+  auto *app = static_cast<BaseApp *>(glfwGetWindowUserPointer(window));
+  if (app != nullptr) app->had_events_ = true;
+}
+
+void BaseApp::InstallEventCallbacks(GLFWwindow *window) {
+  // Installed before the ImGui bindings, which chain to them; they only
+  // note that something happened, so an idle MainLoop() draws again
+  glfwSetWindowUserPointer(window, this);
+  glfwSetMouseButtonCallback(window, [](GLFWwindow *w, int, int, int) {
+    OnWindowEvent(w);
+  });
+  glfwSetScrollCallback(window, [](GLFWwindow *w, double, double) {
+    OnWindowEvent(w);
+  });
+  glfwSetKeyCallback(window, [](GLFWwindow *w, int, int, int, int) {
+    OnWindowEvent(w);
+  });
+  glfwSetCharCallback(window, [](GLFWwindow *w, unsigned int codepoint) {
+    OnWindowEvent(w);
+    auto *app = static_cast<BaseApp *>(glfwGetWindowUserPointer(w));
+    if (app != nullptr && app->font_glyphs_.Add(codepoint))
+      app->fonts_dirty_ = true;
+  });
+  glfwSetCursorPosCallback(window, [](GLFWwindow *w, double, double) {
+    OnWindowEvent(w);
+  });
+  glfwSetCursorEnterCallback(window, [](GLFWwindow *w, int) {
+    OnWindowEvent(w);
+  });
+  glfwSetWindowFocusCallback(window, [](GLFWwindow *w, int) {
+    OnWindowEvent(w);
+  });
+  glfwSetFramebufferSizeCallback(window, [](GLFWwindow *w, int, int) {
+    OnWindowEvent(w);
+  });
+  glfwSetWindowRefreshCallback(window, [](GLFWwindow *w) {
+    OnWindowEvent(w);
+  });
+}
+
 void BaseApp::InitGLFWWithErrorCallback() const noexcept(false) {
   // Setup window
   glfwSetErrorCallback(ErrorCallback);
@@ -139,14 +283,21 @@ GLFWwindow * BaseApp::CreateGLFWWindow(
   return window;
 }
 
-void BaseApp::InitGLLoader() const noexcept(false) {
-  // Initialize OpenGL loader
+void BaseApp::InitGLLoader(
+    HeadlessContext::GetProcAddressProc get_proc_address) const noexcept(false) {
+  // Initialize OpenGL loader; headless contexts resolve functions through
+  // their own GetProcAddress
 #if defined(IMGUI_IMPL_OPENGL_LOADER_GL3W)
-  bool err = gl3wInit() != 0;
+  bool err = get_proc_address
+      ? gl3wInit2(reinterpret_cast<GL3WGetProcAddressProc>(get_proc_address)) != 0
+      : gl3wInit() != 0;
 #elif defined(IMGUI_IMPL_OPENGL_LOADER_GLEW)
+  (void)get_proc_address;
   bool err = glewInit() != GLEW_OK;
 #elif defined(IMGUI_IMPL_OPENGL_LOADER_GLAD)
-  bool err = gladLoadGL() == 0;
+  bool err = get_proc_address
+      ? gladLoadGLLoader(reinterpret_cast<GLADloadproc>(get_proc_address)) == 0
+      : gladLoadGL() == 0;
 #else
   bool err = false;
   // If you use IMGUI_IMPL_OPENGL_LOADER_CUSTOM,
@@ -174,8 +325,26 @@ void BaseApp::BindPlatformAndRenderer(
     GLFWwindow *window,
     const std::string &glsl_version) {
   // Setup Platform/Renderer bindings
+  InstallEventCallbacks(window);
   ImGui_ImplGlfw_InitForOpenGL(window, true);
   ImGui_ImplOpenGL3_Init(glsl_version.c_str());
+
+  // Pasted text gets its glyphs like typed text
+  ImGuiIO &io = ImGui::GetIO();
+  get_clipboard_text_ = io.GetClipboardTextFn;
+  set_clipboard_text_ = io.SetClipboardTextFn;
+  clipboard_user_data_ = io.ClipboardUserData;
+  io.ClipboardUserData = this;
+  io.GetClipboardTextFn = [](void *user_data) -> const char * {
+    BaseApp *app = static_cast<BaseApp *>(user_data);
+    const char *text = app->get_clipboard_text_(app->clipboard_user_data_);
+    app->RequestGlyphs(text);
+    return text;
+  };
+  io.SetClipboardTextFn = [](void *user_data, const char *text) {
+    BaseApp *app = static_cast<BaseApp *>(user_data);
+    app->set_clipboard_text_(app->clipboard_user_data_, text);
+  };
 }
 
 void BaseApp::SetImguiStyle() const noexcept {
@@ -183,72 +352,281 @@ void BaseApp::SetImguiStyle() const noexcept {
   ImGui::StyleColorsDark();
 }
 
-void BaseApp::LoadFonts() {
+void BaseApp::LoadFonts(FontAtlasCache &cache) {
   // Load Fonts
   // - If no fonts are loaded, dear imgui will use the default font.
   //    You can also load multiple fonts and use ImGui::PushFont()/PopFont()
   //    to select them.
-  // - AddFontFromFileTTF() will return the ImFont* so you can store it if 
-  //    you need to select the font among multiple.
-  // - If the file cannot be loaded, the function will return NULL.
-  //    Please handle those errors in your application
-  //    (e.g. use an assertion, or display an error and quit).
   // - The fonts will be rasterized at a given size (w/ oversampling) and
   //    stored into a texture when calling
   //    ImFontAtlas::Build()/GetTexDataAsXXXX(), which ImGui_ImplXXXX_NewFrame
-  //    below will call.
-  // - Read 'misc/fonts/README.txt' for more instructions and details.
-  // - Remember that in C/C++ if you want to include a backslash \ in a string
-  //    literal you need to write a double backslash \\ !
+  //    below will call. Here 'cache' builds the atlas, or restores the one
+  //    an earlier start built from the same fonts.
+  // - Glyph ranges are read when the atlas is built, so they must outlive
+  //    this function.
+  // - Only the glyphs of 'font_glyphs_' are rasterized, and only the fonts
+  //    asked for so far. RefreshFonts() calls this again, from scratch, when
+  //    either grows; the ImFont pointers change then.
   ImGuiIO &io = ImGui::GetIO();
   ImFontAtlas *atlas = io.Fonts;
-  ImFontConfig icons_config;
-               icons_config.MergeMode = true;
-               icons_config.PixelSnapH = true;
-  {
-    Font &font = font_map[VkTutoFontFlag::Normal];
-    font.im_font = atlas->AddFontFromFileTTF(font.file.c_str(), font.size,
-                                             NULL,
-                                             atlas->GetGlyphRangesKorean());
-    IM_ASSERT(font.im_font != NULL);
+  atlas->Clear();
+  font_ranges_ = font_glyphs_.BuildRanges();
+  // merge in icons from Font Awesome
+  // use FONT_ICON_FILE_NAME_FAR if you want regular instead of solid
+  static const ImWchar icons_ranges_solid[] = { ICON_MIN_FAS, ICON_MAX_FAS, 0 };
+  static const ImWchar icons_ranges_brand[] = { ICON_MIN_FAB, ICON_MAX_FAB, 0 };
+  AddFont(*atlas, VkTutoFontFlag::Normal, false, font_ranges_.data());
+  AddFont(*atlas, VkTutoFontFlag::SolidIcon, true, icons_ranges_solid);
+  AddFont(*atlas, VkTutoFontFlag::BrandIcon, true, icons_ranges_brand);
+  AddFont(*atlas, VkTutoFontFlag::Bold, false, font_ranges_.data());
+  AddFont(*atlas, VkTutoFontFlag::Thin, false, font_ranges_.data());
+  if (atlas->ConfigData.Size == 0) atlas->AddFontDefault();
+
+  if (!cache.Build(*atlas))
+    throw std::runtime_error("Font atlas building failed!");
+}
+
+void BaseApp::AddFont(ImFontAtlas &atlas, VkTutoFontFlag flag, bool merge,
+                      const ImWchar *ranges) {
+  Font &font = font_map.at(flag);
+  font.im_font = nullptr;
+  // Icons merge into the font before them
+  if (!font.wanted || (merge && atlas.Fonts.Size == 0)) return;
+  // Read once and kept for later rebuilds; the atlas only borrows it
+  if (font.data.empty() && !ReadFontFile(font.file, font.data)) {
+    std::cerr << "Unable to open " << font.file << std::endl;
+    font.wanted = false;
+    return;
   }
-  {
-    // merge in icons from Font Awesome
-    const ImWchar icons_ranges_solid[] = { ICON_MIN_FAS, ICON_MAX_FAS, 0 };
-    Font &font = font_map[VkTutoFontFlag::SolidIcon];
-    font.im_font = atlas->AddFontFromFileTTF(font.file.c_str(), font.size,
-                                             &icons_config,
-                                             icons_ranges_solid);
-    IM_ASSERT(font.im_font != NULL);
-    // use FONT_ICON_FILE_NAME_FAR if you want regular instead of solid
+  ImFontConfig config;
+  config.FontDataOwnedByAtlas = false;
+  config.MergeMode = merge;
+  config.PixelSnapH = merge;
+  const size_t slash = font.file.find_last_of("/\\");
+  const size_t name = slash == std::string::npos ? 0 : slash + 1;
+  std::snprintf(config.Name, sizeof(config.Name), "%s, %.0fpx",
+                font.file.c_str() + name, font.size);
+  font.im_font = atlas.AddFontFromMemoryTTF(font.data.data(),
+                                            int(font.data.size()), font.size,
+                                            &config, ranges);
+}
+
+ImFont * BaseApp::GetFont(VkTutoFontFlag flag) noexcept {
+  Font &font = font_map.at(flag);
+  if (font.im_font != nullptr || window_ == nullptr) return font.im_font;
+  // Loaded before the next frame; this one makes do with the normal font
+  if (!font.wanted) {
+    font.wanted = true;
+    fonts_dirty_ = true;
   }
-  {
-    const ImWchar icons_ranges_brand[] = { ICON_MIN_FAB, ICON_MAX_FAB, 0 };
-    Font &font = font_map[VkTutoFontFlag::BrandIcon];
-    font.im_font = atlas->AddFontFromFileTTF(font.file.c_str(), font.size,
-                                             &icons_config,
-                                             icons_ranges_brand);
-    IM_ASSERT(font.im_font != NULL);
+  return font_map.at(VkTutoFontFlag::Normal).im_font;
+}
+
+void BaseApp::RequestGlyphs(const char *text, const char *text_end) {
+  if (font_glyphs_.AddText(text, text_end) > 0) fonts_dirty_ = true;
+}
+
+void BaseApp::RefreshFonts() {
+  // Console lines since the last frame, those still kept
+  const utility::ConsoleLog &log = console.Log;
+  console_lines_seen_ = std::max(console_lines_seen_, log.first());
+  for (; console_lines_seen_ < log.last(); console_lines_seen_++) {
+    const char *text_end;
+    const char *text = log.Line(console_lines_seen_, &text_end);
+    RequestGlyphs(text, text_end);
   }
-  {
-    Font &font = font_map[VkTutoFontFlag::Bold];
-    font.im_font = atlas->AddFontFromFileTTF(font.file.c_str(), font.size,
-                                             NULL,
-                                             atlas->GetGlyphRangesKorean());
-    IM_ASSERT(font.im_font != NULL);
+  if (!fonts_dirty_) return;
+  fonts_dirty_ = false;
+
+  // The cache file keeps the atlas of the start; later ones are built here
+  ImFontAtlas *atlas = ImGui::GetIO().Fonts;
+  const ImTextureID texture = atlas->TexID;
+  FontAtlasCache cache("");
+  LoadFonts(cache);
+  font_stats_ = cache.stats();
+
+  // The new pixels replace the font texture under its old name, after the
+  // frames drawn with the old glyphs
+  unsigned char *pixels = nullptr;
+  int width = 0, height = 0;
+  atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+  atlas->TexID = texture;
+  auto rgba = std::make_shared<std::vector<unsigned char>>(
+      pixels, pixels + size_t(4) * width * height);
+  Record([texture, rgba, width, height] {
+    GLint last_texture = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+    glBindTexture(GL_TEXTURE_2D, GLuint(reinterpret_cast<intptr_t>(texture)));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, rgba->data());
+    glBindTexture(GL_TEXTURE_2D, GLuint(last_texture));
+  }, kFontCommand, true);
+  console.AddLog("Font atlas rebuilt: %dx%d (%zu KiB), %zu glyphs in %.1f ms",
+                 width, height, size_t(width) * height * 4 / 1024,
+                 font_stats_.glyphs, font_stats_.total_ms);
+}
+
+void BaseApp::AddConsoleCommands() {
+  console.AddCommand("STATS", "", [this](const std::vector<std::string> &) {
+    PrintStats();
+  });
+  console.AddCommand("PROFILE", "start|stop [file]",
+                     [this](const std::vector<std::string> &args) {
+    ProfileCommand(args);
+  });
+  console.AddCommand("LOD", "off|auto|<level>",
+                     [this](const std::vector<std::string> &args) {
+    LodCommand(args);
+  });
+}
+
+void BaseApp::PrintStats() {
+  std::vector<std::pair<const char *, double>> counters;
+  // Render side, read where OpenGL runs
+  RunOnRenderThread([this, &counters] {
+    const UploadStats &uploads = UploadStats::Global();
+    counters.emplace_back("upload bytes", double(uploads.bytes));
+    counters.emplace_back("uploads", double(uploads.uploads));
+    counters.emplace_back("upload orphans", double(uploads.orphans));
+    counters.emplace_back("upload waits", double(uploads.waits));
+    if (grid_cache_) {
+      counters.emplace_back("grid index hits", double(grid_cache_->hits()));
+      counters.emplace_back("grid index misses",
+                            double(grid_cache_->misses()));
+    }
+    if (lod_ && !lod_->empty()) {
+      counters.emplace_back("lod patches", double(lod_->NumPatches()));
+      counters.emplace_back("lod visible patches",
+                            double(lod_->NumVisiblePatches()));
+      counters.emplace_back("lod triangles", double(lod_->NumTriangles()));
+    }
+  });
+  const EvaluationStats &evaluations = EvaluationStats::Global();
+  counters.emplace_back("surface points", double(evaluations.surface_points));
+  counters.emplace_back("surface normals",
+                        double(evaluations.surface_normals));
+  counters.emplace_back("curve points", double(evaluations.curve_points));
+  // NaN, shown as n/a, when allocations are not counted
+  const double kNotCounted = std::numeric_limits<double>::quiet_NaN();
+  const AllocationStats &allocations = AllocationStats::Global();
+  const bool counted = AllocationStats::Enabled();
+  const uint64_t allocated = allocations.allocations;
+  const uint64_t freed = allocations.frees;
+  counters.emplace_back("allocations",
+                        counted ? double(allocated) : kNotCounted);
+  counters.emplace_back("frees", counted ? double(freed) : kNotCounted);
+  counters.emplace_back("live allocations",
+                        counted ? double(allocated - freed) : kNotCounted);
+  counters.emplace_back("programs cached", double(program_stats_.cached));
+  counters.emplace_back("programs compiled", double(program_stats_.compiled));
+  counters.emplace_back("font glyphs", double(font_stats_.glyphs));
+
+  ConsoleTable table({ "counter", "total", "since last" });
+  for (const auto &counter : counters) {
+    if (std::isnan(counter.second)) {
+      table.AddRow({ counter.first, "n/a", "n/a" });
+      continue;
+    }
+    auto seen = stats_seen_.find(counter.first);
+    table.AddRow({ counter.first, ConsoleTable::Format("%.0f", counter.second),
+                   seen == stats_seen_.end()
+                       ? std::string("-")
+                       : ConsoleTable::Format("%+.0f",
+                                              counter.second - seen->second) });
+    stats_seen_[counter.first] = counter.second;
   }
-  {
-    Font &font = font_map[VkTutoFontFlag::Thin];
-    font.im_font = atlas->AddFontFromFileTTF(font.file.c_str(), font.size,
-                                             NULL,
-                                             atlas->GetGlyphRangesKorean());
-    IM_ASSERT(font.im_font != NULL);
+  table.Print(console);
+}
+
+void BaseApp::ProfileCommand(const std::vector<std::string> &args) {
+  const std::string action = args.empty() ? "" : Lowercase(args[0]);
+  if ((action != "start" && action != "stop") || args.size() > 2)
+    throw std::invalid_argument("expected start|stop [file]");
+  if (args.size() == 2) profile_file_ = args[1];
+  if (action == "start") {
+    profile_frames_.clear();
+    {
+      std::unique_lock<std::mutex> lock = profiler_->LockHistory();
+      profile_next_frame_ =
+          profiler_->empty() ? 0 : profiler_->Latest().frame + 1;
+    }
+    profiling_ = true;
+    console.AddLog("Profiling frames into %s until PROFILE stop",
+                   profile_file_.c_str());
+    return;
+  }
+  if (!profiling_) throw std::runtime_error("not profiling");
+  profiling_ = false;
+  // The last frames go without their GPU times
+  CollectProfile(true);
+  WriteFrameStatsCsv(profile_file_, profile_frames_);
+  console.AddLog("%zu frames written to %s", profile_frames_.size(),
+                 profile_file_.c_str());
+  ConsoleTable table({ "section", "cpu mean", "cpu p95", "cpu max",
+                       "gpu mean" });
+  for (size_t idx = 0; idx < kNumProfileSections; idx++) {
+    const ProfileSection section = static_cast<ProfileSection>(idx);
+    const ProfileSummary cpu = SummarizeFrames(profile_frames_, section);
+    if (cpu.samples == 0) continue;
+    const ProfileSummary gpu =
+        SummarizeFrames(profile_frames_, section, ProfileClock::kGpu);
+    table.AddRow({ ProfileSectionName(section),
+                   ConsoleTable::Format("%.2f ms", cpu.mean),
+                   ConsoleTable::Format("%.2f ms", cpu.p95),
+                   ConsoleTable::Format("%.2f ms", cpu.max),
+                   gpu.samples == 0
+                       ? std::string("-")
+                       : ConsoleTable::Format("%.2f ms", gpu.mean) });
   }
+  table.Print(console);
+}
 
-  io.Fonts->Build();
+void BaseApp::CollectProfile(bool all) {
+  std::unique_lock<std::mutex> lock = profiler_->LockHistory();
+  if (profiler_->empty()) return;
+  const unsigned long long latest = profiler_->Latest().frame;
+  for (size_t idx = 0; idx < profiler_->size(); idx++) {
+    const FrameStats &frame = profiler_->at(idx);
+    if (frame.frame < profile_next_frame_) continue;
+    if (!all && frame.frame + 2 > latest) break;
+    profile_frames_.push_back(frame);
+    profile_next_frame_ = frame.frame + 1;
+  }
+}
+
+void BaseApp::LodCommand(const std::vector<std::string> &args) {
+  const std::string mode = args.size() == 1 ? Lowercase(args[0]) : "";
+  if (mode == "off") {
+    if (lod_enabled_) SetGridLod(false);
+  }
+  else if (mode == "auto") {
+    SetLodLevel(-1);
+    if (!lod_enabled_) SetGridLod(true);
+  }
+  else {
+    char *end = nullptr;
+    const long level = std::strtol(mode.c_str(), &end, 10);
+    if (mode.empty() || *end != '\0' || level < 0 ||
+        level >= long(kLodMaxLevels))
+      throw std::invalid_argument(ConsoleTable::Format(
+          "expected off, auto or a level from 0 to %u", kLodMaxLevels - 1));
+    SetLodLevel(int(level));
+    if (!lod_enabled_) SetGridLod(true);
+  }
+  ConsoleTable table({ "setting", "value" });
+  table.AddRow({ "level of detail", lod_enabled_ ? "on" : "off" });
+  table.AddRow({ "level", lod_level_ < 0
+                              ? std::string("auto")
+                              : ConsoleTable::Format("%d", lod_level_) });
+  table.AddRow({ "tolerance",
+                 ConsoleTable::Format("%.2f px", lod_tolerance_) });
+  table.AddRow({ "frustum culling", cull_enabled_ ? "on" : "off" });
+  table.Print(console);
 }
 
 void BaseApp::MainLoop() {
+  if (VKTUTO_RENDER_THREAD) StartRenderThread(VKTUTO_FRAME_PACING);
   // Main loop
   while (!glfwWindowShouldClose(window_)) {
     // Poll and handle events (inputs, window resize, etc.)
@@ -260,55 +638,264 @@ void BaseApp::MainLoop() {
     //    data to your main application.
     // Generally you may always pass all inputs to dear imgui, and hide them
     //    from your application based on those two flags.
-    glfwPollEvents();
+    // Nothing moved for a few frames: sleep until input arrives, but wake
+    //    up now and then for the console and blinking cursors.
+    if (active_frames_ > 0 || VKTUTO_IDLE_WAIT_SECONDS <= 0)
+      glfwPollEvents();
+    else
+      glfwWaitEventsTimeout(VKTUTO_IDLE_WAIT_SECONDS);
+    if (had_events_) {
+      active_frames_ = VKTUTO_IDLE_FRAMES;
+      had_events_ = false;
+    }
+    // Glyphs for the text that came in since the last frame
+    RefreshFonts();
+    const Clock::time_point ui_start = Clock::now();
+    std::unique_ptr<Frame> frame = NewFrame();
 
     // Start the Dear ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
+    const Clock::time_point update_start = Clock::now();
+    work_deadline_ = AfterMilliseconds(update_start, work_budget_ms_);
     Update();
+    frame->ui_ms[static_cast<size_t>(ProfileSection::kUpdate)] =
+        MillisecondsSince(update_start);
 
     // 1. Show the big demo window (Most of the sample code is in
     //    ImGui::ShowDemoWindow()! You can browse its code to learn more about
     //    Dear ImGui!).
     if (show_demo_window_)
       ImGui::ShowDemoWindow(&show_demo_window_);
+    if (show_profiler_)
+      ShowProfilerOverlay(*profiler_, &show_profiler_);
 
-    // Rendering
+    // Rendering: ImGui's draw lists are copied into the frame, OpenGL runs
+    //    in DrawFrame()
+    const Clock::time_point imgui_start = Clock::now();
     ImGui::Render();
-    int display_w, display_h;
-    glfwMakeContextCurrent(window_);
-    glfwGetFramebufferSize(window_, &display_w, &display_h);
-    switch (draw_mode)
-    {
-    case vktuto::opengl3::BaseApp::GLDrawMode::Point:
-      glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
-      break;
-    case vktuto::opengl3::BaseApp::GLDrawMode::Line:
-      glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-      break;
-    case vktuto::opengl3::BaseApp::GLDrawMode::Fill: default:
-      glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-      break;
+    frame->imgui.Assign(*ImGui::GetDrawData());
+    frame->ui_ms[static_cast<size_t>(ProfileSection::kImGuiRender)] =
+        MillisecondsSince(imgui_start);
+    glfwGetFramebufferSize(window_, &frame->display_w, &frame->display_h);
+    frame->clear_color = clear_color_;
+    // The canvas texture is kept until one of its inputs changes. ImGui
+    //    shows it from the next frame on, so a redraw keeps frames coming.
+    const bool redraw_canvas = CanvasChanges() != 0;
+    frame->canvas = CurrentCanvasState();
+    frame->draw_canvas = redraw_canvas;
+    if (redraw_canvas) RememberCanvasState();
+    frame->ui_ms[static_cast<size_t>(ProfileSection::kUiFrame)] =
+        MillisecondsSince(ui_start);
+    SubmitFrame(std::move(frame));
+    if (profiling_) CollectProfile(false);
+
+    if (redraw_canvas || IsAnimating() || ImGui::IsAnyItemActive())
+      active_frames_ = VKTUTO_IDLE_FRAMES;
+    else if (active_frames_ > 0)
+      active_frames_--;
+
+    // Without a swap on this thread nothing else holds it to a frame rate
+    if (render_thread_ && render_thread_->pacing() == FramePacing::kLatest &&
+        VKTUTO_UI_FRAME_RATE > 0) {
+      std::this_thread::sleep_until(
+          ui_start + std::chrono::microseconds(1000000 / VKTUTO_UI_FRAME_RATE));
+    }
+  }
+  StopRenderThread();
+}
+
+void BaseApp::HeadlessLoop() {
+  // Same frame as MainLoop() minus events, ImGui and presenting
+  if (headless_options_.render_thread)
+    StartRenderThread(headless_options_.pacing);
+  while (!quit_) {
+    const Clock::time_point ui_start = Clock::now();
+    std::unique_ptr<Frame> frame = NewFrame();
+    work_deadline_ = AfterMilliseconds(ui_start, work_budget_ms_);
+    Update();
+    if (quit_) break;
+    frame->ui_ms[static_cast<size_t>(ProfileSection::kUpdate)] =
+        MillisecondsSince(ui_start);
+    frame->canvas = CurrentCanvasState();
+    frame->draw_canvas = true;
+    frame->ui_ms[static_cast<size_t>(ProfileSection::kUiFrame)] =
+        MillisecondsSince(ui_start);
+    SubmitFrame(std::move(frame));
+  }
+  StopRenderThread();
+}
+
+void BaseApp::ApplyDrawMode(GLDrawMode mode) const {
+  switch (mode)
+  {
+  case vktuto::opengl3::BaseApp::GLDrawMode::Point:
+    glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
+    break;
+  case vktuto::opengl3::BaseApp::GLDrawMode::Line:
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    break;
+  case vktuto::opengl3::BaseApp::GLDrawMode::Fill: default:
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    break;
+  }
+}
+
+void BaseApp::MakeContextCurrent() {
+  if (window_ != nullptr) glfwMakeContextCurrent(window_);
+  else headless_->MakeCurrent();
+}
+
+void BaseApp::ReleaseContext() {
+  if (window_ != nullptr) glfwMakeContextCurrent(nullptr);
+  else headless_->ReleaseCurrent();
+}
+
+void BaseApp::StartRenderThread(FramePacing pacing) {
+  // The context is current on one thread at a time
+  ReleaseContext();
+  render_thread_ = std::make_unique<RenderThread>(
+      [this] { MakeContextCurrent(); },
+      [this](const FramePacket &packet) { RunPacket(packet); },
+      [this] { ReleaseContext(); },
+      pacing, VKTUTO_QUEUED_FRAMES);
+}
+
+void BaseApp::StopRenderThread() {
+  if (!render_thread_) return;
+  std::exception_ptr error;
+  try {
+    render_thread_->Stop();
+  }
+  catch (...) {
+    error = std::current_exception();
+  }
+  render_thread_.reset();
+  MakeContextCurrent();
+  if (error) std::rethrow_exception(error);
+}
+
+void BaseApp::Record(std::function<void()> run, uint32_t key, bool full) {
+  commands_.push_back(RenderCommand{ std::move(run), key, full });
+}
+
+void BaseApp::RunOnRenderThread(const std::function<void()> &run) {
+  Record(run);
+  std::unique_ptr<FramePacket> packet = std::make_unique<FramePacket>();
+  packet->commands.swap(commands_);
+  if (render_thread_) {
+    render_thread_->Submit(std::move(packet));
+    render_thread_->Finish();
+  }
+  else {
+    RunPacket(*packet);
+  }
+}
+
+std::unique_ptr<BaseApp::Frame> BaseApp::NewFrame() {
+  // Packets the render thread is done with come back here, to be reused or
+  // freed on this thread
+  if (render_thread_) {
+    while (std::unique_ptr<FramePacket> packet = render_thread_->Recycle()) {
+      if (packet->has_frame && !spare_frame_)
+        spare_frame_.reset(static_cast<Frame *>(packet.release()));
     }
-    glViewport(0, 0, display_w, display_h);
-    glClearColor(
-      clear_color_.x,
-      clear_color_.y,
-      clear_color_.z,
-      clear_color_.w);
-    glClear(GL_COLOR_BUFFER_BIT);
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-    CustomGLDraw();
+  }
+  std::unique_ptr<Frame> frame = std::move(spare_frame_);
+  if (!frame) frame = std::make_unique<Frame>();
+  frame->commands.clear();
+  frame->draw_canvas = false;
+  std::fill(std::begin(frame->ui_ms), std::end(frame->ui_ms), 0.0);
+  return frame;
+}
+
+void BaseApp::SubmitFrame(std::unique_ptr<Frame> frame) {
+  frame->commands.swap(commands_);
+  if (render_thread_) {
+    render_thread_->Submit(std::move(frame));
+    return;
+  }
+  RunPacket(*frame);
+  spare_frame_ = std::move(frame);
+}
+
+void BaseApp::RunPacket(const FramePacket &packet) {
+  // Uploads count in the frame they are drawn with
+  if (packet.has_frame) profiler_->BeginFrame();
+  for (const RenderCommand &command : packet.commands) command.run();
+  if (!packet.has_frame) return;
+
+  const Frame &frame = static_cast<const Frame &>(packet);
+  DrawFrame(frame);
+  for (size_t idx = 0; idx < kNumProfileSections; idx++) {
+    if (frame.ui_ms[idx] > 0.0)
+      profiler_->AddCpuTime(static_cast<ProfileSection>(idx), frame.ui_ms[idx]);
+  }
+  profiler_->EndFrame();
+}
+
+void BaseApp::DrawFrame(const Frame &frame) {
+  ApplyDrawMode(frame.canvas.draw_mode);
+  if (window_ == nullptr) {
+    ScopedTimer timer(*profiler_, ProfileSection::kCanvasDraw);
+    CustomGLDraw(frame.canvas);
+    return;
+  }
 
-    glfwMakeContextCurrent(window_);
-    glfwSwapBuffers(window_);
+  glViewport(0, 0, frame.display_w, frame.display_h);
+  glClearColor(
+    frame.clear_color.x,
+    frame.clear_color.y,
+    frame.clear_color.z,
+    frame.clear_color.w);
+  glClear(GL_COLOR_BUFFER_BIT);
+  {
+    ScopedTimer timer(*profiler_, ProfileSection::kImGuiRender);
+    ImGui_ImplOpenGL3_RenderDrawData(frame.imgui.get());
+  }
+  if (frame.draw_canvas) {
+    ScopedTimer timer(*profiler_, ProfileSection::kCanvasDraw);
+    CustomGLDraw(frame.canvas);
   }
+  glfwSwapBuffers(window_);
+}
+
+unsigned int BaseApp::CanvasChanges() const noexcept {
+  unsigned int changes = canvas_forced_ ? kCanvasForced : 0;
+  if (cam_x_ != canvas_drawn_.cam_x || cam_y_ != canvas_drawn_.cam_y ||
+      cam_width_ != canvas_drawn_.cam_width ||
+      cam_height_ != canvas_drawn_.cam_height ||
+      rotate_x_ != canvas_drawn_.rotate_x || rotate_y_ != canvas_drawn_.rotate_y)
+    changes |= kCanvasCamera;
+  if (geometry_version_ != canvas_drawn_.geometry_version)
+    changes |= kCanvasGeometry;
+  if (draw_mode != canvas_drawn_.draw_mode) changes |= kCanvasDrawMode;
+  if (texture_x_ != canvas_drawn_.width || texture_y_ != canvas_drawn_.height)
+    changes |= kCanvasSize;
+  return changes;
+}
 
+BaseApp::CanvasState BaseApp::CurrentCanvasState() const noexcept {
+  return { cam_x_, cam_y_, cam_width_, cam_height_, rotate_x_, rotate_y_,
+           texture_x_, texture_y_, draw_mode, geometry_version_,
+           mesh_color_, lod_tolerance_, lod_level_ };
 }
 
-void BaseApp::InitCustomGL() {
+void BaseApp::RememberCanvasState() noexcept {
+  canvas_drawn_ = CurrentCanvasState();
+  canvas_forced_ = false;
+}
+
+void BaseApp::Quit() {
+  quit_ = true;
+  if (window_ != nullptr) glfwSetWindowShouldClose(window_, GLFW_TRUE);
+}
+
+void BaseApp::InitCustomGL(int width, int height) {
+  profiler_ = std::make_unique<FrameProfiler>();
+
   glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
   glEnable(GL_DEPTH_TEST);
   glDepthFunc(GL_LEQUAL);
@@ -316,179 +903,593 @@ void BaseApp::InitCustomGL() {
   ////////////////////////////////////////////////////////////////////
   // Create program for drawing cube, create VBOs and copy the data //
   ////////////////////////////////////////////////////////////////////
-  program_ = LoadShaders("vertex_shader.vs", "fragment_shader.fs");
+  // The canvas and glyph programs are linked together, from cached
+  // binaries when the shaders and the driver are unchanged
+  ProgramCache program_cache(headless_options_.program_cache);
+  if (headless_options_.clear_program_cache) program_cache.Clear();
+  const std::vector<GLuint> programs = program_cache.Load({
+      { "vertex_shader.vs", "fragment_shader.fs" },
+      { "glyph_shader.vs", "fragment_shader.fs" } });
+  program_stats_ = program_cache.stats();
+  console.AddLog("Shader programs: %zu from cache, %zu compiled in %.1f ms",
+                 program_stats_.cached, program_stats_.compiled,
+                 program_stats_.total_ms);
+  program_ = programs[0];
+  uniform_.mvp = glGetUniformLocation(program_, "MVP");
+  uniform_.model = glGetUniformLocation(program_, "Model");
+  uniform_.position_offset = glGetUniformLocation(program_, "positionOffset");
+  uniform_.position_scale = glGetUniformLocation(program_, "positionScale");
+  uniform_.object_color = glGetUniformLocation(program_, "objectColor");
+  uniform_.use_vertex_color = glGetUniformLocation(program_, "useVertexColor");
+  uniform_.has_normals = glGetUniformLocation(program_, "hasNormals");
+  uniform_.skirt_first_vertex = glGetUniformLocation(program_, "skirtFirstVertex");
+  uniform_.skirt_depth = glGetUniformLocation(program_, "skirtDepth");
 
   /////////////////////////
   // Create and bind VBO //
   /////////////////////////
   glGenVertexArrays(1, &vao_);
-  glGenBuffers(1, &vbo_position_);
-  glGenBuffers(1, &vbo_color_);
-  glGenBuffers(1, &ibo_);
+  glBindVertexArray(vao_);
+  vbo_vertex_ = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, 0);
+  vbo_color_ = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, 0);
+  ibo_ = std::make_unique<StreamBuffer>(GL_ELEMENT_ARRAY_BUFFER, 0);
+  grid_cache_ = std::make_unique<GridIndexCache>();
+  lod_ = std::make_unique<GridLod>();
 
   BindBuffers();
 
-  glGenVertexArrays(1, &vao2_);
-  glGenBuffers(1, &vbo_position2_);
-  glGenBuffers(1, &vbo_color2_);
-  glGenBuffers(1, &ibo2_);
-
+  arena_ = std::make_unique<MeshArena>();
   BindBuffers2();
 
+  glyphs_ = std::make_unique<GlyphRenderer>(programs[1]);
+
   ////////////////////////////////////////////////////////////////////////
   // Create and bind framebuffer, attach a depth buffer to it           //
   // Create the texture to render to, and attach it to the framebuffer  //
   ////////////////////////////////////////////////////////////////////////
-  ImGuiIO &io = ImGui::GetIO();
+  texture_x_ = width;
+  texture_y_ = height;
 
   glGenFramebuffers(1, &fbo_);
   glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
 
   glGenRenderbuffers(1, &rbo_depth_);
   glBindRenderbuffer(GL_RENDERBUFFER, rbo_depth_);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, io.DisplaySize.x, io.DisplaySize.y);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
   glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo_depth_);
 
   glGenTextures(1, &texture_);
   glBindTexture(GL_TEXTURE_2D, texture_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, io.DisplaySize.x, io.DisplaySize.y, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
   glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture_, 0);
   GLenum draw_options[1] = { GL_COLOR_ATTACHMENT0 };
   glDrawBuffers(1, draw_options);
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+  // Checked while bound: headless contexts have no default framebuffer
   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
     std::cerr << "Error in setting up the framebuffer" << std::endl;
   }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void BaseApp::BindBuffers() const {
-  glBindVertexArray(vao_);
+void BaseApp::ResizeCanvas(int width, int height) {
+  texture_x_ = width;
+  texture_y_ = height;
+  cam_width_ = cam_height_ * width / float(height);
+
+  Record([this, width, height] {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
+                 GL_UNSIGNED_BYTE, NULL);
+    glBindRenderbuffer(GL_RENDERBUFFER, rbo_depth_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  }, kCanvasSizeCommand, true);
+}
+
+void BaseApp::ReadCanvas(std::vector<uint8_t> &rgb) {
+  rgb.resize(size_t(3) * texture_x_ * texture_y_);
+  RunOnRenderThread([this, &rgb] {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, texture_x_, texture_y_, GL_RGB, GL_UNSIGNED_BYTE,
+                 rgb.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  });
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_position_);
-  glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(glm::vec3), vertices_.data(), GL_STATIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_color_);
-  glBufferData(GL_ARRAY_BUFFER, colors_.size() * sizeof(glm::vec3), colors_.data(), GL_STATIC_DRAW);
+void BaseApp::BindBuffers() {
+  // The render thread gets a copy; the UI goes on editing its own
+  geometry_version_++;
+  auto surface = std::make_shared<SurfaceData>();
+  surface->vertices = vertices_;
+  surface->normals = normals_;
+  surface->colors = colors_;
+  surface->indices = indices_;
+  surface->format = vertex_format_;
+  surface->grid_u = grid_u_;
+  surface->grid_v = grid_v_;
+  surface->topology = grid_topology_;
+  surface->lod = lod_enabled_;
+  surface->cull = cull_enabled_;
+  bound_vertices_ = vertices_.size();
+  // Runs once, so it takes the copy over
+  Record([this, surface] {
+    drawn_ = std::move(*surface);
+    UploadSurface();
+  }, kSurfaceCommand, true);
+}
+
+void BaseApp::UploadSurface() {
+  // Stream uploads land at a new offset (or in a new buffer) every time, so
+  // the attribute pointers are re-specified right after
+  ScopedCpuTimer timer(*profiler_, ProfileSection::kUpload);
+  grid_ = grid_cache_->Get(drawn_.grid_u, drawn_.grid_v, drawn_.topology);
+  row_band_.reset();
+  glBindVertexArray(vao_);
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(GLuint), indices_.data(), GL_STATIC_DRAW);
+  const std::vector<glm::vec3> &vertices = drawn_.vertices;
+  const std::vector<glm::vec3> &colors = drawn_.colors;
+  bool has_normals = !drawn_.normals.empty() &&
+                     drawn_.normals.size() == vertices.size();
+  PackVertices(vertices.data(), has_normals ? drawn_.normals.data() : nullptr,
+               vertices.size(), drawn_.format, packed_);
+  PrepareGridLod();
+  if (!lod_->empty()) {
+    packed_.bytes.resize(
+        (packed_.count + lod_->SkirtSources().size()) * packed_.stride);
+    CopySkirtVertices(0, lod_->SkirtSources().size());
+  }
+  vbo_vertex_->Upload(packed_.bytes.data(), packed_.bytes.size());
+  bool vertex_colors = colors.size() == vertices.size() && !colors.empty();
+  if (vertex_colors)
+    vbo_color_->Upload(colors.data(), colors.size() * sizeof(glm::vec3));
+  SetVertexAttributes(packed_, *vbo_vertex_,
+                      vertex_colors ? vbo_color_.get() : nullptr);
+
+  ibo_->Upload(drawn_.indices.data(), drawn_.indices.size() * sizeof(GLuint));
   glBindVertexArray(0);
 }
 
-void BaseApp::BindBuffers2() const {
-  glBindVertexArray(vao2_);
+void BaseApp::BindBuffers2() {
+  // Curves are one line mesh of the arena, replaced as a whole
+  geometry_version_++;
+  auto vertices = std::make_shared<std::vector<glm::vec3>>(vertices2_);
+  auto colors = std::make_shared<std::vector<glm::vec3>>(colors2_);
+  auto indices = std::make_shared<std::vector<GLuint>>(indices2_);
+  Record([this, vertices, colors, indices] {
+    ScopedCpuTimer timer(*profiler_, ProfileSection::kUpload);
+    arena_->Remove(curve_mesh_);
+    ArenaMesh mesh;
+    mesh.mode = GL_LINES;
+    mesh.positions = vertices->data();
+    mesh.num_vertices = vertices->size();
+    if (colors->size() == vertices->size()) mesh.colors = colors->data();
+    mesh.indices = indices->data();
+    mesh.num_indices = indices->size();
+    curve_mesh_ = arena_->Add(mesh);
+  }, kCurveCommand, true);
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_position2_);
-  glBufferData(GL_ARRAY_BUFFER, vertices2_.size() * sizeof(glm::vec3), vertices2_.data(), GL_STATIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_color2_);
-  glBufferData(GL_ARRAY_BUFFER, colors2_.size() * sizeof(glm::vec3), colors2_.data(), GL_STATIC_DRAW);
+MeshHandle BaseApp::AddMesh(const ArenaMesh &mesh) {
+  // The arena copies from 'mesh' on the render thread, so from a copy
+  struct Copy {
+    ArenaMesh view;
+    std::vector<glm::vec3> positions, normals, colors;
+    std::vector<GLuint> indices;
+  };
+  auto copy = std::make_shared<Copy>();
+  copy->view = mesh;
+  copy->positions.assign(mesh.positions, mesh.positions + mesh.num_vertices);
+  if (mesh.normals != nullptr)
+    copy->normals.assign(mesh.normals, mesh.normals + mesh.num_vertices);
+  if (mesh.colors != nullptr)
+    copy->colors.assign(mesh.colors, mesh.colors + mesh.num_vertices);
+  copy->indices.assign(mesh.indices, mesh.indices + mesh.num_indices);
+  // Triangles of arbitrary meshes come in whatever order their source had;
+  // Tipsify reorders them for the post-transform cache
+  if (mesh.mode == GL_TRIANGLES && !copy->indices.empty() &&
+      *std::max_element(copy->indices.begin(), copy->indices.end()) <
+          mesh.num_vertices) {
+    const VertexCacheStats before = SimulateVertexCache(
+        copy->indices.data(), copy->indices.size(), mesh.num_vertices);
+    OptimizeVertexCache(copy->indices.data(), copy->indices.size(),
+                        mesh.num_vertices);
+    const VertexCacheStats after = SimulateVertexCache(
+        copy->indices.data(), copy->indices.size(), mesh.num_vertices);
+    console.AddLog("Mesh of %zu triangles (tipsify): ACMR %.3f -> %.3f, "
+                   "ATVR %.3f -> %.3f", after.num_triangles, before.acmr,
+                   after.acmr, before.atvr, after.atvr);
+  }
+  copy->view.positions = copy->positions.data();
+  copy->view.normals = mesh.normals != nullptr ? copy->normals.data() : nullptr;
+  copy->view.colors = mesh.colors != nullptr ? copy->colors.data() : nullptr;
+  copy->view.indices = copy->indices.data();
+
+  const MeshHandle handle = next_mesh_++;
+  num_meshes_++;
+  geometry_version_++;
+  Record([this, copy, handle] {
+    ScopedCpuTimer timer(*profiler_, ProfileSection::kUpload);
+    arena_meshes_[handle] = arena_->Add(copy->view);
+  });
+  return handle;
+}
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo2_);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices2_.size() * sizeof(GLuint), indices2_.data(), GL_STATIC_DRAW);
-  glBindVertexArray(0);
+MeshHandle BaseApp::AddGridMesh(unsigned int num_u, unsigned int num_v,
+                                const glm::vec3 *positions,
+                                const glm::vec3 *normals,
+                                const glm::vec4 &color) {
+  const size_t count = size_t(num_u) * num_v;
+  auto grid_positions = std::make_shared<std::vector<glm::vec3>>(
+      positions, positions + count);
+  auto grid_normals = std::make_shared<std::vector<glm::vec3>>();
+  if (normals != nullptr) grid_normals->assign(normals, normals + count);
+
+  const MeshHandle handle = next_mesh_++;
+  num_meshes_++;
+  geometry_version_++;
+  Record([this, handle, num_u, num_v, grid_positions, grid_normals, color] {
+    ScopedCpuTimer timer(*profiler_, ProfileSection::kUpload);
+    arena_meshes_[handle] = arena_->AddGrid(
+        num_u, num_v, grid_positions->data(),
+        grid_normals->empty() ? nullptr : grid_normals->data(), color);
+  });
+  return handle;
+}
+
+void BaseApp::RemoveMesh(MeshHandle mesh) {
+  if (mesh == kInvalidMesh || mesh >= next_mesh_) return;
+  num_meshes_--;
+  geometry_version_++;
+  Record([this, mesh] {
+    auto found = arena_meshes_.find(mesh);
+    if (found == arena_meshes_.end()) return;
+    arena_->Remove(found->second);
+    arena_meshes_.erase(found);
+  });
+}
+
+void BaseApp::BindGlyphs() {
+  geometry_version_++;
+  auto instances = std::make_shared<
+      std::vector<std::vector<GlyphInstance>>>(std::begin(glyph_instances_),
+                                                std::end(glyph_instances_));
+  Record([this, instances] {
+    ScopedCpuTimer timer(*profiler_, ProfileSection::kUpload);
+    for (size_t idx = 0; idx < kNumGlyphShapes; idx++) {
+      glyphs_->Instances(static_cast<GlyphShape>(idx))
+          .swap((*instances)[idx]);
+    }
+    glyphs_->Upload();
+  }, kGlyphCommand, true);
 }
 
-std::string BaseApp::ReadShaderFile(const char *file_name) {
-  /////////////////////////////////////////////////////////////
-  // Read content of "filename" and return it as a c-string. //
-  /////////////////////////////////////////////////////////////
-  std::string str;
-  std::cout << "Reading " << file_name << std::endl;
-  std::ifstream in(file_name, std::ios::ate);
-  if (in.is_open()) {
-    in.seekg(0, in.end);
-    long fsize = in.tellg();
-    in.seekg(0, in.beg);
-    std::cout << "Filesize = " << fsize << std::endl;
-    str.resize(fsize + 1);
-    in.read(str.data(), fsize);
-    str.data()[fsize] = '\0';
-    in.close();
+void BaseApp::UpdateVertices(size_t first, size_t count) {
+  if (vertices_.size() != bound_vertices_ || first + count > vertices_.size()) {
+    BindBuffers();
+    return;
   }
-  else std::cout << "Unable to open file" << std::endl;
+  geometry_version_++;
+  auto vertices = std::make_shared<std::vector<glm::vec3>>(
+      vertices_.begin() + first, vertices_.begin() + first + count);
+  auto normals = std::make_shared<std::vector<glm::vec3>>();
+  if (normals_.size() == vertices_.size()) {
+    normals->assign(normals_.begin() + first,
+                    normals_.begin() + first + count);
+  }
+  Record([this, first, vertices, normals] {
+    UploadVertexRange(first, *vertices, *normals);
+  }, kSurfaceCommand);
+}
 
-  return str;
+void BaseApp::UploadVertexRange(size_t first,
+                                const std::vector<glm::vec3> &vertices,
+                                const std::vector<glm::vec3> &normals) {
+  ScopedCpuTimer timer(*profiler_, ProfileSection::kUpload);
+  const size_t count = vertices.size();
+  std::copy(vertices.begin(), vertices.end(), drawn_.vertices.begin() + first);
+  const bool has_normals = packed_.has_normals && normals.size() == count &&
+                           drawn_.normals.size() == drawn_.vertices.size();
+  if (has_normals)
+    std::copy(normals.begin(), normals.end(), drawn_.normals.begin() + first);
+  if (drawn_.vertices.size() != packed_.count ||
+      !PackVertexRange(drawn_.vertices.data(),
+                       has_normals ? drawn_.normals.data() : nullptr,
+                       first, count, packed_)) {
+    UploadSurface();
+    return;
+  }
+  vbo_vertex_->UpdateRange(first * packed_.stride,
+                           packed_.bytes.data() + first * packed_.stride,
+                           count * packed_.stride);
+  if (lod_->empty()) return;
+
+  // Skirt copies of the edited vertices, and the errors around them
+  lod_->UpdateErrors(drawn_.vertices.data(), first, count);
+  const std::vector<GLuint> &sources = lod_->SkirtSources();
+  const size_t begin = std::lower_bound(sources.begin(), sources.end(),
+                                        first) - sources.begin();
+  const size_t end = std::lower_bound(sources.begin(), sources.end(),
+                                      first + count) - sources.begin();
+  if (begin == end) return;
+  CopySkirtVertices(begin, end);
+  const size_t offset = (packed_.count + begin) * packed_.stride;
+  vbo_vertex_->UpdateRange(offset, packed_.bytes.data() + offset,
+                           (end - begin) * packed_.stride);
 }
 
-void BaseApp::CompileShader(const char *file_path, GLuint shader_ID) {
-  GLint Result = GL_FALSE;
-  int InfoLogLength;
+void BaseApp::BeginGridRows(unsigned int num_u, unsigned int num_v,
+                            const glm::vec3 &lower, const glm::vec3 &upper,
+                            bool normals) {
+  geometry_version_++;
+  grid_u_ = std::max(2u, num_u);
+  grid_v_ = std::max(2u, num_v);
+  const size_t count = size_t(grid_u_) * grid_v_;
+  vertices_.clear();
+  vertices_.reserve(count);
+  normals_.clear();
+  if (normals) normals_.reserve(count);
+  colors_.clear();
+  indices_.clear();
+  bound_vertices_ = count;
+
+  auto surface = std::make_shared<SurfaceData>();
+  surface->format = vertex_format_;
+  surface->grid_u = grid_u_;
+  surface->grid_v = grid_v_;
+  surface->topology = grid_topology_;
+  surface->lod = lod_enabled_;
+  surface->cull = cull_enabled_;
+  Record([this, surface, lower, upper, normals] {
+    drawn_ = std::move(*surface);
+    ReserveGridRows(lower, upper, normals);
+  }, kSurfaceCommand, true);
+}
 
-  std::string shaderString = ReadShaderFile(file_path);
-  const GLchar *ShaderCode = shaderString.c_str();
+void BaseApp::AppendGridRows(const glm::vec3 *positions,
+                             const glm::vec3 *normals,
+                             unsigned int num_rows) {
+  const size_t count = std::min(size_t(num_rows) * grid_v_,
+                                bound_vertices_ - vertices_.size());
+  if (count == 0) return;
+  geometry_version_++;
+  auto vertices = std::make_shared<std::vector<glm::vec3>>(
+      positions, positions + count);
+  vertices_.insert(vertices_.end(), vertices->begin(), vertices->end());
+  auto row_normals = std::make_shared<std::vector<glm::vec3>>();
+  if (normals != nullptr) {
+    row_normals->assign(normals, normals + count);
+    normals_.insert(normals_.end(), row_normals->begin(), row_normals->end());
+  }
+  Record([this, vertices, row_normals] {
+    UploadGridRows(*vertices, *row_normals);
+  }, kSurfaceCommand);
+}
 
-  // Compile Shader
-  printf("Compiling shader : %s\n", file_path);
-  glShaderSource(shader_ID, 1, &ShaderCode, NULL);
-  glCompileShader(shader_ID);
+void BaseApp::ReserveGridRows(const glm::vec3 &lower, const glm::vec3 &upper,
+                              bool normals) {
+  ScopedCpuTimer timer(*profiler_, ProfileSection::kUpload);
+  const size_t count = size_t(drawn_.grid_u) * drawn_.grid_v;
+  drawn_.vertices.reserve(count);
+  if (normals) drawn_.normals.reserve(count);
+  // Nothing to draw from the previous surface
+  grid_.reset();
+  if (!lod_->empty()) lod_->Build(0, 0, nullptr);
+  PackGridBox(lower, upper, normals);
+
+  // The rows land in place as they come
+  glBindVertexArray(vao_);
+  vbo_vertex_->Reserve(packed_.bytes.size());
+  SetVertexAttributes(packed_, *vbo_vertex_, nullptr);
+  glBindVertexArray(0);
+  row_band_ = grid_cache_->Get(std::min(kRowBand + 1, drawn_.grid_u),
+                               drawn_.grid_v, GridTopology::kTriangles);
+}
 
-  // Check Shader
-  glGetShaderiv(shader_ID, GL_COMPILE_STATUS, &Result);
-  glGetShaderiv(shader_ID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+void BaseApp::UploadGridRows(const std::vector<glm::vec3> &vertices,
+                             const std::vector<glm::vec3> &normals) {
+  if (!row_band_) return;
+  const size_t first = drawn_.vertices.size();
+  const size_t count = vertices.size();
+  drawn_.vertices.insert(drawn_.vertices.end(), vertices.begin(),
+                         vertices.end());
+  if (packed_.has_normals) {
+    drawn_.normals.insert(drawn_.normals.end(), normals.begin(),
+                          normals.end());
+    drawn_.normals.resize(drawn_.vertices.size(), glm::vec3(0.0f, 0.0f, 1.0f));
+  }
+  if (drawn_.vertices.size() >= packed_.count) {
+    // Complete: packed again with its own bounding box, with the grid
+    // indices and level of detail of BindBuffers()
+    UploadSurface();
+    return;
+  }
 
-  if (Result == GL_FALSE) {
-    char ShaderErrorMessage[9999];
-    glGetShaderInfoLog(shader_ID, InfoLogLength, NULL, ShaderErrorMessage);
-    printf("%s", ShaderErrorMessage);
+  ScopedCpuTimer timer(*profiler_, ProfileSection::kUpload);
+  const glm::vec3 *row_normals =
+      packed_.has_normals ? drawn_.normals.data() : nullptr;
+  if (PackVertexRange(drawn_.vertices.data(), row_normals, first, count,
+                      packed_)) {
+    vbo_vertex_->UpdateRange(first * packed_.stride,
+                             packed_.bytes.data() + first * packed_.stride,
+                             count * packed_.stride);
+    return;
+  }
+  // Out of the box: a bigger one, and the rows so far packed again
+  glm::vec3 lower = packed_.position_offset;
+  glm::vec3 upper = lower + packed_.position_scale;
+  for (const glm::vec3 &pos : vertices) {
+    lower = glm::min(lower, pos);
+    upper = glm::max(upper, pos);
   }
+  PackGridBox(lower, upper, packed_.has_normals);
+  PackVertexRange(drawn_.vertices.data(), row_normals, 0,
+                  drawn_.vertices.size(), packed_);
+  vbo_vertex_->UpdateRange(0, packed_.bytes.data(),
+                           drawn_.vertices.size() * packed_.stride);
 }
 
-GLuint BaseApp::LoadShaders(const char *vertex_file_path, const char *fragment_file_path) {
-  printf("Creating shaders\n");
-  GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-  GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+void BaseApp::PackGridBox(const glm::vec3 &lower, const glm::vec3 &upper,
+                          bool normals) {
+  // Packing the two corners sets the layout and the box; samples on the
+  // boundary then stay inside despite rounding
+  const glm::vec3 extent = upper - lower;
+  const float size = std::max(std::max(extent.x, extent.y), extent.z);
+  const float margin = 1e-3f * std::max(size, 1e-3f);
+  const glm::vec3 corners[2] = { lower - margin, upper + margin };
+  const glm::vec3 up[2] = { glm::vec3(0.0f, 0.0f, 1.0f),
+                            glm::vec3(0.0f, 0.0f, 1.0f) };
+  PackVertices(corners, normals ? up : nullptr, 2, drawn_.format, packed_);
+  packed_.count = size_t(drawn_.grid_u) * drawn_.grid_v;
+  packed_.bytes.resize(packed_.count * packed_.stride);
+}
+
+void BaseApp::SetGridIndices(unsigned int num_u, unsigned int num_v,
+                             GridTopology topology) {
+  grid_u_ = num_u;
+  grid_v_ = num_v;
+  grid_topology_ = topology;
+  geometry_version_++;
+  Record([this, num_u, num_v, topology] {
+    SetGrid(num_u, num_v, topology);
+  }, kSurfaceCommand);
+}
 
-  CompileShader(vertex_file_path, VertexShaderID);
-  CompileShader(fragment_file_path, FragmentShaderID);
+void BaseApp::SetGrid(unsigned int num_u, unsigned int num_v,
+                      GridTopology topology) {
+  drawn_.grid_u = num_u;
+  drawn_.grid_v = num_v;
+  drawn_.topology = topology;
+  grid_ = grid_cache_->Get(num_u, num_v, topology);
+}
 
+void BaseApp::SetGridLod(bool enabled) {
+  lod_enabled_ = enabled;
+  // Adds or drops the skirt vertices
+  BindBuffers();
+}
 
-  printf("Create and linking program\n");
-  GLuint program = glCreateProgram();
-  glAttachShader(program, VertexShaderID);
-  glAttachShader(program, FragmentShaderID);
-  glLinkProgram(program);
+void BaseApp::SetFrustumCulling(bool enabled) {
+  cull_enabled_ = enabled;
+  BindBuffers();
+}
+
+void BaseApp::PrepareGridLod() {
+  // The index pyramid depends on the grid size only, the errors on the
+  // positions
+  const std::vector<glm::vec3> &vertices = drawn_.vertices;
+  const bool use_lod = (drawn_.lod || drawn_.cull) && grid_ &&
+                       size_t(grid_->num_u) * grid_->num_v == vertices.size();
+  if (!use_lod) {
+    if (!lod_->empty()) lod_->Build(0, 0, nullptr);
+    return;
+  }
+  if (lod_->num_u() != grid_->num_u || lod_->num_v() != grid_->num_v)
+    lod_->Build(grid_->num_u, grid_->num_v, vertices.data());
+  else
+    lod_->UpdateErrors(vertices.data(), 0, vertices.size());
+}
 
-  // Check the program
-  GLint Result = GL_FALSE;
-  int InfoLogLength;
+bool BaseApp::GridLodActive() const noexcept {
+  return (drawn_.lod || drawn_.cull) && grid_ && !lod_->empty() &&
+         lod_->num_u() == grid_->num_u && lod_->num_v() == grid_->num_v &&
+         packed_.count == size_t(grid_->num_u) * grid_->num_v;
+}
 
-  glGetProgramiv(program, GL_LINK_STATUS, &Result);
-  glGetProgramiv(program, GL_INFO_LOG_LENGTH, &InfoLogLength);
+void BaseApp::CopySkirtVertices(size_t begin, size_t end) {
+  const std::vector<GLuint> &sources = lod_->SkirtSources();
+  const size_t stride = packed_.stride;
+  uint8_t *skirts = packed_.bytes.data() + packed_.count * stride;
+  for (size_t idx = begin; idx < end; idx++) {
+    std::copy_n(packed_.bytes.data() + sources[idx] * stride, stride,
+                skirts + idx * stride);
+  }
+}
 
-  if (InfoLogLength > 0) {
-    GLchar ProgramErrorMessage[9999];
-    glGetProgramInfoLog(program, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-    printf("%s\n", &ProgramErrorMessage[0]); fflush(stdout);
+void BaseApp::SetVertexAttributes(const PackedVertices &packed,
+                                  const StreamBuffer &vbo_vertex,
+                                  const StreamBuffer *vbo_color) const {
+  // Expects the target VAO to be bound
+  const bool quantized = packed.format == VertexFormat::kQuantized;
+  const GLsizei stride = static_cast<GLsizei>(packed.stride);
+  const size_t base = vbo_vertex.offset();
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_vertex.id());
+  glVertexAttribPointer(0, 3, quantized ? GL_UNSIGNED_SHORT : GL_FLOAT,
+                        quantized ? GL_TRUE : GL_FALSE, stride,
+                        reinterpret_cast<const void *>(base));
+  glEnableVertexAttribArray(0);
+  if (packed.has_normals) {
+    glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, stride,
+                          reinterpret_cast<const void *>(base + packed.normal_offset));
+    glEnableVertexAttribArray(2);
+  }
+  else {
+    glDisableVertexAttribArray(2);
+  }
+  if (vbo_color != nullptr) {
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_color->id());
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0,
+                          reinterpret_cast<const void *>(vbo_color->offset()));
+    glEnableVertexAttribArray(1);
   }
+  else {
+    glDisableVertexAttribArray(1);
+  }
+}
 
-  glDeleteShader(VertexShaderID);
-  glDeleteShader(FragmentShaderID);
+void BaseApp::SetMeshUniforms(const PackedVertices &packed,
+                              const glm::vec4 &color,
+                              bool use_vertex_color) const {
+  glUniform3fv(uniform_.position_offset, 1,
+               glm::value_ptr(packed.position_offset));
+  glUniform3fv(uniform_.position_scale, 1,
+               glm::value_ptr(packed.position_scale));
+  glUniform4fv(uniform_.object_color, 1, glm::value_ptr(color));
+  glUniform1i(uniform_.use_vertex_color, use_vertex_color);
+  glUniform1i(uniform_.has_normals, packed.has_normals);
+  glUniform1i(uniform_.skirt_first_vertex, std::numeric_limits<GLint>::max());
+  glUniform1f(uniform_.skirt_depth, 0.0f);
+}
 
-  return program;
+void BaseApp::SetArenaUniforms(bool has_normals) const {
+  // Arena vertices are full floats with their colors
+  glUniform3f(uniform_.position_offset, 0.0f, 0.0f, 0.0f);
+  glUniform3f(uniform_.position_scale, 1.0f, 1.0f, 1.0f);
+  glUniform4f(uniform_.object_color, 1.0f, 1.0f, 1.0f, 1.0f);
+  glUniform1i(uniform_.use_vertex_color, GL_TRUE);
+  glUniform1i(uniform_.has_normals, has_normals);
+  glUniform1i(uniform_.skirt_first_vertex, std::numeric_limits<GLint>::max());
+  glUniform1f(uniform_.skirt_depth, 0.0f);
 }
 
 void BaseApp::DestroyCustomGL() {
   // optional: de-allocate all resources once they've outlived their purpose:
   // ------------------------------------------------------------------------
   glDeleteVertexArrays(1, &vao_);
-  glDeleteBuffers(1, &vbo_position_);
-  glDeleteBuffers(1, &vbo_color_);
-  glDeleteBuffers(1, &ibo_);
-
-  glDeleteVertexArrays(1, &vao2_);
-  glDeleteBuffers(1, &vbo_position2_);
-  glDeleteBuffers(1, &vbo_color2_);
-  glDeleteBuffers(1, &ibo2_);
+  grid_.reset();
+  row_band_.reset();
+  grid_cache_.reset();
+  lod_.reset();
+  vbo_vertex_.reset();
+  vbo_color_.reset();
+  ibo_.reset();
+
+  arena_.reset();
+  curve_mesh_ = kInvalidMesh;
+  glyphs_.reset();
 
   glDeleteFramebuffers(1, &fbo_);
   glDeleteRenderbuffers(1, &rbo_depth_);
   glDeleteTextures(1, &texture_);
+  profiler_.reset();
 }
 
-void BaseApp::CustomGLDraw() {
+void BaseApp::CustomGLDraw(const CanvasState &canvas) {
   /*
   const GLfloat instanceStart[] = {
       0.7, 0.0, 0.0, 0.0,
@@ -528,7 +1529,7 @@ void BaseApp::CustomGLDraw() {
   //////////////////////////////////////////////////////////////////////
 
   glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
-  glViewport(0, 0, texture_x_, texture_y_);
+  glViewport(0, 0, canvas.width, canvas.height);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glUseProgram(program_);
 
@@ -537,8 +1538,9 @@ void BaseApp::CustomGLDraw() {
   // camera movement put in orthogonal projection matrix instead //
   /////////////////////////////////////////////////////////////////
   glm::mat4 view = glm::mat4(1.0f);
-  glm::mat4 projection = glm::ortho<float>(cam_x_, cam_x_ + cam_width_,
-                                           cam_y_, cam_y_ + cam_height_, -10, 10);
+  glm::mat4 projection = glm::ortho<float>(
+      canvas.cam_x, canvas.cam_x + canvas.cam_width,
+      canvas.cam_y, canvas.cam_y + canvas.cam_height, -10, 10);
   //mat4 view = view(vec3(1,0,0), vec3(0,1,0), vec3(0,0,-1), vec3(cam_x,cam_y,6));
   //mat4 projection = glm::perspective(60, resx/float(resy), 0.01, 10.0);
 
@@ -546,42 +1548,83 @@ void BaseApp::CustomGLDraw() {
   // same RNG seed every frame  //
   // "minimal standard" LCG RNG //
   ////////////////////////////////
-  glm::mat4 model = glm::rotate(glm::mat4(1.0f), rotate_x_, glm::vec3(1.0, 0.0, 0.0))
-                    *glm::rotate(glm::mat4(1.0f), rotate_y_, glm::vec3(0.0, 1.0, 0.0)); 
+  glm::mat4 model = glm::rotate(glm::mat4(1.0f), canvas.rotate_x, glm::vec3(1.0, 0.0, 0.0))
+                    *glm::rotate(glm::mat4(1.0f), canvas.rotate_y, glm::vec3(0.0, 1.0, 0.0)); 
 
   glm::mat4 MVP = projection * view * model;
-  glUniformMatrix4fv(glGetUniformLocation(program_, "MVP"), 1, GL_FALSE, glm::value_ptr(MVP));
+  glUniformMatrix4fv(uniform_.mvp, 1, GL_FALSE, glm::value_ptr(MVP));
+  glUniformMatrix4fv(uniform_.model, 1, GL_FALSE, glm::value_ptr(model));
 
-  // Draw!
+  // Draw! Vertex layouts are part of the VAOs, set by BindBuffers()
   glBindVertexArray(vao_);
-  glEnableVertexAttribArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_position_);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-  glEnableVertexAttribArray(1);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_color_);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-
-  glVertexAttribDivisor(0, 0);
-  glVertexAttribDivisor(1, 0);
-  glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_INT, NULL);
-  glDisableVertexAttribArray(0);
-  glDisableVertexAttribArray(1);
+  SetMeshUniforms(packed_, canvas.mesh_color,
+                  !drawn_.colors.empty() &&
+                  drawn_.colors.size() == drawn_.vertices.size());
+  if (GridLodActive()) {
+    // Orthographic: a world length covers the same number of pixels
+    // anywhere on the canvas and in any rotation
+    const float pixels_per_unit =
+        0.5f * canvas.height * std::abs(projection[1][1]);
+    lod_->Select(pixels_per_unit, drawn_.lod ? canvas.lod_tolerance : 0.0f,
+                 drawn_.cull ? &MVP : nullptr,
+                 drawn_.lod ? canvas.lod_level : -1);
+    glUniform1i(uniform_.skirt_first_vertex, lod_->FirstSkirtVertex());
+    glUniform1f(uniform_.skirt_depth, lod_->SkirtDepth());
+    profiler_->AddDraw(lod_->Draw());
+  }
+  else if (row_band_) {
+    // The finished rows of a grid still arriving, a band at a time; the
+    // band indices start at the band's first row through the base vertex
+    const unsigned int num_v = drawn_.grid_v;
+    const unsigned int num_rows = unsigned(drawn_.vertices.size() / num_v);
+    const unsigned int band = row_band_->num_u - 1;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, row_band_->ibo);
+    for (unsigned int first = 0; first + 1 < num_rows; first += band) {
+      const size_t quads = size_t(std::min(band, num_rows - 1 - first)) *
+                           (num_v - 1);
+      glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(6 * quads),
+                               row_band_->type, NULL, GLint(first * num_v));
+      profiler_->AddDraw(2 * quads);
+    }
+  }
+  else if (grid_) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid_->ibo);
+    if (grid_->mode == GL_TRIANGLE_STRIP) {
+      glEnable(GL_PRIMITIVE_RESTART);
+      glPrimitiveRestartIndex(grid_->restart_index);
+    }
+    glDrawElements(grid_->mode, grid_->count, grid_->type, NULL);
+    glDisable(GL_PRIMITIVE_RESTART);
+    profiler_->AddDraw(grid_->NumTriangles());
+  }
+  else {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_->id());
+    glDrawElements(GL_TRIANGLES, drawn_.indices.size(), GL_UNSIGNED_INT,
+                   reinterpret_cast<const void *>(ibo_->offset()));
+    profiler_->AddDraw(drawn_.indices.size() / 3);
+  }
   glBindVertexArray(0);
 
-  glBindVertexArray(vao2_);
-  glEnableVertexAttribArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_position2_);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-  glEnableVertexAttribArray(1);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_color2_);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-
-  glVertexAttribDivisor(0, 0);
-  glVertexAttribDivisor(1, 0);
-  glDrawElements(GL_LINES, indices2_.size(), GL_UNSIGNED_INT, NULL);
-  glDisableVertexAttribArray(0);
-  glDisableVertexAttribArray(1);
-  glBindVertexArray(0);
+  // Curves and AddMesh() meshes: one call per batch, however many meshes
+  const std::vector<MeshArena::Batch> &batches = arena_->Batches();
+  for (size_t idx = 0; idx < batches.size(); idx++) {
+    SetArenaUniforms(batches[idx].has_normals);
+    arena_->DrawBatch(idx);
+    profiler_->AddDraw(batches[idx].triangles);
+  }
+
+  // Markers keep their pixel size at any zoom
+  const float units_per_pixel = canvas.cam_height / canvas.height;
+  for (size_t idx = 0; idx < kNumGlyphShapes; idx++) {
+    const GlyphShape shape = static_cast<GlyphShape>(idx);
+    if (glyphs_->NumUploaded(shape) == 0) continue;
+    profiler_->AddDraw(glyphs_->Draw(shape, MVP, units_per_pixel));
+  }
+
+  // Ring regions read by the draws above are recycled once these pass
+  for (auto *buffer : { vbo_vertex_.get(), vbo_color_.get(), ibo_.get() })
+    buffer->Fence();
+  glyphs_->Fence();
 
   glUseProgram(0);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
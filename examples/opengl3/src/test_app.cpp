@@ -1,8 +1,12 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <iomanip>
-#include <string>
-#include <sstream>
 #include <random>
+#include <stdexcept>
+#include <string>
 #include <functional>
 
 #include "test_app.h"
@@ -11,7 +15,82 @@ namespace vktuto {
 
 inline namespace opengl3 {
 
-TestApp::TestApp() {
+namespace {
+
+// Scrolling list of 'count' rows, of which only the ones in view are laid
+// out: 'row(idx)' draws one row, under its own ID, and returns true when it
+// was edited. Every row must be one frame high.
+template <typename Row>
+bool ListEditor(const char *child_id, float height, int count, Row &&row) {
+  bool edited = false;
+  ImGui::BeginChild(child_id, ImVec2(0, height), true);
+  ImGuiListClipper clipper(count, ImGui::GetFrameHeightWithSpacing());
+  while (clipper.Step()) {
+    for (int idx = clipper.DisplayStart; idx < clipper.DisplayEnd; idx++) {
+      ImGui::PushID(idx);
+      edited |= row(idx);
+      ImGui::PopID();
+    }
+  }
+  ImGui::EndChild();
+  return edited;
+}
+
+// Runs of each BENCH measurement; the best and the mean are reported
+constexpr int kBenchRuns = 5;
+// Limits of the BENCH arguments, so a typo cannot exhaust the memory
+constexpr unsigned long kBenchMaxSamples = 2048;
+constexpr unsigned long kBenchMaxThreads = 256;
+constexpr unsigned long kBenchMaxEvaluations = 10000000;
+
+// Keeps the timed evaluations from being optimized away
+volatile float g_bench_sink = 0.0f;
+
+typedef std::chrono::steady_clock BenchClock;
+
+double MillisecondsSince(BenchClock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+      BenchClock::now() - start).count();
+}
+
+unsigned long ParseCount(const std::string &arg, const char *what,
+                         unsigned long max_value) {
+  char *end = nullptr;
+  const unsigned long value = std::strtoul(arg.c_str(), &end, 10);
+  if (arg.empty() || arg[0] == '-' || *end != '\0' || value == 0 ||
+      value > max_value)
+    throw std::invalid_argument(ConsoleTable::Format(
+        "%s must be from 1 to %lu", what, max_value));
+  return value;
+}
+
+// Bicubic 5 x 5 patch with a bump, for BENCH when the edited surface is
+// not valid
+nurbs::RationalSurface3f BenchSurface() {
+  nurbs::RationalSurface3f surface;
+  surface.degree_u = 3;
+  surface.degree_v = 3;
+  surface.knots_u = { 0, 0, 0, 0, 0.5f, 1, 1, 1, 1 };
+  surface.knots_v = surface.knots_u;
+  surface.control_points = nurbs::array2<glm::vec3>(5, 5);
+  for (size_t row = 0; row < 5; row++) {
+    for (size_t col = 0; col < 5; col++) {
+      const float height = (row == 2 && col == 2) ? 1.2f : 0.1f * (row % 2);
+      surface.control_points(row, col) =
+          glm::vec3(0.7f * col, 1.0f * row, height);
+    }
+  }
+  surface.weights = nurbs::array2<float>(5, 5, 1.0f);
+  return surface;
+}
+
+} // namespace
+
+TestApp::TestApp(const WindowOptions &window) : BaseApp(window) {
+  console.AddCommand("BENCH", "tessellate <nu> <nv> <threads> | eval <n>",
+                     [this](const std::vector<std::string> &args) {
+    BenchCommand(args);
+  });
   Initialize();
 }
 
@@ -24,6 +103,10 @@ void TestApp::Initialize() {
 }
 
 void TestApp::Update() {
+  PollLoadedModels();
+  PollGeometry();
+  PollBench();
+  StepIncremental();
   if (show_main_window_) ShowMainWindow();
 }
 
@@ -40,97 +123,80 @@ void TestApp::ChangeOutData() {
     return;
   }
 
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_real_distribution<float> dis(0, 1);
-
-  auto & vertices = GetVertices();
-  vertices = surface_points;
-
-  auto & colors = GetColors();
-  colors.resize(surface_points.size());
-  for (auto & color : colors) {
-    color = glm::vec3(1.0, 0.6, 0.1);//glm::vec3(dis(gen), dis(gen), dis(gen));
-  }
-
-  auto & indices = GetIndices();
-  indices.resize(6 * row_size * col_size);
-  std::vector<GLuint> mesh(6);
-  for (size_t u_idx = 0; u_idx < num_para_u; u_idx++) {
-    if (u_idx == row_size) continue;
-    for (size_t v_idx = 0; v_idx < num_para_v; v_idx++) {
-    if (v_idx == col_size) continue;
-      unsigned int idx = num_para_v * u_idx + v_idx;
-      unsigned int loc = col_size * (u_idx % row_size) + (v_idx % col_size);
-      mesh = { idx, idx + 1, idx + num_para_v,
-               idx + 1 , idx + 1 + num_para_v, idx + num_para_v };
-      std::copy(mesh.begin(), mesh.end(), indices.begin() + 6 * loc);
-    }
+  GetVertices() = surface_points;
+  GetNormals() = surface_normals;
+  // One color for the whole surface, set as a uniform
+  GetColors().clear();
+  SetMeshColor(glm::vec4(1.0f, 0.6f, 0.1f, 1.0f));
+
+  // Grid indices come from the shared cache
+  GetIndices().clear();
+  SetGridIndices(num_para_u, num_para_v);
+  if (!live_preview_) {
+    VertexCacheStats stats = SimulateGridCache(num_para_u, num_para_v,
+                                               VKTUTO_GRID_TOPOLOGY);
+    console.AddLog("Surface grid %u x %u (%s): ACMR %.3f, ATVR %.3f",
+                   num_para_u, num_para_v,
+                   GridTopologyName(VKTUTO_GRID_TOPOLOGY), stats.acmr,
+                   stats.atvr);
   }
 
   BindBuffers();
+  ChangeGlyphs();
 }
 
 void TestApp::ChangeOutData2() {
-  auto &positions = GetVertices2();
-  positions.resize(curve_points.size() + curve_tangents.size()
-                    + curve_normals.size() + curve_binormals.size());
-  for (size_t idx = 0; idx < positions.size(); idx++) {
-    if (idx < curve_points.size()) {
-      positions.at(idx) = curve_points.at(idx);
-    } else if (idx < curve_points.size() + curve_tangents.size()) {
-      size_t ii = idx - curve_points.size();
-      positions.at(idx) = curve_points.at(ii) + curve_tangents.at(ii);
-    } else if (idx < curve_points.size() + curve_tangents.size() + curve_normals.size()) {
-      size_t ii = idx - curve_points.size() - curve_tangents.size();
-      positions.at(idx) = curve_points.at(ii) - curve_normals.at(ii);
-    } else {
-      size_t ii = idx - curve_points.size() - curve_tangents.size() - curve_normals.size();
-      positions.at(idx) = curve_points.at(ii) + curve_binormals.at(ii);
-    }
-  }
-
-  auto &colors = GetColors2();
-  colors.resize(positions.size());
-  for (size_t idx = 0; idx < colors.size(); idx++) {
-    if (idx < curve_points.size()) {
-      colors.at(idx) = glm::vec3(0.5, 0.95, 0.45);
-    } else if (idx < curve_points.size() + curve_tangents.size()) {
-      colors.at(idx) = glm::vec3(1.0, 0.5, 0.5);
-    } else if (idx < curve_points.size() + curve_tangents.size() + curve_normals.size()) {
-      colors.at(idx) = glm::vec3(1.0, 1.0, 0.0);
-    } else {
-      colors.at(idx) = glm::vec3(0.18, 0.77, 0.71);
-    }
-  }
-
+  // The curve itself; its frames are arrow glyphs
+  GetVertices2() = curve_points;
+  GetColors2().assign(curve_points.size(), glm::vec3(0.5, 0.95, 0.45));
   auto &indices = GetIndices2();
   indices.clear();
-  size_t total_size = curve_points.size() - 1;
-  if (show_tangent)   total_size += curve_tangents.size();
-  if (show_normal)    total_size += curve_normals.size();
-  if (show_binormal)  total_size += curve_binormals.size();
-  indices.reserve(2 * total_size);
-  for (unsigned int idx = 0; idx < curve_points.size(); idx++) {
-    unsigned int ii;
-    if (idx < curve_points.size() - 1) {
-      indices.push_back(idx); indices.push_back(idx + 1);
-    }
-    if (show_tangent) {
-      ii = idx + curve_points.size();
-      indices.push_back(idx); indices.push_back(ii);
-    }
-    if (show_normal) {
-      ii = idx + curve_points.size() + curve_tangents.size();
-      indices.push_back(idx); indices.push_back(ii);
-    }
-    if (show_binormal) {
-      ii = idx + curve_points.size() + curve_tangents.size() + curve_normals.size();
-      indices.push_back(idx); indices.push_back(ii);
+  indices.reserve(2 * curve_points.size());
+  for (GLuint idx = 0; idx + 1 < curve_points.size(); idx++) {
+    indices.push_back(idx); indices.push_back(idx + 1);
+  }
+  BindBuffers2();
+  ChangeGlyphs();
+}
+
+void TestApp::ChangeGlyphs() {
+  auto &markers = GetGlyphs(GlyphShape::kMarker);
+  markers.clear();
+  if (show_control_points && !GetVertices().empty()) {
+    const auto &net = surface_primitive.control_points;
+    for (size_t u_idx = 0; u_idx < net.rows(); u_idx++) {
+      for (size_t v_idx = 0; v_idx < net.cols(); v_idx++) {
+        markers.push_back(MakeMarker(net(u_idx, v_idx), kMarkerPixels,
+                                     glm::vec3(0.35, 0.6, 1.0)));
+      }
     }
   }
+  const bool has_curve = !GetVertices2().empty();
+  if (show_control_points && has_curve) {
+    for (const glm::vec3 &point : curve_primitive.control_points)
+      markers.push_back(MakeMarker(point, kMarkerPixels, glm::vec3(1.0)));
+  }
 
-  BindBuffers2();
+  auto &arrows = GetGlyphs(GlyphShape::kArrow);
+  arrows.clear();
+  if (has_curve) {
+    arrows.reserve((show_tangent + show_normal + show_binormal) *
+                   curve_points.size());
+    for (size_t idx = 0; idx < curve_points.size(); idx++) {
+      const glm::vec3 &point = curve_points[idx];
+      if (show_tangent)
+        arrows.push_back(MakeArrow(point, curve_tangents[idx],
+                                   glm::vec3(1.0, 0.5, 0.5)));
+      // Curvature vector, drawn away from the center of curvature
+      if (show_normal)
+        arrows.push_back(MakeArrow(point, -curve_normals[idx],
+                                   glm::vec3(1.0, 1.0, 0.0)));
+      if (show_binormal)
+        arrows.push_back(MakeArrow(point, curve_binormals[idx],
+                                   glm::vec3(0.18, 0.77, 0.71)));
+    }
+  }
+  BindGlyphs();
 }
 
 ImGuiWindowFlags & TestApp::SetupWindowFlags() const noexcept
@@ -175,11 +241,29 @@ void TestApp::MenuTabs() {
   // Menu
   if (ImGui::BeginMenuBar()) {
     if (ImGui::BeginMenu("Menu")) {
-      ImGui::MenuItem(ICON_FA_FILE_IMPORT " Load files", "Ctrl+L");
+      if (ImGui::MenuItem(ICON_FA_FILE_IMPORT " Load files", "Ctrl+L"))
+        open_load_popup_ = true;
+      if (ImGui::BeginMenu(ICON_FA_FILE_EXPORT " Export surface mesh",
+                           !GetVertices().empty())) {
+        if (ImGui::MenuItem("Binary PLY (.ply)")) ExportSurfaceMesh("surface.ply");
+        if (ImGui::MenuItem("Binary STL (.stl)")) ExportSurfaceMesh("surface.stl");
+        if (ImGui::MenuItem("glTF binary (.glb)")) ExportSurfaceMesh("surface.glb");
+        ImGui::MenuItem("Reorder vertices for fetch", nullptr,
+                        &export_fetch_order_);
+        ImGui::Separator();
+        if (ImGui::MenuItem("High resolution PLY, streamed", nullptr, false,
+                            !geometry_.ExportBusy())) {
+          // 2001 x 2001 samples: 8M triangles, written one tile at a time
+          ExportSurfaceMeshStreamed("surface_high.ply", 2001, 2001);
+        }
+        ImGui::EndMenu();
+      }
       ImGui::EndMenu();
     }
     if (ImGui::BeginMenu("Examples")) {
       ImGui::MenuItem("Demonstration", "Ctrl+D", &ShowDemo());
+      ImGui::MenuItem(ICON_FA_TACHOMETER_ALT " Performance overlay", "Ctrl+P",
+                      &ShowProfiler());
       ImGui::EndMenu();
     }
     if (ImGui::BeginMenu("Help")) {
@@ -187,8 +271,304 @@ void TestApp::MenuTabs() {
       ImGui::MenuItem("Github " ICON_FA_GITHUB, NULL);
       ImGui::EndMenu();
     }
+
+    // Background load in progress
+    if (model_loader_.Busy()) {
+      ImGui::Separator();
+      ImGui::ProgressBar(model_loader_.Progress(), ImVec2(160, 0),
+                         StageName(model_loader_.CurrentStage()));
+      if (ImGui::SmallButton("Cancel")) model_loader_.Cancel();
+    }
+    // Streamed export in progress
+    if (geometry_.ExportBusy()) {
+      ImGui::Separator();
+      ImGui::ProgressBar(geometry_.ExportProgress(), ImVec2(160, 0),
+                         "Exporting");
+      if (ImGui::SmallButton("Cancel##export")) {
+        geometry_.CancelExport();
+        console.AddLog("Export cancelled");
+      }
+    }
     ImGui::EndMenuBar();
   }
+
+  ImGuiIO &io = ImGui::GetIO();
+  if (io.KeyCtrl && ImGui::IsKeyPressed(GLFW_KEY_L, false))
+    open_load_popup_ = true;
+  if (io.KeyCtrl && ImGui::IsKeyPressed(GLFW_KEY_P, false))
+    ShowProfiler() = !ShowProfiler();
+  if (open_load_popup_) {
+    ImGui::OpenPopup("Load files##popup");
+    open_load_popup_ = false;
+  }
+  LoadFilesPopup();
+}
+
+void TestApp::LoadFilesPopup() {
+  if (!ImGui::BeginPopupModal("Load files##popup", NULL,
+                              ImGuiWindowFlags_AlwaysAutoResize)) {
+    return;
+  }
+  ImGui::Text("Wavefront OBJ with free-form curves and surfaces");
+  bool submit = ImGui::InputText("##load-file-name", load_file_name_,
+                                 IM_ARRAYSIZE(load_file_name_),
+                                 ImGuiInputTextFlags_EnterReturnsTrue);
+  submit |= ImGui::Button("Load");
+  if (submit) {
+    // Same sampling as "Make surface"
+    model_loader_.Load(load_file_name_, kSurfaceSamples, kSurfaceSamples);
+    console.AddLog("Loading %s ...", load_file_name_);
+    ImGui::CloseCurrentPopup();
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Close")) ImGui::CloseCurrentPopup();
+  ImGui::EndPopup();
+}
+
+void TestApp::PollLoadedModels() {
+  LoadResult result;
+  while (model_loader_.Poll(result)) {
+    if (result.cancelled) {
+      console.AddLog("Loading %s cancelled", result.file_name.c_str());
+      continue;
+    }
+    if (!result.error.empty()) {
+      console.AddLog("[error] %s", result.error.c_str());
+      continue;
+    }
+    console.AddLog("Loaded %s: %zu surfaces, %zu curves, %zu invalid (%.3f s)",
+                   result.file_name.c_str(), result.surfaces.size(),
+                   result.curves.size(), result.num_invalid, result.seconds);
+
+    // The first surface and curve are the editable ones; the other
+    // surfaces are drawn from the mesh arena
+    for (MeshHandle mesh : extra_meshes_) RemoveMesh(mesh);
+    extra_meshes_.clear();
+    for (size_t idx = 1; idx < result.surfaces.size(); idx++) {
+      const auto &loaded = result.surfaces[idx];
+      extra_meshes_.push_back(AddGridMesh(
+          loaded.num_u, loaded.num_v, loaded.positions.data(),
+          loaded.normals.data(), glm::vec4(0.75f, 0.75f, 0.8f, 1.0f)));
+    }
+    if (!extra_meshes_.empty()) {
+      console.AddLog("%zu more surfaces in the mesh arena (%zu meshes)",
+                     extra_meshes_.size(), NumMeshes());
+    }
+    if (!result.surfaces.empty()) {
+      // Edits made before the load are out of date
+      geometry_.CancelSurface();
+      incremental_.Cancel();
+      auto &loaded = result.surfaces.front();
+      surface_primitive = std::move(loaded.surface);
+      surface_points = std::move(loaded.positions);
+      surface_normals = std::move(loaded.normals);
+      num_para_u = loaded.num_u;
+      num_para_v = loaded.num_v;
+      // The editor shows the loaded net and keeps its knots
+      surface_control_points = surface_primitive.control_points;
+      num_surface_con_point_u = int(surface_control_points.rows());
+      num_surface_con_point_v = int(surface_control_points.cols());
+      degree_u = int(surface_primitive.degree_u);
+      degree_v = int(surface_primitive.degree_v);
+      surface_cp_changed = surface_degree_changed = false;
+      ChangeOutData();
+    }
+    if (!result.curves.empty()) {
+      geometry_.CancelCurve();
+      curve_primitive = std::move(result.curves.front());
+      num_curve_con_points = int(curve_primitive.control_points.size());
+      curve_degree = int(curve_primitive.degree);
+      curve_cp_changed = curve_degree_changed = false;
+      // Tessellated in the background like "Make curve"
+      RequestCurve(true);
+    }
+  }
+}
+
+void TestApp::PollGeometry() {
+  if (geometry_.SwapSurface(surface_geometry_)) {
+    const SurfaceGeometry &geometry = surface_geometry_;
+    if (!geometry.error.empty()) {
+      console.AddLog("[error] %s", geometry.error.c_str());
+    }
+    else {
+      // The previous buffers go back to the worker with the next swap
+      surface_points.swap(surface_geometry_.positions);
+      surface_normals.swap(surface_geometry_.normals);
+      num_para_u = geometry.num_u;
+      num_para_v = geometry.num_v;
+      if (!live_preview_) {
+        console.AddLog("Surface tessellated in %.2f ms (%zu jobs "
+                       "dropped)", geometry.seconds * 1000.0,
+                       geometry_.JobsCancelled());
+      }
+      ChangeOutData();
+    }
+  }
+  if (geometry_.SwapCurve(curve_geometry_)) {
+    if (!curve_geometry_.error.empty()) {
+      console.AddLog("[error] %s", curve_geometry_.error.c_str());
+    }
+    else {
+      curve_points.swap(curve_geometry_.points);
+      curve_tangents.swap(curve_geometry_.tangents);
+      curve_normals.swap(curve_geometry_.normals);
+      curve_binormals.swap(curve_geometry_.binormals);
+      num_curve_para = static_cast<unsigned int>(curve_points.size());
+      ChangeOutData2();
+    }
+  }
+  if (geometry_.SwapExport(export_result_)) {
+    if (!export_result_.error.empty()) {
+      console.AddLog("[error] %s", export_result_.error.c_str());
+    }
+    else {
+      console.AddLog("Exported %u x %u samples to %s in %.2f s",
+                     export_result_.num_u, export_result_.num_v,
+                     export_result_.file_name.c_str(),
+                     export_result_.seconds);
+    }
+  }
+}
+
+void TestApp::StepIncremental() {
+  if (!incremental_.Active()) return;
+  const unsigned int first = incremental_.rows_done();
+  const unsigned int num_rows = incremental_.Step(WorkDeadline());
+  incremental_frames_++;
+  if (num_rows > 0) {
+    const size_t offset = size_t(first) * incremental_.num_v();
+    AppendGridRows(incremental_.positions().data() + offset,
+                   incremental_.normals().data() + offset, num_rows);
+  }
+  if (!incremental_.Done()) return;
+
+  // BaseApp has the whole grid by now; the samples are ours to keep
+  surface_points.swap(incremental_.positions());
+  surface_normals.swap(incremental_.normals());
+  num_para_u = incremental_.num_u();
+  num_para_v = incremental_.num_v();
+  console.AddLog("Surface %u x %u tessellated incrementally in %.2f ms "
+                 "over %u frames", num_para_u, num_para_v,
+                 std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() -
+                     incremental_start_).count(),
+                 incremental_frames_);
+  incremental_.Cancel();
+  ChangeGlyphs();
+}
+
+void TestApp::RequestSurface(bool report) {
+  nurbs::array2<float> wei = { surface_control_points.rows(), surface_control_points.cols(), { 1, } };
+  MakeSurface(degree_u, degree_v,
+    surface_primitive.knots_u, surface_primitive.knots_v,
+    surface_control_points, wei);
+
+  if (nurbs::internal::SurfaceIsValid(
+    surface_primitive.degree_u, surface_primitive.degree_v,
+    surface_primitive.knots_u, surface_primitive.knots_v,
+    surface_primitive.control_points, surface_primitive.weights)) {
+    const unsigned int samples = unsigned(surface_samples_);
+    if (incremental_mode_) {
+      // Restarts a tessellation in progress
+      geometry_.CancelSurface();
+      incremental_.Start(surface_primitive, samples, samples, true);
+      incremental_start_ = std::chrono::steady_clock::now();
+      incremental_frames_ = 0;
+      GetColors().clear();
+      GetIndices().clear();
+      SetMeshColor(glm::vec4(1.0f, 0.6f, 0.1f, 1.0f));
+      BeginGridRows(samples, samples, incremental_.lower(),
+                    incremental_.upper(), true);
+    }
+    else {
+      incremental_.Cancel();
+      geometry_.SubmitSurface(surface_primitive, samples, samples);
+    }
+  }
+  else if (report) {
+    std::cerr << "Parameters(degree and control points) are wrong!" << std::endl;
+  }
+}
+
+void TestApp::RequestCurve(bool report) {
+  auto &weight = curve_primitive.weights;
+  weight.resize(curve_primitive.control_points.size(), 1);
+
+  if (nurbs::CurveIsValid(curve_primitive))
+    geometry_.SubmitCurve(curve_primitive, kCurveSamples);
+  else if (report)
+    console.AddLog("[error] Curve parameters are invalid");
+}
+
+void TestApp::ExportSurfaceMesh(const std::string &file_name) {
+  // The GPU draws the grid with cached (possibly strip) indices; files get
+  // a triangle list in cache-friendly order: tiled when the grid is, else
+  // the rows reordered with Tipsify
+  if (size_t(num_para_u) * num_para_v != GetVertices().size()) {
+    console.AddLog("[error] Surface mesh is out of date, make the surface first");
+    return;
+  }
+  const bool tiled = VKTUTO_GRID_TOPOLOGY == GridTopology::kTiledTriangles;
+  const GridTopology topology =
+      tiled ? GridTopology::kTiledTriangles : GridTopology::kTriangles;
+  std::vector<uint32_t> indices(
+      GridIndexCount(num_para_u, num_para_v, topology));
+  BuildGridIndices(num_para_u, num_para_v, topology, indices.data());
+  if (!tiled)
+    OptimizeVertexCache(indices.data(), indices.size(), GetVertices().size());
+  const bool has_normals = GetNormals().size() == GetVertices().size();
+  // By default the writers read the surface buffers as they are; only
+  // with export_fetch_order_ are the vertices copied, renumbered in the
+  // order the triangles fetch them
+  std::vector<glm::vec3> positions, normals;
+  size_t num_used = GetVertices().size();
+  if (export_fetch_order_) {
+    std::vector<uint32_t> remap;
+    num_used = OptimizeVertexFetch(indices.data(), indices.size(),
+                                   GetVertices().size(), remap);
+    positions = RemapVertices(GetVertices(), remap, num_used);
+    if (has_normals) normals = RemapVertices(GetNormals(), remap, num_used);
+  }
+  const std::vector<glm::vec3> &out_positions =
+      export_fetch_order_ ? positions : GetVertices();
+  const std::vector<glm::vec3> &out_normals =
+      export_fetch_order_ ? normals : GetNormals();
+  MeshView mesh(out_positions, indices, has_normals ? &out_normals : nullptr);
+  std::string ext = file_name.substr(file_name.find_last_of('.') + 1);
+  try {
+    if (ext == "ply")       SaveMeshPLY(file_name, mesh);
+    else if (ext == "stl")  SaveMeshSTL(file_name, mesh);
+    else                    SaveMeshGLB(file_name, mesh);
+    VertexCacheStats stats = SimulateVertexCache(indices.data(),
+                                                 indices.size(), num_used);
+    VertexCacheStats grid = SimulateGridCache(num_para_u, num_para_v,
+                                              VKTUTO_GRID_TOPOLOGY);
+    console.AddLog("Exported %zu triangles to %s (%s: ACMR %.3f, ATVR %.3f; "
+                   "grid %s: ACMR %.3f, ATVR %.3f)", mesh.NumTriangles(),
+                   file_name.c_str(), tiled ? "tiled" : "tipsify", stats.acmr,
+                   stats.atvr, GridTopologyName(VKTUTO_GRID_TOPOLOGY),
+                   grid.acmr, grid.atvr);
+  }
+  catch (const std::exception &except) {
+    console.AddLog("[error] %s", except.what());
+  }
+}
+
+void TestApp::ExportSurfaceMeshStreamed(const std::string &file_name,
+                                        unsigned int num_u,
+                                        unsigned int num_v) {
+  if (!nurbs::internal::SurfaceIsValid(
+          surface_primitive.degree_u, surface_primitive.degree_v,
+          surface_primitive.knots_u, surface_primitive.knots_v,
+          surface_primitive.control_points, surface_primitive.weights)) {
+    console.AddLog("[error] Surface parameters are invalid");
+    return;
+  }
+  // Written on the geometry worker; PollGeometry() reports the result
+  geometry_.SubmitExport(surface_primitive, num_u, num_v, file_name);
+  console.AddLog("Exporting %u x %u samples to %s ...", num_u, num_v,
+                 file_name.c_str());
 }
 
 void TestApp::SplitView() {
@@ -216,7 +596,8 @@ void TestApp::SplitView() {
 
 void TestApp::ControlsColumn() {
   if (ImGui::CollapsingHeader("Surface")) {
-    static bool cp_changed = true, degree_changed = true;
+    // Anything the tessellation depends on, for live preview
+    bool surface_edited = false;
     // Pick 4 boundary points
     if (ImGui::TreeNode("Set 4 corner points")) {
       ImGui::Columns(4, "##pick-four-boundary-points");
@@ -230,33 +611,24 @@ void TestApp::ControlsColumn() {
       static float fx = 0.0f, fy = 0.0f, fz = 0.0f;
       static bool button_clicked[4] = { false, false, false, false };
       for (int i = 0; i < 4; i++) {
-        std::stringstream idx; idx << i;
-        std::string selectable_name("##dummy-bound");
-        std::string confirm_name(ICON_FA_LOCK_OPEN "##");
-        std::string change_name(ICON_FA_LOCK "##");
-        selectable_name.append(idx.str());
-        confirm_name.append(idx.str());
-        change_name.append(idx.str());
+        ImGui::PushID(i);
         if (button_clicked[i]) {
-          ImGui::InputFloat((selectable_name + "x").c_str(), &boundary[i].x, 0.0f); ImGui::NextColumn();
-          ImGui::InputFloat((selectable_name + "y").c_str(), &boundary[i].y, 0.0f); ImGui::NextColumn();
-          ImGui::InputFloat((selectable_name + "z").c_str(), &boundary[i].z, 0.0f); ImGui::NextColumn();
-          if (ImGui::Button(confirm_name.c_str())) {
+          ImGui::InputFloat("##x", &boundary[i].x, 0.0f); ImGui::NextColumn();
+          ImGui::InputFloat("##y", &boundary[i].y, 0.0f); ImGui::NextColumn();
+          ImGui::InputFloat("##z", &boundary[i].z, 0.0f); ImGui::NextColumn();
+          if (ImGui::Button(ICON_FA_LOCK_OPEN)) {
             button_clicked[i] = false;
-            cp_changed = true;
+            surface_cp_changed = true;
           }
         }
         else {
-          idx << std::fixed << std::setprecision(2);
-          idx.str(std::string()); idx << boundary[i].x;
-          ImGui::Text(idx.str().c_str()); ImGui::NextColumn();
-          idx.str(std::string()); idx << boundary[i].y;
-          ImGui::Text(idx.str().c_str()); ImGui::NextColumn();
-          idx.str(std::string()); idx << boundary[i].z;
-          ImGui::Text(idx.str().c_str()); ImGui::NextColumn();
-          if (ImGui::Button(change_name.c_str())) button_clicked[i] = true;
+          ImGui::Text("%.2f", boundary[i].x); ImGui::NextColumn();
+          ImGui::Text("%.2f", boundary[i].y); ImGui::NextColumn();
+          ImGui::Text("%.2f", boundary[i].z); ImGui::NextColumn();
+          if (ImGui::Button(ICON_FA_LOCK)) button_clicked[i] = true;
         }
         ImGui::NextColumn();
+        ImGui::PopID();
       }
       ImGui::Columns(1);
       ImGui::Separator();
@@ -270,14 +642,14 @@ void TestApp::ControlsColumn() {
       ImGui::Text("The number of C.P.");
       ImGui::PopFont(); ImGui::SameLine();
       ImGui::PushItemWidth(ImGui::GetContentRegionAvailWidth() * 0.3f);
-      cp_changed |= ImGui::DragInt("##cp_u", &num_surface_con_point_u, 0.1, 2, 20, "U: %d"); ImGui::SameLine();
-      cp_changed |= ImGui::DragInt("##cp_v", &num_surface_con_point_v, 0.1, 2, 20, "V: %d");
+      surface_cp_changed |= ImGui::DragInt("##cp_u", &num_surface_con_point_u, 0.1, 2, kMaxControlPoints, "U: %d"); ImGui::SameLine();
+      surface_cp_changed |= ImGui::DragInt("##cp_v", &num_surface_con_point_v, 0.1, 2, kMaxControlPoints, "V: %d");
       ImGui::PopItemWidth();
     }
 
     // Make control points
     {
-      if (cp_changed) {
+      if (surface_cp_changed) {
         surface_control_points.resize(num_surface_con_point_u, num_surface_con_point_v);
         for (size_t v_idx = 0; v_idx < surface_control_points.cols(); v_idx++) {
           float vv = static_cast<float>(v_idx) / (surface_control_points.cols() - 1);
@@ -293,23 +665,17 @@ void TestApp::ControlsColumn() {
       }
     }
 
-    // Customize control points
+    // Customize control points, one row each in U-major order. An edit
+    // keeps the net: only its size and the corners lay it out again.
     if (ImGui::TreeNode("Customize control points")) {
-      ImGui::BeginGroup();
-      ImGui::BeginChild("##cp-list", ImVec2(0, 200), true);
-      for (size_t u_idx = 0; u_idx < surface_control_points.rows(); u_idx++) {
-        for (size_t v_idx = 0; v_idx < surface_control_points.cols(); v_idx++) {
-          std::stringstream idx;
-          idx << u_idx << v_idx;
-          std::string dummy_name("##dummy");
-          dummy_name.append(idx.str());
-          ImGui::Text("C.P.(%d, %d)", u_idx, v_idx);
-          ImGui::SameLine();
-          cp_changed |= ImGui::InputFloat3(dummy_name.c_str(), surface_control_points(u_idx, v_idx).data.data);
-        }
-      }
-      ImGui::EndChild();
-      ImGui::EndGroup();
+      const int num_v = static_cast<int>(surface_control_points.cols());
+      const int count = static_cast<int>(surface_control_points.rows()) * num_v;
+      surface_edited |= ListEditor("##cp-list", 200.0f, count, [&](int idx) {
+        const int u_idx = idx / num_v, v_idx = idx % num_v;
+        ImGui::Text("C.P.(%d, %d)", u_idx, v_idx);
+        ImGui::SameLine();
+        return ImGui::InputFloat3("##cp", surface_control_points(u_idx, v_idx).data.data);
+      });
 
       ImGui::TreePop();
     }
@@ -323,13 +689,13 @@ void TestApp::ControlsColumn() {
       ImGui::TextColored(color, "Degree");
       ImGui::PopFont(); ImGui::SameLine();
       ImGui::PushItemWidth(ImGui::GetContentRegionAvailWidth() * 0.25f);
-      degree_changed |= ImGui::DragInt("##degree_u", &degree_u, 0.1, 1, num_surface_con_point_u - 1, "U: %d"); ImGui::SameLine();
-      degree_changed |= ImGui::DragInt("##degree_v", &degree_v, 0.1, 1, num_surface_con_point_v - 1, "V: %d");
+      surface_degree_changed |= ImGui::DragInt("##degree_u", &degree_u, 0.1, 1, num_surface_con_point_u - 1, "U: %d"); ImGui::SameLine();
+      surface_degree_changed |= ImGui::DragInt("##degree_v", &degree_v, 0.1, 1, num_surface_con_point_v - 1, "V: %d");
       ImGui::PopItemWidth();
     }
 
     // Make knots
-    if (cp_changed || degree_changed) {
+    if (surface_cp_changed || surface_degree_changed) {
       auto & knots_u = surface_primitive.knots_u;
       knots_u.resize(surface_control_points.rows() + degree_u + 1);
       auto & knots_v = surface_primitive.knots_v;
@@ -359,7 +725,8 @@ void TestApp::ControlsColumn() {
         }
       }
 
-      cp_changed = degree_changed = false;
+      surface_cp_changed = surface_degree_changed = false;
+      surface_edited = true;
     }
 
     // Customize knots
@@ -376,124 +743,54 @@ void TestApp::ControlsColumn() {
       //track_line_v |= ImGui::DragInt("##line_vknots", &track_vknot, 0.25f, 0, surface_primitive.knots_v.size() - 1, "V = %d");
       //ImGui::PopItemWidth();
       ImGui::Columns(2);
-      ImGui::BeginChild("##uknots-list", ImVec2(0, 150), true);
-      for (size_t u_idx = 0; u_idx < surface_primitive.knots_u.size(); u_idx++) {
-        std::stringstream idx;
-        idx << u_idx;
-        std::string dummy_name("##dummy_uknots");
-        dummy_name.append(idx.str());
-        //if (u_idx == track_uknot) {
-        ImGui::Text("U Knot(%d)", u_idx);
+      auto &knots_u = surface_primitive.knots_u;
+      surface_edited |= ListEditor("##uknots-list", 150.0f,
+          static_cast<int>(knots_u.size()), [&](int idx) {
+        ImGui::Text("U Knot(%d)", idx);
         ImGui::SameLine();
-        ImGui::InputFloat(dummy_name.c_str(), &surface_primitive.knots_u.at(u_idx));
-        //  //if (track_line_u) ImGui::SetScrollHereY();
-        //}
-        //else {
-        //  ImGui::Text("U Knot(%d)", u_idx);
-        //  ImGui::SameLine();
-        //  ImGui::InputFloat(dummy_name.c_str(), &surface_primitive.knots_u.at(u_idx));
-        //}
-      }
-      ImGui::EndChild(); ImGui::NextColumn();
-      ImGui::BeginChild("##vknots-list", ImVec2(0, 150), true);
-      for (size_t v_idx = 0; v_idx < surface_primitive.knots_v.size(); v_idx++) {
-        std::stringstream idx;
-        idx << v_idx;
-        std::string dummy_name("##dummy_vknots");
-        dummy_name.append(idx.str());
-        //if (v_idx == track_vknot) {
-        ImGui::Text("V Knot(%d)", v_idx);
+        return ImGui::InputFloat("##knot", &knots_u[idx]);
+      });
+      ImGui::NextColumn();
+      auto &knots_v = surface_primitive.knots_v;
+      surface_edited |= ListEditor("##vknots-list", 150.0f,
+          static_cast<int>(knots_v.size()), [&](int idx) {
+        ImGui::Text("V Knot(%d)", idx);
         ImGui::SameLine();
-        ImGui::InputFloat(dummy_name.c_str(), &surface_primitive.knots_v.at(v_idx));
-        //  if (track_line_v) ImGui::SetScrollHereY();
-        //}
-        //else {
-        //  ImGui::Text("V Knot(%d)", v_idx);
-        //  ImGui::SameLine();
-        //  ImGui::InputFloat(dummy_name.c_str(), &surface_primitive.knots_v.at(v_idx));
-        //}
-      }
-      ImGui::EndChild(); ImGui::NextColumn();
+        return ImGui::InputFloat("##knot", &knots_v[idx]);
+      });
+      ImGui::NextColumn();
       ImGui::Columns(1);
       ImGui::EndGroup();
 
       ImGui::TreePop();
     }
 
-    // Make surface
+    // Make surface: tessellated in the background and shown once done, or
+    // a few rows per frame and shown as they come
+    ImGui::PushItemWidth(ImGui::GetContentRegionAvailWidth() * 0.4f);
+    ImGui::DragInt("Samples", &surface_samples_, 1.0f, 2, 2049);
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    ImGui::Checkbox("Incremental", &incremental_mode_);
     if (ImGui::Button("Make surface"))
-    {
-      nurbs::array2<float> wei = { surface_control_points.rows(), surface_control_points.cols(), { 1, } };
-      MakeSurface(degree_u, degree_v,
-        surface_primitive.knots_u, surface_primitive.knots_v,
-        surface_control_points, wei);
-
-      if (nurbs::internal::SurfaceIsValid(
-        surface_primitive.degree_u, surface_primitive.degree_v,
-        surface_primitive.knots_u, surface_primitive.knots_v,
-        surface_primitive.control_points, surface_primitive.weights)) {
-        float interval_u = 0.01f, interval_v = 0.01f;
-        num_para_u = 1 / interval_u + 1;
-        num_para_v = 1 / interval_v + 1;
-        surface_points.resize(num_para_u * num_para_v);
-        for (size_t u_idx = 0; u_idx < num_para_u; ++u_idx) {
-          float para_u = interval_u * u_idx;
-          for (size_t v_idx = 0; v_idx < num_para_v; ++v_idx) {
-            float para_v = interval_v * v_idx;
-            glm::vec3 pt = nurbs::SurfacePoint(surface_primitive, para_u, para_v);
-            surface_points.at(num_para_v * u_idx + v_idx) = pt;
-          }
-        }
-
-        ChangeOutData();
-
-        //  nurbs::SurfaceSaveOBJ("surface.txt", srf);
-      }
-      else {
-        std::cerr << "Parameters(degree and control points) are wrong!" << std::endl;
-      }
-    }
+      RequestSurface(true);
+    else if (live_preview_ && surface_edited)
+      RequestSurface(false);
     ImGui::SameLine();
 
     // Clear surface
     if (ImGui::Button("Clear surface")) {
+      geometry_.CancelSurface();
+      incremental_.Cancel();
       GetVertices() = std::vector<glm::vec3>();
+      GetNormals() = std::vector<glm::vec3>();
       GetColors() = std::vector<glm::vec3>();
       GetIndices() = std::vector<GLuint>();
+      SetGridIndices(0, 0);
       BindBuffers();
+      ChangeGlyphs();
     }
 
-    // Load surface
-    //if (ImGui::Button("Load surface"))
-    //{
-      //std::string file_name = "surface.txt";
-      //auto srf2 = nurbs::SurfaceReadOBJ<3, float>(file_name.c_str());
-
-      //if (nurbs::internal::SurfaceIsValid(
-      //  srf2.degree_u, srf2.degree_v,
-      //  srf2.knots_u, srf2.knots_v,
-      //  srf2.control_points, srf2.weights)) {
-      //  float interval_u = 0.01f, interval_v = 0.01f;
-      //  num_para_u = 1 / interval_u + 1;
-      //  num_para_v = 1 / interval_v + 1;
-      //  surface.resize(num_para_u * num_para_v);
-      //  for (size_t u_idx = 0; u_idx < num_para_u; ++u_idx) {
-      //    float para_u = interval_u * u_idx;
-      //    for (size_t v_idx = 0; v_idx < num_para_v; ++v_idx) {
-      //      float para_v = interval_v * v_idx;
-      //      glm::vec3 pt = nurbs::SurfacePoint(srf2, para_u, para_v);
-      //      surface.at(num_para_v * u_idx + v_idx) = pt;
-      //    }
-      //  }
-
-      //  srf = srf2;
-      //  ChangeOutData();
-      //}
-      //else {
-      //  std::cerr << "Parameters(degree and control points) are wrong!" << std::endl;
-      //}
-    //}
-
     // Set draw mode
     {
       static int draw_mode = 2;
@@ -502,41 +799,53 @@ void TestApp::ControlsColumn() {
       ImGui::RadioButton("Point", &draw_mode, 0);
       ChangeDrawMode(draw_mode);
     }
+
+    // Coarser patches when zoomed out, within a pixel of the full grid
+    {
+      bool lod = GridLodEnabled();
+      if (ImGui::Checkbox("Level of detail", &lod)) SetGridLod(lod);
+      ImGui::SameLine();
+      // Only patches in view are drawn when zoomed in
+      bool cull = FrustumCullingEnabled();
+      if (ImGui::Checkbox("Frustum culling", &cull)) SetFrustumCulling(cull);
+    }
+    if (ImGui::Checkbox("Control points", &show_control_points))
+      ChangeGlyphs();
+    // Re-tessellate on every edit, also while a value is being dragged
+    ImGui::Checkbox("Live preview##surface", &live_preview_);
+    if (incremental_.Active()) {
+      char rows[64];
+      std::snprintf(rows, sizeof(rows), "rows %u / %u",
+                    incremental_.rows_done(), incremental_.num_u());
+      ImGui::ProgressBar(incremental_.Progress(), ImVec2(-1.0f, 0.0f), rows);
+    }
   }
 
   if (ImGui::CollapsingHeader("Curve")) {
     auto &cp = curve_primitive.control_points;
     auto &knots = curve_primitive.knots;
     auto &degree = curve_primitive.degree;
-    static bool curve_cp_changed = true, curve_degree_changed = true;
+    bool curve_edited = false;
 
     // The number of control points
     {
-      static int num_curve_con_points = 4;
       ImGui::PushFont(GetBoldFont());
       ImGui::Text("The number of C.P.");
       ImGui::PopFont(); ImGui::SameLine();
       ImGui::PushItemWidth(ImGui::GetContentRegionAvailWidth() * 0.4f);
-      curve_cp_changed |= ImGui::DragInt("##curve-num-C.P.", &num_curve_con_points, 0.1, 2, 20, "%d");
+      curve_cp_changed |= ImGui::DragInt("##curve-num-C.P.", &num_curve_con_points, 0.1, 2, kMaxControlPoints, "%d");
       ImGui::PopItemWidth();
       if (curve_cp_changed) cp.resize(num_curve_con_points);
     }
 
     // Customize control points
     if (ImGui::TreeNode("Customize control points##curve")) {
-      ImGui::BeginGroup();
-      ImGui::BeginChild("##curve-cp-list", ImVec2(0, 150), true);
-      for (size_t u_idx = 0; u_idx < cp.size(); u_idx++) {
-        std::stringstream idx;
-        idx << u_idx;
-        std::string dummy_name("##dummy-curve-cp");
-        dummy_name.append(idx.str());
-        ImGui::Text("C.P.(%d)", u_idx);
+      curve_cp_changed |= ListEditor("##curve-cp-list", 150.0f,
+          static_cast<int>(cp.size()), [&](int idx) {
+        ImGui::Text("C.P.(%d)", idx);
         ImGui::SameLine();
-        curve_cp_changed |= ImGui::InputFloat3(dummy_name.c_str(), cp.at(u_idx).data.data);
-      }
-      ImGui::EndChild();
-      ImGui::EndGroup();
+        return ImGui::InputFloat3("##cp", cp[idx].data.data);
+      });
 
       ImGui::TreePop();
     }
@@ -564,7 +873,9 @@ void TestApp::ControlsColumn() {
           return glm::sqrt(norm) / total_length;
         }
       };
-      if (curve_cp_changed) {
+      // A loaded curve comes with its knots, but the parameters are still
+      // needed when its degree is edited
+      if (curve_cp_changed || parameters.size() != cp.size()) {
         parameters.resize(cp.size());
 
         float total_chord_length = 0;
@@ -586,7 +897,6 @@ void TestApp::ControlsColumn() {
 
     // Degrees
     {
-      static int curve_degree = 2;
       ImVec4 color(ImGui::GetStyleColorVec4(ImGuiCol_Text));
       if (degree >= cp.size())
         color = ImGui::GetStyleColorVec4(ImGuiCol_PlotLinesHovered);
@@ -631,75 +941,46 @@ void TestApp::ControlsColumn() {
           knots.at(knots.size() - 1 - u_idx) = 1.0f;
         }
         curve_cp_changed = curve_degree_changed = false;
+        curve_edited = true;
       }
     }
 
     // Customize knots
     if (ImGui::TreeNode("Customize knots")) {
-      ImGui::BeginGroup();
-      ImGui::BeginChild("##curve-knots-list", ImVec2(0, 150), true);
-      for (size_t u_idx = 0; u_idx < knots.size(); u_idx++) {
-        std::stringstream idx;
-        idx << u_idx;
-        std::string knot_name("##curve-knot");
-        knot_name.append(idx.str());
-        ImGui::Text("Knot(%d)", u_idx); ImGui::SameLine();
-        ImGui::InputFloat(knot_name.c_str(), &knots.at(u_idx));
-      }
-      ImGui::EndChild();
-      ImGui::EndGroup();
+      curve_edited |= ListEditor("##curve-knots-list", 150.0f,
+          static_cast<int>(knots.size()), [&](int idx) {
+        ImGui::Text("Knot(%d)", idx); ImGui::SameLine();
+        return ImGui::InputFloat("##knot", &knots[idx]);
+      });
 
       ImGui::TreePop();
     }
     
     ImGui::Separator();
-    ImGui::Checkbox("Tangent", &show_tangent); ImGui::SameLine();
-    ImGui::Checkbox("Normal", &show_normal); ImGui::SameLine();
-    ImGui::Checkbox("Binormal", &show_binormal);
-    // Make curve
-    if (ImGui::Button("Make curve")) {
-      auto &weight = curve_primitive.weights;
-      weight.resize(curve_primitive.control_points.size(), 1);
-
-      if (nurbs::CurveIsValid(curve_primitive)) {
-        static float interval = 0.01f;
-        num_curve_para = 1 / interval + 1;
-        curve_points.resize(num_curve_para);
-        curve_tangents.resize(num_curve_para);
-        curve_normals.resize(num_curve_para);
-        curve_binormals.resize(num_curve_para);
-
-        for (size_t u_idx = 0; u_idx < curve_points.size(); u_idx++) {
-          float para = interval * u_idx;
-          glm::vec3 pt = nurbs::CurvePoint(curve_primitive, para);
-          curve_points.at(u_idx) = pt;
-
-          glm::vec3 c1 = nurbs::CurveDerivatives(curve_primitive, 1, para).at(1);
-          curve_tangents.at(u_idx) = glm::normalize(c1);
-
-          glm::vec3 c2 = nurbs::CurveDerivatives(curve_primitive, 2, para).at(2);
-          glm::vec3 binormal = glm::cross(c1, c2);
-          curve_binormals.at(u_idx) = glm::normalize(binormal);
-
-          float nomi = glm::length(binormal);
-          float denomi = glm::pow(glm::length(c1), 3);
-          float curvature = nomi / denomi;
-          glm::vec3 normal = curvature * glm::normalize(glm::cross(binormal, c1));
-          curve_normals.at(u_idx) = normal;
-        }
-
-        ChangeOutData2();
-      }
-    }
+    // Frames are glyphs, toggled without evaluating the curve again
+    bool frames_changed = ImGui::Checkbox("Tangent", &show_tangent);
+    ImGui::SameLine();
+    frames_changed |= ImGui::Checkbox("Normal", &show_normal);
+    ImGui::SameLine();
+    frames_changed |= ImGui::Checkbox("Binormal", &show_binormal);
+    if (frames_changed) ChangeGlyphs();
+    ImGui::Checkbox("Live preview##curve", &live_preview_);
+    // Make curve: evaluated in the background like the surface
+    if (ImGui::Button("Make curve"))
+      RequestCurve(true);
+    else if (live_preview_ && curve_edited)
+      RequestCurve(false);
     ImGui::SameLine();
 
     // Clear curve
     if (ImGui::Button("Clear curve")) {
+      geometry_.CancelCurve();
       GetVertices2()  = std::vector<glm::vec3>();
       GetColors2()    = std::vector<glm::vec3>();
       GetIndices2()   = std::vector<GLuint>();
 
       BindBuffers2();
+      ChangeGlyphs();
     }
   }
 
@@ -734,17 +1015,8 @@ void TestApp::CanvasContext() {
   // keep cam_height constant                        //
   /////////////////////////////////////////////////////
   ImVec2 size = ImGui::GetContentRegionAvail();
-  if (GetTextrueX() != size.x || GetTextrueY() != size.y) {
-    GetTextrueX() = size.x;
-    GetTextrueY() = size.y;
-    GetCamW() = GetCamH() * GetTextrueX() / float(GetTextrueY());
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, this->GetTexture());
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, GetTextrueX(), GetTextrueY(), 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
-    glBindFramebuffer(GL_FRAMEBUFFER, this->GetFBO());
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, GetTextrueX(), GetTextrueY());
-  }
+  if (GetTextrueX() != size.x || GetTextrueY() != size.y)
+    ResizeCanvas(int(size.x), int(size.y));
 
   ImGuiIO& io = ImGui::GetIO();
   static ImVec2 image_pos = ImVec2(GetTextrueX() / 2, GetTextrueY() / 2); // If mouse cursor is outside the screen, use center of image as zoom point
@@ -836,6 +1108,149 @@ void TestApp::CanvasContext() {
   }
 }
 
+void TestApp::BenchCommand(const std::vector<std::string> &args) {
+  std::string mode = args.empty() ? "" : args[0];
+  for (char &c : mode)
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  const bool tessellate = mode == "tessellate" && args.size() == 4;
+  const bool evaluate = mode == "eval" && args.size() == 2;
+  if (!tessellate && !evaluate)
+    throw std::invalid_argument("expected tessellate <nu> <nv> <threads> "
+                                "or eval <n>");
+  if (bench_.valid())
+    throw std::runtime_error("a benchmark is still running");
+
+  const bool edited = nurbs::internal::SurfaceIsValid(
+      surface_primitive.degree_u, surface_primitive.degree_v,
+      surface_primitive.knots_u, surface_primitive.knots_v,
+      surface_primitive.control_points, surface_primitive.weights);
+  const nurbs::RationalSurface3f surface =
+      edited ? surface_primitive : BenchSurface();
+  console.AddLog("Benchmarking the %s surface: degree %u x %u, %zu x %zu "
+                 "control points", edited ? "edited" : "stock",
+                 surface.degree_u, surface.degree_v,
+                 surface.control_points.rows(), surface.control_points.cols());
+  if (tessellate) {
+    const unsigned int num_u =
+        unsigned(ParseCount(args[1], "nu", kBenchMaxSamples));
+    const unsigned int num_v =
+        unsigned(ParseCount(args[2], "nv", kBenchMaxSamples));
+    const unsigned int threads =
+        unsigned(ParseCount(args[3], "threads", kBenchMaxThreads));
+    bench_ = bench_thread_.Submit([surface, num_u, num_v, threads] {
+      return BenchTessellate(surface, num_u, num_v, threads);
+    });
+  }
+  else {
+    const size_t count = ParseCount(args[1], "n", kBenchMaxEvaluations);
+    bench_ = bench_thread_.Submit([surface, count] {
+      return BenchEvaluate(surface, count);
+    });
+  }
+}
+
+void TestApp::PollBench() {
+  if (!bench_.valid() || bench_.wait_for(std::chrono::seconds(0)) !=
+                             std::future_status::ready)
+    return;
+  try {
+    const BenchReport report = bench_.get();
+    console.AddLog("%s", report.title.c_str());
+    report.table.Print(console);
+  }
+  catch (const std::exception &except) {
+    console.AddLog("[error] BENCH: %s", except.what());
+  }
+}
+
+TestApp::BenchReport TestApp::BenchTessellate(
+    const nurbs::RationalSurface3f &surface, unsigned int num_u,
+    unsigned int num_v, unsigned int threads) {
+  const SurfaceEvaluator evaluator(surface);
+  const size_t samples = size_t(num_u) * num_v;
+  std::vector<glm::vec3> positions(samples), normals(samples);
+  // Best and mean milliseconds over the runs
+  auto time_runs = [&](nurbs::util::ThreadPool *pool, double &best,
+                       double &mean) {
+    best = 0.0;
+    mean = 0.0;
+    for (int run = 0; run < kBenchRuns; run++) {
+      const BenchClock::time_point start = BenchClock::now();
+      TessellateSurfaceParallel(evaluator, num_u, num_v, pool,
+                                positions.data(), normals.data());
+      const double ms = MillisecondsSince(start);
+      best = run == 0 ? ms : std::min(best, ms);
+      mean += ms / kBenchRuns;
+    }
+  };
+
+  ConsoleTable table({ "threads", "best", "mean", "Msamples/s", "speedup" });
+  double single_best, single_mean;
+  time_runs(nullptr, single_best, single_mean);
+  table.AddRow({ "1", ConsoleTable::Format("%.2f ms", single_best),
+                 ConsoleTable::Format("%.2f ms", single_mean),
+                 ConsoleTable::Format("%.2f", samples / single_best / 1e3),
+                 "1.00x" });
+  if (threads > 1) {
+    // The calling thread takes bands too
+    nurbs::util::ThreadPool pool(threads - 1);
+    double best, mean;
+    time_runs(&pool, best, mean);
+    table.AddRow({ ConsoleTable::Format("%u", threads),
+                   ConsoleTable::Format("%.2f ms", best),
+                   ConsoleTable::Format("%.2f ms", mean),
+                   ConsoleTable::Format("%.2f", samples / best / 1e3),
+                   ConsoleTable::Format("%.2fx", single_best / best) });
+  }
+  return { ConsoleTable::Format(
+               "Tessellation of %u x %u samples with normals, best of %d",
+               num_u, num_v, kBenchRuns),
+           std::move(table) };
+}
+
+TestApp::BenchReport TestApp::BenchEvaluate(
+    const nurbs::RationalSurface3f &surface, size_t count) {
+  const SurfaceEvaluator evaluator(surface);
+  // The parameters are drawn before the clock starts
+  const float min_u = evaluator.ParameterU(0, 2);
+  const float max_u = evaluator.ParameterU(1, 2);
+  const float min_v = evaluator.ParameterV(0, 2);
+  const float max_v = evaluator.ParameterV(1, 2);
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<glm::vec2> params(count);
+  for (glm::vec2 &param : params) {
+    param.x = min_u + (max_u - min_u) * unit(random);
+    param.y = min_v + (max_v - min_v) * unit(random);
+  }
+
+  ConsoleTable table({ "evaluation", "total", "per eval", "Mevals/s" });
+  auto time_evaluations = [&](const char *name, auto &&evaluate) {
+    const BenchClock::time_point start = BenchClock::now();
+    glm::vec3 sum(0.0f);
+    for (const glm::vec2 &param : params) sum += evaluate(param.x, param.y);
+    const double ms = MillisecondsSince(start);
+    g_bench_sink = sum.x + sum.y + sum.z;
+    EvaluationStats::FlushSurface();
+    table.AddRow({ name, ConsoleTable::Format("%.2f ms", ms),
+                   ConsoleTable::Format("%.1f ns", ms * 1e6 / count),
+                   ConsoleTable::Format("%.2f", count / ms / 1e3) });
+  };
+  time_evaluations("point", [&](float u, float v) {
+    return evaluator.Point(u, v);
+  });
+  time_evaluations("normal", [&](float u, float v) {
+    return evaluator.Normal(u, v);
+  });
+  time_evaluations("nurbs::SurfacePoint", [&](float u, float v) {
+    return nurbs::SurfacePoint(surface, u, v);
+  });
+
+  return { ConsoleTable::Format("%zu evaluations at random parameters",
+                                count),
+           std::move(table) };
+}
+
 void TestApp::MakeSurface(
     unsigned int degree_u,
     unsigned int degree_v,
@@ -0,0 +1,363 @@
+#include "vktuto_font_cache.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double MillisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Start of every cache file; the version changes with the file layout
+constexpr char     kMagic[4] = { 'V', 'K', 'F', 'A' };
+constexpr uint32_t kFileVersion = 1;
+
+// The file is the header, one FontRecord and its glyphs per font of the
+// atlas, in order, and the Alpha8 pixels
+struct CacheHeader {
+  char     magic[4];
+  uint32_t version;
+  uint64_t key;
+  uint32_t num_fonts;
+  uint32_t glyph_size;  // sizeof(ImFontGlyph)
+  int32_t  width, height;
+  float    uv_scale[2];
+  float    uv_white_pixel[2];
+};
+
+struct FontRecord {
+  float    size;
+  float    ascent, descent;
+  uint32_t num_glyphs;
+};
+
+constexpr uint64_t kHashBasis = 14695981039346656037ull;
+constexpr uint64_t kHashPrime = 1099511628211ull;
+
+// 64-bit FNV-1a, continued from 'hash'
+uint64_t HashBytes(const void *data, size_t size, uint64_t hash) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for (size_t idx = 0; idx < size; idx++) {
+    hash ^= bytes[idx];
+    hash *= kHashPrime;
+  }
+  return hash;
+}
+
+// FNV-1a on 64-bit words, folded so high bits reach the low ones: the font
+// files are megabytes, hashed on every start
+uint64_t HashWords(const void *data, size_t size, uint64_t hash) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  size_t idx = 0;
+  for (; idx + sizeof(uint64_t) <= size; idx += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes + idx, sizeof(word));
+    hash = (hash ^ word) * kHashPrime;
+    hash ^= hash >> 32;
+  }
+  return HashBytes(bytes + idx, size - idx, hash);
+}
+
+template <typename T>
+uint64_t HashValue(const T &value, uint64_t hash) {
+  return HashBytes(&value, sizeof(value), hash);
+}
+
+// Everything ImFontAtlas::Build() reads, and the layout of what it makes
+uint64_t AtlasKey(const ImFontAtlas &atlas) {
+  uint64_t hash = HashBytes(IMGUI_VERSION, sizeof(IMGUI_VERSION), kHashBasis);
+  hash = HashValue(uint32_t(sizeof(ImFontGlyph)), hash);
+  hash = HashValue(uint32_t(sizeof(ImWchar)), hash);
+  hash = HashValue(atlas.Flags, hash);
+  hash = HashValue(atlas.TexDesiredWidth, hash);
+  hash = HashValue(atlas.TexGlyphPadding, hash);
+  hash = HashValue(atlas.Fonts.Size, hash);
+  for (const ImFontConfig &config : atlas.ConfigData) {
+    hash = HashValue(config.FontDataSize, hash);
+    hash = HashWords(config.FontData, size_t(config.FontDataSize), hash);
+    hash = HashValue(config.FontNo, hash);
+    hash = HashValue(config.SizePixels, hash);
+    hash = HashValue(config.OversampleH, hash);
+    hash = HashValue(config.OversampleV, hash);
+    hash = HashValue(config.PixelSnapH, hash);
+    hash = HashValue(config.GlyphExtraSpacing, hash);
+    hash = HashValue(config.GlyphOffset, hash);
+    hash = HashValue(config.GlyphMinAdvanceX, hash);
+    hash = HashValue(config.GlyphMaxAdvanceX, hash);
+    hash = HashValue(config.MergeMode, hash);
+    hash = HashValue(config.RasterizerFlags, hash);
+    hash = HashValue(config.RasterizerMultiply, hash);
+    // Pairs of codepoints up to a 0, which ends the list in the hash too
+    for (const ImWchar *range = config.GlyphRanges; range && *range; range++)
+      hash = HashValue(*range, hash);
+    hash = HashValue(ImWchar(0), hash);
+    int font_idx = 0;
+    while (font_idx < atlas.Fonts.Size && atlas.Fonts[font_idx] != config.DstFont)
+      font_idx++;
+    hash = HashValue(font_idx, hash);
+  }
+  return hash;
+}
+
+bool Contains(const MappedFile &file, const void *pointer) {
+  const uintptr_t address = reinterpret_cast<uintptr_t>(pointer);
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(file.data());
+  return !file.empty() && address >= begin && address < begin + file.size();
+}
+
+} // namespace
+
+MappedFile::MappedFile(const std::string &file_name) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) return;
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) {
+      void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      if (view != NULL) {
+        data_ = static_cast<const unsigned char *>(view);
+        size_ = size_t(size.QuadPart);
+        mapping_ = mapping;
+      }
+      else {
+        CloseHandle(mapping);
+      }
+    }
+  }
+  // The mapping keeps the file open
+  CloseHandle(file);
+#else
+  const int file = open(file_name.c_str(), O_RDONLY);
+  if (file < 0) return;
+  struct stat status;
+  if (fstat(file, &status) == 0 && status.st_size > 0) {
+    void *view = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE,
+                      file, 0);
+    if (view != MAP_FAILED) {
+      data_ = static_cast<const unsigned char *>(view);
+      size_ = size_t(status.st_size);
+    }
+  }
+  close(file);
+#endif
+}
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+  *this = std::move(other);
+}
+
+MappedFile & MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this == &other) return *this;
+  Close();
+  std::swap(data_, other.data_);
+  std::swap(size_, other.size_);
+#ifdef _WIN32
+  std::swap(mapping_, other.mapping_);
+#endif
+  return *this;
+}
+
+void MappedFile::Close() {
+  if (data_ == nullptr) return;
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+  CloseHandle(mapping_);
+  mapping_ = nullptr;
+#else
+  munmap(const_cast<unsigned char *>(data_), size_);
+#endif
+  data_ = nullptr;
+  size_ = 0;
+}
+
+FontAtlasCache::FontAtlasCache(std::string file_name)
+    : file_name_(std::move(file_name)) {}
+
+bool FontAtlasCache::Build(ImFontAtlas &atlas) {
+  const Clock::time_point start = Clock::now();
+  Release(atlas);
+  stats_ = FontCacheStats();
+
+  uint64_t key = 0;
+  if (!file_name_.empty()) {
+    key = AtlasKey(atlas);
+    stats_.key_ms = MillisecondsSince(start);
+  }
+
+  const Clock::time_point build_start = Clock::now();
+  stats_.cached = !file_name_.empty() && Restore(atlas, key);
+  bool built = stats_.cached;
+  if (!built) {
+    built = atlas.Build();
+    if (built && !file_name_.empty()) stats_.stored = Store(atlas, key);
+  }
+  stats_.build_ms = MillisecondsSince(build_start);
+
+  stats_.fonts = size_t(atlas.Fonts.Size);
+  for (const ImFont *font : atlas.Fonts) stats_.glyphs += size_t(font->Glyphs.Size);
+  stats_.width = atlas.TexWidth;
+  stats_.height = atlas.TexHeight;
+  stats_.total_ms = MillisecondsSince(start);
+  return built;
+}
+
+void FontAtlasCache::Release(ImFontAtlas &atlas) {
+  if (Contains(file_, atlas.TexPixelsAlpha8)) {
+    if (atlas.TexPixelsRGBA32 != nullptr) {
+      // The texture was made from the RGBA copy, which the atlas owns
+      atlas.TexPixelsAlpha8 = nullptr;
+    }
+    else {
+      // Nothing uploaded yet: the atlas gets pixels of its own
+      const size_t size = size_t(atlas.TexWidth) * size_t(atlas.TexHeight);
+      unsigned char *pixels = static_cast<unsigned char *>(ImGui::MemAlloc(size));
+      std::memcpy(pixels, atlas.TexPixelsAlpha8, size);
+      atlas.TexPixelsAlpha8 = pixels;
+    }
+  }
+  file_.Close();
+}
+
+void FontAtlasCache::Clear() {
+  if (file_name_.empty()) return;
+  std::error_code error;
+  std::filesystem::remove(file_name_, error);
+}
+
+bool FontAtlasCache::Restore(ImFontAtlas &atlas, uint64_t key) {
+  // A missing, short or foreign file is a miss; the whole layout is checked
+  // before the atlas is touched
+  MappedFile file(file_name_);
+  if (file.size() < sizeof(CacheHeader)) return false;
+  CacheHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kFileVersion || header.key != key ||
+      header.num_fonts != uint32_t(atlas.Fonts.Size) ||
+      header.glyph_size != sizeof(ImFontGlyph) ||
+      header.width <= 0 || header.height <= 0)
+    return false;
+
+  std::vector<FontRecord> records(header.num_fonts);
+  std::vector<size_t> glyph_offsets(header.num_fonts);
+  size_t offset = sizeof(header);
+  for (uint32_t font_idx = 0; font_idx < header.num_fonts; font_idx++) {
+    if (file.size() - offset < sizeof(FontRecord)) return false;
+    FontRecord &record = records[font_idx];
+    std::memcpy(&record, file.data() + offset, sizeof(record));
+    offset += sizeof(record);
+    if ((file.size() - offset) / sizeof(ImFontGlyph) < record.num_glyphs)
+      return false;
+    glyph_offsets[font_idx] = offset;
+    offset += record.num_glyphs * sizeof(ImFontGlyph);
+  }
+  const size_t num_pixels = size_t(header.width) * size_t(header.height);
+  if (file.size() - offset != num_pixels) return false;
+
+  // The ImFont objects stay: the pointers handed out by AddFont*() and the
+  // merged fonts' targets remain valid
+  for (uint32_t font_idx = 0; font_idx < header.num_fonts; font_idx++) {
+    const FontRecord &record = records[font_idx];
+    ImFont *font = atlas.Fonts[int(font_idx)];
+    font->ClearOutputData();
+    font->FontSize = record.size;
+    font->Ascent = record.ascent;
+    font->Descent = record.descent;
+    font->ContainerAtlas = &atlas;
+    font->Glyphs.resize(int(record.num_glyphs));
+    if (record.num_glyphs > 0) {
+      std::memcpy(font->Glyphs.Data, file.data() + glyph_offsets[font_idx],
+                  record.num_glyphs * sizeof(ImFontGlyph));
+    }
+    font->BuildLookupTable();
+  }
+  // Frees the font files AddFontFromFileTTF() read
+  atlas.ClearInputData();
+  atlas.ClearTexData();
+  atlas.TexWidth = header.width;
+  atlas.TexHeight = header.height;
+  atlas.TexUvScale = ImVec2(header.uv_scale[0], header.uv_scale[1]);
+  atlas.TexUvWhitePixel = ImVec2(header.uv_white_pixel[0],
+                                 header.uv_white_pixel[1]);
+  // Until Release(); ImGui only reads it to make the texture
+  atlas.TexPixelsAlpha8 = const_cast<unsigned char *>(file.data() + offset);
+  file_ = std::move(file);
+  return true;
+}
+
+bool FontAtlasCache::Store(const ImFontAtlas &atlas, uint64_t key) const {
+  if (atlas.TexPixelsAlpha8 == nullptr) return false;
+  // Written aside and renamed, so a concurrent start never maps half a file
+  const std::string temporary = file_name_ + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    CacheHeader header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFileVersion;
+    header.key = key;
+    header.num_fonts = uint32_t(atlas.Fonts.Size);
+    header.glyph_size = uint32_t(sizeof(ImFontGlyph));
+    header.width = atlas.TexWidth;
+    header.height = atlas.TexHeight;
+    header.uv_scale[0] = atlas.TexUvScale.x;
+    header.uv_scale[1] = atlas.TexUvScale.y;
+    header.uv_white_pixel[0] = atlas.TexUvWhitePixel.x;
+    header.uv_white_pixel[1] = atlas.TexUvWhitePixel.y;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const ImFont *font : atlas.Fonts) {
+      FontRecord record;
+      record.size = font->FontSize;
+      record.ascent = font->Ascent;
+      record.descent = font->Descent;
+      record.num_glyphs = uint32_t(font->Glyphs.Size);
+      out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+      out.write(reinterpret_cast<const char *>(font->Glyphs.Data),
+                font->Glyphs.size_in_bytes());
+    }
+    out.write(reinterpret_cast<const char *>(atlas.TexPixelsAlpha8),
+              std::streamsize(atlas.TexWidth) * atlas.TexHeight);
+    if (!out) return false;
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, file_name_, error);
+  if (error) std::filesystem::remove(temporary, error);
+  return !error;
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -0,0 +1,351 @@
+#include "vktuto_geometry_jobs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <utility>
+
+#include "vktuto_mesh_io.h"
+#include "vktuto_nurbs.h"
+
+namespace vktuto {
+
+inline namespace algorithm {
+
+namespace {
+
+// u-rows per surface work item and samples per curve check for newer
+// results; small enough that an outdated job stops within a fraction of a
+// millisecond
+constexpr unsigned int kRowsPerItem = 8;
+constexpr unsigned int kSamplesPerCheck = 64;
+
+// Buffers kept for later jobs beyond the ones in use
+constexpr size_t kMaxSpare = 2;
+
+// Tile size of an export: small tiles report progress and notice a cancel
+// often
+constexpr size_t kExportTileBytes = size_t(4) << 20;
+
+// Thrown through TessellateSurfaceStreaming() to stop an outdated export
+struct ExportCancelled {};
+
+// Forwards the tiles of an export to the file and counts its rows
+class ExportSink : public MeshSink {
+ public:
+  ExportSink(MeshSink &file, unsigned int num_v,
+             std::atomic<unsigned int> &rows, std::function<bool()> outdated)
+      : file_(file), num_v_(num_v), rows_(rows),
+        outdated_(std::move(outdated)) {}
+
+  void Begin(size_t num_vertices, size_t num_indices,
+             bool has_normals) override {
+    file_.Begin(num_vertices, num_indices, has_normals);
+  }
+  void AddVertices(size_t first_vertex, const glm::vec3 *positions,
+                   const glm::vec3 *normals, size_t count) override {
+    if (outdated_()) throw ExportCancelled();
+    file_.AddVertices(first_vertex, positions, normals, count);
+    rows_ = unsigned((first_vertex + count) / num_v_);
+  }
+  void AddTriangles(const uint32_t *indices, size_t num_indices) override {
+    file_.AddTriangles(indices, num_indices);
+  }
+  void End() override { file_.End(); }
+
+ private:
+  MeshSink &file_;
+  unsigned int num_v_;
+  std::atomic<unsigned int> &rows_;
+  std::function<bool()> outdated_;
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+template <typename Geometry>
+uint64_t GeometryWorker::Channel<Geometry>::Next() {
+  const uint64_t version = next++;
+  latest = version;
+  return version;
+}
+
+template <typename Geometry>
+void GeometryWorker::Channel<Geometry>::Cancel() {
+  // A version no job has: everything in flight is outdated
+  const uint64_t version = Next();
+  std::lock_guard<std::mutex> lock(mutex);
+  waiting = nullptr;
+  published = version;
+  if (ready && spare.size() < kMaxSpare) spare.push_back(std::move(ready));
+  ready.reset();
+}
+
+template <typename Geometry>
+bool GeometryWorker::Channel<Geometry>::Busy() const {
+  return published < latest;
+}
+
+template <typename Geometry>
+std::unique_ptr<Geometry> GeometryWorker::Channel<Geometry>::Acquire() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!spare.empty()) {
+      std::unique_ptr<Geometry> geometry = std::move(spare.back());
+      spare.pop_back();
+      return geometry;
+    }
+  }
+  return std::make_unique<Geometry>();
+}
+
+template <typename Geometry>
+bool GeometryWorker::Channel<Geometry>::Publish(
+    std::unique_ptr<Geometry> geometry) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (geometry->version <= published) {
+    if (spare.size() < kMaxSpare) spare.push_back(std::move(geometry));
+    return false;
+  }
+  published = geometry->version;
+  std::swap(ready, geometry);
+  if (geometry && spare.size() < kMaxSpare) spare.push_back(std::move(geometry));
+  return true;
+}
+
+template <typename Geometry>
+bool GeometryWorker::Channel<Geometry>::Swap(Geometry &geometry) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!ready) return false;
+  std::swap(*ready, geometry);
+  if (spare.size() < kMaxSpare) spare.push_back(std::move(ready));
+  ready.reset();
+  return true;
+}
+
+template <typename Geometry>
+void GeometryWorker::Schedule(Channel<Geometry> &channel,
+                              std::function<void()> job) {
+  std::lock_guard<std::mutex> lock(channel.mutex);
+  if (channel.waiting) cancelled_++;
+  channel.waiting = std::move(job);
+  if (channel.running) return;
+  channel.running = true;
+  pool_.Submit([this, &channel] { Drain(channel); });
+}
+
+template <typename Geometry>
+void GeometryWorker::Drain(Channel<Geometry> &channel) {
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::lock_guard<std::mutex> lock(channel.mutex);
+      if (!channel.waiting) {
+        channel.running = false;
+        return;
+      }
+      job.swap(channel.waiting);
+    }
+    job();
+  }
+}
+
+GeometryWorker::GeometryWorker(unsigned int num_threads)
+    : pool_(num_threads) {}
+
+GeometryWorker::~GeometryWorker() {
+  // A running job stops at its next check
+  CancelSurface();
+  CancelCurve();
+  CancelExport();
+}
+
+uint64_t GeometryWorker::SubmitSurface(
+    const nurbs::RationalSurface3f &surface,
+    unsigned int num_u, unsigned int num_v) {
+  const uint64_t version = surfaces_.Next();
+  auto copy = std::make_shared<const nurbs::RationalSurface3f>(surface);
+  num_u = std::max(2u, num_u);
+  num_v = std::max(2u, num_v);
+  Schedule(surfaces_, [this, version, copy, num_u, num_v] {
+    RunSurface(version, copy, num_u, num_v);
+  });
+  return version;
+}
+
+uint64_t GeometryWorker::SubmitCurve(const nurbs::RationalCurve3f &curve,
+                                     unsigned int num_samples) {
+  const uint64_t version = curves_.Next();
+  auto copy = std::make_shared<const nurbs::RationalCurve3f>(curve);
+  num_samples = std::max(2u, num_samples);
+  Schedule(curves_, [this, version, copy, num_samples] {
+    RunCurve(version, copy, num_samples);
+  });
+  return version;
+}
+
+uint64_t GeometryWorker::SubmitExport(
+    const nurbs::RationalSurface3f &surface,
+    unsigned int num_u, unsigned int num_v, const std::string &file_name) {
+  const uint64_t version = exports_.Next();
+  auto copy = std::make_shared<const nurbs::RationalSurface3f>(surface);
+  Schedule(exports_, [this, version, copy, num_u, num_v, file_name] {
+    RunExport(version, copy, num_u, num_v, file_name);
+  });
+  return version;
+}
+
+void GeometryWorker::CancelSurface() {
+  surfaces_.Cancel();
+}
+
+void GeometryWorker::CancelCurve() {
+  curves_.Cancel();
+}
+
+void GeometryWorker::CancelExport() {
+  exports_.Cancel();
+}
+
+bool GeometryWorker::SurfaceBusy() const {
+  return surfaces_.Busy();
+}
+
+bool GeometryWorker::CurveBusy() const {
+  return curves_.Busy();
+}
+
+bool GeometryWorker::ExportBusy() const {
+  return exports_.Busy();
+}
+
+float GeometryWorker::ExportProgress() const {
+  const unsigned int num_u = export_num_u_;
+  return num_u > 0 ? float(export_rows_) / num_u : 0.0f;
+}
+
+bool GeometryWorker::SwapSurface(SurfaceGeometry &geometry) {
+  return surfaces_.Swap(geometry);
+}
+
+bool GeometryWorker::SwapCurve(CurveGeometry &geometry) {
+  return curves_.Swap(geometry);
+}
+
+bool GeometryWorker::SwapExport(ExportResult &result) {
+  return exports_.Swap(result);
+}
+
+void GeometryWorker::RunSurface(
+    uint64_t version,
+    const std::shared_ptr<const nurbs::RationalSurface3f> &surface,
+    unsigned int num_u, unsigned int num_v) {
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<SurfaceGeometry> geometry = surfaces_.Acquire();
+  geometry->version = version;
+  geometry->num_u = num_u;
+  geometry->num_v = num_v;
+  geometry->error.clear();
+  try {
+    // One work item per band of rows; the other workers help out
+    SurfaceEvaluator evaluator(*surface);
+    geometry->positions.resize(size_t(num_u) * num_v);
+    geometry->normals.resize(geometry->positions.size());
+    const size_t num_items = (num_u + kRowsPerItem - 1) / kRowsPerItem;
+    pool_.ParallelFor(num_items, [&](size_t item_idx) {
+      if (surfaces_.IsOutdated(version)) return;
+      const unsigned int row_begin = unsigned(item_idx) * kRowsPerItem;
+      const unsigned int row_end = std::min(row_begin + kRowsPerItem, num_u);
+      TessellateSurfaceRows(evaluator, num_u, num_v, row_begin, row_end,
+                            geometry->positions.data(),
+                            geometry->normals.data());
+    });
+  }
+  catch (const std::exception &except) {
+    geometry->error = except.what();
+  }
+  geometry->seconds = SecondsSince(start);
+  if (!surfaces_.Publish(std::move(geometry))) cancelled_++;
+}
+
+void GeometryWorker::RunCurve(
+    uint64_t version,
+    const std::shared_ptr<const nurbs::RationalCurve3f> &curve,
+    unsigned int num_samples) {
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<CurveGeometry> geometry = curves_.Acquire();
+  geometry->version = version;
+  geometry->error.clear();
+  geometry->points.resize(num_samples);
+  geometry->tangents.resize(num_samples);
+  geometry->normals.resize(num_samples);
+  geometry->binormals.resize(num_samples);
+  try {
+    const float min_u = curve->knots[curve->degree];
+    const float max_u = curve->knots[curve->knots.size() - curve->degree - 1];
+    unsigned int idx = 0;
+    for (; idx < num_samples; idx++) {
+      if (idx % kSamplesPerCheck == 0 && curves_.IsOutdated(version)) break;
+      const float para = min_u + (max_u - min_u) * idx / (num_samples - 1);
+      std::vector<glm::vec3> ders = nurbs::CurveDerivatives(*curve, 2, para);
+      const glm::vec3 &c1 = ders.at(1), &c2 = ders.at(2);
+      geometry->points[idx] = ders.at(0);
+      geometry->tangents[idx] = glm::normalize(c1);
+
+      glm::vec3 binormal = glm::cross(c1, c2);
+      geometry->binormals[idx] = glm::normalize(binormal);
+      float curvature = glm::length(binormal) / glm::pow(glm::length(c1), 3.0f);
+      geometry->normals[idx] =
+          curvature * glm::normalize(glm::cross(binormal, c1));
+    }
+    EvaluationStats::AddCurve(idx);
+  }
+  catch (const std::exception &except) {
+    geometry->error = except.what();
+  }
+  geometry->seconds = SecondsSince(start);
+  if (!curves_.Publish(std::move(geometry))) cancelled_++;
+}
+
+void GeometryWorker::RunExport(
+    uint64_t version,
+    const std::shared_ptr<const nurbs::RationalSurface3f> &surface,
+    unsigned int num_u, unsigned int num_v, const std::string &file_name) {
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<ExportResult> result = exports_.Acquire();
+  result->version = version;
+  result->file_name = file_name;
+  result->num_u = num_u;
+  result->num_v = num_v;
+  result->error.clear();
+  export_rows_ = 0;
+  export_num_u_ = num_u;
+  try {
+    PlyStreamWriter writer(file_name);
+    ExportSink sink(writer, num_v, export_rows_, [this, version] {
+      return exports_.IsOutdated(version);
+    });
+    StreamingTessellationOptions options;
+    options.memory_budget = kExportTileBytes;
+    options.normals = true;
+    TessellateSurfaceStreaming(*surface, num_u, num_v, sink, options);
+  }
+  catch (const ExportCancelled &) {
+    // Half a file is of no use
+    std::remove(file_name.c_str());
+  }
+  catch (const std::exception &except) {
+    result->error = except.what();
+  }
+  result->seconds = SecondsSince(start);
+  if (!exports_.Publish(std::move(result))) cancelled_++;
+}
+
+} // inline namespace algorithm
+
+} // namespace vktuto
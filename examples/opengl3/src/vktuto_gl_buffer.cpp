@@ -0,0 +1,235 @@
+#include "vktuto_gl_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+// Configuration file (edit vktuto_config.h or define VKTUTO_USER_CONFIG to
+// set your own filename)
+#ifdef VKTUTO_USER_CONFIG
+#include VKTUTO_USER_CONFIG
+#endif
+#if !defined(VKTUTO_DISABLE_INCLUDE_CONFIG_H) || \
+     defined(VKTUTO_INCLUDE_CONFIG_H)
+#include "vktuto_config.h"
+#endif
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+namespace {
+
+bool HasExtension(const char *name) {
+  GLint num_extensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+  for (GLint idx = 0; idx < num_extensions; idx++) {
+    const char *ext = reinterpret_cast<const char *>(
+        glGetStringi(GL_EXTENSIONS, idx));
+    if (ext != nullptr && std::strcmp(ext, name) == 0) return true;
+  }
+  return false;
+}
+
+bool AtLeast(const GLCapabilities &caps, int major, int minor) {
+  return caps.major > major || (caps.major == major && caps.minor >= minor);
+}
+
+inline size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+const GLCapabilities & GLCapabilities::Get() {
+  static const GLCapabilities caps = [] {
+    GLCapabilities caps;
+    glGetIntegerv(GL_MAJOR_VERSION, &caps.major);
+    glGetIntegerv(GL_MINOR_VERSION, &caps.minor);
+    caps.primitive_restart = AtLeast(caps, 3, 1);
+    caps.sync = AtLeast(caps, 3, 2) || HasExtension("GL_ARB_sync");
+    caps.buffer_storage = AtLeast(caps, 4, 4) ||
+                          HasExtension("GL_ARB_buffer_storage");
+    caps.timer_query = AtLeast(caps, 3, 3) ||
+                       HasExtension("GL_ARB_timer_query");
+    caps.program_binary = AtLeast(caps, 4, 1) ||
+                          HasExtension("GL_ARB_get_program_binary");
+    return caps;
+  }();
+  return caps;
+}
+
+UploadStats & UploadStats::Global() {
+  static UploadStats stats;
+  return stats;
+}
+
+StreamBuffer::StreamBuffer(GLenum target, size_t capacity)
+    : target_(target) {
+  Allocate(AlignUp(std::max<size_t>(capacity, VKTUTO_STREAM_BUFFER_MIN_SIZE),
+                   kAlignment));
+}
+
+StreamBuffer::~StreamBuffer() {
+  Release();
+}
+
+void StreamBuffer::Allocate(size_t capacity) {
+  Release();
+  capacity_ = capacity;
+  head_ = written_ = unfenced_ = 0;
+  live_offset_ = live_size_ = 0;
+
+  const GLCapabilities &caps = GLCapabilities::Get();
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(target_, buffer_);
+#if VKTUTO_STREAM_BUFFER_PERSISTENT
+  if (caps.buffer_storage && caps.sync) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                       GL_MAP_COHERENT_BIT;
+    glBufferStorage(target_, capacity_, nullptr, flags);
+    mapped_ = static_cast<char *>(
+        glMapBufferRange(target_, 0, capacity_, flags));
+    if (mapped_ != nullptr) return;
+    // Mapping refused, start over with mutable storage
+    glDeleteBuffers(1, &buffer_);
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(target_, buffer_);
+  }
+#endif
+  glBufferData(target_, capacity_, nullptr, GL_STREAM_DRAW);
+}
+
+void StreamBuffer::Release() {
+  for (auto &region : regions_) glDeleteSync(region.sync);
+  regions_.clear();
+  if (buffer_ != 0) {
+    if (mapped_ != nullptr) {
+      glBindBuffer(target_, buffer_);
+      glUnmapBuffer(target_);
+      mapped_ = nullptr;
+    }
+    glDeleteBuffers(1, &buffer_);
+    buffer_ = 0;
+  }
+}
+
+void StreamBuffer::WaitRegions(size_t begin, size_t end) {
+  if (!persistent()) return;
+  // Draws issued since the last fence may still read the target bytes;
+  // reserved bytes nobody wrote yet were never handed to the GPU
+  if (begin < written_ && unfenced_ < end) Fence();
+
+  // Fences signal in order, so waiting on the newest overlapping region
+  // retires every region before it as well
+  size_t count = 0;
+  for (size_t idx = 0; idx < regions_.size(); idx++) {
+    if (regions_[idx].begin < end && begin < regions_[idx].end)
+      count = idx + 1;
+  }
+  if (count == 0) return;
+
+  GLsync sync = regions_[count - 1].sync;
+  if (glClientWaitSync(sync, 0, 0) == GL_TIMEOUT_EXPIRED) {
+    auto start = std::chrono::steady_clock::now();
+    while (glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT,
+                            1000000) == GL_TIMEOUT_EXPIRED) {
+    }
+    UploadStats &stats = UploadStats::Global();
+    stats.waits++;
+    stats.wait_seconds += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+  }
+  for (size_t idx = 0; idx < count; idx++) glDeleteSync(regions_[idx].sync);
+  regions_.erase(regions_.begin(), regions_.begin() + count);
+}
+
+size_t StreamBuffer::Upload(const void *data, size_t size) {
+  const size_t offset = Reserve(size);
+  if (size > 0) {
+    if (persistent()) {
+      std::memcpy(mapped_ + offset, data, size);
+      written_ = offset + size;
+    }
+    else {
+      void *dst = glMapBufferRange(target_, offset, size,
+                                   GL_MAP_WRITE_BIT |
+                                   GL_MAP_INVALIDATE_RANGE_BIT |
+                                   GL_MAP_UNSYNCHRONIZED_BIT);
+      if (dst != nullptr) {
+        std::memcpy(dst, data, size);
+        glUnmapBuffer(target_);
+      }
+      else {
+        glBufferSubData(target_, offset, size, data);
+      }
+    }
+  }
+  UploadStats &stats = UploadStats::Global();
+  stats.bytes += size;
+  stats.uploads++;
+  return offset;
+}
+
+size_t StreamBuffer::Reserve(size_t size) {
+  UploadStats &stats = UploadStats::Global();
+  // Keep room for three uploads of this size in flight
+  if (size * 3 > capacity_) {
+    size_t capacity = capacity_;
+    while (size * 3 > capacity) capacity *= 2;
+    Allocate(capacity);
+  }
+
+  size_t offset = AlignUp(head_, kAlignment);
+  glBindBuffer(target_, buffer_);
+  if (offset + size > capacity_) {
+    // Wrap around
+    offset = 0;
+    stats.orphans++;
+    if (persistent()) {
+      Fence();
+    }
+    else {
+      glBufferData(target_, capacity_, nullptr, GL_STREAM_DRAW);
+    }
+    head_ = written_ = unfenced_ = 0;
+  }
+
+  // Wait for the draws still reading an older upload here before the
+  // bytes become part of the live one
+  if (persistent() && size > 0) WaitRegions(offset, offset + size);
+  head_ = offset + size;
+  live_offset_ = offset;
+  live_size_ = size;
+  return offset;
+}
+
+void StreamBuffer::UpdateRange(size_t offset, const void *data, size_t size) {
+  if (size == 0 || offset + size > live_size_) return;
+  size_t begin = live_offset_ + offset;
+  if (persistent()) {
+    WaitRegions(begin, begin + size);
+    std::memcpy(mapped_ + begin, data, size);
+    written_ = std::max(written_, begin + size);
+  }
+  else {
+    // The driver copies or waits as needed
+    glBindBuffer(target_, buffer_);
+    glBufferSubData(target_, begin, size, data);
+  }
+  UploadStats &stats = UploadStats::Global();
+  stats.bytes += size;
+  stats.uploads++;
+}
+
+void StreamBuffer::Fence() {
+  if (!persistent() || unfenced_ >= written_) return;
+  GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  regions_.push_back({ unfenced_, written_, sync });
+  unfenced_ = written_;
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -0,0 +1,136 @@
+#include "vktuto_glyph_set.h"
+
+#include <cstring>
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+namespace {
+
+// Length of the UTF-8 sequence at 'text' and its codepoint; a malformed or
+// cut off sequence is one byte long, with codepoint 0
+size_t DecodeUtf8(const unsigned char *text, const unsigned char *end,
+                  unsigned int &codepoint) {
+  codepoint = 0;
+  const unsigned char lead = text[0];
+  size_t length = 0;
+  unsigned int min_value = 0;
+  if (lead < 0x80) {
+    codepoint = lead;
+    return 1;
+  }
+  else if ((lead & 0xE0) == 0xC0) {
+    length = 2;
+    min_value = 0x80;
+    codepoint = lead & 0x1F;
+  }
+  else if ((lead & 0xF0) == 0xE0) {
+    length = 3;
+    min_value = 0x800;
+    codepoint = lead & 0x0F;
+  }
+  else if ((lead & 0xF8) == 0xF0) {
+    length = 4;
+    min_value = 0x10000;
+    codepoint = lead & 0x07;
+  }
+  else {
+    return 1;
+  }
+  if (size_t(end - text) < length) {
+    codepoint = 0;
+    return 1;
+  }
+  for (size_t idx = 1; idx < length; idx++) {
+    if ((text[idx] & 0xC0) != 0x80) {
+      codepoint = 0;
+      return 1;
+    }
+    codepoint = (codepoint << 6) | (text[idx] & 0x3F);
+  }
+  // Overlong forms and surrogates
+  if (codepoint < min_value || (codepoint >= 0xD800 && codepoint < 0xE000)) {
+    codepoint = 0;
+    return 1;
+  }
+  return length;
+}
+
+} // namespace
+
+GlyphSet::GlyphSet() : bits_(kNumCodepoints / 64, 0) {}
+
+size_t GlyphSet::AddRanges(const ImWchar *ranges) {
+  size_t added = 0;
+  for (; ranges != nullptr && ranges[0] != 0; ranges += 2) {
+    for (unsigned int codepoint = ranges[0]; codepoint <= ranges[1];
+         codepoint++)
+      added += Add(codepoint) ? 1 : 0;
+  }
+  return added;
+}
+
+bool GlyphSet::Add(unsigned int codepoint) {
+  if (codepoint < 0x20 || codepoint >= kNumCodepoints ||
+      (codepoint >= 0x7F && codepoint < 0xA0))
+    return false;
+  uint64_t &word = bits_[codepoint / 64];
+  const uint64_t bit = uint64_t(1) << (codepoint % 64);
+  if ((word & bit) != 0) return false;
+  word |= bit;
+  count_++;
+  return true;
+}
+
+size_t GlyphSet::AddText(const char *text, const char *text_end) {
+  if (text == nullptr) return 0;
+  if (text_end == nullptr) text_end = text + std::strlen(text);
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(text);
+  const unsigned char *end = reinterpret_cast<const unsigned char *>(text_end);
+  size_t added = 0;
+  while (bytes < end) {
+    // Runs of ASCII, the common case, are one test per character
+    if (*bytes < 0x80) {
+      added += Add(*bytes++) ? 1 : 0;
+      continue;
+    }
+    unsigned int codepoint;
+    bytes += DecodeUtf8(bytes, end, codepoint);
+    added += Add(codepoint) ? 1 : 0;
+  }
+  return added;
+}
+
+bool GlyphSet::Contains(unsigned int codepoint) const noexcept {
+  return codepoint < kNumCodepoints &&
+         (bits_[codepoint / 64] & (uint64_t(1) << (codepoint % 64))) != 0;
+}
+
+std::vector<ImWchar> GlyphSet::BuildRanges() const {
+  std::vector<ImWchar> ranges;
+  unsigned int codepoint = 0;
+  while (codepoint < kNumCodepoints) {
+    // Whole empty words at once
+    if (bits_[codepoint / 64] == 0) {
+      codepoint = (codepoint / 64 + 1) * 64;
+      continue;
+    }
+    if (!Contains(codepoint)) {
+      codepoint++;
+      continue;
+    }
+    const unsigned int first = codepoint;
+    while (codepoint + 1 < kNumCodepoints && Contains(codepoint + 1))
+      codepoint++;
+    ranges.push_back(ImWchar(first));
+    ranges.push_back(ImWchar(codepoint));
+    codepoint++;
+  }
+  ranges.push_back(0);
+  return ranges;
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
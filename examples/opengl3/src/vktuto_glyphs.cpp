@@ -0,0 +1,166 @@
+#include "vktuto_glyphs.h"
+
+#include <algorithm>
+
+#include "glm/gtc/type_ptr.hpp"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+namespace {
+
+// Unit-sized meshes in the glyph frame, +Z being the arrow direction
+struct BaseMesh {
+  std::vector<glm::vec3> vertices;
+  std::vector<GLushort>  indices;
+  GLenum mode;
+  bool   screen_sized;
+};
+
+const BaseMesh & GetBaseMesh(GlyphShape shape) {
+  static const BaseMesh marker = {
+    { glm::vec3( 0.5f, 0.0f, 0.0f), glm::vec3(-0.5f, 0.0f, 0.0f),
+      glm::vec3( 0.0f, 0.5f, 0.0f), glm::vec3( 0.0f,-0.5f, 0.0f),
+      glm::vec3( 0.0f, 0.0f, 0.5f), glm::vec3( 0.0f, 0.0f,-0.5f) },
+    { 0, 2, 4,  2, 1, 4,  1, 3, 4,  3, 0, 4,
+      2, 0, 5,  1, 2, 5,  3, 1, 5,  0, 3, 5 },
+    GL_TRIANGLES, true
+  };
+  static const BaseMesh arrow = {
+    { glm::vec3( 0.0f,  0.0f,  0.0f), glm::vec3( 0.0f,  0.0f,  1.0f),
+      glm::vec3( 0.06f, 0.0f,  0.85f), glm::vec3(-0.06f, 0.0f,  0.85f),
+      glm::vec3( 0.0f,  0.06f, 0.85f), glm::vec3( 0.0f, -0.06f, 0.85f) },
+    { 0, 1,  1, 2,  1, 3,  1, 4,  1, 5 },
+    GL_LINES, false
+  };
+  return shape == GlyphShape::kMarker ? marker : arrow;
+}
+
+void PackColor(const glm::vec3 &color, uint8_t out[4]) {
+  for (int channel = 0; channel < 3; channel++) {
+    out[channel] = static_cast<uint8_t>(
+        std::clamp(color[channel], 0.0f, 1.0f) * 255.0f + 0.5f);
+  }
+  out[3] = 255;
+}
+
+} // namespace
+
+GlyphInstance MakeMarker(const glm::vec3 &position, float pixels,
+                         const glm::vec3 &color) {
+  GlyphInstance glyph;
+  glyph.position = position;
+  glyph.scale = pixels;
+  glyph.direction = glm::vec3(0.0f);
+  PackColor(color, glyph.color);
+  return glyph;
+}
+
+GlyphInstance MakeArrow(const glm::vec3 &origin, const glm::vec3 &vector,
+                        const glm::vec3 &color) {
+  GlyphInstance glyph;
+  glyph.position = origin;
+  glyph.scale = 1.0f;
+  glyph.direction = vector;
+  PackColor(color, glyph.color);
+  return glyph;
+}
+
+GlyphRenderer::GlyphRenderer(GLuint program) : program_(program) {
+  uniform_.mvp = glGetUniformLocation(program_, "MVP");
+  uniform_.screen_sized = glGetUniformLocation(program_, "screenSized");
+  uniform_.units_per_pixel = glGetUniformLocation(program_, "unitsPerPixel");
+  instance_buffer_ = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, 0);
+
+  for (size_t idx = 0; idx < kNumGlyphShapes; idx++) {
+    const BaseMesh &mesh = GetBaseMesh(static_cast<GlyphShape>(idx));
+    ShapeBuffers &shape = shapes_[idx];
+    shape.mode = mesh.mode;
+    shape.num_indices = static_cast<GLsizei>(mesh.indices.size());
+    shape.screen_sized = mesh.screen_sized;
+
+    glGenVertexArrays(1, &shape.vao);
+    glBindVertexArray(shape.vao);
+    glGenBuffers(1, &shape.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, shape.vbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(glm::vec3),
+                 mesh.vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+    glEnableVertexAttribArray(0);
+    glGenBuffers(1, &shape.ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shape.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 mesh.indices.size() * sizeof(GLushort), mesh.indices.data(),
+                 GL_STATIC_DRAW);
+    // Instance attributes advance once per glyph
+    for (GLuint attribute = 1; attribute <= 3; attribute++)
+      glVertexAttribDivisor(attribute, 1);
+  }
+  glBindVertexArray(0);
+}
+
+GlyphRenderer::~GlyphRenderer() {
+  for (ShapeBuffers &shape : shapes_) {
+    glDeleteVertexArrays(1, &shape.vao);
+    glDeleteBuffers(1, &shape.vbo);
+    glDeleteBuffers(1, &shape.ibo);
+  }
+  glDeleteProgram(program_);
+}
+
+size_t GlyphRenderer::NumInstances() const noexcept {
+  size_t count = 0;
+  for (const auto &instances : instances_) count += instances.size();
+  return count;
+}
+
+void GlyphRenderer::Upload() {
+  staging_.clear();
+  staging_.reserve(NumInstances());
+  for (size_t idx = 0; idx < kNumGlyphShapes; idx++) {
+    shapes_[idx].first = staging_.size();
+    shapes_[idx].count = instances_[idx].size();
+    staging_.insert(staging_.end(), instances_[idx].begin(),
+                    instances_[idx].end());
+  }
+  instance_buffer_->Upload(staging_.data(),
+                           staging_.size() * sizeof(GlyphInstance));
+
+  // The upload moved, so the instance pointers of every shape follow
+  const GLsizei stride = sizeof(GlyphInstance);
+  for (ShapeBuffers &shape : shapes_) {
+    const size_t base = instance_buffer_->offset() +
+                        shape.first * sizeof(GlyphInstance);
+    glBindVertexArray(shape.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_->id());
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride,
+        reinterpret_cast<const void *>(base + offsetof(GlyphInstance, position)));
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride,
+        reinterpret_cast<const void *>(base + offsetof(GlyphInstance, direction)));
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+        reinterpret_cast<const void *>(base + offsetof(GlyphInstance, color)));
+    for (GLuint attribute = 1; attribute <= 3; attribute++)
+      glEnableVertexAttribArray(attribute);
+  }
+  glBindVertexArray(0);
+}
+
+size_t GlyphRenderer::Draw(GlyphShape shape_id, const glm::mat4 &mvp,
+                           float units_per_pixel) {
+  const ShapeBuffers &shape = shapes_[static_cast<size_t>(shape_id)];
+  if (shape.count == 0) return 0;
+  glUseProgram(program_);
+  glUniformMatrix4fv(uniform_.mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+  glUniform1i(uniform_.screen_sized, shape.screen_sized);
+  glUniform1f(uniform_.units_per_pixel, units_per_pixel);
+  glBindVertexArray(shape.vao);
+  glDrawElementsInstanced(shape.mode, shape.num_indices, GL_UNSIGNED_SHORT,
+                          NULL, static_cast<GLsizei>(shape.count));
+  glBindVertexArray(0);
+  return shape.mode == GL_TRIANGLES ? shape.count * shape.num_indices / 3 : 0;
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
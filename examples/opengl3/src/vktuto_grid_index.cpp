@@ -0,0 +1,132 @@
+#include "vktuto_grid_index.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "vktuto_gl_buffer.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+namespace {
+
+inline uint64_t GridKey(unsigned int num_u, unsigned int num_v,
+                        GridTopology topology) {
+  return (uint64_t(num_u) << 34) | (uint64_t(num_v) << 2) |
+         static_cast<uint64_t>(topology);
+}
+
+template <typename Index>
+void UploadGridIndices(GridIndexBuffer &grid) {
+  std::vector<Index> indices(grid.count);
+  BuildGridIndices(grid.num_u, grid.num_v, grid.topology, indices.data());
+  grid.bytes = indices.size() * sizeof(Index);
+  // The copy target leaves the element binding of the bound VAO alone
+  glBindBuffer(GL_COPY_WRITE_BUFFER, grid.ibo);
+  glBufferData(GL_COPY_WRITE_BUFFER, grid.bytes, indices.data(),
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+} // namespace
+
+size_t GridIndexCount(unsigned int num_u, unsigned int num_v,
+                      GridTopology topology) {
+  if (num_u < 2 || num_v < 2) return 0;
+  if (topology == GridTopology::kTriangleStrip)
+    return size_t(num_u - 1) * (2 * size_t(num_v) + 1) - 1;
+  return 6 * size_t(num_u - 1) * (num_v - 1);
+}
+
+const char * GridTopologyName(GridTopology topology) {
+  switch (topology) {
+    case GridTopology::kTriangleStrip:     return "strips";
+    case GridTopology::kTiledTriangles:    return "tiled";
+    case GridTopology::kHilbertTriangles:  return "Hilbert";
+    default:                               return "rows";
+  }
+}
+
+VertexCacheStats SimulateGridCache(unsigned int num_u, unsigned int num_v,
+                                   GridTopology topology,
+                                   unsigned int cache_size) {
+  std::vector<uint32_t> indices(GridIndexCount(num_u, num_v, topology));
+  BuildGridIndices(num_u, num_v, topology, indices.data());
+  if (topology != GridTopology::kTriangleStrip) {
+    return SimulateVertexCache(indices.data(), indices.size(),
+                               size_t(num_u) * num_v, cache_size);
+  }
+  // A FIFO cache only sees the order vertices are referenced in
+  indices.erase(std::remove(indices.begin(), indices.end(), ~0u),
+                indices.end());
+  VertexCacheStats stats = SimulateVertexCache(
+      indices.data(), indices.size(), size_t(num_u) * num_v, cache_size);
+  stats.num_triangles = 2 * size_t(num_u - 1) * (num_v - 1);
+  stats.acmr = float(stats.num_transformed) / float(stats.num_triangles);
+  return stats;
+}
+
+GridIndexBuffer::~GridIndexBuffer() {
+  if (ibo != 0) glDeleteBuffers(1, &ibo);
+}
+
+GridIndexCache::GridIndexCache(size_t max_entries)
+    : max_entries_(max_entries > 0 ? max_entries : 1) {}
+
+std::shared_ptr<const GridIndexBuffer> GridIndexCache::Get(
+    unsigned int num_u, unsigned int num_v, GridTopology topology) {
+  if (num_u < 2 || num_v < 2) return nullptr;
+  const GLCapabilities &caps = GLCapabilities::Get();
+  if (topology == GridTopology::kTriangleStrip && !caps.primitive_restart)
+    topology = GridTopology::kTriangles;
+
+  uint64_t key = GridKey(num_u, num_v, topology);
+  auto found = entries_.find(key);
+  if (found != entries_.end()) {
+    hits_++;
+    found->second.last_use = ++clock_;
+    return found->second.buffer;
+  }
+
+  misses_++;
+  if (entries_.size() >= max_entries_) {
+    // Evict the least recently used grid; drawables still holding it keep
+    // their buffer alive
+    auto oldest = entries_.begin();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (it->second.last_use < oldest->second.last_use) oldest = it;
+    }
+    entries_.erase(oldest);
+  }
+  auto buffer = Build(num_u, num_v, topology);
+  entries_[key] = { buffer, ++clock_ };
+  return buffer;
+}
+
+std::shared_ptr<const GridIndexBuffer> GridIndexCache::Build(
+    unsigned int num_u, unsigned int num_v, GridTopology topology) const {
+  auto grid = std::make_shared<GridIndexBuffer>();
+  grid->num_u = num_u;
+  grid->num_v = num_v;
+  grid->topology = topology;
+  grid->mode = topology == GridTopology::kTriangleStrip ? GL_TRIANGLE_STRIP
+                                                        : GL_TRIANGLES;
+  grid->count = static_cast<GLsizei>(GridIndexCount(num_u, num_v, topology));
+  glGenBuffers(1, &grid->ibo);
+  if (GridFitsUint16(num_u, num_v)) {
+    grid->type = GL_UNSIGNED_SHORT;
+    grid->restart_index = 0xFFFF;
+    UploadGridIndices<uint16_t>(*grid);
+  }
+  else {
+    grid->type = GL_UNSIGNED_INT;
+    grid->restart_index = 0xFFFFFFFF;
+    UploadGridIndices<uint32_t>(*grid);
+  }
+  return grid;
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
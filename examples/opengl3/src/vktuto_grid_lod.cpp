@@ -0,0 +1,369 @@
+#include "vktuto_grid_lod.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+namespace {
+
+// A patch coarsens once the next level's error is below this share of the
+// tolerance, and refines as soon as its level exceeds the tolerance
+constexpr float kCoarsenMargin = 0.75f;
+
+} // namespace
+
+GridLod::GridLod() {
+  glGenBuffers(1, &ibo_);
+}
+
+GridLod::~GridLod() {
+  glDeleteBuffers(1, &ibo_);
+}
+
+void GridLod::Build(unsigned int num_u, unsigned int num_v,
+                    const glm::vec3 *positions) {
+  patches_.clear();
+  nodes_.clear();
+  skirt_sources_.clear();
+  draw_counts_.clear();
+  draw_offsets_.clear();
+  num_selected_triangles_ = 0;
+  skirt_depth_ = 0.0f;
+  if (num_u < 2 || num_v < 2) {
+    num_u_ = num_v_ = 0;
+    return;
+  }
+  num_u_ = num_u;
+  num_v_ = num_v;
+  num_patches_v_ = (num_v - 1 + kLodPatchSize - 1) / kLodPatchSize;
+
+  // Vertices on patch edges inside the grid; the grid border has no
+  // neighbour to crack against
+  auto interior_line = [](unsigned int idx, unsigned int num) {
+    return idx % kLodPatchSize == 0 && idx > 0 && idx + 1 < num;
+  };
+  for (unsigned int u_idx = 0; u_idx < num_u; u_idx++) {
+    for (unsigned int v_idx = 0; v_idx < num_v; v_idx++) {
+      if (interior_line(u_idx, num_u) || interior_line(v_idx, num_v))
+        skirt_sources_.push_back(num_v * u_idx + v_idx);
+    }
+  }
+
+  std::vector<GLuint> indices;
+  indices.reserve(8 * size_t(num_u) * num_v);
+  for (unsigned int u0 = 0; u0 + 1 < num_u; u0 += kLodPatchSize) {
+    for (unsigned int v0 = 0; v0 + 1 < num_v; v0 += kLodPatchSize) {
+      Patch patch;
+      patch.u0 = u0;
+      patch.v0 = v0;
+      patch.size_u = std::min(kLodPatchSize, num_u - 1 - u0);
+      patch.size_v = std::min(kLodPatchSize, num_v - 1 - v0);
+      // Levels whose step divides both sides of the patch
+      patch.num_levels = 1;
+      while (patch.num_levels < kLodMaxLevels &&
+             patch.size_u % (1u << patch.num_levels) == 0 &&
+             patch.size_v % (1u << patch.num_levels) == 0)
+        patch.num_levels++;
+      // Across u0, u1, v0 and v1; the grid border has none
+      const int pu = static_cast<int>(u0 / kLodPatchSize);
+      const int pv = static_cast<int>(v0 / kLodPatchSize);
+      const int npv = static_cast<int>(num_patches_v_);
+      patch.neighbor[0] = u0 > 0 ? (pu - 1) * npv + pv : -1;
+      patch.neighbor[1] = u0 + patch.size_u + 1 < num_u ? (pu + 1) * npv + pv : -1;
+      patch.neighbor[2] = v0 > 0 ? pu * npv + pv - 1 : -1;
+      patch.neighbor[3] = v0 + patch.size_v + 1 < num_v ? pu * npv + pv + 1 : -1;
+
+      for (unsigned int level = 0; level < patch.num_levels; level++) {
+        const unsigned int step = 1u << level;
+        Range &range = patch.range[level];
+        range.first = indices.size();
+        for (unsigned int u_idx = u0; u_idx < u0 + patch.size_u;
+             u_idx += step) {
+          for (unsigned int v_idx = v0; v_idx < v0 + patch.size_v;
+               v_idx += step) {
+            // Same diagonal as BuildGridIndices()
+            const GLuint idx = num_v * u_idx + v_idx;
+            const GLuint next = idx + step * num_v;
+            indices.insert(indices.end(), { idx, idx + step, next,
+                                            idx + step, next + step, next });
+            range.triangles += 2;
+          }
+        }
+
+        // Skirts of the four sides follow, each drawn only while the
+        // neighbour across it uses another level. The bottom of a skirt
+        // follows the full-resolution edge, so it also fills the sliver
+        // between a coarse edge and the finer one in the view plane, where
+        // hanging it along the normal would not.
+        auto skirt = [&](int side, unsigned int u_idx, unsigned int v_idx,
+                         unsigned int du, unsigned int dv, unsigned int num) {
+          const size_t side_first = indices.size();
+          const GLuint unit = (du * num_v + dv) / step;
+          for (unsigned int edge = 0; edge < num; edge++) {
+            const GLuint top0 = num_v * (u_idx + edge * du) + v_idx + edge * dv;
+            const GLuint top1 = top0 + step * unit;
+            indices.insert(indices.end(), { top0, top1, SkirtVertex(top1) });
+            for (unsigned int fine = 0; fine < step; fine++) {
+              indices.insert(indices.end(),
+                             { top0, SkirtVertex(top0 + (fine + 1) * unit),
+                               SkirtVertex(top0 + fine * unit) });
+            }
+          }
+          range.side_count[side] =
+              static_cast<GLsizei>(indices.size() - side_first);
+        };
+        const unsigned int u1 = u0 + patch.size_u, v1 = v0 + patch.size_v;
+        if (patch.neighbor[0] >= 0) skirt(0, u0, v0, 0, step, patch.size_v / step);
+        if (patch.neighbor[1] >= 0) skirt(1, u1, v0, 0, step, patch.size_v / step);
+        if (patch.neighbor[2] >= 0) skirt(2, u0, v0, step, 0, patch.size_u / step);
+        if (patch.neighbor[3] >= 0) skirt(3, u0, v1, step, 0, patch.size_u / step);
+      }
+      MeasureErrors(patch, positions);
+      patches_.push_back(patch);
+    }
+  }
+
+  Node root;
+  root.pu0 = 0;
+  root.pu1 = static_cast<unsigned int>(patches_.size() / num_patches_v_);
+  root.pv0 = 0;
+  root.pv1 = num_patches_v_;
+  nodes_.push_back(root);
+  SplitNode(0);
+  RefitNodes();
+
+  // The copy target leaves the element binding of the bound VAO alone
+  glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_);
+  glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(GLuint),
+               indices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GridLod::UpdateErrors(const glm::vec3 *positions, size_t first,
+                           size_t count) {
+  if (empty() || count == 0) return;
+  const size_t row_first = first / num_v_;
+  const size_t row_last = (first + count - 1) / num_v_;
+  for (Patch &patch : patches_) {
+    // A patch owns its border rows too
+    if (patch.u0 <= row_last && patch.u0 + patch.size_u >= row_first)
+      MeasureErrors(patch, positions);
+  }
+  RefitNodes();
+}
+
+void GridLod::MeasureErrors(Patch &patch, const glm::vec3 *positions) const {
+  auto position = [this, positions](unsigned int u_idx, unsigned int v_idx) {
+    return positions[size_t(num_v_) * u_idx + v_idx];
+  };
+  // Coarser levels use a subset of these vertices, so the box holds them all
+  patch.lo = patch.hi = position(patch.u0, patch.v0);
+  for (unsigned int du = 0; du <= patch.size_u; du++) {
+    for (unsigned int dv = 0; dv <= patch.size_v; dv++) {
+      const glm::vec3 p = position(patch.u0 + du, patch.v0 + dv);
+      patch.lo = glm::min(patch.lo, p);
+      patch.hi = glm::max(patch.hi, p);
+    }
+  }
+
+  patch.error[0] = 0.0f;
+  for (unsigned int level = 1; level < patch.num_levels; level++) {
+    const unsigned int step = 1u << level;
+    float error = 0.0f;
+    for (unsigned int du = 0; du <= patch.size_u; du++) {
+      const unsigned int quad_u = std::min(du / step, patch.size_u / step - 1);
+      const float x = float(du - quad_u * step) / step;
+      for (unsigned int dv = 0; dv <= patch.size_v; dv++) {
+        const unsigned int quad_v =
+            std::min(dv / step, patch.size_v / step - 1);
+        const float y = float(dv - quad_v * step) / step;
+        // Corners a (u, v), b (u, v + 1), c (u + 1, v), d (u + 1, v + 1),
+        // split along b-c
+        const unsigned int u_idx = patch.u0 + quad_u * step;
+        const unsigned int v_idx = patch.v0 + quad_v * step;
+        const glm::vec3 a = position(u_idx, v_idx);
+        const glm::vec3 b = position(u_idx, v_idx + step);
+        const glm::vec3 c = position(u_idx + step, v_idx);
+        const glm::vec3 d = position(u_idx + step, v_idx + step);
+        const glm::vec3 coarse = x + y <= 1.0f
+            ? a + x * (c - a) + y * (b - a)
+            : d + (1.0f - x) * (b - d) + (1.0f - y) * (c - d);
+        error = std::max(error, glm::length(
+            coarse - position(patch.u0 + du, patch.v0 + dv)));
+      }
+    }
+    // Coarser levels never claim to be more accurate
+    patch.error[level] = std::max(error, patch.error[level - 1]);
+  }
+}
+
+GLuint GridLod::SkirtVertex(GLuint source) const {
+  auto found = std::lower_bound(skirt_sources_.begin(), skirt_sources_.end(),
+                                source);
+  return static_cast<GLuint>(FirstSkirtVertex() +
+                             (found - skirt_sources_.begin()));
+}
+
+void GridLod::SplitNode(size_t node_idx) {
+  const Node node = nodes_[node_idx];
+  if (node.pu1 - node.pu0 == 1 && node.pv1 - node.pv0 == 1) return;
+  const unsigned int mid_u = (node.pu0 + node.pu1 + 1) / 2;
+  const unsigned int mid_v = (node.pv0 + node.pv1 + 1) / 2;
+  const unsigned int bounds_u[] = { node.pu0, mid_u, node.pu1 };
+  const unsigned int bounds_v[] = { node.pv0, mid_v, node.pv1 };
+
+  const size_t first_child = nodes_.size();
+  for (int half_u = 0; half_u < 2; half_u++) {
+    for (int half_v = 0; half_v < 2; half_v++) {
+      Node child;
+      child.pu0 = bounds_u[half_u];
+      child.pu1 = bounds_u[half_u + 1];
+      child.pv0 = bounds_v[half_v];
+      child.pv1 = bounds_v[half_v + 1];
+      // Odd spans split unevenly; a side of one patch does not split
+      if (child.pu0 < child.pu1 && child.pv0 < child.pv1)
+        nodes_.push_back(child);
+    }
+  }
+  nodes_[node_idx].first_child = first_child;
+  nodes_[node_idx].num_children =
+      static_cast<unsigned int>(nodes_.size() - first_child);
+  for (size_t child = first_child; child < first_child +
+           nodes_[node_idx].num_children; child++)
+    SplitNode(child);
+}
+
+void GridLod::RefitNodes() {
+  for (size_t idx = nodes_.size(); idx-- > 0;) {
+    Node &node = nodes_[idx];
+    if (node.num_children == 0) {
+      const Patch &patch = patches_[node.pu0 * num_patches_v_ + node.pv0];
+      node.lo = patch.lo;
+      node.hi = patch.hi;
+      continue;
+    }
+    node.lo = nodes_[node.first_child].lo;
+    node.hi = nodes_[node.first_child].hi;
+    for (unsigned int child = 1; child < node.num_children; child++) {
+      node.lo = glm::min(node.lo, nodes_[node.first_child + child].lo);
+      node.hi = glm::max(node.hi, nodes_[node.first_child + child].hi);
+    }
+  }
+}
+
+void GridLod::Cull(const glm::mat4 &clip_from_model, float margin) {
+  enum Containment { kOutside, kIntersecting, kInside };
+  // An affine map takes a box to a parallelepiped; its extent along a clip
+  // axis is the centre's coordinate plus or minus the projected half sizes
+  auto classify = [&clip_from_model, margin](const Node &node) {
+    const glm::vec3 center = 0.5f * (node.lo + node.hi);
+    const glm::vec3 half = 0.5f * (node.hi - node.lo) + margin;
+    const glm::vec4 clip = clip_from_model * glm::vec4(center, 1.0f);
+    Containment result = kInside;
+    for (int axis = 0; axis < 3; axis++) {
+      const float radius = std::abs(clip_from_model[0][axis]) * half.x +
+                           std::abs(clip_from_model[1][axis]) * half.y +
+                           std::abs(clip_from_model[2][axis]) * half.z;
+      if (std::abs(clip[axis]) - radius > clip.w) return kOutside;
+      if (std::abs(clip[axis]) + radius > clip.w) result = kIntersecting;
+    }
+    return result;
+  };
+
+  for (Patch &patch : patches_) patch.visible = false;
+  cull_stack_.assign(1, 0);
+  while (!cull_stack_.empty()) {
+    const Node &node = nodes_[cull_stack_.back()];
+    cull_stack_.pop_back();
+    const Containment containment = classify(node);
+    if (containment == kOutside) continue;
+    if (containment == kInside || node.num_children == 0) {
+      for (unsigned int pu = node.pu0; pu < node.pu1; pu++) {
+        for (unsigned int pv = node.pv0; pv < node.pv1; pv++)
+          patches_[pu * num_patches_v_ + pv].visible = true;
+      }
+      continue;
+    }
+    for (unsigned int child = 0; child < node.num_children; child++)
+      cull_stack_.push_back(node.first_child + child);
+  }
+}
+
+void GridLod::Select(float pixels_per_unit, float tolerance,
+                     const glm::mat4 *clip_from_model, int fixed_level) {
+  draw_counts_.clear();
+  draw_offsets_.clear();
+  num_selected_triangles_ = 0;
+  skirt_depth_ = 0.0f;
+  // Levels of hidden patches are kept up to date as well, so they come
+  // back without popping
+  for (Patch &patch : patches_) {
+    unsigned int level = patch.level;
+    if (fixed_level >= 0) {
+      level = std::min(unsigned(fixed_level), patch.num_levels - 1);
+    }
+    else {
+      while (level > 0 && patch.error[level] * pixels_per_unit > tolerance)
+        level--;
+      while (level + 1 < patch.num_levels &&
+             patch.error[level + 1] * pixels_per_unit <=
+                 kCoarsenMargin * tolerance)
+        level++;
+    }
+    patch.level = level;
+
+    // A crack is never wider than the error of the coarser neighbour
+    skirt_depth_ = std::max(skirt_depth_, patch.error[level]);
+  }
+
+  // Skirts reach SkirtDepth() past the patch boxes
+  if (clip_from_model) {
+    Cull(*clip_from_model, skirt_depth_);
+  }
+  else {
+    for (Patch &patch : patches_) patch.visible = true;
+  }
+  auto emit = [this](size_t first, GLsizei count) {
+    const void *offset = reinterpret_cast<const void *>(first * sizeof(GLuint));
+    if (!draw_counts_.empty() &&
+        static_cast<const char *>(draw_offsets_.back()) +
+            draw_counts_.back() * sizeof(GLuint) == offset) {
+      draw_counts_.back() += count;
+      return;
+    }
+    draw_counts_.push_back(count);
+    draw_offsets_.push_back(offset);
+  };
+  num_visible_patches_ = 0;
+  for (const Patch &patch : patches_) {
+    if (!patch.visible) continue;
+    const Range &range = patch.range[patch.level];
+    emit(range.first, 3 * range.triangles);
+    size_t side_first = range.first + 3 * range.triangles;
+    for (int side = 0; side < 4; side++) {
+      // Both sides of an edge at one level share its vertices: no crack
+      if (range.side_count[side] > 0 && skirt_depth_ > 0.0f &&
+          patches_[patch.neighbor[side]].level != patch.level)
+        emit(side_first, range.side_count[side]);
+      side_first += range.side_count[side];
+    }
+    num_visible_patches_++;
+    num_selected_triangles_ += range.triangles;
+  }
+}
+
+size_t GridLod::Draw() const {
+  if (draw_counts_.empty()) return 0;
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+  glMultiDrawElements(GL_TRIANGLES, draw_counts_.data(), GL_UNSIGNED_INT,
+                      draw_offsets_.data(),
+                      static_cast<GLsizei>(draw_counts_.size()));
+  return num_selected_triangles_;
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
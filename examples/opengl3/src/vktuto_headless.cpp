@@ -0,0 +1,292 @@
+#include "vktuto_headless.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// Configuration file (edit vktuto_config.h or define VKTUTO_USER_CONFIG to
+// set your own filename)
+#ifdef VKTUTO_USER_CONFIG
+#include VKTUTO_USER_CONFIG
+#endif
+#if !defined(VKTUTO_DISABLE_INCLUDE_CONFIG_H) || \
+     defined(VKTUTO_INCLUDE_CONFIG_H)
+#include "vktuto_config.h"
+#endif
+
+#if VKTUTO_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#if VKTUTO_HEADLESS_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+struct HeadlessContext::Native {
+#if VKTUTO_HEADLESS_EGL
+  EGLDisplay display = EGL_NO_DISPLAY;
+  EGLContext context = EGL_NO_CONTEXT;
+  // Only when the display cannot make a context current without a surface
+  EGLSurface surface = EGL_NO_SURFACE;
+#endif
+#if VKTUTO_HEADLESS_OSMESA
+  OSMesaContext osmesa = nullptr;
+  // OSMesa wants a color buffer to bind; rendering goes to FBOs anyway
+  std::vector<unsigned char> buffer = std::vector<unsigned char>(4 * 16 * 16);
+#endif
+};
+
+namespace {
+
+#if VKTUTO_HEADLESS_EGL
+bool HasEGLExtension(EGLDisplay display, const char *name) {
+  const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+  if (extensions == nullptr) return false;
+  size_t length = std::strlen(name);
+  for (const char *found = std::strstr(extensions, name); found != nullptr;
+       found = std::strstr(found + length, name)) {
+    if ((found == extensions || found[-1] == ' ') &&
+        (found[length] == ' ' || found[length] == '\0'))
+      return true;
+  }
+  return false;
+}
+
+// Mesa's surfaceless platform first, then the first EGL device (vendor
+// drivers without a display server), then whatever the default display is
+EGLDisplay OpenEGLDisplay(std::string &platform) {
+  auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+      eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  if (get_platform_display != nullptr &&
+      HasEGLExtension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+    EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                              EGL_DEFAULT_DISPLAY, nullptr);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+      platform = "surfaceless";
+      return display;
+    }
+  }
+  auto query_devices = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(
+      eglGetProcAddress("eglQueryDevicesEXT"));
+  if (get_platform_display != nullptr && query_devices != nullptr) {
+    EGLDeviceEXT device;
+    EGLint num_devices = 0;
+    if (query_devices(1, &device, &num_devices) && num_devices > 0) {
+      EGLDisplay display = get_platform_display(EGL_PLATFORM_DEVICE_EXT,
+                                                device, nullptr);
+      if (display != EGL_NO_DISPLAY &&
+          eglInitialize(display, nullptr, nullptr)) {
+        platform = "device";
+        return display;
+      }
+    }
+  }
+  EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+    platform = "default display";
+    return display;
+  }
+  return EGL_NO_DISPLAY;
+}
+
+void CreateEGLContext(HeadlessContext::Native &native, int major, int minor,
+                      std::string &description) {
+  std::string platform;
+  native.display = OpenEGLDisplay(platform);
+  if (native.display == EGL_NO_DISPLAY)
+    throw std::runtime_error("No EGL display available!");
+  if (!eglBindAPI(EGL_OPENGL_API))
+    throw std::runtime_error("EGL has no desktop OpenGL support!");
+
+  const EGLint config_attribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+    EGL_NONE
+  };
+  EGLConfig config = nullptr;
+  EGLint num_configs = 0;
+  eglChooseConfig(native.display, config_attribs, &config, 1, &num_configs);
+  const bool surfaceless =
+      HasEGLExtension(native.display, "EGL_KHR_surfaceless_context");
+  if (num_configs == 0 &&
+      !(surfaceless &&
+        HasEGLExtension(native.display, "EGL_KHR_no_config_context")))
+    throw std::runtime_error("No EGL config for desktop OpenGL!");
+
+  const bool core = major > 3 || (major == 3 && minor >= 2);
+  const EGLint context_attribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION, major,
+    EGL_CONTEXT_MINOR_VERSION, minor,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK,
+    core ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT
+         : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+    EGL_NONE
+  };
+  native.context = eglCreateContext(
+      native.display, num_configs > 0 ? config : EGL_NO_CONFIG_KHR,
+      EGL_NO_CONTEXT, context_attribs);
+  if (native.context == EGL_NO_CONTEXT)
+    throw std::runtime_error("EGL context creation failed!");
+
+  if (!surfaceless) {
+    const EGLint pbuffer_attribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16,
+                                       EGL_NONE };
+    native.surface = eglCreatePbufferSurface(native.display, config,
+                                             pbuffer_attribs);
+    if (native.surface == EGL_NO_SURFACE)
+      throw std::runtime_error("EGL pbuffer creation failed!");
+  }
+
+  description = std::string("EGL ") +
+                eglQueryString(native.display, EGL_VERSION) + " (" +
+                eglQueryString(native.display, EGL_VENDOR) + ", " + platform +
+                ")";
+}
+
+void DestroyEGLContext(HeadlessContext::Native &native) {
+  if (native.display == EGL_NO_DISPLAY) return;
+  eglMakeCurrent(native.display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                 EGL_NO_CONTEXT);
+  if (native.surface != EGL_NO_SURFACE)
+    eglDestroySurface(native.display, native.surface);
+  if (native.context != EGL_NO_CONTEXT)
+    eglDestroyContext(native.display, native.context);
+  eglTerminate(native.display);
+}
+
+HeadlessContext::GLProc GetEGLProcAddress(const char *name) {
+  return reinterpret_cast<HeadlessContext::GLProc>(eglGetProcAddress(name));
+}
+#endif // VKTUTO_HEADLESS_EGL
+
+#if VKTUTO_HEADLESS_OSMESA
+void CreateOSMesaContext(HeadlessContext::Native &native, int major, int minor,
+                         std::string &description) {
+  const bool core = major > 3 || (major == 3 && minor >= 2);
+  const int attribs[] = {
+    OSMESA_FORMAT, OSMESA_RGBA,
+    OSMESA_DEPTH_BITS, 24,
+    OSMESA_PROFILE, core ? OSMESA_CORE_PROFILE : OSMESA_COMPAT_PROFILE,
+    OSMESA_CONTEXT_MAJOR_VERSION, major,
+    OSMESA_CONTEXT_MINOR_VERSION, minor,
+    0
+  };
+  native.osmesa = OSMesaCreateContextAttribs(attribs, nullptr);
+  if (native.osmesa == nullptr)
+    throw std::runtime_error("OSMesa context creation failed!");
+  description = "OSMesa";
+}
+
+void DestroyOSMesaContext(HeadlessContext::Native &native) {
+  if (native.osmesa == nullptr) return;
+  OSMesaDestroyContext(native.osmesa);
+  native.osmesa = nullptr;
+}
+
+HeadlessContext::GLProc GetOSMesaProcAddress(const char *name) {
+  return reinterpret_cast<HeadlessContext::GLProc>(OSMesaGetProcAddress(name));
+}
+#endif // VKTUTO_HEADLESS_OSMESA
+
+} // namespace
+
+HeadlessContext::HeadlessContext(HeadlessBackend backend, int major, int minor)
+    : backend_(backend), native_(std::make_unique<Native>()) {
+  if (!Available(backend)) {
+    throw std::runtime_error(std::string("Headless backend ") +
+                             HeadlessBackendName(backend) +
+                             " is not compiled in!");
+  }
+  try {
+#if VKTUTO_HEADLESS_EGL
+    if (backend == HeadlessBackend::kEGL)
+      CreateEGLContext(*native_, major, minor, description_);
+#endif
+#if VKTUTO_HEADLESS_OSMESA
+    if (backend == HeadlessBackend::kOSMesa)
+      CreateOSMesaContext(*native_, major, minor, description_);
+#endif
+    MakeCurrent();
+  }
+  catch (...) {
+    // The destructor does not run for a constructor that throws
+#if VKTUTO_HEADLESS_EGL
+    if (backend == HeadlessBackend::kEGL) DestroyEGLContext(*native_);
+#endif
+#if VKTUTO_HEADLESS_OSMESA
+    if (backend == HeadlessBackend::kOSMesa) DestroyOSMesaContext(*native_);
+#endif
+    throw;
+  }
+}
+
+HeadlessContext::~HeadlessContext() {
+#if VKTUTO_HEADLESS_EGL
+  if (backend_ == HeadlessBackend::kEGL) DestroyEGLContext(*native_);
+#endif
+#if VKTUTO_HEADLESS_OSMESA
+  if (backend_ == HeadlessBackend::kOSMesa) DestroyOSMesaContext(*native_);
+#endif
+}
+
+void HeadlessContext::MakeCurrent() {
+#if VKTUTO_HEADLESS_EGL
+  if (backend_ == HeadlessBackend::kEGL &&
+      !eglMakeCurrent(native_->display, native_->surface, native_->surface,
+                      native_->context))
+    throw std::runtime_error("eglMakeCurrent failed!");
+#endif
+#if VKTUTO_HEADLESS_OSMESA
+  if (backend_ == HeadlessBackend::kOSMesa &&
+      !OSMesaMakeCurrent(native_->osmesa, native_->buffer.data(),
+                         GL_UNSIGNED_BYTE, 16, 16))
+    throw std::runtime_error("OSMesaMakeCurrent failed!");
+#endif
+}
+
+void HeadlessContext::ReleaseCurrent() {
+#if VKTUTO_HEADLESS_EGL
+  if (backend_ == HeadlessBackend::kEGL)
+    eglMakeCurrent(native_->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+#endif
+#if VKTUTO_HEADLESS_OSMESA
+  if (backend_ == HeadlessBackend::kOSMesa)
+    OSMesaMakeCurrent(nullptr, nullptr, 0, 0, 0);
+#endif
+}
+
+HeadlessContext::GetProcAddressProc
+HeadlessContext::GetProcAddress() const noexcept {
+#if VKTUTO_HEADLESS_EGL
+  if (backend_ == HeadlessBackend::kEGL) return GetEGLProcAddress;
+#endif
+#if VKTUTO_HEADLESS_OSMESA
+  if (backend_ == HeadlessBackend::kOSMesa) return GetOSMesaProcAddress;
+#endif
+  return nullptr;
+}
+
+bool HeadlessContext::Available(HeadlessBackend backend) noexcept {
+  switch (backend) {
+    case HeadlessBackend::kEGL:    return VKTUTO_HEADLESS_EGL != 0;
+    case HeadlessBackend::kOSMesa: return VKTUTO_HEADLESS_OSMESA != 0;
+    default:                       return false;
+  }
+}
+
+const char * HeadlessBackendName(HeadlessBackend backend) {
+  switch (backend) {
+    case HeadlessBackend::kOSMesa: return "OSMesa";
+    default:                       return "EGL";
+  }
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -0,0 +1,171 @@
+#include "vktuto_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <utility>
+
+#include "vktuto_nurbs.h"
+
+namespace vktuto {
+
+inline namespace io {
+
+namespace {
+
+// u-rows per tessellation work item; small enough for smooth progress and
+// prompt cancellation, large enough to keep scheduling overhead negligible
+constexpr unsigned int kRowsPerItem = 16;
+
+// Share of the progress bar covered by parsing and validation
+constexpr float kParseShare = 0.2f;
+
+} // namespace
+
+struct ModelLoader::Job {
+  uint64_t          id;
+  std::string       file_name;
+  unsigned int      num_u, num_v;
+  std::atomic<bool> cancel{ false };
+  std::atomic<bool> finished{ false };
+  std::atomic<int>  stage{ static_cast<int>(Stage::kParsing) };
+  std::atomic<size_t> rows_done{ 0 };
+  std::atomic<size_t> rows_total{ 0 };
+};
+
+ModelLoader::ModelLoader(unsigned int num_threads) : pool_(num_threads) {}
+
+ModelLoader::~ModelLoader() {
+  Cancel();
+}
+
+uint64_t ModelLoader::Load(const std::string &file_name,
+                           unsigned int num_u, unsigned int num_v) {
+  Cancel();
+  auto job = std::make_shared<Job>();
+  job->id = next_id_++;
+  job->file_name = file_name;
+  job->num_u = std::max(2u, num_u);
+  job->num_v = std::max(2u, num_v);
+  current_ = job;
+  pool_.Submit([this, job] { Run(job); });
+  return job->id;
+}
+
+void ModelLoader::Cancel() {
+  if (current_) current_->cancel = true;
+}
+
+bool ModelLoader::Busy() const {
+  return current_ && !current_->finished;
+}
+
+ModelLoader::Stage ModelLoader::CurrentStage() const {
+  if (!Busy()) return Stage::kIdle;
+  return static_cast<Stage>(current_->stage.load());
+}
+
+float ModelLoader::Progress() const {
+  if (!current_) return 0.0f;
+  if (current_->finished) return 1.0f;
+  size_t total = current_->rows_total;
+  if (current_->stage != static_cast<int>(Stage::kTessellating) || total == 0)
+    return 0.0f;
+  return kParseShare +
+         (1.0f - kParseShare) * float(current_->rows_done) / float(total);
+}
+
+bool ModelLoader::Poll(LoadResult &result) {
+  std::unique_ptr<LoadResult> next;
+  if (!results_.TryPop(next)) return false;
+  result = std::move(*next);
+  if (current_ && current_->id == result.id) current_.reset();
+  return true;
+}
+
+void ModelLoader::Run(const std::shared_ptr<Job> &job) {
+  auto start = std::chrono::steady_clock::now();
+  auto result = std::make_unique<LoadResult>();
+  result->id = job->id;
+  result->file_name = job->file_name;
+
+  try {
+    nurbs::ObjScene<float> scene;
+    if (!job->cancel)
+      scene = nurbs::SceneReadOBJ<float>(job->file_name, pool_, &job->cancel);
+
+    // Validate
+    job->stage = static_cast<int>(Stage::kValidating);
+    for (auto &surface : scene.surfaces) {
+      if (job->cancel) break;
+      if (nurbs::SurfaceIsValid(surface)) {
+        LoadedSurface loaded;
+        loaded.surface = std::move(surface);
+        loaded.num_u = job->num_u;
+        loaded.num_v = job->num_v;
+        result->surfaces.push_back(std::move(loaded));
+      }
+      else {
+        result->num_invalid++;
+      }
+    }
+    for (auto &curve : scene.curves) {
+      if (job->cancel) break;
+      if (nurbs::CurveIsValid(curve)) result->curves.push_back(std::move(curve));
+      else                            result->num_invalid++;
+    }
+
+    // Tessellate: one work item per band of rows of one surface
+    std::vector<SurfaceEvaluator> evaluators;
+    std::vector<std::pair<size_t, unsigned int>> items;
+    evaluators.reserve(result->surfaces.size());
+    for (size_t srf_idx = 0; srf_idx < result->surfaces.size(); srf_idx++) {
+      auto &loaded = result->surfaces[srf_idx];
+      evaluators.emplace_back(loaded.surface);
+      loaded.positions.resize(size_t(loaded.num_u) * loaded.num_v);
+      loaded.normals.resize(loaded.positions.size());
+      for (unsigned int row = 0; row < loaded.num_u; row += kRowsPerItem)
+        items.emplace_back(srf_idx, row);
+    }
+    job->rows_total = result->surfaces.size() * size_t(job->num_u);
+    job->stage = static_cast<int>(Stage::kTessellating);
+    pool_.ParallelFor(items.size(), [&](size_t item_idx) {
+      if (job->cancel) return;
+      size_t srf_idx = items[item_idx].first;
+      unsigned int row_begin = items[item_idx].second;
+      auto &loaded = result->surfaces[srf_idx];
+      unsigned int row_end = std::min(row_begin + kRowsPerItem, loaded.num_u);
+      TessellateSurfaceRows(evaluators[srf_idx], loaded.num_u, loaded.num_v,
+                            row_begin, row_end, loaded.positions.data(),
+                            loaded.normals.data());
+      job->rows_done += row_end - row_begin;
+    });
+  }
+  catch (const std::exception &except) {
+    result->error = except.what();
+  }
+
+  if (job->cancel) {
+    // Partial results are dropped, only the notification is delivered
+    result->cancelled = true;
+    result->surfaces.clear();
+    result->curves.clear();
+  }
+  result->seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  job->finished = true;
+  results_.Push(std::move(result));
+}
+
+const char * StageName(ModelLoader::Stage stage) {
+  switch (stage) {
+    case ModelLoader::Stage::kParsing:      return "Parsing";
+    case ModelLoader::Stage::kValidating:   return "Validating";
+    case ModelLoader::Stage::kTessellating: return "Tessellating";
+    default:                                return "Idle";
+  }
+}
+
+} // inline namespace io
+
+} // namespace vktuto
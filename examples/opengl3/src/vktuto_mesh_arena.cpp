@@ -0,0 +1,340 @@
+#include "vktuto_mesh_arena.h"
+
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+
+#include "vktuto_grid_index.h"
+#include "vktuto_vertex_format.h"
+
+// Configuration file (edit vktuto_config.h or define VKTUTO_USER_CONFIG to
+// set your own filename)
+#ifdef VKTUTO_USER_CONFIG
+#include VKTUTO_USER_CONFIG
+#endif
+#if !defined(VKTUTO_DISABLE_INCLUDE_CONFIG_H) || \
+     defined(VKTUTO_INCLUDE_CONFIG_H)
+#include "vktuto_config.h"
+#endif
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+RangeAllocator::RangeAllocator(size_t capacity) {
+  Grow(capacity);
+}
+
+size_t RangeAllocator::Allocate(size_t size) {
+  if (size == 0) return 0;
+  for (auto it = free_.begin(); it != free_.end(); ++it) {
+    if (it->second < size) continue;
+    const size_t offset = it->first;
+    const size_t rest = it->second - size;
+    free_.erase(it);
+    if (rest > 0) free_.emplace(offset + size, rest);
+    used_ += size;
+    return offset;
+  }
+  return kFailed;
+}
+
+void RangeAllocator::Free(size_t offset, size_t size) {
+  if (size == 0) return;
+  used_ -= size;
+  auto next = free_.lower_bound(offset);
+  if (next != free_.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      size += prev->second;
+      free_.erase(prev);
+    }
+  }
+  if (next != free_.end() && offset + size == next->first) {
+    size += next->second;
+    free_.erase(next);
+  }
+  free_.emplace(offset, size);
+}
+
+void RangeAllocator::Grow(size_t capacity) {
+  if (capacity <= capacity_) return;
+  const size_t added = capacity - capacity_;
+  // Free() merges the new tail with a free range ending at the old capacity
+  used_ += added;
+  const size_t offset = capacity_;
+  capacity_ = capacity;
+  Free(offset, added);
+}
+
+void RangeAllocator::Reset() {
+  free_.clear();
+  used_ = 0;
+  if (capacity_ > 0) free_.emplace(0, capacity_);
+}
+
+MeshArena::MeshArena(size_t vertex_capacity, size_t index_capacity)
+    : vertices_(vertex_capacity), indices_(index_capacity) {
+  glGenBuffers(1, &vbo_);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, vbo_);
+  glBufferData(GL_COPY_WRITE_BUFFER, vertex_capacity * sizeof(ArenaVertex),
+               NULL, GL_STATIC_DRAW);
+  glGenBuffers(1, &ibo_);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_);
+  glBufferData(GL_COPY_WRITE_BUFFER, index_capacity * sizeof(GLuint), NULL,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  glGenVertexArrays(1, &vao_);
+  SetAttributes();
+}
+
+MeshArena::~MeshArena() {
+  glDeleteVertexArrays(1, &vao_);
+  glDeleteBuffers(1, &vbo_);
+  glDeleteBuffers(1, &ibo_);
+}
+
+void MeshArena::SetAttributes() const {
+  // Same locations as the mesh layouts of vktuto_vertex_format.h, with the
+  // color interleaved
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  const GLsizei stride = sizeof(ArenaVertex);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+      reinterpret_cast<const void *>(offsetof(ArenaVertex, position)));
+  glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+      reinterpret_cast<const void *>(offsetof(ArenaVertex, color)));
+  glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, stride,
+      reinterpret_cast<const void *>(offsetof(ArenaVertex, normal)));
+  for (GLuint attribute = 0; attribute < 3; attribute++)
+    glEnableVertexAttribArray(attribute);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+  glBindVertexArray(0);
+}
+
+void MeshArena::GrowBuffer(GLuint &buffer, size_t old_bytes,
+                           size_t new_bytes) {
+  GLuint grown = 0;
+  glGenBuffers(1, &grown);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+  glBufferData(GL_COPY_WRITE_BUFFER, new_bytes, NULL, GL_STATIC_DRAW);
+  glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                      old_bytes);
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  glDeleteBuffers(1, &buffer);
+  buffer = grown;
+}
+
+size_t MeshArena::AllocateVertices(size_t count) {
+  size_t first = vertices_.Allocate(count);
+  if (first != RangeAllocator::kFailed) return first;
+  // Doubling keeps the copies amortized
+  const size_t old_capacity = vertices_.capacity();
+  const size_t capacity = std::max(2 * old_capacity, old_capacity + count);
+  GrowBuffer(vbo_, old_capacity * sizeof(ArenaVertex),
+             capacity * sizeof(ArenaVertex));
+  vertices_.Grow(capacity);
+  SetAttributes();
+  return vertices_.Allocate(count);
+}
+
+size_t MeshArena::AllocateIndices(size_t count) {
+  size_t first = indices_.Allocate(count);
+  if (first != RangeAllocator::kFailed) return first;
+  const size_t old_capacity = indices_.capacity();
+  const size_t capacity = std::max(2 * old_capacity, old_capacity + count);
+  GrowBuffer(ibo_, old_capacity * sizeof(GLuint), capacity * sizeof(GLuint));
+  indices_.Grow(capacity);
+  SetAttributes();
+  return indices_.Allocate(count);
+}
+
+void MeshArena::UploadVertices(const ArenaMesh &mesh, size_t first_vertex) {
+  std::vector<ArenaVertex> packed(mesh.num_vertices);
+  for (size_t idx = 0; idx < mesh.num_vertices; idx++) {
+    ArenaVertex &vertex = packed[idx];
+    vertex.position = mesh.positions[idx];
+    if (mesh.normals != nullptr) {
+      OctEncode(mesh.normals[idx], vertex.normal);
+    }
+    else {
+      vertex.normal[0] = vertex.normal[1] = 0;
+    }
+    const glm::vec4 color = mesh.colors != nullptr
+        ? glm::vec4(mesh.colors[idx], mesh.color.w) : mesh.color;
+    for (int channel = 0; channel < 4; channel++) {
+      vertex.color[channel] = static_cast<uint8_t>(
+          std::clamp(color[channel], 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, vbo_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, first_vertex * sizeof(ArenaVertex),
+                  packed.size() * sizeof(ArenaVertex), packed.data());
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+MeshHandle MeshArena::Insert(const Mesh &mesh) {
+  MeshHandle handle;
+  if (!free_handles_.empty()) {
+    handle = free_handles_.back();
+    free_handles_.pop_back();
+    meshes_[handle] = mesh;
+  }
+  else {
+    handle = meshes_.size();
+    meshes_.push_back(mesh);
+  }
+  meshes_[handle].alive = true;
+  num_meshes_++;
+  dirty_ = true;
+  return handle;
+}
+
+MeshHandle MeshArena::Add(const ArenaMesh &view) {
+  if (view.num_vertices == 0 || view.num_indices == 0) return kInvalidMesh;
+  Mesh mesh;
+  mesh.mode = view.mode;
+  mesh.has_normals = view.normals != nullptr;
+  mesh.num_vertices = view.num_vertices;
+  mesh.first_vertex = AllocateVertices(view.num_vertices);
+  mesh.num_indices = view.num_indices;
+  mesh.first_index = AllocateIndices(view.num_indices);
+  UploadVertices(view, mesh.first_vertex);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.first_index * sizeof(GLuint),
+                  view.num_indices * sizeof(GLuint), view.indices);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  return Insert(mesh);
+}
+
+MeshHandle MeshArena::AddGrid(unsigned int num_u, unsigned int num_v,
+                              const glm::vec3 *positions,
+                              const glm::vec3 *normals,
+                              const glm::vec4 &color) {
+  if (num_u < 2 || num_v < 2) return kInvalidMesh;
+  const uint64_t key = (uint64_t(num_u) << 32) | num_v;
+  SharedIndices &shared = grid_indices_[key];
+  if (shared.users == 0) {
+    std::vector<GLuint> indices(
+        GridIndexCount(num_u, num_v, GridTopology::kTiledTriangles));
+    BuildGridIndices(num_u, num_v, GridTopology::kTiledTriangles,
+                     indices.data());
+    shared.count = indices.size();
+    shared.first = AllocateIndices(shared.count);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, shared.first * sizeof(GLuint),
+                    indices.size() * sizeof(GLuint), indices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+  shared.users++;
+
+  ArenaMesh view;
+  view.positions = positions;
+  view.normals = normals;
+  view.num_vertices = size_t(num_u) * num_v;
+  view.color = color;
+  Mesh mesh;
+  mesh.mode = GL_TRIANGLES;
+  mesh.has_normals = normals != nullptr;
+  mesh.num_vertices = view.num_vertices;
+  mesh.first_vertex = AllocateVertices(view.num_vertices);
+  mesh.first_index = shared.first;
+  mesh.num_indices = shared.count;
+  mesh.grid_key = key;
+  UploadVertices(view, mesh.first_vertex);
+  return Insert(mesh);
+}
+
+void MeshArena::Remove(MeshHandle handle) {
+  if (handle >= meshes_.size() || !meshes_[handle].alive) return;
+  Mesh &mesh = meshes_[handle];
+  vertices_.Free(mesh.first_vertex, mesh.num_vertices);
+  if (mesh.grid_key == 0) {
+    indices_.Free(mesh.first_index, mesh.num_indices);
+  }
+  else {
+    auto shared = grid_indices_.find(mesh.grid_key);
+    if (--shared->second.users == 0) {
+      indices_.Free(shared->second.first, shared->second.count);
+      grid_indices_.erase(shared);
+    }
+  }
+  mesh.alive = false;
+  free_handles_.push_back(handle);
+  num_meshes_--;
+  dirty_ = true;
+}
+
+void MeshArena::Clear() {
+  meshes_.clear();
+  free_handles_.clear();
+  grid_indices_.clear();
+  num_meshes_ = 0;
+  vertices_.Reset();
+  indices_.Reset();
+  dirty_ = true;
+}
+
+const std::vector<MeshArena::Batch> & MeshArena::Batches() {
+  if (dirty_) RebuildBatches();
+  return batches_;
+}
+
+void MeshArena::RebuildBatches() {
+  std::vector<const Mesh *> order;
+  order.reserve(num_meshes_);
+  for (const Mesh &mesh : meshes_) {
+    if (mesh.alive) order.push_back(&mesh);
+  }
+  // By state, then by position in the buffers
+  std::sort(order.begin(), order.end(), [](const Mesh *a, const Mesh *b) {
+    return std::tie(a->mode, a->has_normals, a->first_vertex) <
+           std::tie(b->mode, b->has_normals, b->first_vertex);
+  });
+
+  batches_.clear();
+  calls_.clear();
+  for (const Mesh *mesh : order) {
+    if (batches_.empty() || batches_.back().mode != mesh->mode ||
+        batches_.back().has_normals != mesh->has_normals) {
+      batches_.push_back({ mesh->mode, mesh->has_normals, 0, 0 });
+      calls_.emplace_back();
+    }
+    Batch &batch = batches_.back();
+    BatchCalls &calls = calls_.back();
+    batch.meshes++;
+    if (mesh->mode == GL_TRIANGLES) batch.triangles += mesh->num_indices / 3;
+    calls.counts.push_back(static_cast<GLsizei>(mesh->num_indices));
+    calls.offsets.push_back(
+        reinterpret_cast<const void *>(mesh->first_index * sizeof(GLuint)));
+    calls.base_vertices.push_back(static_cast<GLint>(mesh->first_vertex));
+  }
+  dirty_ = false;
+}
+
+void MeshArena::DrawBatch(size_t idx) const {
+  const Batch &batch = batches_[idx];
+  const BatchCalls &calls = calls_[idx];
+  glBindVertexArray(vao_);
+#if VKTUTO_ARENA_MULTI_DRAW
+  glMultiDrawElementsBaseVertex(batch.mode, calls.counts.data(),
+                                GL_UNSIGNED_INT, calls.offsets.data(),
+                                static_cast<GLsizei>(calls.counts.size()),
+                                calls.base_vertices.data());
+#else
+  for (size_t mesh = 0; mesh < calls.counts.size(); mesh++) {
+    glDrawElementsBaseVertex(batch.mode, calls.counts[mesh], GL_UNSIGNED_INT,
+                             calls.offsets[mesh],
+                             calls.base_vertices[mesh]);
+  }
+#endif
+  glBindVertexArray(0);
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -0,0 +1,317 @@
+#include "vktuto_mesh_io.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace vktuto {
+
+inline namespace io {
+
+// Output file with a fixed-size staging buffer for small interleaved writes.
+// Large contiguous arrays bypass the staging buffer and go straight to the
+// stream. Values are written in host byte order, which is little-endian on
+// every platform this project targets.
+class BinaryFile {
+ public:
+  explicit BinaryFile(const std::string &file_name)
+      : out_(file_name, std::ios::binary), staging_(kStagingSize) {
+    if (!out_) throw std::runtime_error("Cannot open " + file_name);
+  }
+
+  template <typename T>
+  void Put(const T &value) {
+    if (used_ + sizeof(T) > staging_.size()) FlushStaging();
+    std::memcpy(staging_.data() + used_, &value, sizeof(T));
+    used_ += sizeof(T);
+  }
+
+  void PutBytes(const void *data, size_t size) {
+    if (size == 0) return;
+    if (size <= staging_.size() - used_) {
+      std::memcpy(staging_.data() + used_, data, size);
+      used_ += size;
+      return;
+    }
+    FlushStaging();
+    out_.write(static_cast<const char *>(data), size);
+  }
+
+  void PutPadding(size_t size, char value) {
+    for (size_t i = 0; i < size; i++) Put(value);
+  }
+
+  void Close() {
+    FlushStaging();
+    out_.close();
+    if (!out_) throw std::runtime_error("Writing mesh file failed");
+  }
+
+ private:
+  static constexpr size_t kStagingSize = 1 << 20;
+
+  std::ofstream     out_;
+  std::vector<char> staging_;
+  size_t            used_ = 0;
+
+  void FlushStaging() {
+    out_.write(staging_.data(), used_);
+    used_ = 0;
+  }
+};
+
+namespace {
+
+void CheckMesh(const MeshView &mesh) {
+  if (mesh.num_indices % 3 != 0)
+    throw std::runtime_error("Mesh index count is not a multiple of 3");
+  if (mesh.num_vertices > 0 && mesh.positions == nullptr)
+    throw std::runtime_error("Mesh has no positions");
+  if (mesh.num_indices > 0 && mesh.indices == nullptr)
+    throw std::runtime_error("Mesh has no indices");
+  // The writers look vertices up by index, e.g. STL facets
+  if (mesh.num_indices > 0 &&
+      *std::max_element(mesh.indices, mesh.indices + mesh.num_indices) >=
+          mesh.num_vertices)
+    throw std::runtime_error("Mesh index out of range");
+}
+
+void AppendFloat(std::string &str, float value) {
+  char buf[32];
+  char *end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+  str.append(buf, end);
+}
+
+void AppendVec3(std::string &str, const glm::vec3 &v) {
+  str += '[';
+  AppendFloat(str, v.x); str += ',';
+  AppendFloat(str, v.y); str += ',';
+  AppendFloat(str, v.z);
+  str += ']';
+}
+
+void PutPLYHeader(BinaryFile &file, size_t num_vertices, size_t num_faces,
+                  bool has_normals) {
+  std::string header =
+      "ply\n"
+      "format binary_little_endian 1.0\n"
+      "comment exported by vktuto\n"
+      "element vertex " + std::to_string(num_vertices) + "\n"
+      "property float x\n"
+      "property float y\n"
+      "property float z\n";
+  if (has_normals) {
+    header += "property float nx\n"
+              "property float ny\n"
+              "property float nz\n";
+  }
+  header += "element face " + std::to_string(num_faces) + "\n"
+            "property list uchar uint vertex_indices\n"
+            "end_header\n";
+  file.PutBytes(header.data(), header.size());
+}
+
+void PutPLYVertices(BinaryFile &file, const glm::vec3 *positions,
+                    const glm::vec3 *normals, size_t count) {
+  if (normals == nullptr) {
+    file.PutBytes(positions, count * sizeof(glm::vec3));
+    return;
+  }
+  for (size_t i = 0; i < count; i++) {
+    file.Put(positions[i]);
+    file.Put(normals[i]);
+  }
+}
+
+void PutPLYFaces(BinaryFile &file, const uint32_t *indices,
+                 size_t num_indices) {
+  const uint8_t corners = 3;
+  for (size_t i = 0; i + 2 < num_indices; i += 3) {
+    file.Put(corners);
+    file.Put(indices[i]);
+    file.Put(indices[i + 1]);
+    file.Put(indices[i + 2]);
+  }
+}
+
+} // namespace
+
+MeshView::MeshView(const std::vector<glm::vec3> &positions,
+                   const std::vector<uint32_t> &indices,
+                   const std::vector<glm::vec3> *normals)
+    : positions(positions.data()), num_vertices(positions.size()),
+      normals(normals != nullptr ? normals->data() : nullptr),
+      indices(indices.data()), num_indices(indices.size()) {}
+
+void SaveMeshPLY(const std::string &file_name, const MeshView &mesh) {
+  CheckMesh(mesh);
+  BinaryFile file(file_name);
+  PutPLYHeader(file, mesh.num_vertices, mesh.NumTriangles(),
+               mesh.normals != nullptr);
+  PutPLYVertices(file, mesh.positions, mesh.normals, mesh.num_vertices);
+  PutPLYFaces(file, mesh.indices, mesh.num_indices);
+  file.Close();
+}
+
+void SaveMeshSTL(const std::string &file_name, const MeshView &mesh) {
+  CheckMesh(mesh);
+  if (mesh.NumTriangles() > std::numeric_limits<uint32_t>::max())
+    throw std::runtime_error("Too many triangles for STL");
+  BinaryFile file(file_name);
+
+  char header[80] = "binary STL exported by vktuto";
+  file.PutBytes(header, sizeof(header));
+  file.Put(static_cast<uint32_t>(mesh.NumTriangles()));
+
+  const uint16_t attribute = 0;
+  for (size_t i = 0; i < mesh.num_indices; i += 3) {
+    const glm::vec3 &p0 = mesh.positions[mesh.indices[i]];
+    const glm::vec3 &p1 = mesh.positions[mesh.indices[i + 1]];
+    const glm::vec3 &p2 = mesh.positions[mesh.indices[i + 2]];
+    glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+    float length = glm::length(normal);
+    normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+    file.Put(normal);
+    file.Put(p0);
+    file.Put(p1);
+    file.Put(p2);
+    file.Put(attribute);
+  }
+  file.Close();
+}
+
+void SaveMeshGLB(const std::string &file_name, const MeshView &mesh) {
+  CheckMesh(mesh);
+
+  const bool has_normals = mesh.normals != nullptr;
+  const size_t position_bytes = mesh.num_vertices * sizeof(glm::vec3);
+  const size_t normal_bytes = has_normals ? position_bytes : 0;
+  const size_t index_bytes = mesh.num_indices * sizeof(uint32_t);
+  // Every view is a multiple of 4 bytes, so no padding between them
+  const size_t bin_bytes = position_bytes + normal_bytes + index_bytes;
+
+  // POSITION accessors must carry their bounds
+  glm::vec3 lower(0.0f), upper(0.0f);
+  if (mesh.num_vertices > 0) {
+    lower = upper = mesh.positions[0];
+    for (size_t i = 1; i < mesh.num_vertices; i++) {
+      lower = glm::min(lower, mesh.positions[i]);
+      upper = glm::max(upper, mesh.positions[i]);
+    }
+  }
+
+  std::string json;
+  json.reserve(1024);
+  json += "{\"asset\":{\"version\":\"2.0\",\"generator\":\"vktuto\"},"
+          "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+          "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0";
+  if (has_normals) json += ",\"NORMAL\":2";
+  json += "},\"indices\":1,\"mode\":4}]}],";
+  json += "\"buffers\":[{\"byteLength\":" + std::to_string(bin_bytes) + "}],";
+  json += "\"bufferViews\":["
+          "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" +
+          std::to_string(position_bytes) + ",\"target\":34962},"
+          "{\"buffer\":0,\"byteOffset\":" +
+          std::to_string(position_bytes + normal_bytes) +
+          ",\"byteLength\":" + std::to_string(index_bytes) +
+          ",\"target\":34963}";
+  if (has_normals) {
+    json += ",{\"buffer\":0,\"byteOffset\":" + std::to_string(position_bytes) +
+            ",\"byteLength\":" + std::to_string(normal_bytes) +
+            ",\"target\":34962}";
+  }
+  json += "],\"accessors\":["
+          "{\"bufferView\":0,\"componentType\":5126,\"count\":" +
+          std::to_string(mesh.num_vertices) + ",\"type\":\"VEC3\",\"min\":";
+  AppendVec3(json, lower);
+  json += ",\"max\":";
+  AppendVec3(json, upper);
+  json += "},{\"bufferView\":1,\"componentType\":5125,\"count\":" +
+          std::to_string(mesh.num_indices) + ",\"type\":\"SCALAR\"}";
+  if (has_normals) {
+    json += ",{\"bufferView\":2,\"componentType\":5126,\"count\":" +
+            std::to_string(mesh.num_vertices) + ",\"type\":\"VEC3\"}";
+  }
+  json += "]}";
+  const size_t json_padding = (4 - json.size() % 4) % 4;
+  const size_t json_chunk = json.size() + json_padding;
+
+  const uint64_t total = 12 + 8 + json_chunk + 8 + bin_bytes;
+  if (total > std::numeric_limits<uint32_t>::max())
+    throw std::runtime_error("Mesh too large for a single .glb file");
+
+  BinaryFile file(file_name);
+  file.Put(uint32_t(0x46546C67));  // "glTF"
+  file.Put(uint32_t(2));
+  file.Put(static_cast<uint32_t>(total));
+
+  file.Put(static_cast<uint32_t>(json_chunk));
+  file.Put(uint32_t(0x4E4F534A));  // "JSON"
+  file.PutBytes(json.data(), json.size());
+  file.PutPadding(json_padding, ' ');
+
+  file.Put(static_cast<uint32_t>(bin_bytes));
+  file.Put(uint32_t(0x004E4942));  // "BIN\0"
+  file.PutBytes(mesh.positions, position_bytes);
+  if (has_normals) file.PutBytes(mesh.normals, normal_bytes);
+  file.PutBytes(mesh.indices, index_bytes);
+  file.Close();
+}
+
+PlyStreamWriter::PlyStreamWriter(const std::string &file_name)
+    : file_name_(file_name), faces_name_(file_name + ".faces") {}
+
+PlyStreamWriter::~PlyStreamWriter() {
+  if (faces_) {
+    faces_.reset();
+    std::remove(faces_name_.c_str());
+  }
+}
+
+void PlyStreamWriter::Begin(size_t num_vertices, size_t num_indices,
+                            bool has_normals) {
+  file_ = std::make_unique<BinaryFile>(file_name_);
+  faces_ = std::make_unique<BinaryFile>(faces_name_);
+  PutPLYHeader(*file_, num_vertices, num_indices / 3, has_normals);
+  vertices_written_ = 0;
+}
+
+void PlyStreamWriter::AddVertices(size_t first_vertex,
+                                  const glm::vec3 *positions,
+                                  const glm::vec3 *normals, size_t count) {
+  // The file has no room for gaps or reordering
+  if (first_vertex != vertices_written_)
+    throw std::runtime_error("Mesh vertices arrived out of order");
+  PutPLYVertices(*file_, positions, normals, count);
+  vertices_written_ += count;
+}
+
+void PlyStreamWriter::AddTriangles(const uint32_t *indices,
+                                   size_t num_indices) {
+  PutPLYFaces(*faces_, indices, num_indices);
+}
+
+void PlyStreamWriter::End() {
+  faces_->Close();
+  faces_.reset();
+
+  // Append the spooled faces after the vertex element
+  std::ifstream in(faces_name_, std::ios::binary);
+  std::vector<char> block(1 << 20);
+  while (in) {
+    in.read(block.data(), block.size());
+    file_->PutBytes(block.data(), static_cast<size_t>(in.gcount()));
+  }
+  in.close();
+  std::remove(faces_name_.c_str());
+  file_->Close();
+  file_.reset();
+}
+
+} // inline namespace io
+
+} // namespace vktuto
@@ -0,0 +1,123 @@
+#include "vktuto_mesh_opt.h"
+
+#include <algorithm>
+
+namespace vktuto {
+
+inline namespace algorithm {
+
+VertexCacheStats SimulateVertexCache(const uint32_t *indices,
+                                     size_t num_indices, size_t num_vertices,
+                                     unsigned int cache_size) {
+  VertexCacheStats stats;
+  stats.num_triangles = num_indices / 3;
+  if (num_indices == 0) return stats;
+
+  // A vertex is cached while fewer than cache_size misses happened since it
+  // was loaded; 0 marks vertices never loaded
+  std::vector<size_t> loaded_at(num_vertices, 0);
+  size_t time = cache_size + 1;
+  for (size_t idx = 0; idx < num_indices; idx++) {
+    uint32_t vertex = indices[idx];
+    if (loaded_at[vertex] == 0) stats.num_vertices++;
+    if (loaded_at[vertex] == 0 || time - loaded_at[vertex] > cache_size) {
+      loaded_at[vertex] = time++;
+      stats.num_transformed++;
+    }
+  }
+  if (stats.num_triangles > 0)
+    stats.acmr = float(stats.num_transformed) / float(stats.num_triangles);
+  stats.atvr = float(stats.num_transformed) / float(stats.num_vertices);
+  return stats;
+}
+
+void OptimizeVertexCache(uint32_t *indices, size_t num_indices,
+                         size_t num_vertices, unsigned int cache_size) {
+  const size_t num_triangles = num_indices / 3;
+  if (num_triangles == 0 || num_vertices == 0) return;
+
+  // Vertex -> triangle adjacency, compressed
+  std::vector<uint32_t> live(num_vertices, 0);
+  for (size_t idx = 0; idx < num_triangles * 3; idx++) live[indices[idx]]++;
+  std::vector<size_t> first(num_vertices + 1, 0);
+  for (size_t vertex = 0; vertex < num_vertices; vertex++)
+    first[vertex + 1] = first[vertex] + live[vertex];
+  std::vector<uint32_t> adjacency(first.back());
+  std::vector<size_t> fill(first.begin(), first.end() - 1);
+  for (size_t idx = 0; idx < num_triangles * 3; idx++)
+    adjacency[fill[indices[idx]]++] = static_cast<uint32_t>(idx / 3);
+
+  std::vector<uint32_t> output;
+  output.reserve(num_triangles * 3);
+  std::vector<bool> emitted(num_triangles, false);
+  std::vector<size_t> cached_at(num_vertices, 0);
+  std::vector<uint32_t> dead_end, candidates;
+  size_t time = cache_size + 1;
+  size_t cursor = 0;
+
+  // Most recent vertex with triangles left, else the next one in input order
+  auto skip_dead_end = [&]() -> long long {
+    while (!dead_end.empty()) {
+      uint32_t vertex = dead_end.back();
+      dead_end.pop_back();
+      if (live[vertex] > 0) return vertex;
+    }
+    for (; cursor < num_vertices; cursor++) {
+      if (live[cursor] > 0) return static_cast<long long>(cursor);
+    }
+    return -1;
+  };
+
+  long long fan = skip_dead_end();
+  while (fan >= 0) {
+    candidates.clear();
+    for (size_t adj = first[fan]; adj < first[fan + 1]; adj++) {
+      uint32_t triangle = adjacency[adj];
+      if (emitted[triangle]) continue;
+      emitted[triangle] = true;
+      for (int corner = 0; corner < 3; corner++) {
+        uint32_t vertex = indices[3 * triangle + corner];
+        output.push_back(vertex);
+        dead_end.push_back(vertex);
+        candidates.push_back(vertex);
+        live[vertex]--;
+        if (time - cached_at[vertex] > cache_size) cached_at[vertex] = time++;
+      }
+    }
+
+    // Next fan: the candidate that stays cached longest while its remaining
+    // triangles are emitted. A candidate that would drop out of the cache
+    // meanwhile has priority 0 and is never picked; with none left the
+    // dead-end stack and then the input order decide.
+    long long next = -1;
+    size_t best = 0;
+    for (uint32_t vertex : candidates) {
+      if (live[vertex] == 0) continue;
+      size_t age = time - cached_at[vertex];
+      size_t priority = age + 2 * live[vertex] <= cache_size ? age : 0;
+      if (priority > best) {
+        best = priority;
+        next = vertex;
+      }
+    }
+    fan = next >= 0 ? next : skip_dead_end();
+  }
+
+  std::copy(output.begin(), output.end(), indices);
+}
+
+size_t OptimizeVertexFetch(uint32_t *indices, size_t num_indices,
+                           size_t num_vertices, std::vector<uint32_t> &remap) {
+  remap.assign(num_vertices, ~0u);
+  uint32_t next = 0;
+  for (size_t idx = 0; idx < num_indices; idx++) {
+    uint32_t &vertex = remap[indices[idx]];
+    if (vertex == ~0u) vertex = next++;
+    indices[idx] = vertex;
+  }
+  return next;
+}
+
+} // inline namespace algorithm
+
+} // namespace vktuto
@@ -1,9 +1,253 @@
 #include "vktuto_nurbs.h"
 
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
 namespace vktuto {
 
 inline namespace algorithm {
 
+namespace {
+
+// Two triangles per grid quad whose lower-left corner is 'idx'
+inline void PutQuad(uint32_t idx, uint32_t num_v, uint32_t *out) {
+  out[0] = idx;     out[1] = idx + 1;          out[2] = idx + num_v;
+  out[3] = idx + 1; out[4] = idx + 1 + num_v;  out[5] = idx + num_v;
+}
+
+// Samples between two looks at the clock in IncrementalTessellation::Step();
+// a few dozen microseconds of work
+constexpr size_t kSamplesPerSlice = 64;
+
+// u-rows per work item of TessellateSurfaceParallel()
+constexpr unsigned int kRowsPerBand = 8;
+
+// Evaluations a thread tallies before adding them to EvaluationStats
+constexpr uint64_t kEvaluationsPerFlush = 4096;
+
+// SurfaceEvaluator evaluations of this thread not yet in EvaluationStats
+struct PendingEvaluations {
+  uint64_t points = 0, normals = 0;
+};
+thread_local PendingEvaluations t_pending;
+
+} // namespace
+
+EvaluationStats & EvaluationStats::Global() {
+  static EvaluationStats stats;
+  return stats;
+}
+
+void EvaluationStats::FlushSurface() {
+  EvaluationStats &stats = Global();
+  if (t_pending.points > 0)
+    stats.surface_points.fetch_add(t_pending.points,
+                                   std::memory_order_relaxed);
+  if (t_pending.normals > 0)
+    stats.surface_normals.fetch_add(t_pending.normals,
+                                    std::memory_order_relaxed);
+  t_pending = PendingEvaluations();
+}
+
+void EvaluationStats::AddCurve(size_t points) {
+  Global().curve_points.fetch_add(points, std::memory_order_relaxed);
+}
+
+SurfaceEvaluator::SurfaceEvaluator(const nurbs::RationalSurface3f &surface)
+    : degree_u_(surface.degree_u), degree_v_(surface.degree_v),
+      knots_u_(surface.knots_u), knots_v_(surface.knots_v),
+      homogeneous_(nurbs::util::CartesianToHomogenous(surface.control_points,
+                                                      surface.weights)),
+      min_u_(knots_u_[degree_u_]),
+      max_u_(knots_u_[knots_u_.size() - degree_u_ - 1]),
+      min_v_(knots_v_[degree_v_]),
+      max_v_(knots_v_[knots_v_.size() - degree_v_ - 1]) {}
+
+glm::vec3 SurfaceEvaluator::Point(float u, float v) const {
+  glm::vec4 pointw = nurbs::internal::SurfacePoint(
+      degree_u_, degree_v_, knots_u_, knots_v_, homogeneous_, u, v);
+  if (++t_pending.points == kEvaluationsPerFlush)
+    EvaluationStats::FlushSurface();
+  return nurbs::util::HomogenousToCartesian(pointw);
+}
+
+glm::vec3 SurfaceEvaluator::Normal(float u, float v) const {
+  nurbs::array2<glm::vec4> ders = nurbs::internal::SurfaceDerivatives(
+      degree_u_, degree_v_, knots_u_, knots_v_, homogeneous_, 1u, u, v);
+  if (++t_pending.normals == kEvaluationsPerFlush)
+    EvaluationStats::FlushSurface();
+  // Quotient rule on S = A / w
+  float w = ders(0, 0).w;
+  glm::vec3 point = glm::vec3(ders(0, 0)) / w;
+  glm::vec3 der_u = (glm::vec3(ders(1, 0)) - ders(1, 0).w * point) / w;
+  glm::vec3 der_v = (glm::vec3(ders(0, 1)) - ders(0, 1).w * point) / w;
+  glm::vec3 normal = glm::cross(der_v, der_u);
+  float length = glm::length(normal);
+  return length > 0.0f ? normal / length : normal;
+}
+
+float SurfaceEvaluator::ParameterU(size_t idx, size_t count) const noexcept {
+  if (count < 2) return min_u_;
+  return min_u_ + (max_u_ - min_u_) * static_cast<float>(idx) / (count - 1);
+}
+
+float SurfaceEvaluator::ParameterV(size_t idx, size_t count) const noexcept {
+  if (count < 2) return min_v_;
+  return min_v_ + (max_v_ - min_v_) * static_cast<float>(idx) / (count - 1);
+}
+
+void TessellateSurface(const nurbs::RationalSurface3f &surface,
+                       unsigned int num_u, unsigned int num_v,
+                       std::vector<glm::vec3> &positions,
+                       std::vector<glm::vec3> *normals) {
+  SurfaceEvaluator evaluator(surface);
+  positions.resize(size_t(num_u) * num_v);
+  if (normals) normals->resize(positions.size());
+  TessellateSurfaceRows(evaluator, num_u, num_v, 0, num_u, positions.data(),
+                        normals ? normals->data() : nullptr);
+}
+
+void TessellateSurfaceRows(const SurfaceEvaluator &evaluator,
+                           unsigned int num_u, unsigned int num_v,
+                           unsigned int row_begin, unsigned int row_end,
+                           glm::vec3 *positions, glm::vec3 *normals) {
+  for (size_t u_idx = row_begin; u_idx < row_end; u_idx++) {
+    float para_u = evaluator.ParameterU(u_idx, num_u);
+    for (size_t v_idx = 0; v_idx < num_v; v_idx++) {
+      float para_v = evaluator.ParameterV(v_idx, num_v);
+      size_t idx = num_v * u_idx + v_idx;
+      positions[idx] = evaluator.Point(para_u, para_v);
+      if (normals) normals[idx] = evaluator.Normal(para_u, para_v);
+    }
+  }
+  EvaluationStats::FlushSurface();
+}
+
+void TessellateSurfaceParallel(const SurfaceEvaluator &evaluator,
+                               unsigned int num_u, unsigned int num_v,
+                               nurbs::util::ThreadPool *pool,
+                               glm::vec3 *positions, glm::vec3 *normals) {
+  if (pool == nullptr) {
+    TessellateSurfaceRows(evaluator, num_u, num_v, 0, num_u, positions,
+                          normals);
+    return;
+  }
+  const size_t num_bands = (num_u + kRowsPerBand - 1) / kRowsPerBand;
+  pool->ParallelFor(num_bands, [&](size_t band) {
+    const unsigned int row_begin = unsigned(band) * kRowsPerBand;
+    const unsigned int row_end = std::min(row_begin + kRowsPerBand, num_u);
+    TessellateSurfaceRows(evaluator, num_u, num_v, row_begin, row_end,
+                          positions, normals);
+  });
+}
+
+void IncrementalTessellation::Start(const nurbs::RationalSurface3f &surface,
+                                   unsigned int num_u, unsigned int num_v,
+                                   bool normals) {
+  evaluator_ = std::make_unique<SurfaceEvaluator>(surface);
+  num_u_ = std::max(2u, num_u);
+  num_v_ = std::max(2u, num_v);
+  next_ = 0;
+  positions_.resize(size_t(num_u_) * num_v_);
+  normals_.resize(normals ? positions_.size() : 0);
+
+  lower_ = upper_ = surface.control_points(0, 0);
+  for (size_t i = 0; i < surface.control_points.rows(); i++) {
+    for (size_t j = 0; j < surface.control_points.cols(); j++) {
+      lower_ = glm::min(lower_, surface.control_points(i, j));
+      upper_ = glm::max(upper_, surface.control_points(i, j));
+    }
+  }
+}
+
+unsigned int IncrementalTessellation::Step(Clock::time_point deadline) {
+  if (!evaluator_) return 0;
+  const unsigned int rows_before = rows_done();
+  const size_t total = size_t(num_u_) * num_v_;
+  do {
+    // A slice of samples, then a look at the clock
+    const size_t end = std::min(next_ + kSamplesPerSlice, total);
+    for (; next_ < end; next_++) {
+      const size_t u_idx = next_ / num_v_, v_idx = next_ % num_v_;
+      const float para_u = evaluator_->ParameterU(u_idx, num_u_);
+      const float para_v = evaluator_->ParameterV(v_idx, num_v_);
+      positions_[next_] = evaluator_->Point(para_u, para_v);
+      if (!normals_.empty())
+        normals_[next_] = evaluator_->Normal(para_u, para_v);
+    }
+  } while (next_ < total && Clock::now() < deadline);
+  EvaluationStats::FlushSurface();
+  // Done: the evaluator is no longer needed
+  if (next_ == total) evaluator_.reset();
+  return rows_done() - rows_before;
+}
+
+void IncrementalTessellation::Cancel() {
+  evaluator_.reset();
+  num_u_ = num_v_ = 0;
+  next_ = 0;
+}
+
+void TessellateSurfaceStreaming(
+    const nurbs::RationalSurface3f &surface,
+    unsigned int num_u, unsigned int num_v,
+    MeshSink &sink,
+    const StreamingTessellationOptions &options) {
+  if (num_u < 2 || num_v < 2) return;
+  if (size_t(num_u) * num_v > std::numeric_limits<uint32_t>::max())
+    throw std::runtime_error("Tessellation exceeds 32-bit vertex indices");
+
+  SurfaceEvaluator evaluator(surface);
+
+  // Bytes one u-row adds to a tile: its vertices and the quads joining it to
+  // the previous row
+  size_t row_bytes = num_v * sizeof(glm::vec3) * (options.normals ? 2 : 1) +
+                     (num_v - 1) * 6 * sizeof(uint32_t);
+  size_t rows_per_tile = std::max<size_t>(1, options.memory_budget / row_bytes);
+  rows_per_tile = std::min<size_t>(rows_per_tile, num_u);
+
+  std::vector<glm::vec3> positions(rows_per_tile * num_v);
+  std::vector<glm::vec3> normals(options.normals ? positions.size() : 0);
+  std::vector<uint32_t> indices(rows_per_tile * (num_v - 1) * 6);
+
+  sink.Begin(size_t(num_u) * num_v, size_t(num_u - 1) * (num_v - 1) * 6,
+             options.normals);
+  for (size_t row_begin = 0; row_begin < num_u; row_begin += rows_per_tile) {
+    size_t row_end = std::min<size_t>(row_begin + rows_per_tile, num_u);
+
+    // New vertex rows of this tile
+    for (size_t u_idx = row_begin; u_idx < row_end; u_idx++) {
+      float para_u = evaluator.ParameterU(u_idx, num_u);
+      for (size_t v_idx = 0; v_idx < num_v; v_idx++) {
+        float para_v = evaluator.ParameterV(v_idx, num_v);
+        size_t local = num_v * (u_idx - row_begin) + v_idx;
+        positions[local] = evaluator.Point(para_u, para_v);
+        if (options.normals)
+          normals[local] = evaluator.Normal(para_u, para_v);
+      }
+    }
+    size_t count = (row_end - row_begin) * num_v;
+    EvaluationStats::FlushSurface();
+    sink.AddVertices(row_begin * num_v, positions.data(),
+                     options.normals ? normals.data() : nullptr, count);
+
+    // Quads ending on this tile's rows; the first one reaches back to the
+    // seam row emitted by the previous tile
+    size_t num_indices = 0;
+    for (size_t u_idx = std::max<size_t>(row_begin, 1); u_idx < row_end;
+         u_idx++) {
+      for (size_t v_idx = 0; v_idx + 1 < num_v; v_idx++) {
+        uint32_t idx = static_cast<uint32_t>(num_v * (u_idx - 1) + v_idx);
+        PutQuad(idx, num_v, indices.data() + num_indices);
+        num_indices += 6;
+      }
+    }
+    if (num_indices > 0) sink.AddTriangles(indices.data(), num_indices);
+  }
+  sink.End();
+}
+
 } // inline namespace algorithm
 
-} // namespace vktuto
\ No newline at end of file
+} // namespace vktuto
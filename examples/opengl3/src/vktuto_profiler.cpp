@@ -0,0 +1,569 @@
+#include "vktuto_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <malloc.h>
+#endif
+
+#include "imgui.h"
+
+#include "vktuto_gl_buffer.h"
+
+// Configuration file (edit vktuto_config.h or define VKTUTO_USER_CONFIG to
+// set your own filename)
+#ifdef VKTUTO_USER_CONFIG
+#include VKTUTO_USER_CONFIG
+#endif
+#if !defined(VKTUTO_DISABLE_INCLUDE_CONFIG_H) || \
+     defined(VKTUTO_INCLUDE_CONFIG_H)
+#include "vktuto_config.h"
+#endif
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+namespace {
+
+// Constant-initialized, so it counts the allocations of static constructors
+// as well
+AllocationStats g_allocations;
+
+double Milliseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+double SectionValue(const FrameStats &stats, size_t section,
+                    ProfileClock clock) {
+  return clock == ProfileClock::kGpu ? stats.gpu_ms[section]
+                                     : stats.cpu_ms[section];
+}
+
+// Sorts 'values'
+ProfileSummary SummarizeValues(std::vector<double> &values) {
+  ProfileSummary summary;
+  summary.samples = values.size();
+  if (values.empty()) return summary;
+  std::sort(values.begin(), values.end());
+  auto percentile = [&values](double fraction) {
+    return values[static_cast<size_t>(fraction * (values.size() - 1) + 0.5)];
+  };
+  for (double value : values) summary.mean += value;
+  summary.mean /= values.size();
+  summary.p50 = percentile(0.50);
+  summary.p95 = percentile(0.95);
+  summary.p99 = percentile(0.99);
+  summary.max = values.back();
+  return summary;
+}
+
+// User and kernel time of all threads
+double ProcessCpuSeconds() {
+#if defined(_WIN32)
+  FILETIME creation, exit, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    return 0.0;
+  auto seconds = [](const FILETIME &time) {
+    return ((ULONGLONG(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1.0e-7;
+  };
+  return seconds(kernel) + seconds(user);
+#else
+  return double(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+} // namespace
+
+AllocationStats & AllocationStats::Global() {
+  return g_allocations;
+}
+
+bool AllocationStats::Enabled() {
+  return VKTUTO_COUNT_ALLOCATIONS != 0;
+}
+
+FrameProfiler::FrameProfiler(size_t history)
+    : history_(std::max<size_t>(history, 1)),
+      usage_start_(Clock::now()),
+      usage_cpu_seconds_(ProcessCpuSeconds()),
+      gpu_timers_(GLCapabilities::Get().timer_query) {
+}
+
+FrameProfiler::~FrameProfiler() {
+  if (!queries_created_) return;
+  for (QuerySet &set : sets_)
+    glDeleteQueries(static_cast<GLsizei>(kNumProfileSections), set.queries);
+}
+
+void FrameProfiler::BeginFrame() {
+  if (in_frame_) EndFrame();
+  const unsigned long long frame = next_frame_++;
+  current_ = FrameStats();
+  current_.frame = frame;
+  std::fill(std::begin(cpu_depth_), std::end(cpu_depth_), 0);
+  active_gpu_ = -1;
+  in_frame_ = true;
+
+  // The set about to be reused was issued kQuerySets frames ago
+  if (queries_created_) CollectGpuResults(CurrentSet());
+  CurrentSet().frame = frame;
+
+  const UploadStats &uploads = UploadStats::Global();
+  upload_bytes_start_ = uploads.bytes;
+  uploads_start_ = uploads.uploads;
+  allocations_start_ =
+      g_allocations.allocations.load(std::memory_order_relaxed);
+  frame_start_ = Clock::now();
+
+  const double wall_seconds = std::chrono::duration<double>(
+      frame_start_ - usage_start_).count();
+  if (wall_seconds >= 1.0) {
+    const double cpu_seconds = ProcessCpuSeconds();
+    std::lock_guard<std::mutex> lock(history_mutex_);
+    cpu_usage_ = (cpu_seconds - usage_cpu_seconds_) / wall_seconds;
+    usage_cpu_seconds_ = cpu_seconds;
+    usage_start_ = frame_start_;
+  }
+}
+
+void FrameProfiler::EndFrame() {
+  if (!in_frame_) return;
+  if (active_gpu_ >= 0) EndGpu(static_cast<ProfileSection>(active_gpu_));
+  current_.cpu_ms[static_cast<size_t>(ProfileSection::kFrame)] =
+      Milliseconds(Clock::now() - frame_start_);
+
+  // Stats are reset by benchmarks between phases; never report negatives
+  const UploadStats &uploads = UploadStats::Global();
+  current_.upload_bytes = uploads.bytes >= upload_bytes_start_
+      ? uploads.bytes - upload_bytes_start_ : uploads.bytes;
+  current_.uploads = uploads.uploads >= uploads_start_
+      ? uploads.uploads - uploads_start_ : uploads.uploads;
+  current_.allocations = static_cast<size_t>(
+      g_allocations.allocations.load(std::memory_order_relaxed) -
+      allocations_start_);
+
+  std::lock_guard<std::mutex> lock(history_mutex_);
+  history_[head_] = current_;
+  head_ = (head_ + 1) % history_.size();
+  count_ = std::min(count_ + 1, history_.size());
+  in_frame_ = false;
+}
+
+void FrameProfiler::BeginCpu(ProfileSection section) {
+  const size_t idx = static_cast<size_t>(section);
+  if (!in_frame_ || cpu_depth_[idx]++ > 0) return;
+  cpu_start_[idx] = Clock::now();
+}
+
+void FrameProfiler::EndCpu(ProfileSection section) {
+  const size_t idx = static_cast<size_t>(section);
+  if (!in_frame_ || cpu_depth_[idx] == 0 || --cpu_depth_[idx] > 0) return;
+  current_.cpu_ms[idx] += Milliseconds(Clock::now() - cpu_start_[idx]);
+}
+
+void FrameProfiler::AddCpuTime(ProfileSection section, double ms) {
+  if (in_frame_) current_.cpu_ms[static_cast<size_t>(section)] += ms;
+}
+
+void FrameProfiler::BeginGpu(ProfileSection section) {
+  // One GL_TIME_ELAPSED query can be active at a time
+  if (!gpu_timers_ || !in_frame_ || active_gpu_ >= 0 ||
+      section == ProfileSection::kFrame)
+    return;
+  if (!queries_created_) {
+    for (QuerySet &set : sets_)
+      glGenQueries(static_cast<GLsizei>(kNumProfileSections), set.queries);
+    queries_created_ = true;
+  }
+  const size_t idx = static_cast<size_t>(section);
+  QuerySet &set = CurrentSet();
+  // Sections entered twice keep the first interval only; queries cannot
+  // be summed before their results are read
+  if (set.issued[idx]) return;
+  glBeginQuery(GL_TIME_ELAPSED, set.queries[idx]);
+  set.issued[idx] = true;
+  active_gpu_ = static_cast<int>(idx);
+}
+
+void FrameProfiler::EndGpu(ProfileSection section) {
+  if (active_gpu_ != static_cast<int>(section)) return;
+  glEndQuery(GL_TIME_ELAPSED);
+  active_gpu_ = -1;
+}
+
+void FrameProfiler::CollectGpuResults(QuerySet &set) {
+  bool any = false, ready = true;
+  for (size_t idx = 0; idx < kNumProfileSections && ready; idx++) {
+    if (!set.issued[idx]) continue;
+    any = true;
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(set.queries[idx], GL_QUERY_RESULT_AVAILABLE,
+                       &available);
+    ready = available == GL_TRUE;
+  }
+  std::lock_guard<std::mutex> lock(history_mutex_);
+  FrameStats *stats = any ? FindFrame(set.frame) : nullptr;
+  if (any && !ready) dropped_++;
+  if (stats != nullptr && ready) {
+    double total = 0.0;
+    for (size_t idx = 0; idx < kNumProfileSections; idx++) {
+      if (!set.issued[idx]) continue;
+      GLuint64 nanoseconds = 0;
+      glGetQueryObjectui64v(set.queries[idx], GL_QUERY_RESULT, &nanoseconds);
+      stats->gpu_ms[idx] = nanoseconds / 1.0e6;
+      total += stats->gpu_ms[idx];
+    }
+    stats->gpu_ms[static_cast<size_t>(ProfileSection::kFrame)] = total;
+    stats->gpu_valid = true;
+  }
+  std::fill(std::begin(set.issued), std::end(set.issued), false);
+}
+
+FrameStats * FrameProfiler::FindFrame(unsigned long long frame) {
+  for (size_t idx = count_; idx-- > 0;) {
+    FrameStats &stats =
+        history_[(head_ + history_.size() - count_ + idx) % history_.size()];
+    if (stats.frame == frame) return &stats;
+    if (stats.frame < frame) break;
+  }
+  return nullptr;
+}
+
+ProfileSummary FrameProfiler::Summarize(ProfileSection section,
+                                        ProfileClock clock) const {
+  const size_t idx = static_cast<size_t>(section);
+  std::vector<double> values;
+  values.reserve(count_);
+  for (size_t frame = 0; frame < count_; frame++) {
+    const FrameStats &stats = at(frame);
+    if (clock == ProfileClock::kGpu && !stats.gpu_valid) continue;
+    values.push_back(SectionValue(stats, idx, clock));
+  }
+  return SummarizeValues(values);
+}
+
+void FrameProfiler::Reset() {
+  std::lock_guard<std::mutex> lock(history_mutex_);
+  head_ = 0;
+  count_ = 0;
+  // The frame in progress, if any, keeps its queries
+  for (QuerySet &set : sets_) {
+    if (in_frame_ && &set == &CurrentSet()) continue;
+    std::fill(std::begin(set.issued), std::end(set.issued), false);
+  }
+}
+
+const char * ProfileSectionName(ProfileSection section) {
+  switch (section) {
+    case ProfileSection::kFrame:       return "frame";
+    case ProfileSection::kUpdate:      return "update";
+    case ProfileSection::kImGuiRender: return "imgui";
+    case ProfileSection::kCanvasDraw:  return "canvas";
+    case ProfileSection::kUpload:      return "upload";
+    case ProfileSection::kUiFrame:     return "ui frame";
+    default:                           return "?";
+  }
+}
+
+ProfileSummary SummarizeFrames(const std::vector<FrameStats> &frames,
+                              ProfileSection section, ProfileClock clock) {
+  const size_t idx = static_cast<size_t>(section);
+  std::vector<double> values;
+  values.reserve(frames.size());
+  for (const FrameStats &stats : frames) {
+    if (clock == ProfileClock::kGpu && !stats.gpu_valid) continue;
+    values.push_back(SectionValue(stats, idx, clock));
+  }
+  return SummarizeValues(values);
+}
+
+void WriteFrameStatsCsv(const std::string &file_name,
+                        const std::vector<FrameStats> &frames) {
+  std::ofstream csv(file_name);
+  if (!csv) throw std::runtime_error("Cannot write " + file_name);
+  csv << "frame";
+  for (size_t idx = 0; idx < kNumProfileSections; idx++) {
+    const char *name = ProfileSectionName(static_cast<ProfileSection>(idx));
+    csv << ",cpu_ms " << name << ",gpu_ms " << name;
+  }
+  csv << ",triangles,draw_calls,uploads,upload_bytes,allocations\n";
+  for (const FrameStats &stats : frames) {
+    csv << stats.frame;
+    for (size_t idx = 0; idx < kNumProfileSections; idx++) {
+      csv << ',' << stats.cpu_ms[idx] << ',';
+      if (stats.gpu_valid) csv << stats.gpu_ms[idx];
+    }
+    csv << ',' << stats.triangles << ',' << stats.draw_calls << ','
+        << stats.uploads << ',' << stats.upload_bytes << ',';
+    // Left empty when allocations are not counted
+    if (AllocationStats::Enabled()) csv << stats.allocations;
+    csv << '\n';
+  }
+  if (!csv) throw std::runtime_error("Cannot write " + file_name);
+}
+
+namespace {
+
+struct PlotSource {
+  const FrameProfiler *profiler;
+  ProfileClock clock;
+};
+
+float FrameTimeGetter(void *data, int idx) {
+  const PlotSource &source = *static_cast<const PlotSource *>(data);
+  const FrameStats &stats = source.profiler->at(idx);
+  if (source.clock == ProfileClock::kGpu && !stats.gpu_valid) return 0.0f;
+  return static_cast<float>(
+      SectionValue(stats, static_cast<size_t>(ProfileSection::kFrame),
+                   source.clock));
+}
+
+} // namespace
+
+void ShowProfilerOverlay(const FrameProfiler &profiler, bool *open) {
+  const float distance = 10.0f;
+  ImGuiIO &io = ImGui::GetIO();
+  ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - distance, distance),
+                          ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+  ImGui::SetNextWindowBgAlpha(0.35f);
+  const ImGuiWindowFlags flags =
+      ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoTitleBar |
+      ImGuiWindowFlags_NoResize | ImGuiWindowFlags_AlwaysAutoResize |
+      ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing |
+      ImGuiWindowFlags_NoNav;
+  if (!ImGui::Begin("Performance overlay", open, flags)) {
+    ImGui::End();
+    return;
+  }
+  // The render thread may be ending a frame meanwhile
+  std::unique_lock<std::mutex> lock = profiler.LockHistory();
+  if (profiler.empty()) {
+    ImGui::Text("No frames yet");
+    ImGui::End();
+    return;
+  }
+
+  const ProfileSummary frame = profiler.Summarize(ProfileSection::kFrame);
+  ImGui::Text("%.1f FPS, %.2f ms (p95 %.2f, p99 %.2f)",
+              frame.mean > 0.0 ? 1000.0 / frame.mean : 0.0, frame.mean,
+              frame.p95, frame.p99);
+
+  char overlay[32];
+  PlotSource cpu = { &profiler, ProfileClock::kCpu };
+  std::snprintf(overlay, sizeof(overlay), "CPU max %.1f ms", frame.max);
+  ImGui::PlotLines("##cpu", FrameTimeGetter, &cpu,
+                   static_cast<int>(profiler.size()), 0, overlay, 0.0f,
+                   static_cast<float>(std::max(frame.max, 1.0)),
+                   ImVec2(260, 50));
+  if (profiler.HasGpuTimers()) {
+    const ProfileSummary gpu =
+        profiler.Summarize(ProfileSection::kFrame, ProfileClock::kGpu);
+    PlotSource source = { &profiler, ProfileClock::kGpu };
+    std::snprintf(overlay, sizeof(overlay), "GPU max %.1f ms", gpu.max);
+    ImGui::PlotLines("##gpu", FrameTimeGetter, &source,
+                     static_cast<int>(profiler.size()), 0, overlay, 0.0f,
+                     static_cast<float>(std::max(gpu.max, 1.0)),
+                     ImVec2(260, 50));
+  }
+
+  // ms per section: CPU mean / p95, GPU mean
+  ImGui::Separator();
+  ImGui::Columns(4, "sections", false);
+  ImGui::Text("section"); ImGui::NextColumn();
+  ImGui::Text("cpu"); ImGui::NextColumn();
+  ImGui::Text("p95"); ImGui::NextColumn();
+  ImGui::Text("gpu"); ImGui::NextColumn();
+  for (size_t idx = 1; idx < kNumProfileSections; idx++) {
+    const ProfileSection section = static_cast<ProfileSection>(idx);
+    const ProfileSummary summary = profiler.Summarize(section);
+    ImGui::Text("%s", ProfileSectionName(section)); ImGui::NextColumn();
+    ImGui::Text("%.2f", summary.mean); ImGui::NextColumn();
+    ImGui::Text("%.2f", summary.p95); ImGui::NextColumn();
+    const ProfileSummary gpu = profiler.Summarize(section, ProfileClock::kGpu);
+    if (gpu.samples > 0 && gpu.max > 0.0)
+      ImGui::Text("%.2f", gpu.mean);
+    else
+      ImGui::TextDisabled("-");
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+
+  ImGui::Separator();
+  const FrameStats &latest = profiler.Latest();
+  ImGui::Text("%zu triangles, %zu draw calls", latest.triangles,
+              latest.draw_calls);
+  ImGui::Text("uploads: %zu, %.1f KB this frame", latest.uploads,
+              latest.upload_bytes / 1024.0);
+  if (AllocationStats::Enabled())
+    ImGui::Text("allocations: %zu this frame", latest.allocations);
+  else
+    ImGui::TextDisabled("allocations: n/a");
+  if (latest.draw_calls == 0) ImGui::TextDisabled("canvas: cached");
+  ImGui::Text("process CPU: %.0f%% of a core",
+              100.0 * profiler.ProcessCpuUsage());
+  ImGui::End();
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
+
+#if VKTUTO_COUNT_ALLOCATIONS
+// Replacements of the global allocation functions, counting every call. The
+// array, sized and aligned forms are replaced too, as not every standard
+// library forwards them to the plain ones.
+namespace {
+
+// Memory of the aligned forms comes from the platform's aligned allocator,
+// which needs its own free
+void * AllocateCounted(std::size_t size, std::size_t alignment) {
+  vktuto::AllocationStats::Global().allocations.fetch_add(
+      1, std::memory_order_relaxed);
+  if (size == 0) size = 1;
+  for (;;) {
+    void *ptr = nullptr;
+    if (alignment == 0) {
+      ptr = std::malloc(size);
+    }
+    else {
+#if defined(_WIN32)
+      ptr = _aligned_malloc(size, alignment);
+#else
+      if (posix_memalign(&ptr, std::max(alignment, sizeof(void *)), size) != 0)
+        ptr = nullptr;
+#endif
+    }
+    if (ptr != nullptr) return ptr;
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) throw std::bad_alloc();
+    handler();
+  }
+}
+
+void FreeCounted(void *ptr, bool aligned) noexcept {
+  if (ptr == nullptr) return;
+  vktuto::AllocationStats::Global().frees.fetch_add(
+      1, std::memory_order_relaxed);
+#if defined(_WIN32)
+  if (aligned) {
+    _aligned_free(ptr);
+    return;
+  }
+#else
+  (void)aligned;
+#endif
+  std::free(ptr);
+}
+
+} // namespace
+
+void * operator new(std::size_t size) {
+  return AllocateCounted(size, 0);
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return AllocateCounted(size, 0);
+  }
+  catch (...) {
+    return nullptr;
+  }
+}
+
+void * operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return operator new(size, std::nothrow);
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment) {
+  return AllocateCounted(size, static_cast<std::size_t>(alignment));
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment,
+                    const std::nothrow_t &) noexcept {
+  try {
+    return AllocateCounted(size, static_cast<std::size_t>(alignment));
+  }
+  catch (...) {
+    return nullptr;
+  }
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment) {
+  return operator new(size, alignment);
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment,
+                      const std::nothrow_t &) noexcept {
+  return operator new(size, alignment, std::nothrow);
+}
+
+void operator delete(void *ptr) noexcept {
+  FreeCounted(ptr, false);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  operator delete(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  operator delete(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  operator delete(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  operator delete(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+  operator delete(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+  FreeCounted(ptr, true);
+}
+
+void operator delete(void *ptr, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept {
+  operator delete(ptr, alignment);
+}
+
+void operator delete(void *ptr, std::size_t,
+                     std::align_val_t alignment) noexcept {
+  operator delete(ptr, alignment);
+}
+
+void operator delete[](void *ptr, std::align_val_t alignment) noexcept {
+  operator delete(ptr, alignment);
+}
+
+void operator delete[](void *ptr, std::align_val_t alignment,
+                       const std::nothrow_t &) noexcept {
+  operator delete(ptr, alignment);
+}
+
+void operator delete[](void *ptr, std::size_t,
+                       std::align_val_t alignment) noexcept {
+  operator delete(ptr, alignment);
+}
+#endif // VKTUTO_COUNT_ALLOCATIONS
@@ -0,0 +1,312 @@
+#include "vktuto_program_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <utility>
+
+#include "vktuto_gl_buffer.h"
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double MillisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Start of every binary file; the version changes with the file layout
+constexpr char     kMagic[4] = { 'V', 'K', 'P', 'B' };
+constexpr uint32_t kFileVersion = 1;
+
+struct BinaryHeader {
+  char     magic[4];
+  uint32_t version;
+  uint64_t key;
+  uint32_t format;
+  uint32_t length;
+};
+
+// 64-bit FNV-1a, continued from 'hash'
+uint64_t HashBytes(const void *data, size_t size,
+                   uint64_t hash = 14695981039346656037ull) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for (size_t idx = 0; idx < size; idx++) {
+    hash ^= bytes[idx];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+uint64_t HashString(const std::string &text, uint64_t hash) {
+  // The terminator keeps "ab" + "c" apart from "a" + "bc"
+  return HashBytes(text.c_str(), text.size() + 1, hash);
+}
+
+bool ReadFile(const std::string &file_name, std::string &out) {
+  std::ifstream in(file_name, std::ios::binary);
+  if (!in) return false;
+  out.assign(std::istreambuf_iterator<char>(in),
+             std::istreambuf_iterator<char>());
+  return !in.bad();
+}
+
+std::string GLString(GLenum name) {
+  const GLubyte *value = glGetString(name);
+  return value != nullptr ? reinterpret_cast<const char *>(value) : "";
+}
+
+GLuint StartShader(GLenum type, const std::string &source) {
+  GLuint shader = glCreateShader(type);
+  const GLchar *code = source.c_str();
+  glShaderSource(shader, 1, &code, NULL);
+  glCompileShader(shader);
+  return shader;
+}
+
+// Prints the log of a failed compile
+bool CheckShader(GLuint shader, const std::string &file_name) {
+  GLint result = GL_FALSE, log_length = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
+  if (result == GL_TRUE) return true;
+  glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_length);
+  std::string log(std::max(log_length, 1), '\0');
+  glGetShaderInfoLog(shader, log_length, NULL, &log[0]);
+  std::cerr << "Compiling " << file_name << " failed:\n" << log.c_str()
+            << std::endl;
+  return false;
+}
+
+bool CheckProgram(GLuint program, const ProgramFiles &files) {
+  GLint result = GL_FALSE, log_length = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &result);
+  if (result == GL_TRUE) return true;
+  glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_length);
+  std::string log(std::max(log_length, 1), '\0');
+  glGetProgramInfoLog(program, log_length, NULL, &log[0]);
+  std::cerr << "Linking " << files.vertex << " + " << files.fragment
+            << " failed:\n" << log.c_str() << std::endl;
+  return false;
+}
+
+} // namespace
+
+struct ProgramCache::Job {
+  const ProgramFiles *files = nullptr;
+  std::string vertex_source, fragment_source;
+  bool        sources_read = false;
+  uint64_t    key = 0;
+  // Cached binary to load, then the binary to store
+  std::string binary;
+  GLenum      format = 0;
+  bool        store = false;
+  GLuint      program = 0;
+  GLuint      vertex_shader = 0, fragment_shader = 0;
+};
+
+ProgramCache::ProgramCache(std::string directory)
+    : directory_(std::move(directory)) {
+  GLint num_formats = 0;
+  if (GLCapabilities::Get().program_binary)
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+  enabled_ = !directory_.empty() && num_formats > 0;
+  if (enabled_) {
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    enabled_ = std::filesystem::is_directory(directory_, error);
+  }
+  // Binaries only work with the driver that made them
+  for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION,
+                       GL_SHADING_LANGUAGE_VERSION })
+    driver_hash_ = HashString(GLString(name), driver_hash_);
+}
+
+std::vector<GLuint> ProgramCache::Load(const std::vector<ProgramFiles> &files) {
+  const Clock::time_point start = Clock::now();
+  stats_ = ProgramCacheStats();
+  stats_.programs = files.size();
+  std::vector<Job> jobs(files.size());
+  for (size_t idx = 0; idx < files.size(); idx++) jobs[idx].files = &files[idx];
+
+  // Files first, all at once
+  {
+    std::vector<std::future<void>> reads;
+    for (Job &job : jobs)
+      reads.push_back(std::async(std::launch::async,
+                                 [this, &job] { ReadJob(job); }));
+    for (std::future<void> &read : reads) read.get();
+  }
+  stats_.read_ms = MillisecondsSince(start);
+
+  const Clock::time_point link_start = Clock::now();
+  for (Job &job : jobs) {
+    if (job.binary.empty()) continue;
+    job.program = glCreateProgram();
+    glProgramBinary(job.program, job.format, job.binary.data(),
+                    GLsizei(job.binary.size()));
+    GLint result = GL_FALSE;
+    glGetProgramiv(job.program, GL_LINK_STATUS, &result);
+    if (result == GL_TRUE) {
+      stats_.cached++;
+      continue;
+    }
+    // Refused, e.g. after a driver update with the same version string
+    glDeleteProgram(job.program);
+    job.program = 0;
+    stats_.rejected++;
+  }
+
+  // Every compile and link is issued before the first status query, which
+  // would wait for it
+  std::vector<Job *> compiles;
+  for (Job &job : jobs) {
+    if (job.program == 0 && job.sources_read) compiles.push_back(&job);
+  }
+  for (Job *job : compiles) {
+    job->vertex_shader = StartShader(GL_VERTEX_SHADER, job->vertex_source);
+    job->fragment_shader = StartShader(GL_FRAGMENT_SHADER,
+                                       job->fragment_source);
+  }
+  for (Job *job : compiles) {
+    job->program = glCreateProgram();
+    glAttachShader(job->program, job->vertex_shader);
+    glAttachShader(job->program, job->fragment_shader);
+    if (enabled_) {
+      glProgramParameteri(job->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                          GL_TRUE);
+    }
+    glLinkProgram(job->program);
+  }
+  for (Job *job : compiles) {
+    // Both logs, even when the first one failed
+    const bool vertex_compiled =
+        CheckShader(job->vertex_shader, job->files->vertex);
+    const bool fragment_compiled =
+        CheckShader(job->fragment_shader, job->files->fragment);
+    const bool linked = vertex_compiled && fragment_compiled &&
+                        CheckProgram(job->program, *job->files);
+    glDetachShader(job->program, job->vertex_shader);
+    glDetachShader(job->program, job->fragment_shader);
+    glDeleteShader(job->vertex_shader);
+    glDeleteShader(job->fragment_shader);
+    if (!linked) {
+      glDeleteProgram(job->program);
+      job->program = 0;
+      continue;
+    }
+    stats_.compiled++;
+    if (!enabled_) continue;
+
+    GLint length = 0;
+    glGetProgramiv(job->program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) continue;
+    job->binary.resize(length);
+    GLsizei written = 0;
+    glGetProgramBinary(job->program, length, &written, &job->format,
+                       &job->binary[0]);
+    job->binary.resize(written);
+    job->store = written > 0;
+  }
+  stats_.link_ms = MillisecondsSince(link_start);
+
+  // For the next start
+  {
+    std::vector<std::future<void>> writes;
+    for (const Job &job : jobs) {
+      if (!job.store) continue;
+      writes.push_back(std::async(std::launch::async,
+                                  [this, &job] { WriteBinary(job); }));
+      stats_.stored++;
+    }
+    for (std::future<void> &write : writes) write.get();
+  }
+
+  std::vector<GLuint> programs;
+  programs.reserve(jobs.size());
+  for (const Job &job : jobs) programs.push_back(job.program);
+  stats_.total_ms = MillisecondsSince(start);
+  return programs;
+}
+
+void ProgramCache::Clear() {
+  if (directory_.empty()) return;
+  std::error_code error;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(directory_, error)) {
+    const std::string name = entry.path().filename().string();
+    if (name.rfind("program_", 0) == 0 && entry.path().extension() == ".bin")
+      std::filesystem::remove(entry.path(), error);
+  }
+}
+
+std::string ProgramCache::BinaryPath(uint64_t key) const {
+  char name[40];
+  std::snprintf(name, sizeof(name), "program_%016llx.bin",
+                static_cast<unsigned long long>(key));
+  return (std::filesystem::path(directory_) / name).string();
+}
+
+void ProgramCache::ReadJob(Job &job) const {
+  const bool vertex_read = ReadFile(job.files->vertex, job.vertex_source);
+  const bool fragment_read = ReadFile(job.files->fragment,
+                                      job.fragment_source);
+  if (!vertex_read || !fragment_read) {
+    std::cerr << "Unable to open " << (vertex_read ? job.files->fragment
+                                                   : job.files->vertex)
+              << std::endl;
+    return;
+  }
+  job.sources_read = true;
+  job.key = HashString(job.fragment_source,
+                       HashString(job.vertex_source, driver_hash_));
+  if (!enabled_) return;
+
+  // A missing, short or foreign file is a miss
+  std::string file;
+  if (!ReadFile(BinaryPath(job.key), file) || file.size() < sizeof(BinaryHeader))
+    return;
+  BinaryHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kFileVersion || header.key != job.key ||
+      header.length != file.size() - sizeof(header))
+    return;
+  job.format = header.format;
+  job.binary.assign(file, sizeof(header), std::string::npos);
+}
+
+void ProgramCache::WriteBinary(const Job &job) const {
+  // Written aside and renamed, so a concurrent start never reads half a file
+  const std::string path = BinaryPath(job.key);
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) return;
+    BinaryHeader header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFileVersion;
+    header.key = job.key;
+    header.format = job.format;
+    header.length = uint32_t(job.binary.size());
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(job.binary.data(), job.binary.size());
+    if (!out) return;
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) std::filesystem::remove(temporary, error);
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
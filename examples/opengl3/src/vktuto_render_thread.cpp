@@ -0,0 +1,230 @@
+#include "vktuto_render_thread.h"
+
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+namespace {
+
+// Reuses the capacity of 'target'; ImVector's assignment frees it first
+template <typename T>
+void CopyVector(ImVector<T> &target, const ImVector<T> &source) {
+  target.resize(source.Size);
+  if (source.Size > 0)
+    std::memcpy(target.Data, source.Data, source.size_in_bytes());
+}
+
+} // namespace
+
+const char * FramePacingName(FramePacing pacing) {
+  switch (pacing) {
+    case FramePacing::kQueue: return "queue";
+    default:                  return "latest";
+  }
+}
+
+void PruneCommands(std::vector<RenderCommand> &commands) {
+  // Backwards: a command is kept unless a later one rewrites its key
+  uint64_t rewritten = 0;
+  size_t kept = commands.size();
+  for (size_t idx = commands.size(); idx-- > 0;) {
+    const RenderCommand &command = commands[idx];
+    const uint64_t bit = command.key != 0 && command.key < 64
+        ? uint64_t(1) << command.key : 0;
+    if ((rewritten & bit) != 0) continue;
+    if (command.full) rewritten |= bit;
+    if (--kept != idx) commands[kept] = std::move(commands[idx]);
+  }
+  commands.erase(commands.begin(), commands.begin() + kept);
+}
+
+DrawDataCopy::~DrawDataCopy() {
+  for (ImDrawList *list : lists_) IM_DELETE(list);
+}
+
+void DrawDataCopy::Assign(const ImDrawData &source) {
+  // Lists beyond CmdListsCount stay allocated for busier frames
+  data_ = source;
+  while (lists_.size() < size_t(source.CmdListsCount))
+    lists_.push_back(IM_NEW(ImDrawList)(nullptr));
+  for (int idx = 0; idx < source.CmdListsCount; idx++) {
+    const ImDrawList &from = *source.CmdLists[idx];
+    ImDrawList &to = *lists_[idx];
+    CopyVector(to.CmdBuffer, from.CmdBuffer);
+    CopyVector(to.IdxBuffer, from.IdxBuffer);
+    CopyVector(to.VtxBuffer, from.VtxBuffer);
+    to.Flags = from.Flags;
+  }
+  data_.CmdLists = lists_.data();
+}
+
+RenderThread::RenderThread(Callback begin, PacketCallback run, Callback end,
+                           FramePacing pacing, size_t queued_frames)
+    : run_(std::move(run)), pacing_(pacing),
+      queued_frames_(queued_frames > 0 ? queued_frames : 1),
+      thread_(&RenderThread::Run, this, std::move(begin), std::move(end)) {
+}
+
+RenderThread::~RenderThread() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    pending_.clear();
+  }
+  changed_.notify_all();
+  if (thread_.joinable()) thread_.join();
+}
+
+void RenderThread::Submit(std::unique_ptr<FramePacket> packet) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (pacing_ == FramePacing::kQueue) {
+    changed_.wait(lock, [this] {
+      return pending_.size() < queued_frames_ || stopped_;
+    });
+  }
+  if (stopped_) {
+    lock.unlock();
+    RethrowError();
+    throw std::runtime_error("Render thread is stopped!");
+  }
+
+  if (pacing_ == FramePacing::kLatest && !pending_.empty()) {
+    // The last packet has not started yet, so it is still ours: its
+    // commands go first, then the newer frame replaces its frame. Commands
+    // without a frame run after the frame before them, so they are only
+    // merged into a commands-only packet.
+    FramePacket &older = *pending_.back();
+    if (packet->has_frame || !older.has_frame) {
+      std::vector<RenderCommand> &commands = older.commands;
+      commands.insert(commands.end(),
+                      std::make_move_iterator(packet->commands.begin()),
+                      std::make_move_iterator(packet->commands.end()));
+      packet->commands.clear();
+      if (packet->has_frame) {
+        if (older.has_frame) {
+          packet->MergeSkipped(older);
+          skipped_++;
+        }
+        packet->commands.swap(commands);
+        std::swap(pending_.back(), packet);
+      }
+      PruneCommands(pending_.back()->commands);
+      merged_.push_back(std::move(packet));
+    }
+  }
+  if (packet) pending_.push_back(std::move(packet));
+  lock.unlock();
+  changed_.notify_all();
+}
+
+void RenderThread::Finish() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] {
+      return (pending_.empty() && !busy_) || stopped_;
+    });
+  }
+  RethrowError();
+}
+
+void RenderThread::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+  if (thread_.joinable()) thread_.join();
+  RethrowError();
+}
+
+std::unique_ptr<FramePacket> RenderThread::Recycle() {
+  std::unique_ptr<FramePacket> packet;
+  if (!merged_.empty()) {
+    packet = std::move(merged_.back());
+    merged_.pop_back();
+  }
+  else {
+    done_.TryPop(packet);
+  }
+  return packet;
+}
+
+unsigned long long RenderThread::FramesDrawn() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return drawn_;
+}
+
+unsigned long long RenderThread::FramesSkipped() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return skipped_;
+}
+
+void RenderThread::Run(const Callback &begin, const Callback &end) {
+  std::exception_ptr error;
+  try {
+    begin();
+  }
+  catch (...) {
+    error = std::current_exception();
+  }
+
+  while (!error) {
+    std::unique_ptr<FramePacket> packet;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+      if (pending_.empty()) break;
+      packet = std::move(pending_.front());
+      pending_.pop_front();
+      busy_ = true;
+    }
+    // Room in the queue for the UI thread
+    changed_.notify_all();
+
+    try {
+      run_(*packet);
+    }
+    catch (...) {
+      error = std::current_exception();
+    }
+    const bool drawn = packet->has_frame && !error;
+    done_.Push(std::move(packet));
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      busy_ = false;
+      if (drawn) drawn_++;
+    }
+    changed_.notify_all();
+  }
+
+  try {
+    end();
+  }
+  catch (...) {
+    if (!error) error = std::current_exception();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    error_ = error;
+    stopped_ = true;
+  }
+  changed_.notify_all();
+}
+
+void RenderThread::RethrowError() {
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(error, error_);
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
@@ -1,10 +1,14 @@
 #include "vktuto_utility.h"
 
+#include <algorithm>        // std::min
+#include <exception>        // std::exception
 #include <ctype.h>          // toupper, isprint
 #include <limits.h>         // INT_MIN, INT_MAX
 #include <math.h>           // sqrtf, powf, cosf, sinf, floorf, ceilf
 #include <stdio.h>          // vsnprintf, sscanf, printf
+#include <stdarg.h>         // va_list, va_start, va_end
 #include <stdlib.h>         // NULL, malloc, free, atoi
+#include <string.h>         // memcpy, strchr, strlen, strstr
 #if defined(_MSC_VER) && _MSC_VER <= 1500 // MSVC 2008 or earlier
 #include <stddef.h>         // intptr_t
 #else
@@ -34,6 +38,16 @@
 #endif
 #endif
 
+// Configuration file (edit vktuto_config.h or define VKTUTO_USER_CONFIG to
+// set your own filename)
+#ifdef VKTUTO_USER_CONFIG
+#include VKTUTO_USER_CONFIG
+#endif
+#if !defined(VKTUTO_DISABLE_INCLUDE_CONFIG_H) || \
+     defined(VKTUTO_INCLUDE_CONFIG_H)
+#include "vktuto_config.h"
+#endif
+
 // Play it nice with Windows users. Notepad in 2017 still doesn't display text data with Unix-style \n.
 #ifdef _WIN32
 #define IM_NEWLINE "\r\n"
@@ -45,7 +59,57 @@ namespace vktuto {
 
 inline namespace utility {
 
-ConsoleApp::ConsoleApp() {
+ConsoleLog::ConsoleLog(size_t max_lines, size_t chunk_size, size_t max_chunks)
+    : chunk_size_(std::max<size_t>(chunk_size, 2)),
+      lines_(std::max<size_t>(max_lines, 1)),
+      chunks_(std::max<size_t>(max_chunks, 1)) {}
+
+void ConsoleLog::Append(const char *text, size_t length, LineKind kind) {
+  length = std::min(length, chunk_size_ - 1);
+  if (used_ + length + 1 > chunk_size_) {
+    // The oldest chunk is next, and with it the oldest lines go
+    chunk_ = (chunk_ + 1) % chunks_.size();
+    used_ = 0;
+    while (!empty() && lines_[first_ % lines_.size()].chunk == chunk_)
+      first_++;
+  }
+  if (size() == lines_.size()) first_++;
+  if (!chunks_[chunk_]) chunks_[chunk_].reset(new char[chunk_size_]);
+
+  char *dest = chunks_[chunk_].get() + used_;
+  memcpy(dest, text, length);
+  dest[length] = 0;
+  lines_[last_ % lines_.size()] = {
+    static_cast<uint32_t>(chunk_), static_cast<uint32_t>(used_),
+    static_cast<uint32_t>(length), kind
+  };
+  last_++;
+  used_ += length + 1;
+}
+
+void ConsoleLog::Clear() {
+  // The chunks are kept for the next lines
+  first_ = last_;
+  used_ = 0;
+}
+
+const char * ConsoleLog::Line(uint64_t number, const char **end) const {
+  IM_ASSERT(number >= first_ && number < last_);
+  const LineRef &line = lines_[number % lines_.size()];
+  const char *text = chunks_[line.chunk].get() + line.offset;
+  if (end != nullptr) *end = text + line.length;
+  return text;
+}
+
+ConsoleLog::LineKind ConsoleLog::Kind(uint64_t number) const {
+  IM_ASSERT(number >= first_ && number < last_);
+  return lines_[number % lines_.size()].kind;
+}
+
+ConsoleApp::ConsoleApp()
+    : Log(VKTUTO_CONSOLE_MAX_LINES, VKTUTO_CONSOLE_CHUNK_SIZE,
+          VKTUTO_CONSOLE_MAX_CHUNKS),
+      FilterIndexBegin(0), FilterScanned(0) {
   ClearLog();
   memset(InputBuf, 0, sizeof(InputBuf));
   HistoryPos = -1;
@@ -95,24 +159,89 @@ void ConsoleApp::Strtrim(char *str) {
 }
 
 void ConsoleApp::ClearLog() {
-  for (int i = 0; i < Items.Size; i++)
-    free(Items[i]);
-  Items.clear();
+  Log.Clear();
   ScrollToBottom = true;
 }
 
 void ConsoleApp::AddLog(const char* fmt, ...) IM_FMTARGS(2) {
-  // FIXME-OPT
   char buf[1024];
   va_list args;
   va_start(args, fmt);
   vsnprintf(buf, IM_ARRAYSIZE(buf), fmt, args);
   buf[IM_ARRAYSIZE(buf) - 1] = 0;
   va_end(args);
-  Items.push_back(Strdup(buf));
+
+  // Colored when drawn
+  ConsoleLog::LineKind kind = ConsoleLog::kText;
+  if (strstr(buf, "[error]")) kind = ConsoleLog::kError;
+  else if (strncmp(buf, "# ", 2) == 0) kind = ConsoleLog::kCommand;
+  // One log line per line of text, so that every line is one row high
+  const char *line = buf;
+  for (const char *line_end; (line_end = strchr(line, '\n')) != NULL;
+       line = line_end + 1)
+    Log.Append(line, (size_t)(line_end - line), kind);
+  if (line[0] != 0 || line == buf)
+    Log.Append(line, strlen(line), kind);
+  ScrollToBottom = true;
+}
+
+void ConsoleApp::AddLine(const char *text, ConsoleLog::LineKind kind) {
+  Log.Append(text, strlen(text), kind);
   ScrollToBottom = true;
 }
 
+void ConsoleApp::AddCommand(const char *name, const char *usage,
+                            CommandFn run) {
+  Commands.push_back(name);
+  AppCommands.push_back({ name, usage, std::move(run) });
+}
+
+void ConsoleApp::UpdateFilter(bool filter_changed) {
+  if (filter_changed) {
+    FilterIndex.clear();
+    FilterIndexBegin = 0;
+    FilterScanned = Log.first();
+  }
+  if (!Filter.IsActive())
+    return;
+
+  // Lines dropped from the log, or cleared
+  while (FilterIndexBegin < FilterIndex.size() &&
+         FilterIndex[FilterIndexBegin] < Log.first())
+    FilterIndexBegin++;
+  if (FilterIndexBegin > 0 && FilterIndexBegin * 2 >= FilterIndex.size()) {
+    FilterIndex.erase(FilterIndex.begin(),
+                      FilterIndex.begin() + FilterIndexBegin);
+    FilterIndexBegin = 0;
+  }
+  FilterScanned = std::max(FilterScanned, Log.first());
+
+  const uint64_t scan_end = std::min<uint64_t>(
+      Log.last(), FilterScanned + VKTUTO_CONSOLE_FILTER_LINES);
+  for (; FilterScanned < scan_end; FilterScanned++) {
+    const char *text_end;
+    const char *text = Log.Line(FilterScanned, &text_end);
+    if (Filter.PassFilter(text, text_end))
+      FilterIndex.push_back(FilterScanned);
+  }
+}
+
+void ConsoleApp::CopyToClipboard() const {
+  ImGuiTextBuffer buf;
+  const bool filtered = Filter.IsActive();
+  const size_t count = filtered ? FilterIndex.size() - FilterIndexBegin
+                                : Log.size();
+  for (size_t i = 0; i < count; i++) {
+    const uint64_t number = filtered ? FilterIndex[FilterIndexBegin + i]
+                                     : Log.first() + i;
+    const char *text_end;
+    const char *text = Log.Line(number, &text_end);
+    buf.append(text, text_end);
+    buf.append(IM_NEWLINE);
+  }
+  ImGui::SetClipboardText(buf.c_str());
+}
+
 
 void ConsoleApp::Draw() {
   ImGui::TextWrapped(
@@ -125,7 +254,7 @@ void ConsoleApp::Draw() {
   // TODO: display items starting from the bottom
 
   if (ImGui::SmallButton("Add Dummy Text")) {
-    AddLog("%d some text", Items.Size);
+    AddLog("%d some text", (int)Log.size());
     AddLog("some more text");
     AddLog("display very important message here!");
   }
@@ -150,9 +279,10 @@ void ConsoleApp::Draw() {
   ImGui::Separator();
 
   ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(0, 0));
-  static ImGuiTextFilter filter;
-  filter.Draw("Filter (\"incl,-excl\") (\"error\")", 180);
+  const bool filter_changed =
+      Filter.Draw("Filter (\"incl,-excl\") (\"error\")", 180);
   ImGui::PopStyleVar();
+  UpdateFilter(filter_changed);
   ImGui::Separator();
 
   const float footer_height_to_reserve =  ImGui::GetStyle().ItemSpacing.y +
@@ -168,50 +298,48 @@ void ConsoleApp::Draw() {
     ImGui::EndPopup();
   }
 
-  // Display every line as a separate entry so we can change their color or add
-  // custom widgets. If you only want raw text you 
-  // can use ImGui::TextUnformatted(log.begin(), log.end());
-  // NB- if you have thousands of entries this approach may be too inefficient
-  // and may require user-side clipping to only process visible items.
-  // You can seek and display only the lines that are visible using
-  // the ImGuiListClipper helper, if your elements are evenly spaced and you
-  // have cheap random access to the elements.
-  // To use the clipper we could replace 
-  // the 'for (int i = 0; i < Items.Size; i++)' loop with:
-  //     ImGuiListClipper clipper(Items.Size);
-  //     while (clipper.Step())
-  //         for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
-  // However, note that you can not use this code as is if a filter is active
-  // because it breaks the 'cheap random-access' property. We would need
-  // random-access on the post-filtered list.
-  // A typical application wanting coarse clipping and filtering may want
-  // to pre-compute an array of indices that passed the filtering test,
-  // recomputing this array when user changes the filter,
-  // and appending newly elements as they are inserted. This is left as a task
-  // to the user until we can manage to improve this example code!
-  // If your items are of variable size you may want to implement code similar
-  // to what ImGuiListClipper does. Or split your data into fixed height items
-  // to allow random-seeking into your list.
-
+  if (copy_to_clipboard)
+    CopyToClipboard();
+  // Every line is one row high, so only the rows in view are laid out; with
+  // a filter, they are looked up in the index of the lines that pass it
   // Tighten spacing
   ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(4, 1));
-  if (copy_to_clipboard)
-    ImGui::LogToClipboard();
-  ImVec4 col_default_text = ImGui::GetStyleColorVec4(ImGuiCol_Text);
-  for (int i = 0; i < Items.Size; i++) {
-    const char *item = Items[i];
-    if (!filter.PassFilter(item))
-      continue;
-    ImVec4 col = col_default_text;
-    if (strstr(item, "[error]")) col = ImColor(1.0f, 0.4f, 0.4f, 1.0f);
-    else if (strncmp(item, "# ", 2) == 0) col = ImColor(1.0f, 0.78f,
-                                                        0.58f, 1.0f);
-    ImGui::PushStyleColor(ImGuiCol_Text, col);
-    ImGui::TextUnformatted(item);
-    ImGui::PopStyleColor();
+  const bool filtered = Filter.IsActive();
+  const int count = (int)(filtered ? FilterIndex.size() - FilterIndexBegin
+                                   : Log.size());
+  // Table columns are so many characters wide; digits are, in most fonts,
+  // of one width
+  const float digit_width = ImGui::CalcTextSize("0").x;
+  const float line_x = ImGui::GetCursorPosX();
+  ImGuiListClipper clipper(count);
+  while (clipper.Step()) {
+    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+      const uint64_t number = filtered ? FilterIndex[FilterIndexBegin + i]
+                                       : Log.first() + i;
+      const char *text_end;
+      const char *text = Log.Line(number, &text_end);
+      const ConsoleLog::LineKind kind = Log.Kind(number);
+      if (kind == ConsoleLog::kText) {
+        ImGui::TextUnformatted(text, text_end);
+        continue;
+      }
+      if (kind == ConsoleLog::kTable || kind == ConsoleLog::kTableHeader) {
+        if (kind == ConsoleLog::kTableHeader)
+          ImGui::PushStyleColor(
+              ImGuiCol_Text, ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled));
+        DrawTableRow(text, text_end, line_x, digit_width);
+        if (kind == ConsoleLog::kTableHeader)
+          ImGui::PopStyleColor();
+        continue;
+      }
+      const ImVec4 col = kind == ConsoleLog::kError
+                             ? ImColor(1.0f, 0.4f, 0.4f, 1.0f)
+                             : ImColor(1.0f, 0.78f, 0.58f, 1.0f);
+      ImGui::PushStyleColor(ImGuiCol_Text, col);
+      ImGui::TextUnformatted(text, text_end);
+      ImGui::PopStyleColor();
+    }
   }
-  if (copy_to_clipboard)
-    ImGui::LogFinish();
   if (ScrollToBottom)
     ImGui::SetScrollHereY(1.0f);
   ScrollToBottom = false;
@@ -254,22 +382,87 @@ void ConsoleApp::ExecCommand(const char *command_line) {
     }
   History.push_back(Strdup(command_line));
 
+  // Words of the command line; the first one may name an app command
+  std::vector<std::string> args;
+  for (const char *word = command_line; *word; ) {
+    while (*word == ' ' || *word == '\t')
+      word++;
+    const char *word_end = word;
+    while (*word_end && *word_end != ' ' && *word_end != '\t')
+      word_end++;
+    if (word_end > word)
+      args.emplace_back(word, word_end);
+    word = word_end;
+  }
+  const AppCommand *app_command = NULL;
+  for (const AppCommand &command : AppCommands)
+    if (!args.empty() && Stricmp(command.name, args[0].c_str()) == 0)
+      app_command = &command;
+
   // Process command
   if (Stricmp(command_line, "CLEAR") == 0) {
     ClearLog();
   } else if (Stricmp(command_line, "HELP") == 0) {
     AddLog("Commands:");
-    for (int i = 0; i < Commands.Size; i++)
-      AddLog("- %s", Commands[i]);
+    for (int i = 0; i < Commands.Size; i++) {
+      const char *usage = "";
+      for (const AppCommand &command : AppCommands)
+        if (command.name == Commands[i])
+          usage = command.usage;
+      AddLog("- %s%s%s", Commands[i], usage[0] ? " " : "", usage);
+    }
   } else if (Stricmp(command_line, "HISTORY") == 0) {
     int first = History.Size - 10;
     for (int i = first > 0 ? first : 0; i < History.Size; i++)
       AddLog("%3d: %s\n", i, History[i]);
+  } else if (app_command != NULL) {
+    args.erase(args.begin());
+    // A failed command, e.g. on a number it could not parse, only reports
+    try {
+      app_command->run(args);
+    }
+    catch (const std::exception &except) {
+      AddLog("[error] %s: %s", app_command->name, except.what());
+    }
   } else {
     AddLog("Unknown command: '%s'\n", command_line);
   }
 }
 
+void ConsoleApp::DrawTableRow(const char *text, const char *text_end,
+                              float line_x, float digit_width) {
+  // Cells are separated by two spaces or more; the first one starts at its
+  // column, the others end at theirs
+  bool first_cell = true;
+  const char *cell_end = text;
+  for (;;) {
+    const char *cell = cell_end;
+    while (cell < text_end && *cell == ' ')
+      cell++;
+    if (cell == text_end)
+      break;
+    cell_end = cell;
+    while (cell_end < text_end &&
+           !(cell_end[0] == ' ' && (cell_end + 1 == text_end ||
+                                    cell_end[1] == ' ')))
+      cell_end++;
+    float cell_x = line_x + digit_width * (float)(cell - text);
+    if (!first_cell) {
+      cell_x = line_x + digit_width * (float)(cell_end - text) -
+               ImGui::CalcTextSize(cell, cell_end).x;
+      ImGui::SameLine(cell_x);
+    }
+    else {
+      ImGui::SetCursorPosX(cell_x);
+    }
+    ImGui::TextUnformatted(cell, cell_end);
+    first_cell = false;
+  }
+  // An empty row is still a row
+  if (first_cell)
+    ImGui::TextUnformatted("");
+}
+
 int ConsoleApp::TextEditCallbackStub(ImGuiInputTextCallbackData *data) {
   ConsoleApp *console = (ConsoleApp *)data->UserData;
   return console->TextEditCallback(data);
@@ -367,6 +560,54 @@ int ConsoleApp::TextEditCallback(ImGuiInputTextCallbackData *data) {
   return 0;
 }
 
+ConsoleTable::ConsoleTable(std::vector<std::string> header) {
+  rows_.push_back(std::move(header));
+}
+
+void ConsoleTable::AddRow(std::vector<std::string> cells) {
+  rows_.push_back(std::move(cells));
+}
+
+std::string ConsoleTable::Format(const char *fmt, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, IM_ARRAYSIZE(buf), fmt, args);
+  buf[IM_ARRAYSIZE(buf) - 1] = 0;
+  va_end(args);
+  return buf;
+}
+
+void ConsoleTable::Print(ConsoleApp &console) const {
+  std::vector<size_t> widths;
+  for (const std::vector<std::string> &row : rows_) {
+    if (widths.size() < row.size())
+      widths.resize(row.size(), 0);
+    for (size_t col = 0; col < row.size(); col++)
+      widths[col] = std::max(widths[col], row[col].size());
+  }
+  std::string line;
+  for (size_t row = 0; row < rows_.size(); row++) {
+    line.clear();
+    for (size_t col = 0; col < widths.size(); col++) {
+      const std::string empty;
+      const std::string &cell = col < rows_[row].size() ? rows_[row][col]
+                                                        : empty;
+      const size_t pad = widths[col] - cell.size();
+      if (col == 0) {
+        line += cell;
+        line.append(pad, ' ');
+      }
+      else {
+        line.append(2 + pad, ' ');
+        line += cell;
+      }
+    }
+    console.AddLine(line.c_str(), row == 0 ? ConsoleLog::kTableHeader
+                                           : ConsoleLog::kTable);
+  }
+}
+
 } // inline namespace utility
 
 } // name vktuto
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "vktuto_vertex_format.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace vktuto {
+
+inline namespace opengl3 {
+
+namespace {
+
+inline int16_t ToSnorm16(float value) {
+  value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+  return static_cast<int16_t>(std::lround(value * 32767.0f));
+}
+
+inline uint16_t ToUnorm16(float value) {
+  value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+  return static_cast<uint16_t>(std::lround(value * 65535.0f));
+}
+
+inline float SignNotZero(float value) {
+  return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+// Writes vertices [first, first + count) using the layout and bounding box
+// already set in 'out'
+void PackRange(const glm::vec3 *positions, const glm::vec3 *normals,
+               size_t first, size_t count, PackedVertices &out) {
+  const bool quantized = out.format == VertexFormat::kQuantized;
+  glm::vec3 inv_scale;
+  for (int axis = 0; axis < 3; axis++) {
+    inv_scale[axis] = out.position_scale[axis] > 0.0f
+                          ? 1.0f / out.position_scale[axis] : 0.0f;
+  }
+
+  uint8_t *dst = out.bytes.data() + first * out.stride;
+  for (size_t idx = first; idx < first + count; idx++, dst += out.stride) {
+    if (quantized) {
+      glm::vec3 unit = (positions[idx] - out.position_offset) * inv_scale;
+      uint16_t packed[4] = { ToUnorm16(unit.x), ToUnorm16(unit.y),
+                             ToUnorm16(unit.z), 0 };
+      std::memcpy(dst, packed, sizeof(packed));
+    }
+    else {
+      std::memcpy(dst, &positions[idx], sizeof(glm::vec3));
+    }
+    if (normals) {
+      int16_t encoded[2];
+      OctEncode(normals[idx], encoded);
+      std::memcpy(dst + out.normal_offset, encoded, sizeof(encoded));
+    }
+  }
+}
+
+} // namespace
+
+void OctEncode(const glm::vec3 &normal, int16_t encoded[2]) {
+  float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+  if (l1 == 0.0f) {
+    encoded[0] = encoded[1] = 0;
+    return;
+  }
+  float x = normal.x / l1, y = normal.y / l1;
+  if (normal.z < 0.0f) {
+    // Fold the lower hemisphere over the diagonals
+    float fx = (1.0f - std::abs(y)) * SignNotZero(x);
+    float fy = (1.0f - std::abs(x)) * SignNotZero(y);
+    x = fx; y = fy;
+  }
+  encoded[0] = ToSnorm16(x);
+  encoded[1] = ToSnorm16(y);
+}
+
+glm::vec3 OctDecode(const int16_t encoded[2]) {
+  float x = encoded[0] / 32767.0f, y = encoded[1] / 32767.0f;
+  glm::vec3 normal(x, y, 1.0f - std::abs(x) - std::abs(y));
+  float t = normal.z < 0.0f ? -normal.z : 0.0f;
+  normal.x += normal.x >= 0.0f ? -t : t;
+  normal.y += normal.y >= 0.0f ? -t : t;
+  return glm::normalize(normal);
+}
+
+void PackVertices(const glm::vec3 *positions, const glm::vec3 *normals,
+                  size_t count, VertexFormat format, PackedVertices &out) {
+  const bool quantized = format == VertexFormat::kQuantized;
+  const size_t position_bytes = quantized ? 4 * sizeof(uint16_t)
+                                          : sizeof(glm::vec3);
+  out.format = format;
+  out.has_normals = normals != nullptr;
+  out.count = count;
+  out.normal_offset = position_bytes;
+  out.stride = position_bytes + (out.has_normals ? 2 * sizeof(int16_t) : 0);
+  out.bytes.resize(count * out.stride);
+  out.position_offset = glm::vec3(0.0f);
+  out.position_scale = glm::vec3(1.0f);
+
+  if (quantized && count > 0) {
+    glm::vec3 lower = positions[0], upper = positions[0];
+    for (size_t idx = 1; idx < count; idx++) {
+      lower = glm::min(lower, positions[idx]);
+      upper = glm::max(upper, positions[idx]);
+    }
+    out.position_offset = lower;
+    out.position_scale = upper - lower;
+  }
+  PackRange(positions, normals, 0, count, out);
+}
+
+bool PackVertexRange(const glm::vec3 *positions, const glm::vec3 *normals,
+                     size_t first, size_t count, PackedVertices &packed) {
+  if (first + count > packed.count || (normals != nullptr) != packed.has_normals)
+    return false;
+  if (packed.format == VertexFormat::kQuantized) {
+    glm::vec3 upper = packed.position_offset + packed.position_scale;
+    for (size_t idx = first; idx < first + count; idx++) {
+      glm::vec3 pos = positions[idx];
+      for (int axis = 0; axis < 3; axis++) {
+        if (pos[axis] < packed.position_offset[axis] || pos[axis] > upper[axis])
+          return false;
+      }
+    }
+  }
+  PackRange(positions, normals, first, count, packed);
+  return true;
+}
+
+} // inline namespace opengl3
+
+} // namespace vktuto
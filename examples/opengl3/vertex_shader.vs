@@ -2,14 +2,43 @@
 
 layout(location = 0) in vec3 vertexPosition;
 layout(location = 1) in vec4 vertexColor;
+layout(location = 2) in vec2 vertexNormal;  // octahedral-encoded
 
 uniform mat4 MVP;
+uniform mat4 Model;
+// Quantized positions are restored as positionOffset + positionScale * x
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+// Per-object color unless the mesh carries vertex colors
+uniform vec4 objectColor;
+uniform bool useVertexColor;
+uniform bool hasNormals;
+// Level-of-detail skirts: vertices from skirtFirstVertex on are copies of
+// patch edge vertices, pushed back along the normal to cover cracks
+uniform int skirtFirstVertex;
+uniform float skirtDepth;
 
 out vec4 Frag_Color;
 
+vec3 OctDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
 void main() {
-	gl_Position = MVP * vec4(vertexPosition, 1.0);
-	Frag_Color = vertexColor;
+	vec3 position = positionOffset + positionScale * vertexPosition;
+	if (hasNormals && gl_VertexID >= skirtFirstVertex)
+		position -= skirtDepth * OctDecode(vertexNormal);
+	gl_Position = MVP * vec4(position, 1.0);
+	vec4 color = useVertexColor ? vertexColor : objectColor;
+	if (hasNormals) {
+		vec3 normal = mat3(Model) * OctDecode(vertexNormal);
+		color.rgb *= 0.35 + 0.65 * abs(normal.z);
+	}
+	Frag_Color = color;
 }
 
 /*